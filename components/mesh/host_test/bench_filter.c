@@ -0,0 +1,126 @@
+/* Host benchmark: reading filter compiler and interpreter
+ *
+ * Checks compiled predicates against the same predicates written in C,
+ * checks that malformed and over-nested expressions are rejected, then
+ * measures the interpreter's cost per reading on the host CPU next to the
+ * native predicate.
+ */
+
+#include "mesh_filter_engine.h"
+#include "test_support.h"
+#include <math.h>
+#include <string.h>
+
+#define SAMPLES (10000000)
+
+typedef bool (*native_t)(uint8_t channel, float value);
+
+typedef struct {
+  const char *expr;
+  native_t native;
+} case_t;
+
+static bool band(uint8_t ch, float v) {
+  return ch == 0 && (v > 25.5f || v < -5);
+}
+
+static bool near(uint8_t ch, float v) {
+  (void)ch;
+  return fabsf(v - 20) >= 2.5f;
+}
+
+static bool other(uint8_t ch, float v) {
+  (void)v;
+  return !(ch == 1);
+}
+
+static bool mixed(uint8_t ch, float v) {
+  return v * 2 + 1 > 3 || (ch != 3 && -v < 0);
+}
+
+static const case_t s_cases[] = {
+    {"channel == 0 && (value > 25.5 || value < -5)", band},
+    {"abs(value - 20) >= 2.5", near},
+    {"!(ch==1)", other},
+    {"value*2+1 > 3 || ch != 3 && -value < 0", mixed},
+};
+
+static void repeat(char *buf, const char *prefix, int n, const char *suffix) {
+  buf[0] = '\0';
+  for (int i = 0; i < n; i++) {
+    strcat(buf, prefix);
+  }
+  strcat(buf, "1");
+  for (int i = 0; suffix != NULL && i < n; i++) {
+    strcat(buf, suffix);
+  }
+}
+
+static void check_rejects(void) {
+  static const char *bad[] = {"value >", "1 2", "(value", "abs value",
+                              "value <> 1", "", "channel == 0 &&"};
+  uint8_t code[MESH_FILTER_MAX_CODE];
+  uint16_t length;
+  char expr[4096];
+
+  for (unsigned i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+    CHECK(mesh_filter_compile(bad[i], code, sizeof(code), &length) ==
+          ESP_ERR_INVALID_ARG);
+  }
+
+  // Nesting up to the limit compiles, one more level is refused
+  repeat(expr, "(", MESH_FILTER_MAX_NESTING, ")");
+  CHECK(mesh_filter_compile(expr, code, sizeof(code), &length) == ESP_OK);
+  repeat(expr, "(", MESH_FILTER_MAX_NESTING + 1, ")");
+  CHECK(mesh_filter_compile(expr, code, sizeof(code), &length) ==
+        ESP_ERR_INVALID_SIZE);
+
+  // Deep input is refused without following it down the stack
+  static const char *deep[] = {"(", "-", "!", "abs("};
+  for (unsigned i = 0; i < sizeof(deep) / sizeof(deep[0]); i++) {
+    repeat(expr, deep[i], 1000, NULL);
+    CHECK(mesh_filter_compile(expr, code, sizeof(code), &length) ==
+          ESP_ERR_INVALID_SIZE);
+  }
+}
+
+int main(void) {
+  uint8_t code[MESH_FILTER_MAX_CODE];
+  uint16_t length;
+  uint32_t seed = 57;
+
+  check_rejects();
+
+  printf("%-46s %5s %10s %10s\n", "expression", "bytes", "ns/eval",
+         "native ns");
+  for (unsigned i = 0; i < sizeof(s_cases) / sizeof(s_cases[0]); i++) {
+    const case_t *t = &s_cases[i];
+    CHECK(mesh_filter_compile(t->expr, code, sizeof(code), &length) == ESP_OK);
+    CHECK(mesh_filter_validate(code, length) == ESP_OK);
+
+    for (int k = 0; k < 10000; k++) {
+      uint8_t ch = test_rand(&seed) % 4;
+      float v = (float)(test_rand(&seed) % 8000) / 100.0f - 40.0f;
+      CHECK(mesh_filter_eval(code, length, ch, v) == t->native(ch, v));
+    }
+
+    volatile int matches = 0;
+    uint64_t start = test_now_ns();
+    for (int k = 0; k < SAMPLES; k++) {
+      matches += mesh_filter_eval(code, length, k & 3, (float)(k % 80) - 40);
+    }
+    uint64_t interp = test_now_ns() - start;
+
+    native_t volatile native = t->native;
+    start = test_now_ns();
+    for (int k = 0; k < SAMPLES; k++) {
+      matches += native(k & 3, (float)(k % 80) - 40);
+    }
+    uint64_t direct = test_now_ns() - start;
+
+    printf("%-46s %5u %10.1f %10.1f\n", t->expr, length,
+           (double)interp / SAMPLES, (double)direct / SAMPLES);
+  }
+  printf("bench_filter: ok\n");
+  return 0;
+}
@@ -0,0 +1,72 @@
+/* In-Memory Flash Partition Implementation */
+
+#include "mem_flash.h"
+#include "test_support.h"
+#include <stdbool.h>
+#include <string.h>
+
+void mem_flash_init(mem_flash_t *flash, uint32_t size) {
+  CHECK(size % MEM_FLASH_SECTOR_SIZE == 0);
+  CHECK(size / MEM_FLASH_SECTOR_SIZE <= MEM_FLASH_MAX_SECTORS);
+
+  memset(flash, 0, sizeof(*flash));
+  flash->data = malloc(size);
+  CHECK(flash->data != NULL);
+  memset(flash->data, 0xFF, size);
+  flash->size = size;
+}
+
+void mem_flash_deinit(mem_flash_t *flash) {
+  free(flash->data);
+  flash->data = NULL;
+}
+
+esp_err_t mem_flash_read(void *ctx, uint32_t offset, void *data,
+                         uint32_t size) {
+  mem_flash_t *flash = ctx;
+
+  if (offset > flash->size || size > flash->size - offset) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  memcpy(data, flash->data + offset, size);
+  flash->bytes_read += size;
+  return ESP_OK;
+}
+
+esp_err_t mem_flash_write(void *ctx, uint32_t offset, const void *data,
+                          uint32_t size) {
+  mem_flash_t *flash = ctx;
+  const uint8_t *bytes = data;
+  bool dirty = false;
+
+  if (offset > flash->size || size > flash->size - offset) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  for (uint32_t i = 0; i < size; i++) {
+    uint8_t *cell = &flash->data[offset + i];
+    if (bytes[i] & ~*cell) {
+      dirty = true;
+    }
+    *cell &= bytes[i];
+  }
+  flash->bytes_written += size;
+  flash->dirty_writes += dirty;
+  return ESP_OK;
+}
+
+esp_err_t mem_flash_erase(void *ctx, uint32_t offset, uint32_t size) {
+  mem_flash_t *flash = ctx;
+
+  if (offset % MEM_FLASH_SECTOR_SIZE != 0 ||
+      size % MEM_FLASH_SECTOR_SIZE != 0 || offset > flash->size ||
+      size > flash->size - offset) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  memset(flash->data + offset, 0xFF, size);
+  for (uint32_t s = offset / MEM_FLASH_SECTOR_SIZE;
+       s < (offset + size) / MEM_FLASH_SECTOR_SIZE; s++) {
+    flash->erase_count[s]++;
+    flash->sectors_erased++;
+  }
+  return ESP_OK;
+}
@@ -0,0 +1,57 @@
+/* In-Memory Flash Partition
+ *
+ * Emulates a NOR flash partition in RAM for the host tests: erase sets
+ * whole 4 KB sectors to 0xFF and writes can only clear bits. Callbacks
+ * match mesh_ota_storage_t and mesh_flash_log_backend_t.
+ */
+
+#ifndef __MEM_FLASH_H__
+#define __MEM_FLASH_H__
+
+#include "esp_err.h"
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MEM_FLASH_SECTOR_SIZE (4096)
+#define MEM_FLASH_MAX_SECTORS (256)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief Emulated partition and its wear counters
+ */
+typedef struct {
+  uint8_t *data;
+  uint32_t size;
+  uint32_t bytes_read;
+  uint32_t bytes_written;
+  uint32_t sectors_erased;
+  uint32_t dirty_writes; /**< Writes that tried to set a cleared bit */
+  uint32_t erase_count[MEM_FLASH_MAX_SECTORS];
+} mem_flash_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Allocate an erased partition of size bytes, a multiple of a sector
+ */
+void mem_flash_init(mem_flash_t *flash, uint32_t size);
+
+/**
+ * @brief Free the partition
+ */
+void mem_flash_deinit(mem_flash_t *flash);
+
+esp_err_t mem_flash_read(void *ctx, uint32_t offset, void *data,
+                         uint32_t size);
+esp_err_t mem_flash_write(void *ctx, uint32_t offset, const void *data,
+                          uint32_t size);
+esp_err_t mem_flash_erase(void *ctx, uint32_t offset, uint32_t size);
+
+#endif /* __MEM_FLASH_H__ */
@@ -0,0 +1,201 @@
+/* Host simulation: relay load balancing on a generated 200-node tree
+ *
+ * Nodes join independently, each picking the best parent by score, which
+ * leaves some relays carrying far more traffic than others on their
+ * layer. Every node then reports its traffic to the root's topology map
+ * through the delta frame encoder every 10 s. Every 30 s the root
+ * publishes the busy relays and plans one steer; the steered node rescans
+ * with the busy penalty applied and avoids its old parent. The relayed
+ * traffic of the busiest relay per layer is compared before and after
+ * three hours.
+ */
+
+#include "mesh_balance_engine.h"
+#include "sim_tree.h"
+#include "test_support.h"
+#include <math.h>
+#include <string.h>
+
+#define NODES (200)
+#define REPORT_MS (10000)
+#define RUN_MS (3 * 3600 * 1000)
+#define LAYERS (6)
+
+static sim_tree_t s_tree;
+static mesh_topology_engine_t s_topology;
+static mesh_topology_encoder_t s_encoders[NODES];
+static uint32_t s_tx[NODES], s_rate[NODES];
+static mesh_balance_busy_t s_busy[MESH_BALANCE_MAX_BUSY];
+static int s_busy_count;
+static int s_avoid[NODES];
+static uint32_t s_avoid_until[NODES], s_now;
+static uint32_t s_moved_at[NODES];
+
+static void sta_mac(int node, uint8_t *mac) {
+  memset(mac, 0, 6);
+  mac[0] = 0x24;
+  mac[3] = (uint8_t)(node >> 8);
+  mac[4] = (uint8_t)node;
+}
+
+static int node_of(const uint8_t *mac) { return mac[3] << 8 | mac[4]; }
+
+/* Busy penalty as applied in mesh_scan_done_handler, plus the old parent */
+static int penalty(void *ctx, int node, int parent) {
+  const mesh_balance_config_t *config = ctx;
+  uint8_t bssid[6];
+  int score = 0;
+
+  sta_mac(parent, bssid);
+  bssid[5] += 1;
+  for (int i = 0; i < s_busy_count; i++) {
+    if (memcmp(s_busy[i].bssid, bssid, 6) == 0) {
+      score += s_busy[i].penalty;
+    }
+  }
+  if (s_avoid[node] == parent && s_now < s_avoid_until[node]) {
+    score += 2 * config->busy_penalty;
+  }
+  return score;
+}
+
+static void report(void) {
+  for (int i = 1; i < NODES; i++) {
+    if (s_tree.layer[i] == 0) {
+      continue;
+    }
+    mesh_topology_sample_t sample = {
+        .layer = (uint8_t)s_tree.layer[i],
+        .children = (uint8_t)s_tree.children[i],
+        .tx_packets = s_tx[i] += s_rate[i],
+    };
+    uint8_t frame[MESH_TOPOLOGY_MAX_FRAME], mac[6];
+    sta_mac(s_tree.parent[i], sample.parent);
+    sta_mac(i, mac);
+    uint16_t length = mesh_topology_encode(&s_encoders[i], &sample,
+                                           !s_encoders[i].primed, frame);
+    CHECK(mesh_topology_engine_apply(&s_topology, mac, frame, length,
+                                     s_now) == ESP_OK);
+  }
+}
+
+/**
+ * @brief Busiest relay over the mean relay of its layer, per layer
+ */
+static void layer_ratios(double *ratio) {
+  double sum[LAYERS + 1] = {0}, max[LAYERS + 1] = {0};
+  int count[LAYERS + 1] = {0};
+
+  for (int i = 1; i < NODES; i++) {
+    uint8_t mac[6];
+    sta_mac(i, mac);
+    int k = mesh_topology_engine_find(&s_topology, mac);
+    int layer = s_tree.layer[i];
+    if (k < 0 || layer > LAYERS) {
+      continue;
+    }
+    const mesh_topology_node_t *node = &s_topology.nodes[k];
+    double relayed = node->first_child == MESH_TOPOLOGY_NONE
+                         ? 0
+                         : node->subtree_traffic - node->traffic;
+    sum[layer] += relayed;
+    count[layer]++;
+    max[layer] = fmax(max[layer], relayed);
+  }
+  for (int l = 2; l <= LAYERS; l++) {
+    ratio[l] = (count[l] > 1 && sum[l] > 0) ? max[l] / (sum[l] / count[l])
+                                            : 0;
+  }
+}
+
+int main(void) {
+  sim_tree_config_t tree_config = {
+      .count = NODES,
+      .max_children = 6,
+      .max_layer = 25,
+      .area = 7.0 * sqrt(NODES),
+      .range = 30.0,
+      .seed = 68,
+  };
+  mesh_balance_config_t config;
+  mesh_balance_history_t history = {0};
+  uint32_t seed = 68;
+  uint8_t root[6];
+  double before[LAYERS + 1], after[LAYERS + 1];
+  int moves = 0, declined = 0;
+
+  CHECK(sim_tree_generate(&s_tree, &tree_config) == NODES - 1);
+  for (int i = 1; i < NODES; i++) {
+    s_rate[i] = 1 + test_rand(&seed) % 10;
+    s_avoid[i] = SIM_TREE_NONE;
+  }
+  mesh_balance_config_default(&config);
+  mesh_topology_engine_init(&s_topology);
+  sta_mac(0, root);
+  CHECK(mesh_topology_engine_set_root(&s_topology, root) == ESP_OK);
+
+  for (int k = 0; k < 20; k++, s_now += REPORT_MS) {
+    report();
+  }
+  layer_ratios(before);
+
+  for (uint32_t end = s_now + RUN_MS; s_now < end; s_now += REPORT_MS) {
+    report();
+    if (s_now % config.period_ms != 0) {
+      continue;
+    }
+    s_busy_count = mesh_balance_find_busy(&s_topology, &config, s_busy,
+                                          MESH_BALANCE_MAX_BUSY);
+    mesh_balance_steer_t steer;
+    if (!mesh_balance_plan_steer(&s_topology, &config, &history, s_now,
+                                 &steer)) {
+      continue;
+    }
+    int child = node_of(steer.child), old = node_of(steer.parent);
+    CHECK(s_tree.parent[child] == old);
+    CHECK(steer.moved < steer.relayed);
+    CHECK(s_moved_at[child] == 0 ||
+          s_now - s_moved_at[child] >= config.node_cooldown_ms);
+    int parent =
+        sim_tree_choose_parent(&s_tree, child, old, penalty, &config);
+    if (parent == SIM_TREE_NONE) {
+      declined++; // the node stays, as it would after an empty scan
+      continue;
+    }
+    s_avoid[child] = old;
+    s_avoid_until[child] = s_now + config.avoid_ms;
+    s_moved_at[child] = s_now;
+    sim_tree_set_parent(&s_tree, child, parent);
+    moves++;
+  }
+  layer_ratios(after);
+
+  printf("busiest relay / layer mean:");
+  for (int l = 2; l <= LAYERS; l++) {
+    printf("  L%d %.2f -> %.2f", l, before[l], after[l]);
+  }
+  printf("\n%d moves, %d declined in 3 h, one steer per %u s at most\n",
+         moves, declined, (unsigned)(config.steer_interval_ms / 1000));
+
+  // Rate limits hold, no layer gets worse and the worst one improves
+  uint32_t max_steers = RUN_MS / config.steer_interval_ms + 1;
+  CHECK((uint32_t)(moves + declined) <= max_steers);
+  double worst_before = 0, worst_after = 0;
+  for (int l = 2; l <= LAYERS; l++) {
+    CHECK(after[l] <= before[l] + 0.05);
+    worst_before = fmax(worst_before, before[l]);
+    worst_after = fmax(worst_after, after[l]);
+  }
+  CHECK(moves > 0 && worst_after < worst_before * 0.75);
+
+  // A ratio below 100 % must not turn the layer mean into an underflow
+  config.traffic_ratio_percent = 50;
+  history = (mesh_balance_history_t){0};
+  mesh_balance_steer_t steer;
+  if (mesh_balance_plan_steer(&s_topology, &config, &history, s_now,
+                              &steer)) {
+    CHECK(steer.moved < steer.relayed);
+  }
+  printf("sim_balance: ok\n");
+  return 0;
+}
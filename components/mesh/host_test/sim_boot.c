@@ -0,0 +1,306 @@
+/* Host simulation: time to the first packet on cold and warm boots
+ *
+ * Boots nodes of a generated 200-node tree the way mesh.c does after
+ * MESH_EVENT_STARTED, on three paths:
+ *
+ * - power-on: the RTC records are gone, so the node scans every channel;
+ * - cold: a software reset with fast boot off. The parent cache survives
+ *   in RTC memory, so the node scans the cached channel first;
+ * - warm: fast boot. The node connects straight to its saved parent. If
+ *   that parent is not up, the attempt fails and the node drops it and
+ *   falls back to the cold path.
+ *
+ * In the first scenario one node resets while the rest of the mesh stays
+ * up. In the second every node restarts at once with the same firmware,
+ * so a saved parent may not be up yet when its child tries it.
+ *
+ * Radio timings are those of sim_rejoin.c: a passive scan dwells 360 ms on
+ * a channel, parents are picked with the parent selection engine from the
+ * beacons heard, and connecting takes 250-550 ms. A connection to a parent
+ * that is not there fails after 1-1.5 s. mesh_init() takes 250-350 ms on
+ * every path, and a packet takes 10 ms per hop to the root. The root joins
+ * the router, which is always up, the same way.
+ */
+
+#include "mesh_parent_select.h"
+#include "sim_tree.h"
+#include "test_support.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NODES (200)
+#define RESETS (2000)
+#define CHANNELS (13)
+#define MESH_CHANNEL (6)
+#define DWELL_MS (360)
+#define BEACONS_PER_DWELL (3)
+#define HOP_MS (10)
+#define ROUTER (-2) /* parent of the root */
+
+typedef enum {
+  PATH_POWER_ON,
+  PATH_COLD,
+  PATH_WARM,
+  PATH_MAX,
+} boot_path_t;
+
+static const char *s_path_names[PATH_MAX] = {"power-on", "cold", "warm"};
+static sim_tree_t s_steady; /* the mesh before the reset */
+static sim_tree_t s_tree;   /* the mesh being rebuilt */
+static mesh_parent_engine_t s_engine;
+static uint32_t s_up_ms[NODES]; /* connected to a parent, 0 = not yet */
+static uint32_t s_seed = 64;
+
+static uint32_t uniform(uint32_t low, uint32_t high) {
+  return low + test_rand(&s_seed) % (high - low + 1);
+}
+
+static bool heard(int rssi) {
+  // Beacon loss from 0 at -60 dBm to 90 % at -87 dBm
+  double loss = fmin(0.9, fmax(0.0, (-60.0 - rssi) / 30.0));
+  for (int b = 0; b < BEACONS_PER_DWELL; b++) {
+    if (test_rand(&s_seed) % 1000 >= loss * 1000) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool is_up(int node, uint32_t now) {
+  return node == ROUTER || (s_tree.layer[node] != 0 && s_up_ms[node] != 0 &&
+                            s_up_ms[node] <= now);
+}
+
+/**
+ * @brief One passive scan of one channel, ending at now
+ *
+ * @return Parent picked from the candidates heard, SIM_TREE_NONE if none
+ */
+static int scan_channel(int node, int channel, uint32_t now) {
+  mesh_parent_candidate_t candidates[SIM_TREE_MAX_NODES];
+  int index[SIM_TREE_MAX_NODES];
+  int count = 0;
+
+  if (channel != MESH_CHANNEL) {
+    return SIM_TREE_NONE;
+  }
+  if (node == 0) {
+    return ROUTER;
+  }
+  for (int p = 0; p < NODES; p++) {
+    if (p == node || !is_up(p, now) || sim_tree_in_subtree(&s_tree, p, node) ||
+        s_tree.layer[p] >= s_tree.max_layer) {
+      continue;
+    }
+    int rssi = sim_tree_rssi(&s_tree, node, p);
+    if (rssi < MESH_PARENT_DEFAULT_MIN_RSSI || !heard(rssi)) {
+      continue;
+    }
+    mesh_parent_candidate_t *c = &candidates[count];
+    memset(c, 0, sizeof(*c));
+    c->bssid[4] = (uint8_t)(p >> 8);
+    c->bssid[5] = (uint8_t)p;
+    c->rssi = rssi;
+    c->layer = s_tree.layer[p];
+    c->layer_cap = s_tree.max_layer - s_tree.layer[p];
+    c->assoc = s_tree.children[p];
+    c->assoc_cap = s_tree.max_children;
+    index[count++] = p;
+  }
+  int chosen = mesh_parent_engine_select(&s_engine, candidates, count, NULL);
+  return chosen >= 0 ? index[chosen] : SIM_TREE_NONE;
+}
+
+static void join(int node, int parent, uint32_t now) {
+  if (parent == ROUTER) {
+    s_tree.layer[node] = 1;
+  } else {
+    sim_tree_set_parent(&s_tree, node, parent);
+  }
+  s_up_ms[node] = now + uniform(250, 550);
+}
+
+/**
+ * @brief A node's boot, one step at a time
+ */
+typedef struct {
+  boot_path_t path;
+  uint32_t next_ms;  /* time of the next step */
+  int cached;        /* cached channels left to scan */
+  int channel;       /* next channel of the full scan */
+  bool tried_parent; /* warm: saved parent tried */
+  bool done;
+} boot_t;
+
+static void boot_start(boot_t *boot, boot_path_t path, uint32_t reset_ms) {
+  memset(boot, 0, sizeof(*boot));
+  boot->path = path;
+  boot->next_ms = reset_ms + uniform(250, 350);
+  boot->channel = 1;
+  if (path != PATH_POWER_ON) {
+    mesh_parent_cache_t cache = {0};
+    mesh_parent_cache_entry_t entry = {.channel = MESH_CHANNEL,
+                                       .seen_s = 1000};
+    uint8_t channels[MESH_PARENT_CACHE_SIZE];
+    mesh_parent_cache_validate(&cache);
+    mesh_parent_cache_update(&cache, &entry);
+    boot->cached = mesh_parent_cache_channels(
+        &cache, 1000, MESH_PARENT_CACHE_MAX_AGE_S, channels,
+        MESH_PARENT_CACHE_SIZE);
+  }
+}
+
+/**
+ * @brief Take the next step of a node's boot
+ */
+static void boot_step(boot_t *boot, int node) {
+  uint32_t now = boot->next_ms;
+
+  if (boot->path == PATH_WARM && !boot->tried_parent) {
+    boot->tried_parent = true;
+    int saved = node == 0 ? ROUTER : s_steady.parent[node];
+    if (is_up(saved, now) &&
+        (saved == ROUTER || s_tree.children[saved] < s_tree.max_children)) {
+      join(node, saved, now);
+      boot->done = true;
+    } else {
+      boot->next_ms = now + uniform(1000, 1500);
+    }
+    return;
+  }
+
+  // Cached channel first, then full scans until a parent is heard
+  int channel = MESH_CHANNEL;
+  if (boot->cached > 0) {
+    boot->cached--;
+  } else {
+    channel = boot->channel;
+    boot->channel = boot->channel % CHANNELS + 1;
+  }
+  boot->next_ms = now + DWELL_MS;
+  int parent = scan_channel(node, channel, boot->next_ms);
+  if (parent != SIM_TREE_NONE) {
+    join(node, parent, boot->next_ms);
+    boot->done = true;
+  }
+}
+
+/**
+ * @brief Time of the first packet a node gets through to the root
+ */
+static uint32_t first_packet_ms(int node, uint32_t reset_ms) {
+  return s_up_ms[node] + s_tree.layer[node] * HOP_MS - reset_ms;
+}
+
+static int compare(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+static uint32_t percentile(uint32_t *samples, int count, int percent) {
+  qsort(samples, count, sizeof(samples[0]), compare);
+  return samples[(count - 1) * percent / 100];
+}
+
+/**
+ * @brief Reset one node while the rest of the mesh is up
+ */
+static uint32_t reset_one(int node, boot_path_t path) {
+  boot_t boot;
+
+  s_tree = s_steady;
+  sim_tree_set_parent(&s_tree, node, SIM_TREE_NONE);
+  for (int n = 0; n < NODES; n++) {
+    s_up_ms[n] = s_tree.layer[n] != 0 ? 1 : 0;
+  }
+  boot_start(&boot, path, 1000);
+  for (int step = 0; !boot.done; step++) {
+    CHECK(step < 1000);
+    boot_step(&boot, node);
+  }
+  return first_packet_ms(node, 1000);
+}
+
+/**
+ * @brief Restart every node at once; fills the time of each node
+ */
+static void reset_all(boot_path_t path, uint32_t *times) {
+  static boot_t boots[NODES];
+
+  s_tree = s_steady;
+  for (int n = NODES - 1; n >= 0; n--) {
+    sim_tree_set_parent(&s_tree, n, SIM_TREE_NONE);
+  }
+  memset(s_up_ms, 0, sizeof(s_up_ms));
+  for (int n = 0; n < NODES; n++) {
+    boot_start(&boots[n], path, 0);
+  }
+  // Steps in time order, so every parent heard was up by then
+  for (int step = 0;; step++) {
+    int next = -1;
+    CHECK(step < 1000 * NODES);
+    for (int n = 0; n < NODES; n++) {
+      if (!boots[n].done &&
+          (next < 0 || boots[n].next_ms < boots[next].next_ms)) {
+        next = n;
+      }
+    }
+    if (next < 0) {
+      break;
+    }
+    boot_step(&boots[next], next);
+  }
+  for (int n = 1; n < NODES; n++) {
+    times[n - 1] = first_packet_ms(n, 0);
+  }
+}
+
+int main(void) {
+  sim_tree_config_t config = {
+      .count = NODES,
+      .max_children = 6,
+      .max_layer = 25,
+      .area = 7.0 * sqrt(NODES),
+      .range = 30.0,
+      .seed = 64,
+  };
+  static uint32_t one[PATH_MAX][RESETS];
+  static uint32_t all[PATH_MAX][NODES - 1];
+
+  CHECK(sim_tree_generate(&s_steady, &config) == NODES - 1);
+  mesh_parent_engine_init(&s_engine, NULL);
+
+  for (int r = 0; r < RESETS; r++) {
+    int node = 1 + test_rand(&s_seed) % (NODES - 1);
+    for (int p = 0; p < PATH_MAX; p++) {
+      one[p][r] = reset_one(node, (boot_path_t)p);
+    }
+  }
+  for (int p = 0; p < PATH_MAX; p++) {
+    reset_all((boot_path_t)p, all[p]);
+  }
+
+  printf("%d nodes, depth %d; time to the first packet in ms\n", NODES,
+         sim_tree_depth(&s_steady));
+  printf("%-10s | %13s %13s | %13s %13s\n", "", "one, median", "one, p90",
+         "all, median", "all, p90");
+  uint32_t med[2][PATH_MAX], p90[2][PATH_MAX];
+  for (int p = 0; p < PATH_MAX; p++) {
+    med[0][p] = percentile(one[p], RESETS, 50);
+    p90[0][p] = percentile(one[p], RESETS, 90);
+    med[1][p] = percentile(all[p], NODES - 1, 50);
+    p90[1][p] = percentile(all[p], NODES - 1, 90);
+    printf("%-10s | %13u %13u | %13u %13u\n", s_path_names[p], med[0][p],
+           p90[0][p], med[1][p], p90[1][p]);
+  }
+
+  // A lone warm boot skips the scan; the cache alone saves the full one
+  CHECK(med[0][PATH_WARM] + DWELL_MS / 2 < med[0][PATH_COLD]);
+  CHECK(med[0][PATH_COLD] * 2 < med[0][PATH_POWER_ON]);
+  // In a fleet restart a failed attempt delays the scan until more parents
+  // are up, which costs less than the full scans of a cold node
+  CHECK(med[1][PATH_WARM] * 2 < med[1][PATH_COLD]);
+  printf("sim_boot: ok\n");
+  return 0;
+}
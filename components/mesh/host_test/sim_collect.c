@@ -0,0 +1,261 @@
+/* Host simulation: collective poll on a 300-node tree
+ *
+ * Runs a poll event by event the way mesh_collect.c does on every node.
+ * The root sends the request to all nodes, and each node answers after
+ * 1-5 ms. A node whose subtree is complete forwards the merged reply at
+ * once. Otherwise it waits for the share of the timeout its layer gets,
+ * then forwards what it has. A reply that finds its relay no longer
+ * collecting is passed on unmerged. Each hop takes 5-15 ms.
+ *
+ * The poll runs once with every node answering. It runs again with 2 % of
+ * the nodes missing the request, where they still relay their children's
+ * replies. The baseline polls the nodes one at a time, one round trip
+ * each, as the application did before.
+ */
+
+#include "mesh_collect_engine.h"
+#include "sim_tree.h"
+#include "test_support.h"
+#include <math.h>
+#include <string.h>
+
+#define NODES (300)
+#define MAX_LAYER (6) /* CONFIG_MESH_MAX_LAYER default */
+#define TIMEOUT_MS (MESH_COLLECT_DEFAULT_TIMEOUT_MS)
+#define MAX_EVENTS (4 * NODES)
+
+typedef enum {
+  EVENT_REQUEST, /* request reaches the node */
+  EVENT_ANSWER,  /* node's own answer is ready */
+  EVENT_REPLY,   /* a child's reply reaches the node */
+  EVENT_TIMER,   /* node's wait for its subtree ends */
+} event_type_t;
+
+typedef struct {
+  uint32_t ms;
+  event_type_t type;
+  int node;
+  bool used;
+  mesh_collect_msg_reply_t reply;
+} event_t;
+
+typedef struct {
+  uint32_t complete_ms; /* root had every answer it would get */
+  bool complete;        /* every node answered */
+  int reply_frames;     /* replies sent over a link */
+  int late_frames;      /* of which passed on unmerged */
+  mesh_collect_msg_reply_t result;
+} poll_t;
+
+static sim_tree_t s_tree;
+static event_t s_events[MAX_EVENTS];
+static mesh_collect_msg_reply_t s_acc[NODES];
+static bool s_collecting[NODES], s_missing[NODES];
+static uint16_t s_expected[NODES];
+static uint32_t s_timer_ms[NODES];
+static uint32_t s_seed = 58;
+
+static uint32_t uniform(uint32_t low, uint32_t high) {
+  return low + test_rand(&s_seed) % (high - low + 1);
+}
+
+static uint8_t node_id(int node) {
+  return node < 256 ? (uint8_t)node : 0;
+}
+
+static float value_of(int node) {
+  return (float)(node % 50);
+}
+
+static void schedule(uint32_t ms, event_type_t type, int node,
+                     const mesh_collect_msg_reply_t *reply) {
+  for (int i = 0; i < MAX_EVENTS; i++) {
+    if (!s_events[i].used) {
+      s_events[i] = (event_t){.ms = ms, .type = type, .node = node,
+                              .used = true};
+      if (reply != NULL) {
+        s_events[i].reply = *reply;
+      }
+      return;
+    }
+  }
+  CHECK(false);
+}
+
+static void send_up(poll_t *poll, uint32_t now, int node,
+                    const mesh_collect_msg_reply_t *reply) {
+  poll->reply_frames++;
+  schedule(now + uniform(5, 15), EVENT_REPLY, s_tree.parent[node], reply);
+}
+
+static void handle(poll_t *poll, const event_t *event, uint16_t req_id) {
+  int n = event->node;
+
+  switch (event->type) {
+  case EVENT_REQUEST:
+    if (!s_missing[n]) {
+      schedule(event->ms + uniform(1, 5), EVENT_ANSWER, n, NULL);
+    }
+    break;
+  case EVENT_ANSWER:
+    mesh_collect_reply_init(&s_acc[n], req_id);
+    mesh_collect_reply_answer(&s_acc[n], node_id(n), true, value_of(n));
+    if (s_acc[n].responded >= s_expected[n]) {
+      send_up(poll, event->ms, n, &s_acc[n]);
+    } else {
+      s_collecting[n] = true;
+      s_timer_ms[n] = event->ms + mesh_collect_wait_ms(
+                                      TIMEOUT_MS, s_tree.layer[n], MAX_LAYER);
+      schedule(s_timer_ms[n], EVENT_TIMER, n, NULL);
+    }
+    break;
+  case EVENT_TIMER:
+    if (s_collecting[n] && event->ms == s_timer_ms[n]) {
+      s_collecting[n] = false;
+      send_up(poll, event->ms, n, &s_acc[n]);
+    }
+    break;
+  case EVENT_REPLY:
+    if (!s_collecting[n]) {
+      CHECK(n != 0);
+      poll->late_frames++;
+      send_up(poll, event->ms, n, &event->reply);
+      break;
+    }
+    mesh_collect_reply_merge(&s_acc[n], &event->reply);
+    if (n == 0) {
+      poll->complete_ms = event->ms;
+      if (s_acc[0].responded >= s_expected[0]) {
+        s_collecting[0] = false;
+        poll->complete = true;
+      }
+    } else if (s_acc[n].responded >= s_expected[n]) {
+      s_collecting[n] = false;
+      send_up(poll, event->ms, n, &s_acc[n]);
+    }
+    break;
+  }
+}
+
+static void run_poll(int missing_percent, uint16_t req_id, poll_t *poll) {
+  uint32_t arrival[NODES] = {0};
+
+  memset(poll, 0, sizeof(*poll));
+  memset(s_events, 0, sizeof(s_events));
+  memset(s_collecting, 0, sizeof(s_collecting));
+  for (int n = 0; n < NODES; n++) {
+    s_missing[n] = n != 0 && (int)uniform(0, 99) < missing_percent;
+    s_expected[n] = 0;
+    for (int m = 1; m < NODES; m++) {
+      s_expected[n] += sim_tree_in_subtree(&s_tree, m, n);
+    }
+  }
+
+  // The root expects every other node; the request goes down the tree
+  mesh_collect_reply_init(&s_acc[0], req_id);
+  s_collecting[0] = true;
+  for (int layer = 2; layer <= MAX_LAYER; layer++) {
+    for (int n = 1; n < NODES; n++) {
+      if (s_tree.layer[n] == layer) {
+        arrival[n] = arrival[s_tree.parent[n]] + uniform(5, 15);
+        schedule(arrival[n], EVENT_REQUEST, n, NULL);
+      }
+    }
+  }
+
+  while (true) {
+    int next = -1;
+    for (int i = 0; i < MAX_EVENTS; i++) {
+      if (s_events[i].used &&
+          (next < 0 || s_events[i].ms < s_events[next].ms)) {
+        next = i;
+      }
+    }
+    if (next < 0 || s_events[next].ms > TIMEOUT_MS || poll->complete) {
+      break;
+    }
+    event_t event = s_events[next];
+    s_events[next].used = false;
+    handle(poll, &event, req_id);
+  }
+  poll->result = s_acc[0];
+}
+
+/**
+ * @brief Check the root's result against the nodes that answered
+ */
+static void check_result(const poll_t *poll) {
+  uint8_t bitmap[MESH_COLLECT_BITMAP_BYTES] = {0};
+  int answered = 0;
+  float sum = 0;
+
+  for (int n = 1; n < NODES; n++) {
+    if (s_missing[n]) {
+      continue;
+    }
+    answered++;
+    sum += value_of(n);
+    if (node_id(n) != 0) {
+      bitmap[node_id(n) / 8] |= 1 << (node_id(n) % 8);
+    }
+  }
+  CHECK(poll->result.responded == answered);
+  CHECK(poll->result.value_count == answered);
+  CHECK(poll->result.sum == sum);
+  CHECK(poll->result.min == 0 && poll->result.max == 49);
+  CHECK(memcmp(poll->result.bitmap, bitmap, sizeof(bitmap)) == 0);
+}
+
+int main(void) {
+  sim_tree_config_t config = {
+      .count = NODES,
+      .max_children = 6,
+      .max_layer = MAX_LAYER,
+      .area = 7.0 * sqrt(NODES),
+      .range = 30.0,
+      .seed = 58,
+  };
+  poll_t poll;
+
+  CHECK(sim_tree_generate(&s_tree, &config) == NODES - 1);
+  int depth = sim_tree_depth(&s_tree);
+
+  // One node at a time: request down, answer, reply up
+  uint32_t serial_ms = 0;
+  int serial_frames = 0;
+  for (int n = 1; n < NODES; n++) {
+    int hops = s_tree.layer[n] - 1;
+    serial_ms += uniform(1, 5);
+    for (int h = 0; h < 2 * hops; h++) {
+      serial_ms += uniform(5, 15);
+    }
+    serial_frames += hops;
+  }
+
+  run_poll(0, 1, &poll);
+  CHECK(poll.complete && poll.late_frames == 0);
+  check_result(&poll);
+  printf("%d nodes, depth %d\n", NODES, depth);
+  printf("%-24s %6s %13s\n", "", "ms", "reply frames");
+  printf("%-24s %6u %13d\n", "one node at a time", serial_ms, serial_frames);
+  printf("%-24s %6u %13d\n", "collect, all answer", poll.complete_ms,
+         poll.reply_frames);
+  // Down and up the tree: two hops of at most 15 ms per layer, and 5 ms
+  // for the answer
+  CHECK(poll.complete_ms <= (uint32_t)(2 * (depth - 1) * 15 + 5));
+  CHECK(poll.reply_frames == NODES - 1);
+
+  run_poll(2, 2, &poll);
+  CHECK(!poll.complete);
+  check_result(&poll);
+  int missing = 0;
+  for (int n = 1; n < NODES; n++) {
+    missing += s_missing[n];
+  }
+  printf("%-24s %6u %13d  (%d missing, %d passed on late)\n",
+         "collect, 2 % missing", poll.complete_ms, poll.reply_frames,
+         missing, poll.late_frames);
+  CHECK(missing > 0 && poll.complete_ms < TIMEOUT_MS);
+  printf("sim_collect: ok\n");
+  return 0;
+}
@@ -0,0 +1,211 @@
+/* Host simulation: converging a 300-node mesh after a config change
+ *
+ * Generates a 300-node tree whose nodes hold version 1 of a 16-key
+ * document and publishes a change of one key the way mesh_config_store.c
+ * does: the diff from the previous version goes to the mesh group once,
+ * and every relay that received it forwards it once to its children. Each
+ * link loses a frame with 2 %, and a relay that missed the diff cannot
+ * pass it on. Nodes left behind advertise their version; once a second
+ * the root answers up to MESH_CONFIG_STORE_MAX_PENDING adverts, one
+ * multicast per base version. A dropped advert is repeated next round.
+ *
+ * The baseline is what the application did before: the full document
+ * sent to each node on its own, one frame per hop down to it.
+ */
+
+#include "mesh_config_store.h"
+#include "mesh_config_store_engine.h"
+#include "sim_tree.h"
+#include "test_support.h"
+#include <math.h>
+#include <string.h>
+
+#define NODES (300)
+#define KEYS (16)
+#define LOSS_PERCENT (2)
+#define MSG_HEADER (2) /* magic and op in front of the diff */
+
+static sim_tree_t s_tree;
+static mesh_config_doc_t s_root, s_nodes[NODES];
+static uint32_t s_seed = 73;
+
+typedef struct {
+  long frames; /* transmissions over any link */
+  long bytes;  /* bytes over any link */
+} traffic_t;
+
+static bool lost(void) {
+  return test_rand(&s_seed) % 100 < LOSS_PERCENT;
+}
+
+/**
+ * @brief Publish the staged document as the next version
+ */
+static void publish(const mesh_config_doc_t *staged) {
+  mesh_config_doc_t next = s_root;
+
+  CHECK(mesh_config_doc_merge(&next, staged, s_root.version + 1) >= 0);
+  next.version = s_root.version + 1;
+  s_root = next;
+}
+
+/**
+ * @brief Deliver a diff to a node, as mesh_config_store_diff_received()
+ */
+static bool deliver(int node, const uint8_t *diff, int length) {
+  mesh_config_doc_t out;
+
+  if (mesh_config_doc_apply(&s_nodes[node], diff, length, &out) != ESP_OK) {
+    return false;
+  }
+  s_nodes[node] = out;
+  return true;
+}
+
+/**
+ * @brief Send a diff down the tree to the nodes marked in wanted
+ *
+ * A relay forwards the frame once if any node below it is wanted, which
+ * is what a group send and mesh_multicast_from_root() cost.
+ */
+static void multicast(const bool *wanted, const uint8_t *diff, int length,
+                      traffic_t *traffic) {
+  bool has[NODES] = {false}, below[NODES] = {false};
+
+  for (int n = 1; n < NODES; n++) {
+    for (int k = n; wanted[n] && k != SIM_TREE_NONE; k = s_tree.parent[k]) {
+      below[k] = true;
+    }
+  }
+  has[0] = true;
+  // Parents come before children in layer order
+  for (int layer = 2; layer <= s_tree.max_layer; layer++) {
+    for (int n = 1; n < NODES; n++) {
+      int p = s_tree.parent[n];
+      if (s_tree.layer[n] != layer || !below[n] || !has[p]) {
+        continue;
+      }
+      bool first = true;
+      for (int s = 1; s < n; s++) {
+        first &= !(s_tree.parent[s] == p && below[s]);
+      }
+      if (first) {
+        traffic->frames++;
+        traffic->bytes += MSG_HEADER + length;
+      }
+      has[n] = !lost();
+      if (has[n] && wanted[n]) {
+        deliver(n, diff, length);
+      }
+    }
+  }
+}
+
+static bool converged(int node) {
+  return s_nodes[node].version == s_root.version &&
+         mesh_config_doc_digest(&s_nodes[node]) ==
+             mesh_config_doc_digest(&s_root);
+}
+
+int main(void) {
+  sim_tree_config_t config = {
+      .count = NODES,
+      .max_children = 6,
+      .max_layer = 25,
+      .area = 7.0 * sqrt(NODES),
+      .range = 30.0,
+      .seed = 73,
+  };
+  static uint8_t diff[MESH_CONFIG_MAX_DIFF];
+  mesh_config_doc_t staged;
+  traffic_t group = {0}, catch_up = {0}, baseline = {0};
+  uint8_t value[MESH_CONFIG_VALUE_MAX];
+  char key[MESH_CONFIG_KEY_SIZE];
+
+  CHECK(sim_tree_generate(&s_tree, &config) == NODES - 1);
+
+  // Version 1 of the document is on every node
+  mesh_config_doc_init(&s_root);
+  mesh_config_doc_init(&staged);
+  for (int k = 0; k < KEYS; k++) {
+    snprintf(key, sizeof(key), "key%02d", k);
+    memset(value, k, sizeof(value));
+    CHECK(mesh_config_doc_set(&staged, key, value, 4 + k % 13, 0) == ESP_OK);
+  }
+  publish(&staged);
+  int full = mesh_config_doc_diff(&s_root, 0, diff, sizeof(diff));
+  CHECK(full > 0);
+  for (int n = 0; n < NODES; n++) {
+    mesh_config_doc_init(&s_nodes[n]);
+    CHECK(deliver(n, diff, full));
+  }
+
+  // Change one key
+  value[0] = 0xAA;
+  CHECK(mesh_config_doc_set(&staged, "key07", value, 4 + 7 % 13, 0) ==
+        ESP_OK);
+  publish(&staged);
+  int length = mesh_config_doc_diff(&s_root, 1, diff, sizeof(diff));
+  CHECK(length > 0 && length < full / 4);
+  CHECK(deliver(0, diff, length));
+
+  bool wanted[NODES];
+  for (int n = 0; n < NODES; n++) {
+    wanted[n] = n != 0;
+  }
+  multicast(wanted, diff, length, &group);
+  int missed = 0;
+  for (int n = 1; n < NODES; n++) {
+    missed += !converged(n);
+  }
+
+  // Nodes behind advertise and are answered a round at a time
+  int rounds = 0;
+  while (true) {
+    int pending = 0;
+    for (int n = 1; n < NODES; n++) {
+      wanted[n] = false;
+      if (!converged(n) && pending < MESH_CONFIG_STORE_MAX_PENDING &&
+          !lost()) {
+        // Every one of them holds version 1, so one multicast answers all
+        CHECK(s_nodes[n].version == 1);
+        wanted[n] = true;
+        pending++;
+      }
+    }
+    if (pending == 0) {
+      break;
+    }
+    rounds++;
+    multicast(wanted, diff, length, &catch_up);
+    CHECK(rounds < 20);
+  }
+  for (int n = 0; n < NODES; n++) {
+    CHECK(converged(n));
+  }
+
+  // The full document sent to each node on its own
+  full = mesh_config_doc_diff(&s_root, 0, diff, sizeof(diff));
+  for (int n = 1; n < NODES; n++) {
+    baseline.frames += s_tree.layer[n] - 1;
+    baseline.bytes += (long)(s_tree.layer[n] - 1) * (MSG_HEADER + full);
+  }
+
+  printf("%d nodes, depth %d, %d keys: full document %d bytes, one-key "
+         "diff %d bytes\n",
+         NODES, sim_tree_depth(&s_tree), KEYS, MSG_HEADER + full,
+         MSG_HEADER + length);
+  printf("%-22s %6s %7s\n", "", "frames", "bytes");
+  printf("%-22s %6ld %7ld\n", "one group diff", group.frames, group.bytes);
+  printf("%-22s %6ld %7ld  (%d nodes missed it, %d multicasts)\n",
+         "catch-up", catch_up.frames, catch_up.bytes, missed, rounds);
+  printf("%-22s %6ld %7ld\n", "full send per node", baseline.frames,
+         baseline.bytes);
+
+  // One multicast reaches most of the mesh, and everything is a fraction
+  // of sending the document to every node
+  CHECK(missed < NODES / 5);
+  CHECK((group.bytes + catch_up.bytes) * 20 < baseline.bytes);
+  printf("sim_config_store: ok\n");
+  return 0;
+}
@@ -0,0 +1,232 @@
+/* Host simulation: healing benchmark against a killed relay
+ *
+ * Generates a 200-node tree and kills, one at a time, every relay with
+ * 3 to MESH_HEAL_MAX_ORPHANS descendants, the way mesh_heal_bench_start()
+ * does: every node probes the root every MESH_HEAL_DEFAULT_PROBE_MS, the
+ * relay stops after MESH_HEAL_ARM_MS, and the probe arrivals go through
+ * the healing engine. Each of the relay's children notices the loss after
+ * the 6-6.3 s beacon timeout and then either:
+ *
+ * - rescans its cached channel (360 ms) and joins the best parent, as
+ *   mesh.c does, or
+ * - first tries the best runner-up of its last scan that sits no deeper
+ *   than the relay, losing 1-1.5 s if it turns out full. This backup
+ *   parent path was dropped because its tail is worse than the rescan's.
+ *
+ * Joining takes 500-700 ms. Nodes further down deliver again once their
+ * subtree's head has rejoined and the route is updated, 100 ms per hop.
+ */
+
+#include "mesh_heal.h"
+#include "sim_tree.h"
+#include "test_support.h"
+#include <math.h>
+#include <string.h>
+
+#define NODES (200)
+#define PROBE_MS (MESH_HEAL_DEFAULT_PROBE_MS)
+#define KILL_MS (10000 + MESH_HEAL_ARM_MS)
+#define RUN_MS (60000)
+#define BACKUPS (1)
+#define MAX_RELAYS (64)
+
+typedef enum {
+  MODE_RESCAN, /* mesh.c */
+  MODE_BACKUP, /* one backup parent, then rescan */
+  MODE_MAX,
+} heal_mode_t;
+
+static const char *s_mode_names[MODE_MAX] = {"rescan", "backup parent"};
+static sim_tree_t s_generated;
+static uint32_t s_seed = 72;
+
+static uint32_t uniform(uint32_t low, uint32_t high) {
+  return low + test_rand(&s_seed) % (high - low + 1);
+}
+
+static void mac_of(int node, uint8_t *mac) {
+  memset(mac, 0, 6);
+  mac[0] = 0x24;
+  mac[4] = (uint8_t)(node >> 8);
+  mac[5] = (uint8_t)node;
+}
+
+/* Keeps only candidates no deeper than the relay, each picked once */
+typedef struct {
+  int max_layer;
+  const int *taken;
+  int count;
+} backup_filter_t;
+
+static int backup_penalty(void *ctx, int node, int parent) {
+  const backup_filter_t *filter = ctx;
+  (void)node;
+  for (int i = 0; i < filter->count; i++) {
+    if (filter->taken[i] == parent) {
+      return 1000000;
+    }
+  }
+  return s_generated.layer[parent] > filter->max_layer ? 1000000 : 0;
+}
+
+/**
+ * @brief Runner-ups of a node's last scan, best first
+ */
+static int find_backups(int node, int relay, int *backups) {
+  int count = 0;
+  backup_filter_t filter = {s_generated.layer[relay], backups, 0};
+
+  while (count < BACKUPS) {
+    int p = sim_tree_choose_parent(&s_generated, node, relay,
+                                   backup_penalty, &filter);
+    if (p == SIM_TREE_NONE || backup_penalty(&filter, node, p) != 0) {
+      break;
+    }
+    backups[count++] = p;
+    filter.count = count;
+  }
+  return count;
+}
+
+/**
+ * @brief Time after the kill at which a child of the relay has rejoined
+ */
+static uint32_t rejoin(sim_tree_t *tree, int node, const int *backups,
+                       int backup_count, heal_mode_t mode) {
+  uint32_t t = uniform(6000, 6300);
+
+  for (int i = 0; mode == MODE_BACKUP && i < backup_count; i++) {
+    int p = backups[i];
+    if (tree->layer[p] != 0 && tree->children[p] < tree->max_children) {
+      sim_tree_set_parent(tree, node, p);
+      return t + uniform(500, 700);
+    }
+    t += uniform(1000, 1500);
+  }
+  t += 360;
+  int p = sim_tree_choose_parent(tree, node, SIM_TREE_NONE, NULL, NULL);
+  CHECK(p != SIM_TREE_NONE);
+  sim_tree_set_parent(tree, node, p);
+  return t + uniform(500, 700);
+}
+
+static void probe(mesh_heal_bench_t *bench, int node, uint32_t from_ms,
+                  uint32_t until_ms) {
+  uint8_t mac[6];
+  uint32_t phase = uniform(0, PROBE_MS - 1);
+
+  mac_of(node, mac);
+  for (uint32_t t = phase; t < until_ms; t += PROBE_MS) {
+    if (t >= from_ms) {
+      mesh_heal_bench_arrival(bench, mac, t + uniform(10, 40));
+    }
+  }
+}
+
+/**
+ * @brief Kill one relay and run the benchmark
+ */
+static void kill_relay(int relay, heal_mode_t mode,
+                       mesh_heal_result_t *result) {
+  static sim_tree_t tree;
+  static mesh_heal_bench_t bench;
+  uint8_t relay_mac[6], orphan_macs[MESH_HEAL_MAX_ORPHANS][6];
+  int orphans[MESH_HEAL_MAX_ORPHANS], heads[MESH_HEAL_MAX_ORPHANS];
+  int backups[MESH_HEAL_MAX_ORPHANS][BACKUPS];
+  int backup_count[MESH_HEAL_MAX_ORPHANS];
+  uint32_t back_ms[SIM_TREE_MAX_NODES] = {0};
+  int count = 0, head_count = 0;
+
+  tree = s_generated;
+  for (int n = 0; n < tree.count; n++) {
+    if (n != relay && tree.layer[n] != 0 &&
+        sim_tree_in_subtree(&tree, n, relay)) {
+      CHECK(count < MESH_HEAL_MAX_ORPHANS);
+      mac_of(n, orphan_macs[count]);
+      orphans[count++] = n;
+    }
+  }
+  for (int i = 0; i < count; i++) {
+    if (tree.parent[orphans[i]] == relay) {
+      backup_count[head_count] = find_backups(orphans[i], relay,
+                                              backups[head_count]);
+      heads[head_count++] = orphans[i];
+    }
+  }
+  mac_of(relay, relay_mac);
+  mesh_heal_bench_init(&bench, relay_mac,
+                       (const uint8_t(*)[6])orphan_macs, count, PROBE_MS, 0);
+
+  // The relay and its subtree drop out; heads rejoin in turn
+  sim_tree_set_parent(&tree, relay, SIM_TREE_NONE);
+  for (int h = 0; h < head_count; h++) {
+    sim_tree_set_parent(&tree, heads[h], SIM_TREE_NONE);
+  }
+  for (int h = 0; h < head_count; h++) {
+    back_ms[heads[h]] = KILL_MS + rejoin(&tree, heads[h], backups[h],
+                                         backup_count[h], mode);
+  }
+  for (int i = 0; i < count; i++) {
+    int n = orphans[i], head = n, hops = 0;
+    while (tree.parent[head] != SIM_TREE_NONE && back_ms[head] == 0) {
+      head = tree.parent[head];
+      hops++;
+    }
+    back_ms[n] = back_ms[head] + hops * 100;
+  }
+
+  probe(&bench, relay, 0, KILL_MS);
+  for (int i = 0; i < count; i++) {
+    probe(&bench, orphans[i], 0, KILL_MS);
+    probe(&bench, orphans[i], back_ms[orphans[i]], KILL_MS + RUN_MS);
+  }
+  mesh_heal_bench_result(&bench, KILL_MS + RUN_MS, result);
+}
+
+int main(void) {
+  sim_tree_config_t config = {
+      .count = NODES,
+      .max_children = 6,
+      .max_layer = 25,
+      .area = 7.0 * sqrt(NODES),
+      .range = 30.0,
+      .seed = 72,
+  };
+  int relays[MAX_RELAYS], relay_count = 0;
+  double slowest[MODE_MAX] = {0}, median[MODE_MAX] = {0};
+  uint32_t worst[MODE_MAX] = {0};
+
+  CHECK(sim_tree_generate(&s_generated, &config) == NODES - 1);
+  for (int n = 1; n < NODES && relay_count < MAX_RELAYS; n++) {
+    int below = 0;
+    for (int k = 1; k < NODES; k++) {
+      below += k != n && sim_tree_in_subtree(&s_generated, k, n);
+    }
+    if (below >= 3 && below <= MESH_HEAL_MAX_ORPHANS) {
+      relays[relay_count++] = n;
+    }
+  }
+  CHECK(relay_count > 0);
+
+  for (int m = 0; m < MODE_MAX; m++) {
+    for (int r = 0; r < relay_count; r++) {
+      mesh_heal_result_t result;
+      kill_relay(relays[r], (heal_mode_t)m, &result);
+      CHECK(result.outage_seen);
+      CHECK(result.healed == result.orphans);
+      // Nobody heals before the beacon timeout
+      CHECK(result.median_ms >= 6000 && result.median_ms <= result.max_ms);
+      slowest[m] += result.max_ms;
+      median[m] += result.median_ms;
+      worst[m] = result.max_ms > worst[m] ? result.max_ms : worst[m];
+    }
+    printf("%-15s %d relays killed: mean slowest %.0f ms, mean median "
+           "%.0f ms, worst %u ms\n",
+           s_mode_names[m], relay_count, slowest[m] / relay_count,
+           median[m] / relay_count, worst[m]);
+  }
+  // A full backup costs more than the scan it saves
+  CHECK(worst[MODE_RESCAN] < worst[MODE_BACKUP]);
+  printf("sim_heal: ok\n");
+  return 0;
+}
@@ -0,0 +1,242 @@
+/* Host simulation: adaptive mesh stack parameters
+ *
+ * Runs the parameter controller one control period at a time the way
+ * mesh_params.c does, in three scenarios:
+ *
+ * - Queue: a relay's TX queue would need 60-75 entries for an hour, then
+ *   carries almost nothing. Sends fail in proportion to the entries above
+ *   xon_qsize.
+ * - Tree: 300 nodes join a generated tree built from the current
+ *   max_layer and ap_connections, starting from a tight 4 layers and 3
+ *   connections. The root sees the figures of the joined nodes.
+ * - Noise: a day of random queue peaks and failures below the thresholds
+ *   half of the time.
+ *
+ * Every set of parameters the controller produces must be within the safe
+ * bounds, and changes must be at least a cooldown apart.
+ */
+
+#include "mesh_params_engine.h"
+#include "sim_tree.h"
+#include "test_support.h"
+#include <math.h>
+#include <string.h>
+
+#define PERIOD_MS (MESH_PARAMS_DEFAULT_PERIOD_MS)
+#define NODES (300)
+
+static uint32_t s_seed = 70;
+
+/**
+ * @brief Controller and the parameters in effect
+ */
+typedef struct {
+  mesh_params_controller_t controller;
+  mesh_params_t params;
+  uint32_t now_ms;
+  uint32_t last_change_ms;
+  int changes;
+} run_t;
+
+static void run_init(run_t *run, const mesh_params_t *params) {
+  mesh_params_controller_config_t config;
+
+  mesh_params_controller_config_default(&config);
+  mesh_params_controller_init(&run->controller, &config);
+  run->params = *params;
+  run->now_ms = 0;
+  run->changes = 0;
+}
+
+/**
+ * @brief Feed one period and apply the change, if any
+ */
+static mesh_params_knob_t run_step(run_t *run,
+                                   const mesh_params_sample_t *sample) {
+  mesh_params_t next;
+  mesh_params_knob_t knob = mesh_params_controller_step(
+      &run->controller, sample, &run->params, run->now_ms, &next);
+
+  CHECK(mesh_params_valid(&next));
+  if (knob != MESH_PARAMS_KNOB_NONE) {
+    CHECK(run->changes == 0 || run->now_ms - run->last_change_ms >=
+                                   MESH_PARAMS_DEFAULT_COOLDOWN_MS);
+    run->last_change_ms = run->now_ms;
+    run->changes++;
+    run->params = next;
+  } else {
+    CHECK(memcmp(&next, &run->params, sizeof(next)) == 0);
+  }
+  run->now_ms += PERIOD_MS;
+  return knob;
+}
+
+static void queue_scenario(void) {
+  static const mesh_params_t start = {6, 6, MESH_PARAMS_DEFAULT_XON_QSIZE,
+                                      MESH_PARAMS_DEFAULT_CAPACITY,
+                                      MESH_PARAMS_DEFAULT_ASSOC_EXPIRE_S};
+  run_t run;
+  long failed = 0, fixed_failed = 0;
+
+  run_init(&run, &start);
+  for (int period = 0; period < 60; period++) {
+    uint32_t demand = 60 + test_rand(&s_seed) % 16;
+    mesh_params_sample_t sample = {.sent = 1000};
+    sample.queue_peak = (uint16_t)(demand < run.params.xon_qsize
+                                       ? demand
+                                       : run.params.xon_qsize);
+    if (demand > run.params.xon_qsize) {
+      sample.dropped = (demand - run.params.xon_qsize) * 10;
+    }
+    failed += sample.dropped;
+    fixed_failed += (demand - start.xon_qsize) * 10;
+    if (run_step(&run, &sample) != MESH_PARAMS_KNOB_NONE) {
+      printf("queue   %3d min: xon_qsize -> %u\n", period + 1,
+             run.params.xon_qsize);
+    }
+  }
+  printf("queue   failed sends in the hour: %ld, %ld with xon_qsize fixed "
+         "at %u\n",
+         failed, fixed_failed, start.xon_qsize);
+  CHECK(failed * 4 < fixed_failed);
+  CHECK(run.params.xon_qsize >= 75);
+
+  // Idle again: back down to the stack default, never below
+  for (int period = 60; period < 180; period++) {
+    mesh_params_sample_t sample = {.sent = 100, .queue_peak = 3};
+    if (run_step(&run, &sample) != MESH_PARAMS_KNOB_NONE) {
+      printf("queue   %3d min: xon_qsize -> %u\n", period + 1,
+             run.params.xon_qsize);
+    }
+  }
+  CHECK(run.params.xon_qsize == MESH_PARAMS_DEFAULT_XON_QSIZE);
+}
+
+static void tree_scenario(void) {
+  static const mesh_params_t start = {4, 3, MESH_PARAMS_DEFAULT_XON_QSIZE,
+                                      MESH_PARAMS_DEFAULT_CAPACITY,
+                                      MESH_PARAMS_DEFAULT_ASSOC_EXPIRE_S};
+  static sim_tree_t tree;
+  sim_tree_config_t config = {
+      .count = NODES,
+      .area = 7.0 * sqrt(NODES),
+      .range = 30.0,
+      .seed = 70,
+  };
+  run_t run;
+  int joined = 0, first_joined = -1;
+
+  run_init(&run, &start);
+  for (int period = 0; period < 240; period++) {
+    // The tree the current parameters allow
+    config.max_layer = run.params.max_layer;
+    config.max_children = run.params.ap_connections;
+    joined = sim_tree_generate(&tree, &config);
+    if (first_joined < 0) {
+      first_joined = joined;
+    }
+
+    mesh_params_sample_t sample = {
+        .sent = 1000,
+        .queue_peak = 4,
+        .have_topology = true,
+        .nodes = (uint16_t)(joined + 1),
+    };
+    for (int n = 1; n < NODES; n++) {
+      sample.deepest += tree.layer[n] == run.params.max_layer;
+      if (tree.layer[n] != 0 && tree.children[n] > 0) {
+        sample.relays++;
+        sample.full_relays += tree.children[n] >= run.params.ap_connections;
+      }
+    }
+    mesh_params_knob_t knob = run_step(&run, &sample);
+    if (knob != MESH_PARAMS_KNOB_NONE) {
+      printf("tree    %3d min: %d of %d joined, %u on the last layer, %u "
+             "of %u relays full -> max_layer %u, ap_connections %u, "
+             "capacity %u\n",
+             period + 1, joined, NODES - 1, sample.deepest,
+             sample.full_relays, sample.relays, run.params.max_layer,
+             run.params.ap_connections, run.params.capacity_num);
+    }
+  }
+  printf("tree    %d of %d joined before, %d after %d changes\n",
+         first_joined, NODES - 1, joined, run.changes);
+  CHECK(joined > first_joined);
+  CHECK(run.params.max_layer <= MESH_PARAMS_CONTROL_MAX_LAYER);
+}
+
+static void noise_scenario(void) {
+  static const mesh_params_t start = {6, 6, 48, MESH_PARAMS_DEFAULT_CAPACITY,
+                                      MESH_PARAMS_DEFAULT_ASSOC_EXPIRE_S};
+  run_t run;
+
+  run_init(&run, &start);
+  for (int period = 0; period < 24 * 60; period++) {
+    mesh_params_sample_t sample = {.sent = 1000};
+    sample.queue_peak =
+        (uint16_t)(test_rand(&s_seed) % (run.params.xon_qsize + 1u));
+    if (test_rand(&s_seed) % 2) {
+      sample.dropped = test_rand(&s_seed) % 21;
+    }
+    run_step(&run, &sample);
+  }
+  printf("noise   %d changes in a day, xon_qsize %u\n", run.changes,
+         run.params.xon_qsize);
+  // Random pressure rarely lasts the confirmation periods
+  CHECK(run.changes <= 10);
+}
+
+static void check_bounds(void) {
+  mesh_params_t params = {6, 6, MESH_PARAMS_DEFAULT_XON_QSIZE,
+                          MESH_PARAMS_DEFAULT_CAPACITY,
+                          MESH_PARAMS_DEFAULT_ASSOC_EXPIRE_S};
+
+  CHECK(mesh_params_valid(&params));
+  params.max_layer = MESH_PARAMS_MAX_LAYER_MAX + 1;
+  CHECK(!mesh_params_valid(&params));
+  params.max_layer = 6;
+  params.ap_connections = 0;
+  CHECK(!mesh_params_valid(&params));
+  params.ap_connections = 6;
+  params.xon_qsize = MESH_PARAMS_XON_QSIZE_MAX + 1;
+  CHECK(!mesh_params_valid(&params));
+  params.xon_qsize = MESH_PARAMS_XON_QSIZE_MIN - 1;
+  CHECK(!mesh_params_valid(&params));
+  params.xon_qsize = MESH_PARAMS_DEFAULT_XON_QSIZE;
+  params.capacity_num = MESH_PARAMS_CAPACITY_MAX + 1;
+  CHECK(!mesh_params_valid(&params));
+  params.capacity_num = MESH_PARAMS_DEFAULT_CAPACITY;
+  params.assoc_expire_s = MESH_PARAMS_ASSOC_EXPIRE_MIN_S - 1;
+  CHECK(!mesh_params_valid(&params));
+
+  // The controller stops at the upper bounds
+  run_t run;
+  params.assoc_expire_s = MESH_PARAMS_DEFAULT_ASSOC_EXPIRE_S;
+  params.xon_qsize = MESH_PARAMS_XON_QSIZE_MAX;
+  params.capacity_num = MESH_PARAMS_CAPACITY_MAX;
+  params.ap_connections = MESH_PARAMS_AP_CONNECTIONS_MAX;
+  params.max_layer = MESH_PARAMS_CONTROL_MAX_LAYER;
+  run_init(&run, &params);
+  for (int period = 0; period < 100; period++) {
+    mesh_params_sample_t sample = {
+        .sent = 1000,
+        .dropped = 500,
+        .queue_peak = MESH_PARAMS_XON_QSIZE_MAX,
+        .have_topology = true,
+        .nodes = MESH_PARAMS_CAPACITY_MAX,
+        .deepest = 500,
+        .relays = 100,
+        .full_relays = 100,
+    };
+    CHECK(run_step(&run, &sample) == MESH_PARAMS_KNOB_NONE);
+  }
+}
+
+int main(void) {
+  check_bounds();
+  queue_scenario();
+  tree_scenario();
+  noise_scenario();
+  printf("sim_params: ok\n");
+  return 0;
+}
@@ -0,0 +1,164 @@
+/* Host simulation: control frames saved by piggybacking
+ *
+ * One node sends data frames to the root at a given rate, with +-20 %
+ * jitter, and queues control items for the root through the piggyback
+ * engine the way mesh_data_transfer.c does: a data frame carries every
+ * queued item that fits in the room its payload leaves, and the deadline
+ * timer, every MESH_PIGGYBACK_TICK_MS, sends due items alone with the
+ * remaining ones attached. Without piggybacking each item is a frame.
+ *
+ * Two item mixes run for an hour per data rate: what this tree queues
+ * (standby hello every 4 s due within a heartbeat, config store advert
+ * every 5 min due within 5 s), and a generic mix of a 4 s heartbeat and
+ * 10 s and 30 s reports.
+ */
+
+#include "mesh_piggyback_engine.h"
+#include "mesh_standby.h"
+#include "test_support.h"
+#include <string.h>
+
+#define RUN_MS (3600u * 1000u)
+#define TICK_MS (50) /* MESH_PIGGYBACK_TICK_MS */
+#define ROOM (200)   /* payload left in a data frame */
+
+typedef struct {
+  const char *name;
+  uint32_t period_ms; /* an item is queued this often */
+  uint32_t delay_ms;  /* and may wait this long */
+  uint8_t type;
+  uint8_t op; /* first byte, items of the same kind replace each other */
+  uint8_t length;
+} kind_t;
+
+typedef struct {
+  long queued;     /* control frames without piggybacking */
+  long standalone; /* control frames sent at a deadline */
+  long attached;   /* items that rode on a data or control frame */
+  long replaced;   /* items superseded while queued */
+  long data;       /* data frames */
+} result_t;
+
+/* Data types as in mesh_data_transfer.h: 0x04 config, 0x0D standby */
+static const kind_t s_tree_mix[] = {
+    {"standby hello",
+     MESH_STANDBY_HELLO_HEARTBEATS * MESH_STANDBY_DEFAULT_HEARTBEAT_MS,
+     MESH_STANDBY_DEFAULT_HEARTBEAT_MS, 0x0D, 1, 5},
+    {"config advert", 300000, 5000, 0x04, 0xC5, 12},
+};
+
+static const kind_t s_generic_mix[] = {
+    {"heartbeat", 4000, 500, 0x0D, 1, 8},
+    {"report", 10000, 1000, 0x03, 1, 16},
+    {"stats", 30000, 5000, 0x03, 2, 24},
+};
+
+static uint32_t s_seed = 75;
+
+/**
+ * @brief Attach the items for the root to a frame being sent now
+ */
+static int attach(mesh_piggyback_queue_t *queue) {
+  static const uint8_t root[6] = {0};
+  uint8_t buf[ROOM];
+  int count = 0;
+
+  mesh_piggyback_attach(queue, root, buf, sizeof(buf), &count);
+  return count;
+}
+
+static result_t run(const kind_t *kinds, int kind_count, uint32_t data_ms) {
+  static const uint8_t root[6] = {0};
+  mesh_piggyback_queue_t queue;
+  uint32_t next[8];
+  uint32_t next_data = data_ms ? test_rand(&s_seed) % data_ms : UINT32_MAX;
+  result_t result = {0};
+
+  CHECK(kind_count <= 8);
+  mesh_piggyback_init(&queue);
+  for (int k = 0; k < kind_count; k++) {
+    next[k] = test_rand(&s_seed) % kinds[k].period_ms;
+  }
+
+  for (uint32_t now = 0; now < RUN_MS; now++) {
+    for (int k = 0; k < kind_count; k++) {
+      if (now == next[k]) {
+        uint8_t data[MESH_PIGGYBACK_ITEM_MAX] = {kinds[k].op};
+        bool replaced;
+        CHECK(mesh_piggyback_put(&queue, root, kinds[k].type, data,
+                                 kinds[k].length, now + kinds[k].delay_ms,
+                                 &replaced) == ESP_OK);
+        result.queued++;
+        result.replaced += replaced;
+        next[k] += kinds[k].period_ms;
+      }
+    }
+    if (now == next_data) {
+      result.data++;
+      result.attached += attach(&queue);
+      uint32_t jitter = data_ms * 4 / 10 + 1;
+      next_data = now + data_ms * 8 / 10 + test_rand(&s_seed) % jitter;
+    }
+    if (now % TICK_MS == 0) {
+      mesh_piggyback_item_t item;
+      while (mesh_piggyback_take_due(&queue, now, &item)) {
+        // Sent at most one tick late
+        CHECK(now - item.deadline_ms < TICK_MS);
+        result.standalone++;
+        result.attached += attach(&queue);
+      }
+    }
+  }
+
+  // Every item went out once, alone or attached, or was superseded
+  int left = 0;
+  for (int i = 0; i < MESH_PIGGYBACK_MAX_ITEMS; i++) {
+    left += queue.items[i].used;
+  }
+  CHECK(result.standalone + result.attached + result.replaced + left ==
+        result.queued);
+  return result;
+}
+
+static double saved(const result_t *r) {
+  return 100.0 * (r->queued - r->standalone) / r->queued;
+}
+
+int main(void) {
+  static const uint32_t rates[] = {1000, 5000, 10000, 60000, 0};
+  static const struct {
+    const char *name;
+    const kind_t *kinds;
+    int count;
+  } mixes[] = {
+      {"this tree", s_tree_mix, sizeof(s_tree_mix) / sizeof(s_tree_mix[0])},
+      {"generic", s_generic_mix,
+       sizeof(s_generic_mix) / sizeof(s_generic_mix[0])},
+  };
+  double saved_1s[2] = {0};
+
+  printf("%-10s %6s | %6s %8s -> %6s %6s | %8s %8s\n", "mix", "data",
+         "frames", "control", "after", "saved", "attached", "replaced");
+  for (unsigned m = 0; m < sizeof(mixes) / sizeof(mixes[0]); m++) {
+    for (unsigned r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+      result_t result = run(mixes[m].kinds, mixes[m].count, rates[r]);
+      char rate[16] = "none";
+      if (rates[r] != 0) {
+        snprintf(rate, sizeof(rate), "%us", rates[r] / 1000);
+      }
+      printf("%-10s %6s | %6ld %8ld -> %6ld %5.0f%% | %8ld %8ld\n",
+             mixes[m].name, rate, result.data, result.queued,
+             result.standalone, saved(&result), result.attached,
+             result.replaced);
+      CHECK(result.standalone <= result.queued);
+      if (rates[r] == 1000) {
+        saved_1s[m] = saved(&result);
+      }
+    }
+  }
+
+  // With a data frame every second most control frames disappear
+  CHECK(saved_1s[0] > 40 && saved_1s[1] > 50);
+  printf("sim_piggyback: ok\n");
+  return 0;
+}
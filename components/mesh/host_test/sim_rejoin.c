@@ -0,0 +1,225 @@
+/* Host simulation: rejoin time with and without the parent cache
+ *
+ * Replays rejoins on a generated 200-node tree. The node scans the way
+ * mesh_start_parent_scan() does: with the cache, one passive scan per
+ * cached channel, then the full scan if none of them turned up a parent;
+ * without it, the full scan straight away. Parents are picked from what
+ * the scan heard with the parent selection engine, and the cache is
+ * filled and read with the engine's cache functions.
+ *
+ * Radio timings are ESP-IDF defaults: a passive scan dwells 360 ms on a
+ * channel and hears a beacon every 100 ms; each beacon is lost with a
+ * probability that grows as the signal weakens. Connecting to the chosen
+ * parent takes 250-550 ms.
+ */
+
+#include "mesh_parent_select.h"
+#include "sim_tree.h"
+#include "test_support.h"
+#include <math.h>
+#include <string.h>
+
+#define NODES (200)
+#define EVENTS (4000)
+#define CHANNELS (13)
+#define MESH_CHANNEL (6)
+#define MOVED_CHANNEL (11)
+#define DWELL_MS (360)
+#define BEACONS_PER_DWELL (3)
+
+typedef enum {
+  SCENARIO_PARENT_LOST, /* parent died, node rescans */
+  SCENARIO_RESET,       /* node reset, parent still up, cache in RTC RAM */
+  SCENARIO_MOVED,       /* mesh followed the router to another channel */
+  SCENARIO_MAX,
+} scenario_t;
+
+typedef enum {
+  MODE_NO_CACHE,   /* cache disabled */
+  MODE_SEEN_JOIN,  /* entries stamped when the parent was joined */
+  MODE_SEEN_LOSS,  /* entry refreshed when the link went down */
+  MODE_MAX,
+} cache_mode_t;
+
+static const char *s_scenario_names[SCENARIO_MAX] = {"parent lost",
+                                                     "reset", "channel moved"};
+static sim_tree_t s_tree;
+static mesh_parent_engine_t s_engine;
+static uint32_t s_seed = 62;
+static uint32_t s_times[MODE_MAX][SCENARIO_MAX][EVENTS];
+static int s_counts[MODE_MAX][SCENARIO_MAX];
+
+static bool heard(int rssi) {
+  // Beacon loss from 0 at -60 dBm to 90 % at -87 dBm
+  double loss = fmin(0.9, fmax(0.0, (-60.0 - rssi) / 30.0));
+  for (int b = 0; b < BEACONS_PER_DWELL; b++) {
+    if (test_rand(&s_seed) % 1000 >= loss * 1000) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void fill_candidate(mesh_parent_candidate_t *c, int node, int p) {
+  memset(c, 0, sizeof(*c));
+  c->bssid[4] = (uint8_t)(p >> 8);
+  c->bssid[5] = (uint8_t)p;
+  c->rssi = sim_tree_rssi(&s_tree, node, p);
+  c->layer = s_tree.layer[p];
+  c->layer_cap = s_tree.max_layer - s_tree.layer[p];
+  c->assoc = s_tree.children[p];
+  c->assoc_cap = s_tree.max_children;
+}
+
+/**
+ * @brief One passive scan of one channel
+ *
+ * @return Parent picked from the candidates heard, SIM_TREE_NONE if none
+ */
+static int scan_channel(int node, int dead, int channel, int mesh_channel) {
+  mesh_parent_candidate_t candidates[SIM_TREE_MAX_NODES];
+  int index[SIM_TREE_MAX_NODES];
+  int count = 0;
+
+  if (channel != mesh_channel) {
+    return SIM_TREE_NONE;
+  }
+  for (int p = 0; p < s_tree.count; p++) {
+    if (p == node || p == dead || s_tree.layer[p] == 0 ||
+        sim_tree_in_subtree(&s_tree, p, node)) {
+      continue;
+    }
+    int rssi = sim_tree_rssi(&s_tree, node, p);
+    if (rssi < MESH_PARENT_DEFAULT_MIN_RSSI || !heard(rssi)) {
+      continue;
+    }
+    fill_candidate(&candidates[count], node, p);
+    index[count++] = p;
+  }
+  int chosen = mesh_parent_engine_select(&s_engine, candidates, count, NULL);
+  return chosen >= 0 ? index[chosen] : SIM_TREE_NONE;
+}
+
+/**
+ * @brief Time from the start of the rejoin to the parent connection
+ */
+static uint32_t rejoin(int node, int dead, int mesh_channel,
+                       const mesh_parent_cache_t *cache, uint32_t now_s) {
+  uint8_t channels[MESH_PARENT_CACHE_SIZE];
+  uint32_t elapsed = 0;
+  int found = SIM_TREE_NONE;
+
+  int cached = 0;
+  if (cache != NULL) {
+    cached = mesh_parent_cache_channels(cache, now_s,
+                                        MESH_PARENT_CACHE_MAX_AGE_S, channels,
+                                        MESH_PARENT_CACHE_SIZE);
+  }
+  for (int i = 0; i < cached && found == SIM_TREE_NONE; i++) {
+    elapsed += DWELL_MS;
+    found = scan_channel(node, dead, channels[i], mesh_channel);
+  }
+  // Full scans until a parent is heard
+  for (int round = 0; found == SIM_TREE_NONE; round++) {
+    CHECK(round < 20);
+    for (int ch = 1; ch <= CHANNELS; ch++) {
+      elapsed += DWELL_MS;
+      int p = scan_channel(node, dead, ch, mesh_channel);
+      found = (found == SIM_TREE_NONE) ? p : found;
+    }
+  }
+  return elapsed + 250 + test_rand(&s_seed) % 301;
+}
+
+static int compare(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+static uint32_t median(uint32_t *samples, int count) {
+  if (count == 0) {
+    return 0;
+  }
+  qsort(samples, count, sizeof(samples[0]), compare);
+  return samples[count / 2];
+}
+
+int main(void) {
+  sim_tree_config_t config = {
+      .count = NODES,
+      .max_children = 6,
+      .max_layer = 25,
+      .area = 7.0 * sqrt(NODES),
+      .range = 30.0,
+      .seed = 62,
+  };
+  CHECK(sim_tree_generate(&s_tree, &config) == NODES - 1);
+  mesh_parent_engine_init(&s_engine, NULL);
+
+  for (int e = 0; e < EVENTS; e++) {
+    int node = 1 + test_rand(&s_seed) % (NODES - 1);
+    int parent = s_tree.parent[node];
+    uint32_t r = test_rand(&s_seed) % 100;
+    scenario_t scenario = r < 70   ? SCENARIO_PARENT_LOST
+                          : r < 90 ? SCENARIO_RESET
+                                   : SCENARIO_MOVED;
+    // Time connected to the parent, from minutes to two days
+    uint32_t uptime_s = 60 + test_rand(&s_seed) % (48 * 3600);
+    uint32_t now_s = 1000000;
+    int dead = (scenario == SCENARIO_PARENT_LOST) ? parent : SIM_TREE_NONE;
+    int channel = (scenario == SCENARIO_MOVED) ? MOVED_CHANNEL : MESH_CHANNEL;
+
+    for (int m = 0; m < MODE_MAX; m++) {
+      mesh_parent_cache_t cache = {0};
+      mesh_parent_cache_validate(&cache); // as after a power cycle
+      mesh_parent_cache_entry_t entry = {
+          .channel = MESH_CHANNEL,
+          .layer = s_tree.layer[parent],
+          .rssi = sim_tree_rssi(&s_tree, node, parent),
+          .seen_s = now_s - uptime_s,
+      };
+      entry.bssid[4] = (uint8_t)(parent >> 8);
+      entry.bssid[5] = (uint8_t)parent;
+      mesh_parent_cache_update(&cache, &entry);
+      if (m == MODE_SEEN_LOSS && scenario != SCENARIO_RESET) {
+        // A reset gives no disconnect event to refresh the entry
+        entry.seen_s = now_s;
+        mesh_parent_cache_update(&cache, &entry);
+      }
+
+      uint32_t ms = rejoin(node, dead, channel,
+                           m == MODE_NO_CACHE ? NULL : &cache, now_s);
+      s_times[m][scenario][s_counts[m][scenario]++] = ms;
+    }
+  }
+
+  printf("%-14s %6s | %9s %14s %16s\n", "median ms", "events", "no cache",
+         "seen at join", "refreshed on loss");
+  uint32_t all[MODE_MAX][EVENTS];
+  int total = 0;
+  for (int m = 0; m < MODE_MAX; m++) {
+    total = 0;
+    for (int s = 0; s < SCENARIO_MAX; s++) {
+      memcpy(&all[m][total], s_times[m][s], s_counts[m][s] * sizeof(uint32_t));
+      total += s_counts[m][s];
+    }
+  }
+  for (int s = 0; s < SCENARIO_MAX; s++) {
+    uint32_t med[MODE_MAX];
+    for (int m = 0; m < MODE_MAX; m++) {
+      med[m] = median(s_times[m][s], s_counts[m][s]);
+    }
+    printf("%-14s %6d | %9u %14u %16u\n", s_scenario_names[s], s_counts[0][s],
+           med[0], med[1], med[2]);
+  }
+  uint32_t none = median(all[MODE_NO_CACHE], total);
+  uint32_t join = median(all[MODE_SEEN_JOIN], total);
+  uint32_t loss = median(all[MODE_SEEN_LOSS], total);
+  printf("%-14s %6d | %9u %14u %16u\n", "all", total, none, join, loss);
+
+  // The cache must pay off once it is kept fresh
+  CHECK(loss * 3 < none);
+  CHECK(loss <= join);
+  printf("sim_rejoin: ok\n");
+  return 0;
+}
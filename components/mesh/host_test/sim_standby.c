@@ -0,0 +1,188 @@
+/* Host simulation: standby root failover
+ *
+ * Runs the standby's takeover engine against a simulated root, tick by
+ * tick as the standby task does:
+ *
+ * - The root sends a heartbeat every 500 ms. Heartbeats are lost in
+ *   bursts, about 9 % of them, from a two-state channel that enters a
+ *   burst with 2 % and leaves it with 20 % per heartbeat.
+ * - When the root fails, the standby notices the lost parent link after
+ *   0.6-2 s of missed beacons. Connecting to the router takes 250-800 ms.
+ * - With a live root, the standby's link drops once an hour on average
+ *   for 0.5-4 s, losing the heartbeats meanwhile.
+ *
+ * Blackout is the time from the root's failure until the standby is root
+ * and connected. A day with a live root counts the takeovers the parent
+ * link check prevents and the ones it does not.
+ */
+
+#include "mesh_standby.h"
+#include "mesh_standby_engine.h"
+#include "test_support.h"
+#include <string.h>
+
+#define FAILURES (20000)
+#define HEARTBEAT_MS (MESH_STANDBY_DEFAULT_HEARTBEAT_MS)
+#define TICK_MS (MESH_STANDBY_TICK_MS)
+#define DAY_MS (86400u * 1000u)
+
+static uint32_t s_seed = 69;
+
+static uint32_t uniform(uint32_t low, uint32_t high) {
+  return low + test_rand(&s_seed) % (high - low + 1);
+}
+
+/**
+ * @brief Heartbeats as the standby receives them
+ */
+typedef struct {
+  uint32_t next_send_ms; /**< Root's next heartbeat */
+  bool burst;            /**< Channel is in a loss burst */
+  uint32_t last_ms;      /**< Last heartbeat received */
+} heartbeats_t;
+
+static void heartbeats_run(heartbeats_t *hb, uint32_t until_ms, bool root_up,
+                           bool link_up) {
+  // Only heartbeats that have arrived by until_ms, whatever their latency
+  for (; hb->next_send_ms + 30 <= until_ms;
+       hb->next_send_ms += HEARTBEAT_MS) {
+    uint32_t r = test_rand(&s_seed) % 100;
+    hb->burst = hb->burst ? r >= 20 : r < 2;
+    if (root_up && link_up && !hb->burst) {
+      hb->last_ms = hb->next_send_ms + uniform(5, 30);
+    }
+  }
+}
+
+static int compare(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * @brief Fail the root once and time the takeover
+ */
+static void failover(uint32_t timeout_ms, uint32_t *detect_ms,
+                     uint32_t *blackout_ms) {
+  mesh_standby_watch_t watch;
+  heartbeats_t hb = {.next_send_ms = uniform(0, HEARTBEAT_MS - 1)};
+  uint32_t fail_ms = uniform(10000, 20000);
+  uint32_t orphaned_ms = fail_ms + uniform(600, 2000);
+  uint32_t root_up_ms = 0;
+
+  mesh_standby_watch_init(&watch, timeout_ms);
+  for (uint32_t now = uniform(0, TICK_MS - 1);; now += TICK_MS) {
+    heartbeats_run(&hb, now, now < fail_ms, true);
+    if (root_up_ms != 0 && now >= root_up_ms) {
+      CHECK(mesh_standby_watch_root(&watch));
+      *blackout_ms = root_up_ms - fail_ms;
+      return;
+    }
+    if (now < orphaned_ms) {
+      CHECK(!mesh_standby_watch_connected(&watch, true));
+    } else if (root_up_ms == 0 &&
+               mesh_standby_watch_due(&watch, true, hb.last_ms, now)) {
+      CHECK(!mesh_standby_watch_started(&watch, now));
+      *detect_ms = now - fail_ms;
+      root_up_ms = now + uniform(250, 800);
+    }
+    CHECK(now < fail_ms + 60000);
+  }
+}
+
+/**
+ * @brief One day with a live root
+ *
+ * @param takeovers Takeovers started with the parent link check
+ * @param silences Times the heartbeat alone would have called the root lost
+ */
+static void live_day(uint32_t timeout_ms, int *takeovers, int *silences) {
+  mesh_standby_watch_t watch;
+  heartbeats_t hb = {0};
+  uint32_t link_down_until = 0;
+  bool silent = false;
+
+  *takeovers = *silences = 0;
+  mesh_standby_watch_init(&watch, timeout_ms);
+  for (uint32_t now = 0; now < DAY_MS; now += TICK_MS) {
+    if (now >= link_down_until && test_rand(&s_seed) % 36000 == 0) {
+      link_down_until = now + uniform(500, 4000);
+    }
+    bool link_up = now >= link_down_until;
+    heartbeats_run(&hb, now, true, link_up);
+
+    bool quiet = now - hb.last_ms >= timeout_ms;
+    *silences += quiet && !silent;
+    silent = quiet;
+
+    if (link_up) {
+      mesh_standby_watch_connected(&watch, true);
+    } else if (mesh_standby_watch_due(&watch, true, hb.last_ms, now)) {
+      mesh_standby_watch_started(&watch, now);
+      (*takeovers)++;
+    }
+  }
+}
+
+static void check_rules(void) {
+  mesh_standby_watch_t watch;
+
+  // A standby below another relay never takes over
+  mesh_standby_watch_init(&watch, 2000);
+  mesh_standby_watch_connected(&watch, false);
+  CHECK(!mesh_standby_watch_due(&watch, true, 0, 10000));
+
+  // Nor does one that does not know the router
+  mesh_standby_watch_connected(&watch, true);
+  CHECK(!mesh_standby_watch_due(&watch, false, 0, 10000));
+  CHECK(!mesh_standby_watch_due(&watch, true, 9000, 10000));
+  CHECK(mesh_standby_watch_due(&watch, true, 8000, 10000));
+
+  // A pending takeover is retried after the timeout, then counted failed
+  CHECK(!mesh_standby_watch_started(&watch, 10000));
+  CHECK(!mesh_standby_watch_due(&watch, true, 8000, 11900));
+  CHECK(mesh_standby_watch_due(&watch, true, 8000, 12000));
+  CHECK(mesh_standby_watch_started(&watch, 12000));
+
+  // Finding a parent ends it as failed, becoming root as completed
+  CHECK(mesh_standby_watch_connected(&watch, true));
+  CHECK(!mesh_standby_watch_root(&watch));
+  mesh_standby_watch_started(&watch, 20000);
+  CHECK(mesh_standby_watch_root(&watch));
+}
+
+int main(void) {
+  static const uint32_t timeouts[] = {1000, 1500, 2000, 3000};
+  static uint32_t detect[FAILURES], blackout[FAILURES];
+  uint32_t default_p95 = 0;
+
+  check_rules();
+  printf("%7s | %14s | %16s | %12s %13s\n", "timeout", "detect p50/p95",
+         "blackout p50/p95", "silences/day", "takeovers/day");
+  for (unsigned t = 0; t < sizeof(timeouts) / sizeof(timeouts[0]); t++) {
+    for (int i = 0; i < FAILURES; i++) {
+      failover(timeouts[t], &detect[i], &blackout[i]);
+      CHECK(detect[i] < blackout[i]);
+    }
+    qsort(detect, FAILURES, sizeof(detect[0]), compare);
+    qsort(blackout, FAILURES, sizeof(blackout[0]), compare);
+
+    int takeovers, silences;
+    live_day(timeouts[t], &takeovers, &silences);
+    printf("%7u | %6u / %5u | %7u / %6u | %12d %13d\n", timeouts[t],
+           detect[FAILURES / 2], detect[FAILURES * 95 / 100],
+           blackout[FAILURES / 2], blackout[FAILURES * 95 / 100], silences,
+           takeovers);
+
+    // The link check filters out nearly every heartbeat silence
+    CHECK(takeovers * 20 < silences);
+    if (timeouts[t] == MESH_STANDBY_DEFAULT_LOSS_TIMEOUT_MS) {
+      default_p95 = blackout[FAILURES * 95 / 100];
+    }
+  }
+
+  // Within a second of the slowest link loss detection
+  CHECK(default_p95 > 0 && default_p95 < 2000 + 1000);
+  printf("sim_standby: ok\n");
+  return 0;
+}
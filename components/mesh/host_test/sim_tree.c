@@ -0,0 +1,134 @@
+/* Mesh Topology Generator Implementation */
+
+#include "sim_tree.h"
+#include "test_support.h"
+#include <math.h>
+#include <string.h>
+
+#define MIN_RSSI (-80)
+#define W_RSSI (4)
+#define W_LAYER (40)
+
+static double distance(const sim_tree_t *tree, int a, int b) {
+  return hypot(tree->x[a] - tree->x[b], tree->y[a] - tree->y[b]);
+}
+
+int sim_tree_rssi(const sim_tree_t *tree, int a, int b) {
+  return (int)(-30.0 - 25.0 * log10(distance(tree, a, b) + 1.0));
+}
+
+bool sim_tree_in_subtree(const sim_tree_t *tree, int node, int top) {
+  for (int n = node; n != SIM_TREE_NONE; n = tree->parent[n]) {
+    if (n == top) {
+      return true;
+    }
+  }
+  return false;
+}
+
+int sim_tree_choose_parent(const sim_tree_t *tree, int node, int exclude,
+                           sim_tree_penalty_t penalty, void *ctx) {
+  int best = SIM_TREE_NONE;
+  long best_score = 0;
+
+  for (int p = 0; p < tree->count; p++) {
+    if (p == node || p == exclude || tree->layer[p] == 0 ||
+        tree->layer[p] >= tree->max_layer ||
+        tree->children[p] >= tree->max_children ||
+        distance(tree, node, p) > tree->range ||
+        sim_tree_in_subtree(tree, p, node)) {
+      continue;
+    }
+    int rssi = sim_tree_rssi(tree, node, p);
+    if (rssi < MIN_RSSI) {
+      continue;
+    }
+    long score = W_RSSI * (rssi - MIN_RSSI) - W_LAYER * tree->layer[p] -
+                 tree->children[p] * 100 / tree->max_children;
+    if (penalty != NULL) {
+      score -= penalty(ctx, node, p);
+    }
+    if (best == SIM_TREE_NONE || score > best_score) {
+      best = p;
+      best_score = score;
+    }
+  }
+  return best;
+}
+
+static void relayer(sim_tree_t *tree, int node, int layer) {
+  tree->layer[node] = layer;
+  for (int c = 0; c < tree->count; c++) {
+    if (tree->parent[c] == node) {
+      relayer(tree, c, layer == 0 ? 0 : layer + 1);
+    }
+  }
+}
+
+void sim_tree_set_parent(sim_tree_t *tree, int node, int parent) {
+  if (tree->parent[node] != SIM_TREE_NONE) {
+    tree->children[tree->parent[node]]--;
+  }
+  tree->parent[node] = parent;
+  if (parent != SIM_TREE_NONE) {
+    tree->children[parent]++;
+    relayer(tree, node, tree->layer[parent] + 1);
+  } else {
+    relayer(tree, node, 0);
+  }
+}
+
+int sim_tree_depth(const sim_tree_t *tree) {
+  int depth = 0;
+  for (int i = 0; i < tree->count; i++) {
+    if (tree->layer[i] > depth) {
+      depth = tree->layer[i];
+    }
+  }
+  return depth;
+}
+
+int sim_tree_generate(sim_tree_t *tree, const sim_tree_config_t *config) {
+  uint32_t seed = config->seed ? config->seed : 1;
+  int order[SIM_TREE_MAX_NODES];
+  int joined = 0;
+
+  CHECK(config->count > 1 && config->count <= SIM_TREE_MAX_NODES);
+  memset(tree, 0, sizeof(*tree));
+  tree->count = config->count;
+  tree->max_children = config->max_children;
+  tree->max_layer = config->max_layer;
+  tree->range = config->range;
+
+  for (int i = 0; i < tree->count; i++) {
+    tree->x[i] = (test_rand(&seed) % 10000) * config->area / 10000.0;
+    tree->y[i] = (test_rand(&seed) % 10000) * config->area / 10000.0;
+    tree->parent[i] = SIM_TREE_NONE;
+    order[i] = i;
+  }
+  tree->x[0] = tree->y[0] = config->area / 2;
+  tree->layer[0] = 1;
+
+  for (int i = tree->count - 1; i > 1; i--) {
+    int j = 1 + test_rand(&seed) % i;
+    int t = order[i];
+    order[i] = order[j];
+    order[j] = t;
+  }
+
+  // Nodes out of reach wait for a later pass, as they keep scanning
+  for (int pass = 0; pass < 16; pass++) {
+    for (int k = 1; k < tree->count; k++) {
+      int n = order[k];
+      if (tree->layer[n] != 0) {
+        continue;
+      }
+      int p = sim_tree_choose_parent(tree, n, SIM_TREE_NONE, NULL, NULL);
+      if (p != SIM_TREE_NONE) {
+        sim_tree_set_parent(tree, n, p);
+        joined++;
+      }
+    }
+  }
+  return joined;
+}
@@ -0,0 +1,104 @@
+/* Mesh Topology Generator for Host Simulations
+ *
+ * Places nodes at random in a square area with the root in the middle and
+ * lets them join in random order the way ESP-MESH nodes do: each picks the
+ * best joined parent in radio range by RSSI, layer and load, skipping full
+ * parents. Node 0 is the root on layer 1.
+ */
+
+#ifndef __SIM_TREE_H__
+#define __SIM_TREE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define SIM_TREE_MAX_NODES (512)
+#define SIM_TREE_NONE (-1)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief Generator parameters
+ */
+typedef struct {
+  int count;        /**< Nodes including the root */
+  int max_children; /**< Association slots per node */
+  int max_layer;    /**< Deepest layer allowed */
+  double area;      /**< Side of the square, in metres */
+  double range;     /**< Radio range, in metres */
+  uint32_t seed;    /**< Seed, the same seed gives the same tree */
+} sim_tree_config_t;
+
+/**
+ * @brief Generated tree
+ */
+typedef struct {
+  int count;
+  int max_children;
+  int max_layer;
+  double range;
+  double x[SIM_TREE_MAX_NODES];
+  double y[SIM_TREE_MAX_NODES];
+  int parent[SIM_TREE_MAX_NODES];   /**< SIM_TREE_NONE for the root */
+  int layer[SIM_TREE_MAX_NODES];    /**< 0 if not joined */
+  int children[SIM_TREE_MAX_NODES]; /**< Number of children */
+} sim_tree_t;
+
+/**
+ * @brief Extra score taken off a candidate parent, e.g. a busy penalty
+ */
+typedef int (*sim_tree_penalty_t)(void *ctx, int node, int parent);
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Generate a tree
+ *
+ * @return Number of nodes besides the root that joined
+ */
+int sim_tree_generate(sim_tree_t *tree, const sim_tree_config_t *config);
+
+/**
+ * @brief Received signal strength between two nodes, log-distance model
+ */
+int sim_tree_rssi(const sim_tree_t *tree, int a, int b);
+
+/**
+ * @brief Check whether node lies in the subtree of top (or is top)
+ */
+bool sim_tree_in_subtree(const sim_tree_t *tree, int node, int top);
+
+/**
+ * @brief Best parent for a node, as it would pick after a scan
+ *
+ * Candidates must be joined, in range, not full and not in the node's own
+ * subtree. The score mirrors the default weights of mesh_parent_select.h.
+ *
+ * @param exclude Parent to skip, SIM_TREE_NONE for none
+ * @param penalty Extra score taken off candidates, may be NULL
+ *
+ * @return Parent, SIM_TREE_NONE if there is none
+ */
+int sim_tree_choose_parent(const sim_tree_t *tree, int node, int exclude,
+                           sim_tree_penalty_t penalty, void *ctx);
+
+/**
+ * @brief Move a node, with its subtree, to a new parent
+ *
+ * @param parent New parent, SIM_TREE_NONE to detach the subtree
+ */
+void sim_tree_set_parent(sim_tree_t *tree, int node, int parent);
+
+/**
+ * @brief Deepest layer in use
+ */
+int sim_tree_depth(const sim_tree_t *tree);
+
+#endif /* __SIM_TREE_H__ */
@@ -0,0 +1,177 @@
+/* Host test: link quality estimator engine
+ *
+ * Feeds the estimator sends over links with known loss and RSSI samples
+ * the way mesh_link.c does, and checks the ETX it settles on, how fast it
+ * follows a link that gets worse, the counters and the table's slot
+ * reuse.
+ */
+
+#include "mesh_link_engine.h"
+#include "test_support.h"
+#include <string.h>
+
+#define RUNS (200)
+
+static const uint8_t s_mac[6] = {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01};
+static uint32_t s_seed = 71;
+
+static bool delivered(int loss_percent) {
+  return (int)(test_rand(&s_seed) % 100) >= loss_percent;
+}
+
+static void test_counters(void) {
+  mesh_link_engine_t engine;
+  mesh_link_estimate_t estimate;
+
+  mesh_link_engine_init(&engine);
+  int index = mesh_link_engine_sample(&engine, s_mac, MESH_LINK_ROLE_PARENT,
+                                      -60, 0);
+  CHECK(index >= 0 && mesh_link_engine_parent(&engine) == index);
+
+  // No ETX until MESH_LINK_MIN_SENDS sends
+  for (int i = 0; i < MESH_LINK_MIN_SENDS - 1; i++) {
+    mesh_link_engine_send(&engine, index, true, 10);
+  }
+  mesh_link_engine_estimate(&engine, index, 10, &estimate);
+  CHECK(estimate.etx == MESH_LINK_ETX_UNKNOWN);
+  mesh_link_engine_send(&engine, index, true, 10);
+  mesh_link_engine_estimate(&engine, index, 10, &estimate);
+  CHECK(estimate.etx == 10 && estimate.delivery_permille == 1000);
+
+  // Two failures in a row: the second send and the one after are retries
+  mesh_link_engine_send(&engine, index, false, 20);
+  mesh_link_engine_send(&engine, index, false, 20);
+  mesh_link_engine_send(&engine, index, true, 20);
+  mesh_link_engine_send(&engine, index, true, 30);
+  mesh_link_engine_estimate(&engine, index, 50, &estimate);
+  CHECK(estimate.sent == MESH_LINK_MIN_SENDS + 4);
+  CHECK(estimate.failed == 2 && estimate.retries == 2);
+  CHECK(estimate.etx > 10 && estimate.age_ms == 20);
+
+  // A link that delivers nothing saturates
+  for (int i = 0; i < 200; i++) {
+    mesh_link_engine_send(&engine, index, false, 40);
+  }
+  mesh_link_engine_estimate(&engine, index, 40, &estimate);
+  CHECK(estimate.etx == MESH_LINK_ETX_MAX && estimate.delivery_permille < 5);
+}
+
+static void test_rssi(void) {
+  mesh_link_engine_t engine;
+  mesh_link_estimate_t estimate;
+  int index = -1;
+
+  // The first samples are a plain mean, not a climb from 0
+  mesh_link_engine_init(&engine);
+  index = mesh_link_engine_sample(&engine, s_mac, MESH_LINK_ROLE_PARENT, -75,
+                                  0);
+  mesh_link_engine_estimate(&engine, index, 0, &estimate);
+  CHECK(estimate.rssi == -75);
+  index = mesh_link_engine_sample(&engine, s_mac, MESH_LINK_ROLE_PARENT, -65,
+                                  1);
+  mesh_link_engine_estimate(&engine, index, 1, &estimate);
+  CHECK(estimate.rssi == -70);
+
+  // Then settles on a steady value
+  for (int i = 0; i < 6 * MESH_LINK_RSSI_WEIGHT; i++) {
+    mesh_link_engine_sample(&engine, s_mac, MESH_LINK_ROLE_PARENT, -60, 2);
+  }
+  mesh_link_engine_estimate(&engine, index, 2, &estimate);
+  CHECK(estimate.rssi >= -61 && estimate.rssi <= -60);
+}
+
+static void test_accuracy(void) {
+  static const int losses[] = {0, 10, 20, 30, 50};
+
+  printf("%5s %8s %13s\n", "loss", "true ETX", "mean estimate");
+  for (unsigned l = 0; l < sizeof(losses) / sizeof(losses[0]); l++) {
+    double sum = 0;
+    int samples = 0;
+    for (int run = 0; run < RUNS; run++) {
+      mesh_link_engine_t engine;
+      mesh_link_engine_init(&engine);
+      int index = mesh_link_engine_sample(&engine, s_mac,
+                                          MESH_LINK_ROLE_PARENT, -60, 0);
+      for (uint32_t k = 1; k <= 400; k++) {
+        mesh_link_engine_send(&engine, index, delivered(losses[l]), k);
+        if (k > 300) {
+          mesh_link_estimate_t estimate;
+          mesh_link_engine_estimate(&engine, index, k, &estimate);
+          sum += estimate.etx;
+          samples++;
+        }
+      }
+    }
+    double truth = 100.0 / (100 - losses[l]);
+    double mean = sum / samples / 10;
+    printf("%4d%% %8.2f %13.2f\n", losses[l], truth, mean);
+    // The EWMA is biased up by its spread, by less than 15 %
+    CHECK(mean >= truth * 0.97 && mean <= truth * 1.15);
+  }
+}
+
+static void test_step(void) {
+  long total = 0;
+
+  // A good link turns to 30 % loss; count sends until ETX passes 1.3
+  for (int run = 0; run < RUNS; run++) {
+    mesh_link_engine_t engine;
+    mesh_link_estimate_t estimate;
+    mesh_link_engine_init(&engine);
+    int index = mesh_link_engine_sample(&engine, s_mac, MESH_LINK_ROLE_PARENT,
+                                        -60, 0);
+    for (uint32_t k = 0; k < 200; k++) {
+      mesh_link_engine_send(&engine, index, true, k);
+    }
+    int sends = 0;
+    do {
+      mesh_link_engine_send(&engine, index, delivered(30), 200);
+      mesh_link_engine_estimate(&engine, index, 200, &estimate);
+      sends++;
+    } while (estimate.etx < 13 && sends < 1000);
+    total += sends;
+  }
+  printf("0%% -> 30%% loss: ETX passes 1.3 after %ld sends on average\n",
+         total / RUNS);
+  CHECK(total / RUNS <= 3 * MESH_LINK_DELIVERY_WEIGHT);
+}
+
+static void test_slots(void) {
+  mesh_link_engine_t engine;
+  uint8_t mac[6] = {0x24, 0x0A, 0xC4, 0x00, 0x01, 0x00};
+
+  // A table of current neighbours has no room
+  mesh_link_engine_init(&engine);
+  for (int i = 0; i < MESH_LINK_TABLE_SIZE; i++) {
+    mac[5] = (uint8_t)i;
+    CHECK(mesh_link_engine_sample(&engine, mac, MESH_LINK_ROLE_CHILD, -50,
+                                  (uint32_t)i) == i);
+  }
+  mac[5] = 0xFF;
+  CHECK(mesh_link_engine_sample(&engine, mac, MESH_LINK_ROLE_CHILD, -50,
+                                100) == -1);
+
+  // Former neighbours give way, the one seen longest ago first
+  mesh_link_engine_clear_roles(&engine);
+  CHECK(mesh_link_engine_parent(&engine) == -1);
+  for (int i = 1; i < MESH_LINK_TABLE_SIZE; i++) {
+    mac[5] = (uint8_t)i;
+    mesh_link_engine_sample(&engine, mac, MESH_LINK_ROLE_CHILD, -50, 200);
+  }
+  mac[5] = 0xFF;
+  CHECK(mesh_link_engine_sample(&engine, mac, MESH_LINK_ROLE_PARENT, -50,
+                                300) == 0);
+  CHECK(mesh_link_engine_parent(&engine) == 0);
+  mac[5] = 0;
+  CHECK(mesh_link_engine_find(&engine, mac) == -1);
+}
+
+int main(void) {
+  test_counters();
+  test_rssi();
+  test_accuracy();
+  test_step();
+  test_slots();
+  printf("test_link_engine: ok\n");
+  return 0;
+}
@@ -0,0 +1,210 @@
+/* Host test: parent selection replayed from scan tables
+ *
+ * Reads the scan tables in scans/ (or the files given on the command line)
+ * and runs every scan through the parent selection engine, checking the
+ * chosen parent against the one the table expects. Tables are text, one
+ * directive per line:
+ *
+ *     scan <name>              start a scan
+ *     current <bssid>          parent before the scan, if any
+ *     record <bssid> good|bad  connection outcome, kept for later scans
+ *     ap <bssid> <rssi> <layer> <layer_cap> <assoc> <assoc_cap>
+ *        <layer2_cap> <etx>    one candidate
+ *     expect <bssid>|none      select and check
+ *
+ * Anything up to "<SCAN>" is skipped, so "ap" lines can be cut from a
+ * node's debug log, where mesh.c prints every candidate in this format.
+ */
+
+#include "mesh_parent_select.h"
+#include "test_support.h"
+#include <dirent.h>
+#include <string.h>
+
+#define MAX_CANDIDATES (32)
+#define MAX_FILES (32)
+
+typedef struct {
+  char name[64];
+  mesh_parent_candidate_t candidates[MAX_CANDIDATES];
+  int count;
+  uint8_t current[6];
+  bool has_current;
+} scan_t;
+
+static int s_scans, s_switches, s_kept;
+
+static bool parse_mac(const char *text, uint8_t *mac) {
+  unsigned b[6];
+  if (sscanf(text, "%x:%x:%x:%x:%x:%x", &b[0], &b[1], &b[2], &b[3], &b[4],
+             &b[5]) != 6) {
+    return false;
+  }
+  for (int i = 0; i < 6; i++) {
+    mac[i] = (uint8_t)b[i];
+  }
+  return true;
+}
+
+static int find(const scan_t *scan, const uint8_t *mac) {
+  for (int i = 0; i < scan->count; i++) {
+    if (memcmp(scan->candidates[i].bssid, mac, 6) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief Select a parent for a completed scan and check the expectation
+ */
+static void run_scan(const char *file, int line, mesh_parent_engine_t *engine,
+                     const scan_t *scan, const char *expect) {
+  const uint8_t *current = scan->has_current ? scan->current : NULL;
+  int chosen = mesh_parent_engine_select(engine, scan->candidates,
+                                         scan->count, current);
+  int wanted = -1;
+  if (strcmp(expect, "none") != 0) {
+    uint8_t mac[6];
+    CHECK(parse_mac(expect, mac));
+    wanted = find(scan, mac);
+    CHECK(wanted >= 0);
+  }
+
+  // select() must agree with score() and should_switch()
+  int32_t best = MESH_PARENT_SCORE_REJECT, kept = MESH_PARENT_SCORE_REJECT;
+  int best_index = -1, kept_index = current ? find(scan, current) : -1;
+  printf("%s: %s\n", file, scan->name);
+  for (int i = 0; i < scan->count; i++) {
+    int32_t score = mesh_parent_engine_score(engine, &scan->candidates[i]);
+    const uint8_t *b = scan->candidates[i].bssid;
+    if (score == MESH_PARENT_SCORE_REJECT) {
+      printf("  %02x:%02x:%02x:%02x:%02x:%02x   reject\n", b[0], b[1], b[2],
+             b[3], b[4], b[5]);
+    } else {
+      printf("  %02x:%02x:%02x:%02x:%02x:%02x %8d%s\n", b[0], b[1], b[2],
+             b[3], b[4], b[5], (int)score, i == chosen ? "  <-" : "");
+    }
+    if (i == kept_index) {
+      kept = score;
+    } else if (score > best) {
+      best = score;
+      best_index = i;
+    }
+  }
+  int model = mesh_parent_engine_should_switch(engine, best, kept)
+                  ? best_index
+                  : (kept != MESH_PARENT_SCORE_REJECT ? kept_index : -1);
+  CHECK(model == chosen);
+
+  if (chosen != wanted) {
+    fprintf(stderr, "%s:%d: %s chose %d, expected %d\n", file, line,
+            scan->name, chosen, wanted);
+    exit(1);
+  }
+  s_scans++;
+  if (kept_index >= 0 && chosen >= 0) {
+    s_switches += chosen != kept_index;
+    s_kept += chosen == kept_index;
+  }
+}
+
+static void replay(const char *path) {
+  static mesh_parent_engine_t engine;
+  static scan_t scan;
+  char text[256];
+  int line = 0;
+  bool open_scan = false;
+
+  FILE *f = fopen(path, "r");
+  CHECK(f != NULL);
+  mesh_parent_engine_init(&engine, NULL);
+
+  while (fgets(text, sizeof(text), f) != NULL) {
+    char *p = strstr(text, "<SCAN>");
+    p = (p != NULL) ? p + strlen("<SCAN>") : text;
+    char word[16] = "", arg[64] = "", extra[16] = "";
+    line++;
+    if (sscanf(p, "%15s %63s %15s", word, arg, extra) < 1 || word[0] == '#') {
+      continue;
+    }
+
+    if (strcmp(word, "scan") == 0) {
+      memset(&scan, 0, sizeof(scan));
+      snprintf(scan.name, sizeof(scan.name), "%s", arg);
+      open_scan = true;
+    } else if (strcmp(word, "current") == 0) {
+      CHECK(open_scan && parse_mac(arg, scan.current));
+      scan.has_current = true;
+    } else if (strcmp(word, "record") == 0) {
+      uint8_t mac[6];
+      CHECK(parse_mac(arg, mac));
+      CHECK(strcmp(extra, "good") == 0 || strcmp(extra, "bad") == 0);
+      mesh_parent_engine_record(&engine, mac, strcmp(extra, "good") == 0);
+    } else if (strcmp(word, "ap") == 0) {
+      int v[7];
+      CHECK(open_scan && scan.count < MAX_CANDIDATES);
+      mesh_parent_candidate_t *c = &scan.candidates[scan.count++];
+      CHECK(parse_mac(arg, c->bssid));
+      CHECK(sscanf(p, "%*s %*s %d %d %d %d %d %d %d", &v[0], &v[1], &v[2],
+                   &v[3], &v[4], &v[5], &v[6]) == 7);
+      c->rssi = v[0];
+      c->layer = v[1];
+      c->layer_cap = v[2];
+      c->assoc = v[3];
+      c->assoc_cap = v[4];
+      c->layer2_cap = v[5];
+      c->etx = v[6];
+    } else if (strcmp(word, "expect") == 0) {
+      CHECK(open_scan);
+      run_scan(path, line, &engine, &scan, arg);
+      open_scan = false;
+    } else {
+      fprintf(stderr, "%s:%d: unknown directive %s\n", path, line, word);
+      exit(1);
+    }
+  }
+  CHECK(!open_scan);
+  fclose(f);
+}
+
+static int compare(const void *a, const void *b) {
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+int main(int argc, char **argv) {
+  static char names[MAX_FILES][280];
+  char *files[MAX_FILES];
+  int count = 0;
+
+  if (argc > 1) {
+    for (int i = 1; i < argc && count < MAX_FILES; i++) {
+      files[count++] = argv[i];
+    }
+  } else {
+    DIR *dir = opendir("scans");
+    CHECK(dir != NULL);
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL && count < MAX_FILES) {
+      size_t n = strlen(entry->d_name);
+      if (n > 5 && strcmp(entry->d_name + n - 5, ".scan") == 0) {
+        snprintf(names[count], sizeof(names[count]), "scans/%s",
+                 entry->d_name);
+        files[count] = names[count];
+        count++;
+      }
+    }
+    closedir(dir);
+  }
+  CHECK(count > 0);
+  qsort(files, count, sizeof(files[0]), compare);
+
+  for (int i = 0; i < count; i++) {
+    replay(files[i]);
+  }
+  printf("%d scans from %d tables, previous parent kept %d times, left %d "
+         "times\n",
+         s_scans, count, s_kept, s_switches);
+  printf("test_parent_select: ok\n");
+  return 0;
+}
@@ -0,0 +1,209 @@
+/* Host test: store-and-forward queue engine
+ *
+ * Queues records up to the largest allowed, spills to an in-memory flash
+ * ring, and drains the queue in bursts the way the replay task does,
+ * checking order, contents and counters.
+ */
+
+#include "mem_flash.h"
+#include "mesh_store_forward_engine.h"
+#include "test_support.h"
+#include <string.h>
+
+#define RECORD_MAX (1400) /* MESH_SF_DEFAULT_BURST_BYTES */
+#define HEADER (3)        /* mesh_batch_record_header_t */
+#define PAYLOAD_MAX (RECORD_MAX - HEADER)
+
+typedef struct {
+  uint32_t next;  /* sequence number expected next */
+  uint32_t count; /* records seen */
+} drain_t;
+
+static uint16_t payload_length(uint32_t seq) {
+  // Mix of small readings and records of the largest size
+  return (seq % 7 == 0) ? PAYLOAD_MAX : 8 + seq % 200;
+}
+
+static void make_payload(uint32_t seq, uint8_t *payload, uint16_t length) {
+  for (uint16_t i = 0; i < length; i++) {
+    payload[i] = (uint8_t)(seq * 31 + i);
+  }
+  memcpy(payload, &seq, sizeof(seq));
+}
+
+static void enqueue(mesh_sf_engine_t *engine, uint32_t seq) {
+  uint8_t payload[PAYLOAD_MAX];
+  uint16_t length = payload_length(seq);
+  make_payload(seq, payload, length);
+  CHECK(mesh_sf_engine_enqueue(engine, 0x10 + seq % 4, payload, length) ==
+        ESP_OK);
+}
+
+/**
+ * @brief Check the records of a burst; sequence numbers may skip records
+ *        lost to overflow but never go backwards
+ */
+static void check_burst(const uint8_t *buf, size_t length, drain_t *drain) {
+  size_t offset = 0;
+  while (offset < length) {
+    uint8_t type = buf[offset];
+    uint16_t record;
+    memcpy(&record, &buf[offset + 1], sizeof(record));
+    offset += HEADER;
+
+    uint32_t seq;
+    uint8_t expect[PAYLOAD_MAX];
+    memcpy(&seq, &buf[offset], sizeof(seq));
+    CHECK(seq >= drain->next);
+    CHECK(type == 0x10 + seq % 4);
+    CHECK(record == payload_length(seq));
+    make_payload(seq, expect, record);
+    CHECK(memcmp(&buf[offset], expect, record) == 0);
+    offset += record;
+    drain->next = seq + 1;
+    drain->count++;
+  }
+  CHECK(offset == length);
+}
+
+static int drain(mesh_sf_engine_t *engine, size_t limit, drain_t *state) {
+  static uint8_t buf[RECORD_MAX];
+  int bursts = 0;
+  mesh_sf_burst_t burst;
+
+  while (mesh_sf_engine_take_burst(engine, buf, limit, &burst) > 0) {
+    CHECK(burst.length <= RECORD_MAX);
+    CHECK(burst.flash_taken + burst.ram_taken == 1 || burst.length <= limit);
+    check_burst(buf, burst.length, state);
+    mesh_sf_engine_finish(engine, &burst, ESP_OK);
+    bursts++;
+  }
+  CHECK(mesh_sf_engine_pending(engine) == 0);
+  CHECK(engine->stats.ram_used == 0 && engine->stats.flash_used == 0);
+  return bursts;
+}
+
+static void test_largest_record(void) {
+  static uint8_t ram[4096], buf[RECORD_MAX], payload[PAYLOAD_MAX + 1];
+  mesh_sf_engine_t engine;
+  mesh_sf_burst_t burst;
+
+  CHECK(mesh_sf_engine_init(&engine, ram, sizeof(ram), RECORD_MAX, NULL) ==
+        ESP_OK);
+
+  // One byte more could never be replayed, so it is refused up front
+  CHECK(mesh_sf_engine_enqueue(&engine, 1, payload, PAYLOAD_MAX + 1) ==
+        ESP_ERR_INVALID_SIZE);
+  CHECK(mesh_sf_engine_pending(&engine) == 0);
+
+  // The largest record drains even to a root that takes one per burst
+  CHECK(mesh_sf_engine_enqueue(&engine, 1, payload, PAYLOAD_MAX) == ESP_OK);
+  CHECK(mesh_sf_engine_enqueue(&engine, 2, payload, PAYLOAD_MAX) == ESP_OK);
+  CHECK(mesh_sf_engine_take_burst(&engine, buf, 0, &burst) == 1);
+  CHECK(burst.length == RECORD_MAX);
+  mesh_sf_engine_finish(&engine, &burst, ESP_OK);
+  CHECK(mesh_sf_engine_take_burst(&engine, buf, RECORD_MAX, &burst) == 1);
+  CHECK(buf[0] == 2);
+  mesh_sf_engine_finish(&engine, &burst, ESP_OK);
+  CHECK(mesh_sf_engine_pending(&engine) == 0);
+  CHECK(engine.stats.replayed == 2 && engine.stats.bursts == 2);
+
+  // A failed send keeps the record, one the root rejects is dropped
+  CHECK(mesh_sf_engine_enqueue(&engine, 3, payload, PAYLOAD_MAX) == ESP_OK);
+  CHECK(mesh_sf_engine_take_burst(&engine, buf, 0, &burst) == 1);
+  mesh_sf_engine_finish(&engine, &burst, ESP_FAIL);
+  CHECK(mesh_sf_engine_pending(&engine) == 1);
+  CHECK(mesh_sf_engine_take_burst(&engine, buf, 0, &burst) == 1);
+  mesh_sf_engine_finish(&engine, &burst, ESP_ERR_INVALID_SIZE);
+  CHECK(mesh_sf_engine_pending(&engine) == 0);
+  CHECK(engine.stats.dropped == 1 && engine.stats.ram_used == 0);
+}
+
+static void test_pinned_while_replaying(void) {
+  static uint8_t ram[4096], buf[RECORD_MAX];
+  mesh_sf_engine_t engine;
+  mesh_sf_burst_t burst;
+  drain_t state = {0};
+  uint32_t seq = 1;
+
+  CHECK(mesh_sf_engine_init(&engine, ram, sizeof(ram), RECORD_MAX, NULL) ==
+        ESP_OK);
+  enqueue(&engine, seq++);
+  CHECK(mesh_sf_engine_take_burst(&engine, buf, RECORD_MAX, &burst) == 1);
+
+  // While the burst is out the queue may not drop what it took
+  uint8_t payload[PAYLOAD_MAX] = {0};
+  esp_err_t err;
+  while ((err = mesh_sf_engine_enqueue(&engine, 0, payload, PAYLOAD_MAX)) ==
+         ESP_OK) {
+  }
+  CHECK(err == ESP_ERR_NO_MEM);
+  check_burst(buf, burst.length, &state);
+  mesh_sf_engine_finish(&engine, &burst, ESP_OK);
+  CHECK(state.count == 1 && engine.stats.replayed == 1);
+}
+
+static void test_spill_and_drain(void) {
+  static uint8_t ram[8192];
+  mem_flash_t flash;
+  mesh_sf_engine_t engine;
+
+  mem_flash_init(&flash, 4 * MEM_FLASH_SECTOR_SIZE);
+  mesh_sf_backend_t backend = {
+      .read = mem_flash_read,
+      .write = mem_flash_write,
+      .erase = mem_flash_erase,
+      .size = flash.size,
+      .ctx = &flash,
+  };
+  CHECK(mesh_sf_engine_init(&engine, ram, sizeof(ram), RECORD_MAX,
+                            &backend) == ESP_OK);
+
+  // Fits RAM and flash: nothing lost, drained in order across both rings
+  uint32_t seq = 0;
+  for (; seq < 60; seq++) {
+    enqueue(&engine, seq);
+  }
+  CHECK(engine.stats.spilled > 0 && engine.stats.dropped == 0);
+  drain_t state = {0};
+  int bursts = drain(&engine, RECORD_MAX, &state);
+  CHECK(state.count == 60);
+  printf("60 records, %u spilled, replayed in %d bursts\n",
+         (unsigned)engine.stats.spilled, bursts);
+
+  // Far more than fits: the oldest are lost, the rest stay in order
+  uint32_t first = seq;
+  for (; seq < first + 2000; seq++) {
+    enqueue(&engine, seq);
+  }
+  CHECK(engine.stats.dropped > 0);
+  state.count = 0;
+  state.next = first;
+  uint32_t kept = mesh_sf_engine_pending(&engine);
+  drain(&engine, RECORD_MAX, &state);
+  CHECK(state.count == kept);
+  CHECK(state.next == seq);
+  CHECK(engine.stats.queued ==
+        engine.stats.replayed + engine.stats.dropped);
+
+  // One record per burst for a root that does not split batches
+  for (uint32_t i = 0; i < 20; i++, seq++) {
+    enqueue(&engine, seq);
+  }
+  state.count = 0;
+  CHECK(drain(&engine, 0, &state) == 20);
+
+  CHECK(flash.dirty_writes == 0);
+  printf("%u queued, %u dropped, %u sector erases\n",
+         (unsigned)engine.stats.queued, (unsigned)engine.stats.dropped,
+         (unsigned)flash.sectors_erased);
+  mem_flash_deinit(&flash);
+}
+
+int main(void) {
+  test_largest_record();
+  test_pinned_while_replaying();
+  test_spill_and_drain();
+  printf("test_store_forward_engine: ok\n");
+  return 0;
+}
@@ -0,0 +1,48 @@
+/* Host Test Support
+ *
+ * Check macro and clock shared by the host tests, simulations and
+ * benchmarks.
+ */
+
+#ifndef __TEST_SUPPORT_H__
+#define __TEST_SUPPORT_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * @brief Abort the test with the failed condition and its location
+ */
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__,         \
+              #cond);                                                          \
+      exit(1);                                                                 \
+    }                                                                          \
+  } while (0)
+
+/**
+ * @brief Monotonic time in nanoseconds, for benchmarks
+ */
+static inline uint64_t test_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Deterministic pseudo random numbers, so runs are repeatable
+ */
+static inline uint32_t test_rand(uint32_t *state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+#endif /* __TEST_SUPPORT_H__ */
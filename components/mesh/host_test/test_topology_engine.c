@@ -0,0 +1,258 @@
+/* Host test: topology map engine
+ *
+ * Every node of a generated 250-node tree reports to the root's map the
+ * way mesh_topology.c does, a keyframe every
+ * MESH_TOPOLOGY_DEFAULT_KEYFRAME_EVERY reports and deltas in between,
+ * with the parent link RSSI wandering a few dB. Nodes then move to other
+ * parents and a subtree goes silent. After each step the cached subtree
+ * sizes, traffic sums and paths are checked against the generated tree,
+ * and the bytes sent per report are counted.
+ */
+
+#include "mesh_topology.h"
+#include "mesh_topology_engine.h"
+#include "sim_tree.h"
+#include "test_support.h"
+#include <math.h>
+#include <string.h>
+
+#define NODES (250)
+#define INTERVAL_MS (MESH_TOPOLOGY_DEFAULT_INTERVAL_MS)
+#define KEYFRAME_EVERY (MESH_TOPOLOGY_DEFAULT_KEYFRAME_EVERY)
+
+static sim_tree_t s_tree;
+static mesh_topology_engine_t s_map;
+static mesh_topology_encoder_t s_encoders[NODES];
+static uint32_t s_reports[NODES], s_tx[NODES];
+static bool s_silent[NODES];
+static uint32_t s_now, s_seed = 67;
+static long s_frames, s_bytes, s_keyframe_bytes, s_keyframes;
+
+static void mac_of(int node, uint8_t *mac) {
+  memset(mac, 0, 6);
+  mac[0] = 0x24;
+  mac[4] = (uint8_t)(node >> 8);
+  mac[5] = (uint8_t)node;
+}
+
+static void report(int node) {
+  mesh_topology_sample_t sample = {
+      .layer = (uint8_t)s_tree.layer[node],
+      .children = (uint8_t)s_tree.children[node],
+      .rssi = (int8_t)(sim_tree_rssi(&s_tree, node, s_tree.parent[node]) +
+                       (int)(test_rand(&s_seed) % 5) - 2),
+      .tx_packets = s_tx[node] += 1 + node % 7,
+  };
+  uint8_t frame[MESH_TOPOLOGY_MAX_FRAME], mac[6];
+  bool keyframe = s_reports[node]++ % KEYFRAME_EVERY == 0;
+
+  mac_of(s_tree.parent[node], sample.parent);
+  mac_of(node, mac);
+  uint16_t length =
+      mesh_topology_encode(&s_encoders[node], &sample, keyframe, frame);
+  CHECK(length <= MESH_TOPOLOGY_MAX_FRAME);
+  CHECK(mesh_topology_engine_apply(&s_map, mac, frame, length, s_now) ==
+        ESP_OK);
+  s_frames++;
+  s_bytes += length;
+  if (keyframe) {
+    s_keyframes++;
+    s_keyframe_bytes += length;
+  }
+}
+
+/**
+ * @brief One interval: every node that is not silent reports
+ */
+static void interval(void) {
+  s_now += INTERVAL_MS;
+  for (int n = 1; n < NODES; n++) {
+    if (s_tree.layer[n] != 0 && !s_silent[n]) {
+      report(n);
+    }
+  }
+}
+
+/**
+ * @brief Compare the map with the tree
+ */
+static void check_map(void) {
+  for (int n = 0; n < NODES; n++) {
+    uint8_t mac[6], path[32][6];
+    mac_of(n, mac);
+    int k = mesh_topology_engine_find(&s_map, mac);
+    if (s_tree.layer[n] == 0 || s_silent[n]) {
+      CHECK(k < 0);
+      continue;
+    }
+    CHECK(k >= 0);
+    const mesh_topology_node_t *node = &s_map.nodes[k];
+
+    int size = 0;
+    for (int m = 0; m < NODES; m++) {
+      size += s_tree.layer[m] != 0 && !s_silent[m] &&
+              sim_tree_in_subtree(&s_tree, m, n);
+    }
+    CHECK(node->subtree_size == size);
+
+    // The cached sum is the traffic of the node and its descendants
+    uint32_t traffic = node->traffic;
+    for (uint16_t c = node->first_child; c != MESH_TOPOLOGY_NONE;
+         c = s_map.nodes[c].next_sibling) {
+      traffic += s_map.nodes[c].subtree_traffic;
+    }
+    CHECK(node->subtree_traffic == traffic);
+
+    int hops = mesh_topology_engine_path(&s_map, mac, path, 32);
+    CHECK(hops == s_tree.layer[n]);
+    for (int h = hops - 1, m = n; h >= 0; h--, m = s_tree.parent[m]) {
+      uint8_t expect[6];
+      mac_of(m, expect);
+      CHECK(memcmp(path[h], expect, 6) == 0);
+    }
+  }
+}
+
+static void check_busiest(void) {
+  mesh_topology_relay_t relays[8];
+  int count = mesh_topology_engine_busiest(&s_map, relays, 8);
+
+  CHECK(count == 8);
+  for (int i = 0; i < count; i++) {
+    CHECK(i == 0 || relays[i].relayed <= relays[i - 1].relayed);
+    int k = mesh_topology_engine_find(&s_map, relays[i].mac);
+    CHECK(k >= 0 && (uint16_t)k != s_map.root);
+    CHECK(relays[i].relayed ==
+          s_map.nodes[k].subtree_traffic - s_map.nodes[k].traffic);
+  }
+}
+
+static void check_frames(void) {
+  mesh_topology_engine_t map;
+  mesh_topology_encoder_t encoder = {0};
+  mesh_topology_sample_t sample = {.layer = 3, .rssi = -60, .tx_packets = 5};
+  uint8_t frame[MESH_TOPOLOGY_MAX_FRAME], root[6], mac[6], parent[6];
+  uint16_t length;
+
+  mac_of(0, root);
+  mac_of(1, parent);
+  mac_of(2, mac);
+  memcpy(sample.parent, parent, 6);
+  mesh_topology_engine_init(&map);
+  CHECK(mesh_topology_engine_set_root(&map, root) == ESP_OK);
+
+  // A delta from an unknown node is not applied
+  encoder.primed = true;
+  length = mesh_topology_encode(&encoder, &sample, false, frame);
+  CHECK(mesh_topology_engine_apply(&map, mac, frame, length, 0) ==
+        ESP_ERR_NOT_FOUND);
+  CHECK(mesh_topology_engine_find(&map, mac) < 0);
+
+  // A child known before its parent hangs below the root once it reports
+  length = mesh_topology_encode(&encoder, &sample, true, frame);
+  CHECK(mesh_topology_engine_apply(&map, mac, frame, length, 0) == ESP_OK);
+  CHECK(map.nodes[map.root].subtree_size == 1);
+  mesh_topology_encoder_t parent_encoder = {0};
+  mesh_topology_sample_t parent_sample = {.layer = 2, .rssi = -50};
+  memcpy(parent_sample.parent, root, 6);
+  length = mesh_topology_encode(&parent_encoder, &parent_sample, true, frame);
+  CHECK(mesh_topology_engine_apply(&map, parent, frame, length, 0) == ESP_OK);
+  CHECK(map.nodes[map.root].subtree_size == 3);
+
+  // A quiet node sends a short heartbeat
+  length = mesh_topology_encode(&encoder, &sample, false, frame);
+  CHECK(length == 3);
+  CHECK(mesh_topology_engine_apply(&map, mac, frame, length, 1) == ESP_OK);
+
+  // A missed frame is applied, but asks for a keyframe
+  mesh_topology_encode(&encoder, &sample, false, frame);
+  length = mesh_topology_encode(&encoder, &sample, false, frame);
+  CHECK(mesh_topology_engine_apply(&map, mac, frame, length, 2) ==
+        ESP_ERR_INVALID_STATE);
+  CHECK(mesh_topology_engine_apply(&map, mac, frame, 2, 2) ==
+        ESP_ERR_INVALID_SIZE);
+
+  // A parent loop reported in error does not corrupt the counts
+  memcpy(parent_sample.parent, mac, 6);
+  length = mesh_topology_encode(&parent_encoder, &parent_sample, false, frame);
+  mesh_topology_engine_apply(&map, parent, frame, length, 3);
+  CHECK(map.nodes[map.root].subtree_size <= map.count);
+}
+
+int main(void) {
+  sim_tree_config_t config = {
+      .count = NODES,
+      .max_children = 6,
+      .max_layer = 25,
+      .area = 7.0 * sqrt(NODES),
+      .range = 30.0,
+      .seed = 67,
+  };
+  uint8_t mac[6];
+
+  check_frames();
+
+  CHECK(sim_tree_generate(&s_tree, &config) == NODES - 1);
+  mesh_topology_engine_init(&s_map);
+  mac_of(0, mac);
+  CHECK(mesh_topology_engine_set_root(&s_map, mac) == ESP_OK);
+
+  // An hour of reports
+  for (int i = 0; i < 360; i++) {
+    interval();
+  }
+  check_map();
+  check_busiest();
+  printf("%d nodes, depth %d: %.1f bytes per report, keyframes %.1f, "
+         "deltas %.1f\n",
+         NODES, sim_tree_depth(&s_tree), (double)s_bytes / s_frames,
+         (double)s_keyframe_bytes / s_keyframes,
+         (double)(s_bytes - s_keyframe_bytes) / (s_frames - s_keyframes));
+  CHECK(s_bytes * 2 < s_keyframe_bytes * KEYFRAME_EVERY);
+
+  // 40 nodes move to their second best parent, taking their subtrees
+  int moved = 0;
+  for (int n = 1; n < NODES && moved < 40; n += 5) {
+    int p = sim_tree_choose_parent(&s_tree, n, s_tree.parent[n], NULL, NULL);
+    if (p != SIM_TREE_NONE) {
+      sim_tree_set_parent(&s_tree, n, p);
+      moved++;
+    }
+  }
+  interval();
+  check_map();
+  check_busiest();
+
+  // A relay's subtree goes silent and expires
+  int relay = 0, below = 0;
+  for (int n = 1; n < NODES && below < 5; n++) {
+    below = 0;
+    for (int m = 0; m < NODES; m++) {
+      below += m != n && sim_tree_in_subtree(&s_tree, m, n);
+    }
+    relay = n;
+  }
+  for (int m = 0; m < NODES; m++) {
+    s_silent[m] = m != 0 && sim_tree_in_subtree(&s_tree, m, relay);
+  }
+  uint32_t silent_from = s_now;
+  for (int i = 0; i < MESH_TOPOLOGY_EXPIRE_INTERVALS + 1; i++) {
+    interval();
+  }
+  int expired = mesh_topology_engine_expire(
+      &s_map, s_now, MESH_TOPOLOGY_EXPIRE_INTERVALS * INTERVAL_MS);
+  CHECK(expired == below + 1);
+  CHECK(s_now - silent_from > MESH_TOPOLOGY_EXPIRE_INTERVALS * INTERVAL_MS);
+  check_map();
+
+  // Report cost: the node's ancestors only
+  uint64_t start = test_now_ns();
+  for (int i = 0; i < 100; i++) {
+    interval();
+  }
+  double per_report = (double)(test_now_ns() - start) / (100.0 * s_map.count);
+  printf("%d moved, %d expired; %.0f ns per report\n", moved, expired,
+         per_report);
+  printf("test_topology_engine: ok\n");
+  return 0;
+}
@@ -8,12 +8,33 @@
 
 #include "esp_err.h"
 #include "esp_mesh.h"
+#include "mesh_parent_select.h"
+#include "mesh_state.h"
 #include <stdint.h>
 
 /*******************************************************
  *                Constants
  *******************************************************/
 #define MESH_MAX_REGISTERED_NODES 20
+#define MESH_REJOIN_SAMPLES 16
+#define MESH_PARENT_LOST_RETRIES 2 /* failed reconnects before giving up */
+
+/* Capabilities announced in the identity handshake */
+#define MESH_PROTOCOL_VERSION 1
+#define MESH_NODE_FEATURE_BATCH (1 << 0)        /* splits batch frames */
+#define MESH_NODE_FEATURE_AGGREGATE (1 << 1)    /* decodes aggregate frames */
+#define MESH_NODE_FEATURE_CONFIG_STORE (1 << 2) /* runs the config store */
+#define MESH_NODE_FEATURE_HEADER_EXT (1 << 3)   /* MESH_DATA_FLAG_EXT frames */
+/* Assumed for peers that never announced: what was sent before the
+ * handshake existed */
+#define MESH_NODE_FEATURES_LEGACY                                              \
+  (MESH_NODE_FEATURE_BATCH | MESH_NODE_FEATURE_AGGREGATE)
+
+/* Mesh events are handled by a task fed from a fixed ring */
+#define MESH_EVENT_RING_SIZE 32
+#define MESH_EVENT_RING_RESERVE 4 /* slots churn events may not take */
+#define MESH_EVENT_TASK_STACK_SIZE 4096
+#define MESH_EVENT_TASK_PRIORITY 10
 
 /*******************************************************
  *                Type Definitions
@@ -30,27 +51,73 @@ typedef enum {
   MESH_NODE_TYPE_CUSTOM = 255
 } mesh_node_type_t;
 
+/**
+ * @brief What a node can receive, announced with its identity
+ */
+typedef struct {
+  uint8_t protocol;   /**< MESH_PROTOCOL_VERSION, 0 = never announced */
+  uint16_t features;  /**< MESH_NODE_FEATURE_* bits */
+  uint16_t rx_buffer; /**< Largest packet it receives, header included */
+  uint16_t rx_queue;  /**< Packets it queues per parent (xon_qsize) */
+  uint32_t firmware;  /**< App version as 0xMMmmpppp, 0 if not numeric */
+} __attribute__((packed)) mesh_node_caps_t;
+
 /**
  * @brief Node identity structure sent by children to root
+ *
+ * Sent behind a magic byte that marks it among the config payloads.
  */
 typedef struct {
-  uint8_t node_id;   /**< Unique node ID (1-255) */
-  uint8_t node_type; /**< Node type from mesh_node_type_t */
-  char name[16];     /**< Human-readable node name */
+  uint8_t node_id;       /**< Unique node ID (1-255) */
+  uint8_t node_type;     /**< Node type from mesh_node_type_t */
+  char name[16];         /**< Human-readable node name */
+  mesh_node_caps_t caps; /**< Capabilities of the node */
 } __attribute__((packed)) mesh_node_identity_t;
 
 /**
  * @brief Registered node information maintained by root
  */
 typedef struct {
-  uint8_t node_id;      /**< Unique node ID */
-  mesh_addr_t mac_addr; /**< MAC address of the node */
-  uint8_t node_type;    /**< Node type */
-  char name[16];        /**< Node name */
-  bool is_active;       /**< Whether node is currently active */
-  uint32_t last_seen;   /**< Timestamp of last communication */
+  uint8_t node_id;       /**< Unique node ID */
+  mesh_addr_t mac_addr;  /**< MAC address of the node */
+  uint8_t node_type;     /**< Node type */
+  char name[16];         /**< Node name */
+  bool is_active;        /**< Whether node is currently active */
+  mesh_node_caps_t caps; /**< Announced capabilities, zero if none */
+  uint32_t last_seen;    /**< Timestamp of last communication */
 } mesh_registered_node_t;
 
+/**
+ * @brief Time from mesh start or parent loss to the next parent connection
+ *
+ * Medians are over the last MESH_REJOIN_SAMPLES rejoins of each kind.
+ */
+typedef struct {
+  uint32_t rejoins_cached;   /**< Parent found by a cached-channel scan */
+  uint32_t rejoins_full;     /**< Parent found by a full scan, or rejoined
+                                  without one */
+  uint32_t median_cached_ms; /**< Median time of cached rejoins */
+  uint32_t median_full_ms;   /**< Median time of full rejoins */
+  uint32_t last_ms;          /**< Time of the latest rejoin */
+} mesh_rejoin_stats_t;
+
+/**
+ * @brief Mesh event task counters
+ *
+ * Latency runs from the default event loop handing the event over to the
+ * mesh event task starting on it; processing is the time spent there.
+ */
+typedef struct {
+  uint32_t events;          /**< Events processed */
+  uint32_t dropped;         /**< Events lost to a full ring */
+  uint16_t ring_size;       /**< Ring capacity */
+  uint16_t ring_high_water; /**< Most events waiting at once */
+  uint32_t latency_max_us;  /**< Longest wait in the ring */
+  uint32_t latency_mean_us; /**< Mean wait in the ring */
+  uint32_t process_max_us;  /**< Longest processing of one event */
+  uint32_t process_mean_us; /**< Mean processing time */
+} mesh_event_stats_t;
+
 /*******************************************************
  *                Function Declarations
  *******************************************************/
@@ -69,11 +136,67 @@ typedef struct {
  */
 esp_err_t mesh_init(void);
 
+/**
+ * @brief Set the weights used to score parent candidates after a scan
+ *
+ * Only used by non-root nodes (CONFIG_MESH_SET_NODE). Takes effect at the
+ * next scan; the link history collected so far is kept.
+ *
+ * @param weights Scoring weights and switch hysteresis
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if weights is NULL
+ */
+esp_err_t mesh_set_parent_weights(const mesh_parent_weights_t *weights);
+
+/**
+ * @brief Enable or disable scanning the channels of cached parents first
+ *
+ * Recent parents are kept in RTC memory. When enabled (the default), a
+ * rejoin first scans only their channels and falls back to a full scan if
+ * no parent is found there. Disable to compare rejoin times.
+ *
+ * @return ESP_OK
+ */
+esp_err_t mesh_set_parent_cache_enabled(bool enable);
+
+/**
+ * @brief Enable or disable the fast boot path (call before mesh_init())
+ *
+ * When enabled (the default), the mesh configuration and the last parent
+ * are kept in RTC memory. After a software reset or deep sleep the node
+ * reuses the configuration and connects to that parent without scanning,
+ * falling back to a scan if the connection fails. A restart of the mesh
+ * stack to apply new parameters does the same. WiFi settings are then
+ * kept in RAM rather than written to flash on every boot. Cold and warm
+ * boot times are reported by mesh_boot_trace_get_stats().
+ *
+ * @return ESP_OK
+ */
+esp_err_t mesh_set_fast_boot_enabled(bool enable);
+
+/**
+ * @brief Get mesh event latency and processing time
+ *
+ * @return
+ *    - ESP_OK: stats filled
+ *    - ESP_ERR_INVALID_ARG: stats is NULL
+ *    - ESP_ERR_INVALID_STATE: mesh_init() has not run
+ */
+esp_err_t mesh_get_event_stats(mesh_event_stats_t *stats);
+
+/**
+ * @brief Get rejoin timing
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t mesh_get_rejoin_stats(mesh_rejoin_stats_t *stats);
+
 /**
  * @brief Register a node in the mesh network (called by root)
  *
- * This function is typically called automatically when a child sends
- * its identity information to the root.
+ * The root calls this automatically when a child announces its identity,
+ * and answers with its own capabilities. A node registered by hand keeps
+ * the capabilities it announced before, if any.
  *
  * @param node_id Unique node ID
  * @param mac_addr MAC address of the node
@@ -89,7 +212,9 @@ esp_err_t mesh_register_node(uint8_t node_id, const mesh_addr_t *mac_addr,
  * @brief Send node identity to root (called by child nodes)
  *
  * Child nodes should call this function after connecting to announce
- * their identity to the root.
+ * their identity to the root. The capabilities of this node are added
+ * automatically, and the identity is announced again whenever the root
+ * changes, so both ends always know what the other can receive.
  *
  * @param node_id Unique node ID for this device
  * @param node_type Type of this node
@@ -114,6 +239,7 @@ esp_err_t mesh_announce_node_identity(uint8_t node_id, uint8_t node_type,
  *    - ESP_OK: Success
  *    - ESP_ERR_INVALID_ARG: Invalid arguments
  *    - ESP_ERR_NOT_FOUND: Node ID not found in registry
+ *    - ESP_ERR_INVALID_SIZE: Larger than the node announced it receives
  *    - ESP_FAIL: Not a root node or send failed
  */
 esp_err_t mesh_send_to_node_id(uint8_t node_id, uint8_t data_type,
@@ -137,6 +263,18 @@ int mesh_get_registered_node_count(void);
 esp_err_t mesh_get_registered_node_info(int index,
                                         mesh_registered_node_t *node_info);
 
+/**
+ * @brief Look up the node ID registered for a MAC address
+ *
+ * @param mac_addr MAC address of the node
+ * @param node_id Pointer to store the node ID
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if the address is not
+ *         registered, ESP_ERR_INVALID_ARG on NULL pointers
+ */
+esp_err_t mesh_get_node_id_by_addr(const mesh_addr_t *mac_addr,
+                                   uint8_t *node_id);
+
 /**
  * @brief Clear all registered nodes from the registry
  *
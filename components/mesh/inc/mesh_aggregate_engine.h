@@ -0,0 +1,127 @@
+/* In-Network Aggregation Engine
+ *
+ * Accumulates sensor readings and the aggregate frames of child nodes into a
+ * single frame: either a per-channel summary (count, min, max, sum) or the
+ * concatenated compact records. The engine has no mesh dependencies so the
+ * merge behaviour can be simulated on a host.
+ */
+
+#ifndef __MESH_AGGREGATE_ENGINE_H__
+#define __MESH_AGGREGATE_ENGINE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_AGGREGATE_MAX_FRAME (1400)
+#define MESH_AGGREGATE_MAX_CHANNELS (16)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief Aggregation mode
+ */
+typedef enum {
+  MESH_AGGREGATE_MODE_SUMMARY = 0, /**< Per-channel count/min/max/sum */
+  MESH_AGGREGATE_MODE_CONCAT = 1,  /**< Concatenated compact records */
+} mesh_aggregate_mode_t;
+
+/**
+ * @brief Payload format of aggregatable packets: an array of readings
+ */
+typedef struct {
+  uint8_t channel; /**< Sensor channel */
+  float value;     /**< Reading */
+} __attribute__((packed)) mesh_sensor_reading_t;
+
+/**
+ * @brief Header of a MESH_DATA_TYPE_AGGREGATE payload
+ */
+typedef struct {
+  uint8_t data_type;   /**< Type of the aggregated packets */
+  uint8_t mode;        /**< mesh_aggregate_mode_t */
+  uint16_t node_count; /**< Nodes that contributed */
+  uint16_t entry_count; /**< Entries following the header */
+} __attribute__((packed)) mesh_aggregate_header_t;
+
+/**
+ * @brief Entry of a MESH_AGGREGATE_MODE_SUMMARY frame
+ */
+typedef struct {
+  uint8_t channel;
+  uint16_t count;
+  float min;
+  float max;
+  float sum;
+} __attribute__((packed)) mesh_aggregate_summary_t;
+
+/**
+ * @brief Entry of a MESH_AGGREGATE_MODE_CONCAT frame
+ */
+typedef struct {
+  uint8_t origin[6]; /**< Station MAC of the reporting node */
+  uint8_t channel;
+  float value;
+} __attribute__((packed)) mesh_aggregate_record_t;
+
+#define MESH_AGGREGATE_MAX_RECORDS                                            \
+  ((MESH_AGGREGATE_MAX_FRAME - sizeof(mesh_aggregate_header_t)) /            \
+   sizeof(mesh_aggregate_record_t))
+
+/**
+ * @brief Accumulator for one data type
+ */
+typedef struct {
+  mesh_aggregate_header_t header;
+  union {
+    mesh_aggregate_summary_t summaries[MESH_AGGREGATE_MAX_CHANNELS];
+    mesh_aggregate_record_t records[MESH_AGGREGATE_MAX_RECORDS];
+  };
+} mesh_aggregate_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Clear an accumulator
+ */
+void mesh_aggregate_reset(mesh_aggregate_t *agg, uint8_t data_type,
+                          mesh_aggregate_mode_t mode);
+
+/**
+ * @brief Add the readings of one node
+ *
+ * @param agg Accumulator
+ * @param origin Station MAC of the node
+ * @param readings Readings
+ * @param count Number of readings
+ *
+ * @return false if they do not fit; the accumulator is left unchanged
+ */
+bool mesh_aggregate_add(mesh_aggregate_t *agg, const uint8_t origin[6],
+                        const mesh_sensor_reading_t *readings, int count);
+
+/**
+ * @brief Merge an aggregate frame received from a child
+ *
+ * @param agg Accumulator
+ * @param frame Frame starting with mesh_aggregate_header_t
+ * @param length Frame length
+ *
+ * @return false if the frame is malformed, of another type or mode, or does
+ *         not fit; the accumulator is left unchanged
+ */
+bool mesh_aggregate_merge(mesh_aggregate_t *agg, const uint8_t *frame,
+                          uint16_t length);
+
+/**
+ * @brief Size of the encoded frame, 0 if nothing was accumulated
+ */
+uint16_t mesh_aggregate_frame_length(const mesh_aggregate_t *agg);
+
+#endif /* __MESH_AGGREGATE_ENGINE_H__ */
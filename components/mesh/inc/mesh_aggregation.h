@@ -0,0 +1,82 @@
+/* ESP-MESH In-Network Aggregation
+ *
+ * Opt-in mode in which relay nodes merge the sensor readings of their
+ * subtree into one MESH_DATA_TYPE_AGGREGATE frame per time window instead of
+ * forwarding every child packet to the root. The root then receives one
+ * frame per branch per window.
+ *
+ * Every node of the mesh must enable aggregation with the same data types
+ * and mode; packets of the designated types must carry an array of
+ * mesh_sensor_reading_t. Nodes send readings unmerged while their root has
+ * announced neither aggregation nor telemetry, which decode the frames.
+ */
+
+#ifndef __MESH_AGGREGATION_H__
+#define __MESH_AGGREGATION_H__
+
+#include "esp_err.h"
+#include "mesh_aggregate_engine.h"
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_AGGREGATION_MAX_TYPES (4)
+#define MESH_AGGREGATION_DEFAULT_WINDOW_MS (1000)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief Aggregation configuration
+ */
+typedef struct {
+  uint8_t data_types[MESH_AGGREGATION_MAX_TYPES]; /**< Types to aggregate */
+  int type_count;             /**< Entries used in data_types */
+  mesh_aggregate_mode_t mode; /**< Summary or concatenation */
+  uint16_t window_ms;         /**< Merge window, 0 = default */
+} mesh_aggregation_config_t;
+
+/**
+ * @brief Aggregation counters
+ */
+typedef struct {
+  uint32_t readings_in; /**< Local packets absorbed */
+  uint32_t frames_in;   /**< Child frames merged */
+  uint32_t frames_out;  /**< Frames sent upstream */
+  uint32_t early_flushes; /**< Frames sent before the window ended */
+  uint32_t dropped;     /**< Frames lost (send failed, not queued) */
+} mesh_aggregation_stats_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Enable aggregation
+ *
+ * From now on mesh_send_to_root() absorbs packets of the designated types
+ * into the current window, and aggregate frames from children are merged
+ * instead of being relayed. On the root, aggregate frames are delivered to
+ * the receive callback as MESH_DATA_TYPE_AGGREGATE packets whose payload
+ * starts with mesh_aggregate_header_t.
+ *
+ * @param config Aggregation configuration
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: Invalid configuration
+ *    - ESP_ERR_INVALID_STATE: Already initialized
+ *    - ESP_ERR_NO_MEM: Out of memory
+ */
+esp_err_t mesh_aggregation_init(const mesh_aggregation_config_t *config);
+
+/**
+ * @brief Get aggregation counters
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t mesh_aggregation_get_stats(mesh_aggregation_stats_t *stats);
+
+#endif /* __MESH_AGGREGATION_H__ */
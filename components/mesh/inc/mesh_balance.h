@@ -0,0 +1,83 @@
+/* ESP-MESH Relay Load Balancing
+ *
+ * Children pick their parent independently, so some relays end up with
+ * every association slot taken and most of the traffic while their
+ * neighbours idle. With balancing enabled:
+ *
+ * - The root finds relays whose forwarded traffic is far above the mean
+ *   of their layer in the topology map and broadcasts them as busy. Every
+ *   node lowers the score of busy parents when it next selects one.
+ * - The root steers one child of the busiest relay to another parent,
+ *   choosing a child whose subtree carries about half the relay's excess.
+ * - A relay whose association slots are nearly all taken hands off the
+ *   child with the weakest link.
+ *
+ * A steered node scans while staying connected and moves only if another
+ * parent qualifies; it then avoids the old parent for avoid_ms. The root
+ * steers at most once per steer_interval_ms, a relay hands off at most
+ * once per handoff_interval_ms, and a node accepts a move at most once per
+ * node_cooldown_ms.
+ *
+ * Every node must enable balancing; the root also needs the topology map
+ * (mesh_topology_init()).
+ */
+
+#ifndef __MESH_BALANCE_H__
+#define __MESH_BALANCE_H__
+
+#include "esp_err.h"
+#include "mesh_balance_engine.h"
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_BALANCE_BUSY_REFRESH_PERIODS (10) /* resend unchanged list */
+#define MESH_BALANCE_TASK_STACK_SIZE (3072)
+#define MESH_BALANCE_TASK_PRIORITY (3)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief Balancing counters
+ */
+typedef struct {
+  uint16_t busy_relays;     /**< Root: relays in the last busy list */
+  uint32_t busy_updates;    /**< Root: busy lists broadcast */
+  uint32_t steers_sent;     /**< Root: children steered */
+  uint32_t handoffs_sent;   /**< Relay: children handed off */
+  uint32_t steers_received; /**< Node: steer requests received */
+  uint32_t steers_accepted; /**< Node: requests that started a scan */
+  uint32_t steers_ignored;  /**< Node: stale or within the cooldown */
+} mesh_balance_stats_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Enable load balancing
+ *
+ * @param config Configuration, NULL for the defaults; start from
+ *               mesh_balance_config_default() to change single fields.
+ *               assoc_high_percent above 100 disables relay handoffs.
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: period_ms is 0 or traffic_ratio_percent is
+ *      below 100
+ *    - ESP_ERR_INVALID_STATE: Already initialized
+ *    - ESP_ERR_NO_MEM: Out of memory
+ */
+esp_err_t mesh_balance_init(const mesh_balance_config_t *config);
+
+/**
+ * @brief Get balancing counters
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t mesh_balance_get_stats(mesh_balance_stats_t *stats);
+
+#endif /* __MESH_BALANCE_H__ */
@@ -0,0 +1,130 @@
+/* Relay Load Balancing Engine
+ *
+ * Works on the root's topology map. A relay is busy when the traffic it
+ * forwards is well above the mean of the nodes on its layer, which are the
+ * parents its children could have chosen instead. Busy relays get a score
+ * penalty that every node applies when it picks a parent, and the busiest
+ * relay can be relieved by steering one of its children to another
+ * parent. The child chosen carries about half of the relay's excess, so a
+ * move does not just shift the hot spot to the neighbour.
+ *
+ * Steering is rate limited globally and per node. The engine has no WiFi
+ * dependencies so it can be run against generated topologies on a host.
+ */
+
+#ifndef __MESH_BALANCE_ENGINE_H__
+#define __MESH_BALANCE_ENGINE_H__
+
+#include "mesh_topology_engine.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_BALANCE_MAX_BUSY (8)
+#define MESH_BALANCE_MAX_LAYERS (26)
+#define MESH_BALANCE_HISTORY_SIZE (16) /* recently steered nodes */
+
+#define MESH_BALANCE_DEFAULT_PERIOD_MS (30000)
+#define MESH_BALANCE_DEFAULT_ASSOC_HIGH (100)   /* percent of assoc slots */
+#define MESH_BALANCE_DEFAULT_TRAFFIC_RATIO (200) /* percent of layer mean */
+#define MESH_BALANCE_DEFAULT_MIN_RELAYED (10)
+#define MESH_BALANCE_DEFAULT_PENALTY (40) /* one layer of depth, see weights */
+#define MESH_BALANCE_DEFAULT_STEER_INTERVAL_MS (120000)
+#define MESH_BALANCE_DEFAULT_HANDOFF_INTERVAL_MS (300000)
+#define MESH_BALANCE_DEFAULT_NODE_COOLDOWN_MS (600000)
+#define MESH_BALANCE_DEFAULT_AVOID_MS (600000)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief Balancing configuration
+ */
+typedef struct {
+  uint32_t period_ms;             /**< Check interval */
+  uint8_t assoc_high_percent;     /**< Relay hands off children above this */
+  uint16_t traffic_ratio_percent; /**< Busy above % of layer mean, >= 100 */
+  uint32_t min_relayed;           /**< Relays carrying less are never busy */
+  int16_t busy_penalty;           /**< Parent score taken off busy relays */
+  uint32_t steer_interval_ms;     /**< Root: time between steers */
+  uint32_t handoff_interval_ms;   /**< Relay: time between handoffs */
+  uint32_t node_cooldown_ms;      /**< Time before a node is moved again */
+  uint32_t avoid_ms;              /**< Old parent penalized this long */
+} mesh_balance_config_t;
+
+/**
+ * @brief A busy relay and the penalty parent selection applies to it
+ */
+typedef struct {
+  uint8_t bssid[6]; /**< Relay softAP BSSID */
+  int16_t penalty;  /**< Score subtracted from the candidate */
+} __attribute__((packed)) mesh_balance_busy_t;
+
+/**
+ * @brief A suggested move
+ */
+typedef struct {
+  uint8_t child[6];  /**< Station MAC of the node to move */
+  uint8_t parent[6]; /**< Station MAC of the relay it leaves */
+  uint32_t relayed;  /**< Traffic the relay carries */
+  uint32_t moved;    /**< Traffic the move takes off it */
+} mesh_balance_steer_t;
+
+/**
+ * @brief Rate limiting state of the root
+ */
+typedef struct {
+  uint8_t mac[MESH_BALANCE_HISTORY_SIZE][6]; /**< Recently steered nodes */
+  uint32_t time_ms[MESH_BALANCE_HISTORY_SIZE];
+  uint8_t next;           /**< Slot the next steer is recorded in */
+  bool steered;           /**< last_steer_ms is valid */
+  uint32_t last_steer_ms; /**< Time of the last steer */
+} mesh_balance_history_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Fill a configuration with the defaults
+ */
+void mesh_balance_config_default(mesh_balance_config_t *config);
+
+/**
+ * @brief List busy relays, busiest first
+ *
+ * @param topology Topology map
+ * @param config Configuration
+ * @param busy Output, BSSIDs and penalties
+ * @param max_busy Capacity of busy
+ *
+ * @return Number of entries written
+ */
+int mesh_balance_find_busy(const mesh_topology_engine_t *topology,
+                           const mesh_balance_config_t *config,
+                           mesh_balance_busy_t *busy, int max_busy);
+
+/**
+ * @brief Choose one child of the busiest relay to move
+ *
+ * Returns false while the steer interval since the last move has not
+ * passed. Nodes steered within node_cooldown_ms are not chosen again. A
+ * suggestion is recorded in history.
+ *
+ * @param topology Topology map
+ * @param config Configuration
+ * @param history Rate limiting state, zeroed before the first call
+ * @param now_ms Current time
+ * @param steer Output
+ *
+ * @return true if a move is suggested
+ */
+bool mesh_balance_plan_steer(const mesh_topology_engine_t *topology,
+                             const mesh_balance_config_t *config,
+                             mesh_balance_history_t *history, uint32_t now_ms,
+                             mesh_balance_steer_t *steer);
+
+#endif /* __MESH_BALANCE_ENGINE_H__ */
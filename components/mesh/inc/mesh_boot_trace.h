@@ -0,0 +1,144 @@
+/* ESP-MESH Boot Trace
+ *
+ * Records when each step between power-on and useful operation happened in
+ * this boot: mesh start, first scan, parent connection, root address, root
+ * reachability, IP address (root), and the first packet sent and received.
+ * Timestamps are microseconds since boot, taken the first time each phase
+ * is reached. The root can build a fleet histogram of any phase through
+ * the collective poll. Time to the first packet is also kept across
+ * software resets, split by cold boots and warm boots that reused the
+ * cached configuration and parent.
+ */
+
+#ifndef __MESH_BOOT_TRACE_H__
+#define __MESH_BOOT_TRACE_H__
+
+#include "esp_err.h"
+#include "mesh_collect.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_BOOT_TRACE_MAX_BUCKETS (16)
+#define MESH_BOOT_TRACE_SAMPLES (8)
+
+/* Collect queries 0xF000-0xFFFF are answered by the boot trace */
+#define MESH_BOOT_TRACE_QUERY_BASE (0xF000)
+#define MESH_BOOT_TRACE_QUERY_UNIT_MS (250)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief Boot phases, in the order they are normally reached
+ */
+typedef enum {
+  MESH_BOOT_PHASE_MESH_INIT = 0,    /**< mesh_init() entered */
+  MESH_BOOT_PHASE_MESH_STARTED,     /**< MESH_EVENT_STARTED */
+  MESH_BOOT_PHASE_SCAN_DONE,        /**< First MESH_EVENT_SCAN_DONE */
+  MESH_BOOT_PHASE_PARENT_CONNECTED, /**< First MESH_EVENT_PARENT_CONNECTED */
+  MESH_BOOT_PHASE_ROOT_ADDRESS,     /**< First MESH_EVENT_ROOT_ADDRESS */
+  MESH_BOOT_PHASE_TODS_STATE,       /**< First MESH_EVENT_TODS_STATE */
+  MESH_BOOT_PHASE_GOT_IP,           /**< IP_EVENT_STA_GOT_IP (root) */
+  MESH_BOOT_PHASE_FIRST_SEND,       /**< First packet handed to the mesh */
+  MESH_BOOT_PHASE_FIRST_RECEIVE,    /**< First valid packet received */
+  MESH_BOOT_PHASE_MAX,
+} mesh_boot_phase_t;
+
+/**
+ * @brief This boot's record
+ */
+typedef struct {
+  int64_t phase_us[MESH_BOOT_PHASE_MAX]; /**< Time since boot, 0 = not yet */
+  uint8_t reset_reason;                  /**< esp_reset_reason_t */
+  bool warm; /**< Cached configuration and parent were used */
+} mesh_boot_record_t;
+
+/**
+ * @brief Time from boot to the first packet sent or received
+ *
+ * Kept in RTC memory, so it covers the boots since the last power cycle.
+ * Medians are over the last MESH_BOOT_TRACE_SAMPLES boots of each kind.
+ */
+typedef struct {
+  uint32_t boots_cold;     /**< Boots that scanned for a parent */
+  uint32_t boots_warm;     /**< Boots that reused the cached parent */
+  uint32_t median_cold_ms; /**< Median time of cold boots */
+  uint32_t median_warm_ms; /**< Median time of warm boots */
+  uint32_t last_ms;        /**< Time of this boot, 0 = no packet yet */
+} mesh_boot_stats_t;
+
+/**
+ * @brief Fleet distribution of one phase
+ *
+ * counts[i] holds the nodes that reached the phase within
+ * [i * bucket_ms, (i + 1) * bucket_ms); the last bucket also holds every
+ * later node.
+ */
+typedef struct {
+  uint32_t bucket_ms;                           /**< Bucket width */
+  uint8_t bucket_count;                         /**< Buckets used */
+  uint16_t counts[MESH_BOOT_TRACE_MAX_BUCKETS]; /**< Nodes per bucket */
+  uint16_t reached;   /**< Nodes past the phase */
+  uint16_t responded; /**< Nodes that answered */
+  float min_ms;       /**< Fastest node */
+  float max_ms;       /**< Slowest node */
+  float mean_ms;      /**< Mean over the nodes past the phase */
+} mesh_boot_histogram_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Get this boot's record
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if record is NULL
+ */
+esp_err_t mesh_boot_trace_get(mesh_boot_record_t *record);
+
+/**
+ * @brief Get cold and warm boot time to the first packet
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t mesh_boot_trace_get_stats(mesh_boot_stats_t *stats);
+
+/**
+ * @brief Name of a phase, for logs
+ */
+const char *mesh_boot_phase_name(mesh_boot_phase_t phase);
+
+/**
+ * @brief Log this boot's record, one line per reached phase
+ */
+void mesh_boot_trace_log(void);
+
+/**
+ * @brief Build the fleet distribution of a phase (root only)
+ *
+ * Runs one collective poll for the summary and one per bucket boundary,
+ * so mesh_collect_init() must have been called on every node. Bucket
+ * widths are rounded up to MESH_BOOT_TRACE_QUERY_UNIT_MS, and the last
+ * bucket boundary must stay below 255 units.
+ *
+ * @param phase Phase to collect
+ * @param bucket_ms Bucket width
+ * @param bucket_count Buckets, 1 to MESH_BOOT_TRACE_MAX_BUCKETS
+ * @param timeout_ms Timeout of each poll, 0 for the default
+ * @param histogram Result
+ *
+ * @return
+ *    - ESP_OK: Every node answered every poll
+ *    - ESP_ERR_TIMEOUT: Some polls were incomplete
+ *    - ESP_ERR_INVALID_ARG: Invalid arguments
+ *    - Other: Error returned by mesh_collect()
+ */
+esp_err_t mesh_boot_trace_collect(mesh_boot_phase_t phase, uint32_t bucket_ms,
+                                  uint8_t bucket_count, uint32_t timeout_ms,
+                                  mesh_boot_histogram_t *histogram);
+
+#endif /* __MESH_BOOT_TRACE_H__ */
@@ -0,0 +1,105 @@
+/* ESP-MESH Collective Poll ("collect from all")
+ *
+ * The root sends one request down the tree; every node answers with a value
+ * from its responder callback, and relays merge the answers of their
+ * subtree into one combined reply before forwarding it to their parent. The
+ * root gets a single result: a completeness bitmap indexed by node ID plus
+ * count/min/max/sum of the reported values.
+ *
+ * Each relay waits for its subtree at most a share of the request timeout
+ * that shrinks with depth, so deeper nodes report first and a missing node
+ * only delays its own branch.
+ */
+
+#ifndef __MESH_COLLECT_H__
+#define __MESH_COLLECT_H__
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_COLLECT_BITMAP_BYTES (32) /* one bit per node ID 0-255 */
+#define MESH_COLLECT_DEFAULT_TIMEOUT_MS (3000)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief Callback producing this node's answer to a query
+ *
+ * Runs in the mesh receive task and must not block.
+ *
+ * @param query Query code chosen by the root application
+ * @param value Set to the value to report
+ *
+ * @return ESP_OK to report value; any other code reports presence only
+ */
+typedef esp_err_t (*mesh_collect_responder_t)(uint16_t query, float *value);
+
+/**
+ * @brief Combined result of a collection
+ */
+typedef struct {
+  uint16_t responded;   /**< Nodes that answered */
+  uint16_t expected;    /**< Nodes in the routing table when polled */
+  uint16_t value_count; /**< Answers that carried a value */
+  float min;            /**< Smallest value */
+  float max;            /**< Largest value */
+  float sum;            /**< Sum of values */
+  uint8_t bitmap[MESH_COLLECT_BITMAP_BYTES]; /**< Bit n: node ID n answered */
+  uint32_t elapsed_ms;  /**< Time until the result was complete */
+} mesh_collect_result_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Start answering and relaying collect requests
+ *
+ * Nodes are identified in the bitmap by the ID passed to
+ * mesh_announce_node_identity(); nodes without an ID are only counted.
+ *
+ * @param responder Callback producing this node's value, may be NULL to
+ *                  report presence only
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_STATE: Already initialized
+ *    - ESP_ERR_NO_MEM: Out of memory
+ */
+esp_err_t mesh_collect_init(mesh_collect_responder_t responder);
+
+/**
+ * @brief Poll every node and wait for the combined result (root only)
+ *
+ * Returns when every node in the routing table answered or timeout_ms
+ * elapsed, whichever comes first.
+ *
+ * @param query Query code passed to the responders
+ * @param timeout_ms Overall timeout, 0 for the default
+ * @param result Combined result
+ *
+ * @return
+ *    - ESP_OK: Every node answered
+ *    - ESP_ERR_TIMEOUT: Partial result, see result->bitmap
+ *    - ESP_ERR_INVALID_ARG: NULL result
+ *    - ESP_ERR_INVALID_STATE: Not initialized or a collection is running
+ *    - ESP_FAIL: Not root or send failed
+ */
+esp_err_t mesh_collect(uint16_t query, uint32_t timeout_ms,
+                       mesh_collect_result_t *result);
+
+/**
+ * @brief Check whether a node ID is set in a result bitmap
+ */
+static inline bool mesh_collect_has_node(const mesh_collect_result_t *result,
+                                         uint8_t node_id) {
+  return result->bitmap[node_id / 8] & (1 << (node_id % 8));
+}
+
+#endif /* __MESH_COLLECT_H__ */
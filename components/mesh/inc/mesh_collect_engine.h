@@ -0,0 +1,82 @@
+/* Collective Poll Engine
+ *
+ * Builds the replies of a collective poll on their way up the tree. A
+ * reply holds the count, minimum, maximum and sum of the values of a
+ * subtree and a bitmap of the node IDs that answered, so a relay merges
+ * its children's replies into its own in any order and the root gets the
+ * same result. The engine also decides how long a node waits for its
+ * subtree before it forwards what it has. It has no WiFi dependencies so
+ * polls can be simulated on a host.
+ */
+
+#ifndef __MESH_COLLECT_ENGINE_H__
+#define __MESH_COLLECT_ENGINE_H__
+
+#include "mesh_collect.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+typedef enum {
+  MESH_COLLECT_OP_REQUEST = 1, /**< root -> nodes */
+  MESH_COLLECT_OP_REPLY = 2,   /**< node -> parent: merged subtree reply */
+} mesh_collect_op_t;
+
+/**
+ * @brief Reply of a subtree, as sent to the parent
+ */
+typedef struct {
+  uint8_t op;
+  uint16_t req_id;
+  uint16_t responded;
+  uint16_t value_count;
+  float min;
+  float max;
+  float sum;
+  uint8_t bitmap[MESH_COLLECT_BITMAP_BYTES];
+} __attribute__((packed)) mesh_collect_msg_reply_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Start an empty reply for a request
+ */
+void mesh_collect_reply_init(mesh_collect_msg_reply_t *reply,
+                             uint16_t req_id);
+
+/**
+ * @brief Add the answer of one node
+ *
+ * @param reply Reply
+ * @param node_id ID of the node, 0 to count it without a bit
+ * @param has_value The node reported a value
+ * @param value The value
+ */
+void mesh_collect_reply_answer(mesh_collect_msg_reply_t *reply,
+                               uint8_t node_id, bool has_value, float value);
+
+/**
+ * @brief Merge a child's reply into a reply
+ */
+void mesh_collect_reply_merge(mesh_collect_msg_reply_t *reply,
+                              const mesh_collect_msg_reply_t *in);
+
+/**
+ * @brief Time a node waits for its subtree before forwarding
+ *
+ * Deeper nodes get a smaller share of the timeout, so that their replies
+ * reach the relays above before those give up.
+ *
+ * @param timeout_ms Timeout of the request
+ * @param layer Layer of the node
+ * @param max_layer Deepest layer of the mesh
+ *
+ * @return Wait in milliseconds, at least 1
+ */
+uint32_t mesh_collect_wait_ms(uint32_t timeout_ms, int layer, int max_layer);
+
+#endif /* __MESH_COLLECT_ENGINE_H__ */
@@ -0,0 +1,165 @@
+/* ESP-MESH Replicated Configuration Store
+ *
+ * A versioned key-value document owned by the root and replicated to every
+ * node (see mesh_config_store_engine.h), replacing per-node
+ * MESH_DATA_TYPE_CONFIG pushes:
+ *
+ * - The root stages changes with mesh_config_store_set() and
+ *   mesh_config_store_delete(), and mesh_config_store_publish() turns them
+ *   into one new version. Its diff from the previous version is sent once
+ *   to a mesh group that every node joins, so the stack carries it down
+ *   the tree and each relay forwards it once.
+ * - Every node applies a diff only to the version it holds, saves the
+ *   result in NVS and advertises its version and digest to the root when
+ *   it connects, every advert_interval_ms, and whenever a diff does not
+ *   fit. The root answers late nodes in batches, multicasting each diff to
+ *   the nodes that hold the same version, or the full document when the
+ *   diff would not help.
+ *
+ * Every node must call mesh_config_store_init(); values survive reboots
+ * and are readable before the mesh connects.
+ */
+
+#ifndef __MESH_CONFIG_STORE_H__
+#define __MESH_CONFIG_STORE_H__
+
+#include "esp_err.h"
+#include "mesh_config_store_engine.h"
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_CONFIG_STORE_NVS_NAMESPACE "mesh_config"
+#define MESH_CONFIG_STORE_NVS_KEY "doc"
+#define MESH_CONFIG_STORE_DEFAULT_ADVERT_MS (300000)
+#define MESH_CONFIG_STORE_ADVERT_SPREAD_MS (5000) /* after connecting */
+#define MESH_CONFIG_STORE_CHECK_MS (1000)         /* root answers adverts */
+#define MESH_CONFIG_STORE_MAX_PENDING (32)        /* adverts per answer */
+#define MESH_CONFIG_STORE_TASK_STACK_SIZE (3584)
+#define MESH_CONFIG_STORE_TASK_PRIORITY (2)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief Configuration store settings
+ */
+typedef struct {
+  uint32_t advert_interval_ms; /**< Periodic version advert, 0 = default */
+} mesh_config_store_config_t;
+
+/**
+ * @brief Configuration store counters
+ */
+typedef struct {
+  uint32_t version;          /**< Version held by this node */
+  uint32_t publishes;        /**< Root: versions published */
+  uint32_t diffs_sent;       /**< Root: diffs sent, group and catch-up */
+  uint32_t full_sent;        /**< Root: of which full documents */
+  uint32_t bytes_sent;       /**< Root: diff bytes sent */
+  uint32_t adverts_received; /**< Root: versions advertised to it */
+  uint32_t adverts_sent;     /**< Node: versions advertised */
+  uint32_t diffs_applied;    /**< Node: diffs that produced a version */
+  uint32_t diffs_rejected;   /**< Node: wrong base or digest */
+} mesh_config_store_stats_t;
+
+/**
+ * @brief Called after a new version was applied on a node
+ *
+ * Runs in the receive task; keep it short.
+ */
+typedef void (*mesh_config_store_cb_t)(uint32_t version);
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Load the saved document and start replicating
+ *
+ * @param config Configuration, NULL for defaults
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_STATE: Already initialized
+ *    - ESP_ERR_NO_MEM: Out of memory
+ */
+esp_err_t mesh_config_store_init(const mesh_config_store_config_t *config);
+
+/**
+ * @brief Stage a key for the next version (root only)
+ *
+ * @param key Up to MESH_CONFIG_KEY_SIZE - 1 characters
+ * @param value Value bytes
+ * @param length Up to MESH_CONFIG_VALUE_MAX bytes
+ *
+ * @return
+ *    - ESP_OK: Success, or the key already had this value
+ *    - ESP_ERR_INVALID_ARG: Bad key or value
+ *    - ESP_ERR_INVALID_STATE: Not initialized
+ *    - ESP_ERR_NO_MEM: The document is full
+ *    - ESP_FAIL: Not a root node
+ */
+esp_err_t mesh_config_store_set(const char *key, const void *value,
+                                uint8_t length);
+
+/**
+ * @brief Stage the deletion of a key for the next version (root only)
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_STATE: Not initialized
+ *    - ESP_ERR_NOT_FOUND: The key is not set
+ *    - ESP_FAIL: Not a root node
+ */
+esp_err_t mesh_config_store_delete(const char *key);
+
+/**
+ * @brief Publish the staged changes as a new version (root only)
+ *
+ * Saves the document and sends the diff to every node in one group
+ * message. Does nothing if no change is staged.
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_STATE: Not initialized
+ *    - ESP_FAIL: Not a root node
+ *    - Other: Error saving the document or sending the diff; the version
+ *      is published either way and late nodes catch up by advert
+ */
+esp_err_t mesh_config_store_publish(void);
+
+/**
+ * @brief Read a key of the applied document
+ *
+ * @param key Key
+ * @param value Output
+ * @param length In: capacity of value, out: length of the value
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: NULL argument
+ *    - ESP_ERR_INVALID_STATE: Not initialized
+ *    - ESP_ERR_NOT_FOUND: The key is not set
+ *    - ESP_ERR_INVALID_SIZE: value is too small, length set to the need
+ */
+esp_err_t mesh_config_store_get(const char *key, void *value,
+                                uint8_t *length);
+
+/**
+ * @brief Register the callback for new versions, NULL to remove it
+ *
+ * @return ESP_OK
+ */
+esp_err_t mesh_config_store_register_callback(mesh_config_store_cb_t cb);
+
+/**
+ * @brief Get configuration store counters
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t mesh_config_store_get_stats(mesh_config_store_stats_t *stats);
+
+#endif /* __MESH_CONFIG_STORE_H__ */
@@ -0,0 +1,177 @@
+/* Replicated Configuration Store Engine
+ *
+ * A small key-value document with a version number that the root edits
+ * and every node holds a copy of. Each entry remembers the version that
+ * last changed it, and a deleted key stays behind as a tombstone, so the
+ * root can encode the changes since any earlier version as a binary diff:
+ *
+ * - a header with the base version the diff applies to, the version it
+ *   produces and a digest of the resulting document,
+ * - one record per key changed or deleted since the base.
+ *
+ * A diff from a base older than the oldest tombstone the document still
+ * has, or from a version it never had, is sent as the full document. A
+ * node applies a diff only to the base version and only if the digest
+ * matches afterwards. The engine has no WiFi dependencies so it can be
+ * run on a host.
+ */
+
+#ifndef __MESH_CONFIG_STORE_ENGINE_H__
+#define __MESH_CONFIG_STORE_ENGINE_H__
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_CONFIG_MAX_KEYS (24)   /* entries, tombstones included */
+#define MESH_CONFIG_KEY_SIZE (16)   /* NUL included, as NVS keys */
+#define MESH_CONFIG_VALUE_MAX (32)  /* bytes */
+#define MESH_CONFIG_MAX_DIFF (1024) /* encoded diff, full document too */
+
+#define MESH_CONFIG_DIFF_FULL (1 << 0) /* replaces the whole document */
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief One key of the document
+ */
+typedef struct {
+  char key[MESH_CONFIG_KEY_SIZE];       /**< NUL-terminated */
+  uint8_t value[MESH_CONFIG_VALUE_MAX]; /**< Opaque bytes */
+  uint8_t length;                       /**< Bytes of value */
+  bool used;                            /**< Slot holds a key */
+  bool deleted;                         /**< Tombstone */
+  uint32_t version;                     /**< Version that last changed it */
+} mesh_config_entry_t;
+
+/**
+ * @brief Document
+ */
+typedef struct {
+  uint32_t version; /**< 0 = empty, never published */
+  uint32_t floor;   /**< Oldest base a diff can start from */
+  mesh_config_entry_t entries[MESH_CONFIG_MAX_KEYS];
+} mesh_config_doc_t;
+
+/**
+ * @brief Header of an encoded diff
+ */
+typedef struct {
+  uint8_t flags;    /**< MESH_CONFIG_DIFF_FULL */
+  uint8_t count;    /**< Records that follow */
+  uint32_t base;    /**< Version the diff applies to */
+  uint32_t version; /**< Version it produces */
+  uint32_t digest;  /**< mesh_config_doc_digest() of the result */
+} __attribute__((packed)) mesh_config_diff_header_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Initialize an empty document
+ */
+void mesh_config_doc_init(mesh_config_doc_t *doc);
+
+/**
+ * @brief Set a key, marking it changed in version
+ *
+ * Setting a key to its current value changes nothing. When every slot is
+ * taken, the oldest tombstone is dropped and the floor raised past it.
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: Empty or too long key, or too long value
+ *    - ESP_ERR_NO_MEM: No slot left, or the full document would not fit
+ *      in MESH_CONFIG_MAX_DIFF
+ */
+esp_err_t mesh_config_doc_set(mesh_config_doc_t *doc, const char *key,
+                              const void *value, uint8_t length,
+                              uint32_t version);
+
+/**
+ * @brief Delete a key, leaving a tombstone marked with version
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if the key is not set
+ */
+esp_err_t mesh_config_doc_delete(mesh_config_doc_t *doc, const char *key,
+                                 uint32_t version);
+
+/**
+ * @brief Find a key that is set
+ *
+ * @return The entry, or NULL if the key is not set
+ */
+const mesh_config_entry_t *mesh_config_doc_find(const mesh_config_doc_t *doc,
+                                                const char *key);
+
+/**
+ * @brief Digest of the keys and values that are set
+ *
+ * Does not depend on the order of the slots or on tombstones, so a node
+ * and the root agree on it whenever their documents hold the same data.
+ */
+uint32_t mesh_config_doc_digest(const mesh_config_doc_t *doc);
+
+/**
+ * @brief Encode the changes from base to the current version
+ *
+ * A base older than the floor or newer than the document gives the full
+ * document, and so does a diff that would be larger than it.
+ *
+ * @param doc Document
+ * @param base Version the receiver holds
+ * @param buf Output
+ * @param size Capacity of buf
+ *
+ * @return Encoded length, or -1 if buf is too small
+ */
+int mesh_config_doc_diff(const mesh_config_doc_t *doc, uint32_t base,
+                         uint8_t *buf, int size);
+
+/**
+ * @brief Apply a diff, leaving doc untouched unless it succeeds
+ *
+ * @param doc Current document
+ * @param diff Encoded diff
+ * @param length Length of diff
+ * @param out Resulting document, may not be doc
+ *
+ * @return
+ *    - ESP_OK: out holds the new document
+ *    - ESP_ERR_INVALID_SIZE: Malformed diff
+ *    - ESP_ERR_INVALID_VERSION: The diff is for another base
+ *    - ESP_ERR_INVALID_CRC: The result does not match the digest
+ *    - ESP_ERR_NO_MEM: The result does not fit the document
+ */
+esp_err_t mesh_config_doc_apply(const mesh_config_doc_t *doc,
+                                const uint8_t *diff, int length,
+                                mesh_config_doc_t *out);
+
+/**
+ * @brief Bring a document to the keys and values of another
+ *
+ * Sets every key of staged that doc lacks or holds with another value and
+ * deletes every key staged lacks, marking them changed in version. Entry
+ * versions of staged are ignored.
+ *
+ * @return Number of keys changed, or -1 if doc ran out of room
+ */
+int mesh_config_doc_merge(mesh_config_doc_t *doc,
+                          const mesh_config_doc_t *staged, uint32_t version);
+
+/**
+ * @brief Move a document to a new version as a whole
+ *
+ * Marks every key changed in version and drops the tombstones, so every
+ * other version gets the full document. Used by a root that finds nodes
+ * ahead of it.
+ */
+void mesh_config_doc_rebase(mesh_config_doc_t *doc, uint32_t version);
+
+#endif /* __MESH_CONFIG_STORE_ENGINE_H__ */
@@ -14,25 +14,39 @@
 #define MESH_DATA_TRANSFER_TASK_STACK_SIZE (4096)
 #define MESH_DATA_TRANSFER_TASK_PRIORITY (5)
 #define MESH_RX_BUFFER_SIZE (1500)
+#define MESH_PIGGYBACK_TICK_MS (50) /* control item deadline resolution */
+
+/* Header flags */
+#define MESH_DATA_FLAG_EXT (1 << 0) /* batch records follow the payload */
 
 /**
  * @brief Data packet types for mesh communication
  */
 typedef enum {
-  MESH_DATA_TYPE_SENSOR = 0x01,  /**< Sensor data */
-  MESH_DATA_TYPE_CONTROL = 0x02, /**< Control commands */
-  MESH_DATA_TYPE_STATUS = 0x03,  /**< Status updates */
-  MESH_DATA_TYPE_CONFIG = 0x04,  /**< Configuration data */
-  MESH_DATA_TYPE_CUSTOM = 0xFF   /**< Custom application data */
+  MESH_DATA_TYPE_SENSOR = 0x01,    /**< Sensor data */
+  MESH_DATA_TYPE_CONTROL = 0x02,   /**< Control commands */
+  MESH_DATA_TYPE_STATUS = 0x03,    /**< Status updates */
+  MESH_DATA_TYPE_CONFIG = 0x04,    /**< Configuration data */
+  MESH_DATA_TYPE_OTA = 0x05,       /**< Mesh OTA distribution (internal) */
+  MESH_DATA_TYPE_BATCH = 0x06,     /**< Several packets coalesced into one */
+  MESH_DATA_TYPE_LOG = 0x07,       /**< Telemetry log pull (internal) */
+  MESH_DATA_TYPE_AGGREGATE = 0x08, /**< Readings merged by relay nodes */
+  MESH_DATA_TYPE_FILTER = 0x09,    /**< Filter subscriptions (internal) */
+  MESH_DATA_TYPE_COLLECT = 0x0A,   /**< Collective poll (internal) */
+  MESH_DATA_TYPE_TOPOLOGY = 0x0B,  /**< Topology reports (internal) */
+  MESH_DATA_TYPE_BALANCE = 0x0C,   /**< Load balancing (internal) */
+  MESH_DATA_TYPE_STANDBY = 0x0D,   /**< Standby root mirror (internal) */
+  MESH_DATA_TYPE_HEAL = 0x0E,      /**< Healing benchmark (internal) */
+  MESH_DATA_TYPE_CUSTOM = 0xFF     /**< Custom application data */
 } mesh_data_type_t;
 
 /**
  * @brief Mesh data packet header structure
  */
 typedef struct {
-  uint8_t type;     /**< Data type from mesh_data_type_t */
-  uint16_t length;  /**< Payload length in bytes */
-  uint8_t reserved; /**< Reserved for future use */
+  uint8_t type;    /**< Data type from mesh_data_type_t */
+  uint16_t length; /**< Payload length in bytes */
+  uint8_t flags;   /**< MESH_DATA_FLAG_* bits */
 } __attribute__((packed)) mesh_data_header_t;
 
 /**
@@ -43,6 +57,31 @@ typedef struct {
   uint8_t payload[];         /**< Variable length payload */
 } __attribute__((packed)) mesh_data_packet_t;
 
+/**
+ * @brief Header of one record inside a MESH_DATA_TYPE_BATCH payload
+ *
+ * A batch payload is a sequence of records, each header followed by
+ * `length` bytes of payload. The receiver delivers every record as if it
+ * had arrived in its own packet.
+ */
+typedef struct {
+  uint8_t type;    /**< Data type of the record */
+  uint16_t length; /**< Record payload length in bytes */
+} __attribute__((packed)) mesh_batch_record_header_t;
+
+/**
+ * @brief Counters of control items piggybacked on data frames
+ *
+ * Control frames saved: piggybacked + replaced.
+ */
+typedef struct {
+  uint32_t queued;      /**< Items queued */
+  uint32_t replaced;    /**< Superseded by a newer item before leaving */
+  uint32_t piggybacked; /**< Sent attached to another frame */
+  uint32_t standalone;  /**< Sent alone at their deadline */
+  uint32_t dropped;     /**< Standalone sends that failed */
+} mesh_piggyback_stats_t;
+
 /**
  * @brief Callback function type for received data
  *
@@ -83,7 +122,11 @@ esp_err_t mesh_data_transfer_deinit(void);
  * @brief Send data from child node to root node
  *
  * This function sends data upstream to the root node. Can be called from
- * any non-root node in the mesh network.
+ * any non-root node in the mesh network. When store-and-forward is enabled
+ * (mesh_store_forward.h), packets that cannot be delivered are queued for
+ * replay and ESP_OK is returned. With aggregation enabled
+ * (mesh_aggregation.h), packets of the aggregated types are merged into the
+ * next aggregate frame.
  *
  * @param data_type Type of data being sent
  * @param payload Pointer to payload data
@@ -112,6 +155,7 @@ esp_err_t mesh_send_to_root(uint8_t data_type, const uint8_t *payload,
  * @return
  *    - ESP_OK: Success
  *    - ESP_ERR_INVALID_ARG: Invalid arguments
+ *    - ESP_ERR_INVALID_SIZE: Larger than the node announced it receives
  *    - ESP_ERR_MESH_NOT_START: Mesh not started
  *    - ESP_ERR_MESH_NOT_ROOT: Not a root node
  *    - ESP_FAIL: Send failed
@@ -139,6 +183,31 @@ esp_err_t mesh_send_to_child(const mesh_addr_t *dest_addr, uint8_t data_type,
 esp_err_t mesh_broadcast_from_root(uint8_t data_type, const uint8_t *payload,
                                    uint16_t length);
 
+/**
+ * @brief Multicast data from root node to a set of nodes
+ *
+ * Unlike mesh_broadcast_from_root(), the packet is handed to the mesh stack
+ * once and replicated by the relays on the way down the tree, so the root
+ * does not pay one transmission per destination. Can only be called from the
+ * root node.
+ *
+ * @param targets Array of destination MAC addresses
+ * @param target_count Number of entries in targets
+ * @param data_type Type of data being sent
+ * @param payload Pointer to payload data
+ * @param length Length of payload in bytes
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: Invalid arguments
+ *    - ESP_ERR_MESH_NOT_START: Mesh not started
+ *    - ESP_FAIL: Not a root node
+ *    - Other: Error returned by esp_mesh_send()
+ */
+esp_err_t mesh_multicast_from_root(const mesh_addr_t *targets, int target_count,
+                                   uint8_t data_type, const uint8_t *payload,
+                                   uint16_t length);
+
 /**
  * @brief Register callback function for received data
  *
@@ -153,4 +222,11 @@ esp_err_t mesh_broadcast_from_root(uint8_t data_type, const uint8_t *payload,
  */
 esp_err_t mesh_register_receive_callback(mesh_data_receive_cb_t callback);
 
+/**
+ * @brief Get piggybacking counters
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t mesh_data_get_piggyback_stats(mesh_piggyback_stats_t *stats);
+
 #endif /* __MESH_DATA_TRANSFER_H__ */
@@ -0,0 +1,83 @@
+/* ESP-MESH Binary Event Log
+ *
+ * Mesh events, scan results and parent decisions are recorded as fixed
+ * 20-byte records in a RAM ring instead of formatted log lines, so a burst
+ * of topology changes costs a few stores per event rather than a printf
+ * with MAC formatting. Records are turned into text only when read out
+ * with mesh_event_log_dump().
+ */
+
+#ifndef __MESH_EVENT_LOG_H__
+#define __MESH_EVENT_LOG_H__
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_EVENT_LOG_SIZE (128) /* records kept, oldest overwritten */
+
+/* Record codes below 0x80 are mesh_event_id_t values */
+#define MESH_EVENT_LOG_SCAN_RECORD (0x80) /* value: layer<<8|chan, arg: rssi */
+#define MESH_EVENT_LOG_PARENT_SET (0x81)  /* value: own layer, arg: channel */
+#define MESH_EVENT_LOG_REJOIN (0x82)      /* value: ms, arg: 1 if cached */
+#define MESH_EVENT_LOG_FAST_BOOT (0x83)   /* value: channel, arg: 1 if failed */
+#define MESH_EVENT_LOG_STEER (0x84)       /* mac: old parent, arg: 1 if moved */
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief One log record
+ *
+ * The meaning of value and arg depends on the code, see
+ * mesh_event_log_dump() for the decoding.
+ */
+typedef struct {
+  uint32_t time_ms; /**< esp_log_timestamp() when recorded */
+  int32_t value;    /**< Main value */
+  int16_t arg;      /**< Second value */
+  uint8_t code;     /**< mesh_event_id_t or MESH_EVENT_LOG_* */
+  uint8_t has_mac;  /**< mac is set */
+  uint8_t mac[6];   /**< Node, parent or BSSID the record is about */
+} mesh_event_log_record_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Append a record
+ *
+ * @param code Record code
+ * @param mac MAC address, NULL if none
+ * @param value Main value
+ * @param arg Second value
+ */
+void mesh_event_log_put(uint8_t code, const uint8_t *mac, int32_t value,
+                        int16_t arg);
+
+/**
+ * @brief Copy records written since a cursor
+ *
+ * Start with *cursor = 0. Records overwritten before they were read are
+ * skipped, and the cursor moves past them.
+ *
+ * @param cursor Sequence number of the next record to read, advanced
+ * @param records Output records, oldest first
+ * @param max_records Capacity of records
+ *
+ * @return Number of records copied
+ */
+int mesh_event_log_read(uint32_t *cursor, mesh_event_log_record_t *records,
+                        int max_records);
+
+/**
+ * @brief Print every retained record as text
+ */
+void mesh_event_log_dump(void);
+
+#endif /* __MESH_EVENT_LOG_H__ */
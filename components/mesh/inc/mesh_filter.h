@@ -0,0 +1,90 @@
+/* ESP-MESH Filter Subscriptions (Query Pushdown)
+ *
+ * The root compiles predicates (see mesh_filter_engine.h) and installs them
+ * on nodes as subscriptions for a data type. A node with subscriptions for
+ * a type only sends the readings of mesh_send_to_root() that match at least
+ * one of them; packets with no matching reading are not sent at all.
+ * Packets of types without subscriptions are sent unchanged.
+ */
+
+#ifndef __MESH_FILTER_H__
+#define __MESH_FILTER_H__
+
+#include "esp_err.h"
+#include "esp_mesh.h"
+#include "mesh_filter_engine.h"
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_FILTER_MAX_SUBSCRIPTIONS (4)
+#define MESH_FILTER_MAX_READINGS (64) /* larger packets are sent unfiltered */
+#define MESH_FILTER_ALL_SUBSCRIPTIONS (0xFF)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief Filter counters
+ *
+ * eval_cycles / evaluated is the interpreter cost per reading.
+ */
+typedef struct {
+  uint32_t evaluated;   /**< Readings run through the filters */
+  uint32_t passed;      /**< Readings that matched */
+  uint32_t packets_dropped; /**< Packets with no matching reading */
+  uint64_t eval_cycles; /**< CPU cycles spent evaluating */
+  uint8_t installed;    /**< Subscriptions currently installed */
+} mesh_filter_stats_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Accept filter subscriptions from the root
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_STATE: Already initialized
+ *    - ESP_ERR_NO_MEM: Out of memory
+ */
+esp_err_t mesh_filter_init(void);
+
+/**
+ * @brief Compile an expression and install it on nodes (root only)
+ *
+ * Installing an existing subscription ID replaces it.
+ *
+ * @param node Target node, NULL for every node
+ * @param sub_id Subscription ID chosen by the root
+ * @param data_type Data type the filter applies to
+ * @param expr Filter expression
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: Syntax error or invalid ID
+ *    - ESP_ERR_INVALID_SIZE: Expression too large
+ *    - ESP_FAIL: Not root or send failed
+ */
+esp_err_t mesh_filter_subscribe(const mesh_addr_t *node, uint8_t sub_id,
+                                uint8_t data_type, const char *expr);
+
+/**
+ * @brief Remove a subscription from nodes (root only)
+ *
+ * @param node Target node, NULL for every node
+ * @param sub_id Subscription ID, or MESH_FILTER_ALL_SUBSCRIPTIONS
+ */
+esp_err_t mesh_filter_unsubscribe(const mesh_addr_t *node, uint8_t sub_id);
+
+/**
+ * @brief Get filter counters
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t mesh_filter_get_stats(mesh_filter_stats_t *stats);
+
+#endif /* __MESH_FILTER_H__ */
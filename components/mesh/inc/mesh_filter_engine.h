@@ -0,0 +1,71 @@
+/* Reading Filter Compiler and Interpreter
+ *
+ * A small predicate language over one sensor reading, e.g.
+ *
+ *     channel == 0 && (value > 25.5 || value < -5)
+ *
+ * Operands are the variables `channel` (alias `ch`) and `value`, and
+ * numeric literals. Operators, by increasing precedence: `||`, `&&`, `!`,
+ * comparisons (`< <= > >= == !=`), `+ -`, `* /`, unary `-`, and `abs(x)`.
+ * A non-zero result means the reading matches.
+ *
+ * Expressions are compiled on the root into stack-machine bytecode; nodes
+ * validate the bytecode once when it is installed and then evaluate it
+ * without allocating.
+ */
+
+#ifndef __MESH_FILTER_ENGINE_H__
+#define __MESH_FILTER_ENGINE_H__
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_FILTER_MAX_CODE (64)
+#define MESH_FILTER_STACK_DEPTH (8)
+#define MESH_FILTER_MAX_NESTING (16) /* parentheses, abs(), unary - and ! */
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Compile an expression into bytecode
+ *
+ * @param expr Expression text
+ * @param code Output buffer
+ * @param capacity Size of code, at most MESH_FILTER_MAX_CODE is used
+ * @param length Set to the bytecode length
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: Syntax error or NULL pointers
+ *    - ESP_ERR_INVALID_SIZE: Bytecode, stack depth or nesting exceeds the
+ *      limits
+ */
+esp_err_t mesh_filter_compile(const char *expr, uint8_t *code,
+                              uint16_t capacity, uint16_t *length);
+
+/**
+ * @brief Check bytecode received from the network
+ *
+ * Verifies opcodes, operand lengths and stack depth so that
+ * mesh_filter_eval() can run without further checks.
+ *
+ * @return ESP_OK if the bytecode is safe to evaluate,
+ *         ESP_ERR_INVALID_ARG otherwise
+ */
+esp_err_t mesh_filter_validate(const uint8_t *code, uint16_t length);
+
+/**
+ * @brief Evaluate validated bytecode against one reading
+ *
+ * @return true if the reading matches
+ */
+bool mesh_filter_eval(const uint8_t *code, uint16_t length, uint8_t channel,
+                      float value);
+
+#endif /* __MESH_FILTER_ENGINE_H__ */
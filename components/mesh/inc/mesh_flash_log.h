@@ -0,0 +1,151 @@
+/* ESP-MESH Persistent Telemetry Log
+ *
+ * Append-only log kept in a dedicated data partition so readings survive
+ * reboots and long outages. The root pulls records from a node by cursor
+ * (everything from sequence number N onward) and acknowledges what it has
+ * stored; acknowledged sectors are reclaimed and can be pre-erased with
+ * mesh_flash_log_compact().
+ */
+
+#ifndef __MESH_FLASH_LOG_H__
+#define __MESH_FLASH_LOG_H__
+
+#include "esp_err.h"
+#include "esp_mesh.h"
+#include "mesh_flash_log_engine.h"
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_FLASH_LOG_DEFAULT_PARTITION "mesh_log"
+#define MESH_FLASH_LOG_PULL_MAX_RECORDS (64)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief Callback invoked on the root for every record pulled from a node
+ *
+ * @param from Node the record came from
+ * @param seq Record sequence number on that node
+ * @param data Record data
+ * @param length Record length
+ */
+typedef void (*mesh_flash_log_record_cb_t)(const mesh_addr_t *from,
+                                           uint32_t seq, const uint8_t *data,
+                                           uint16_t length);
+
+/**
+ * @brief Callback invoked on the root at the end of every pull reply
+ *
+ * @param from Node that replied
+ * @param first_seq Oldest record the node still stores
+ * @param next_seq Cursor for the next pull
+ * @param count Records delivered in this reply
+ */
+typedef void (*mesh_flash_log_pull_done_cb_t)(const mesh_addr_t *from,
+                                              uint32_t first_seq,
+                                              uint32_t next_seq,
+                                              uint16_t count);
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Initialize the telemetry log
+ *
+ * Mounts the log partition and starts answering pull requests from the root.
+ * The root may pass NULL to only collect from other nodes.
+ *
+ * @param partition_label Data partition holding the log, NULL for none
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_STATE: Already initialized
+ *    - ESP_ERR_NOT_FOUND: Partition not found
+ *    - ESP_ERR_INVALID_SIZE: Partition too small or too large
+ *    - ESP_ERR_NO_MEM: Out of memory
+ */
+esp_err_t mesh_flash_log_init(const char *partition_label);
+
+/**
+ * @brief Append one record to the local log
+ *
+ * Records are batched in RAM and programmed a block at a time; call
+ * mesh_flash_log_flush() to force the pending block out.
+ *
+ * @param data Record data
+ * @param length Record length, 1 to MESH_FLASH_LOG_MAX_RECORD
+ * @param seq Set to the record's sequence number, may be NULL
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_STATE: No local log
+ *    - ESP_ERR_INVALID_ARG: Invalid data or length
+ */
+esp_err_t mesh_flash_log_append(const void *data, uint16_t length,
+                                uint32_t *seq);
+
+/**
+ * @brief Program buffered records to flash
+ */
+esp_err_t mesh_flash_log_flush(void);
+
+/**
+ * @brief Pre-erase acknowledged sectors ahead of the write position
+ *
+ * Erasing blocks for tens of milliseconds per sector; call from a
+ * low-priority context.
+ *
+ * @param erased Set to the number of sectors erased, may be NULL
+ */
+esp_err_t mesh_flash_log_compact(int *erased);
+
+/**
+ * @brief Get append and wear counters of the local log
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if stats is NULL,
+ *         ESP_ERR_INVALID_STATE if there is no local log
+ */
+esp_err_t mesh_flash_log_get_stats(mesh_flash_log_stats_t *stats);
+
+/**
+ * @brief Register the root-side callbacks for pulled records
+ *
+ * @param record_cb Called per record, may be NULL
+ * @param done_cb Called at the end of each reply, may be NULL
+ */
+esp_err_t mesh_flash_log_register_callbacks(
+    mesh_flash_log_record_cb_t record_cb,
+    mesh_flash_log_pull_done_cb_t done_cb);
+
+/**
+ * @brief Ask a node for records starting at from_seq (root only)
+ *
+ * The node answers with as many records as fit in one mesh packet, capped at
+ * max_records; pull again from the reported next_seq to continue.
+ *
+ * @param node Node to pull from
+ * @param from_seq First sequence number wanted
+ * @param max_records Record cap, 0 for MESH_FLASH_LOG_PULL_MAX_RECORDS
+ *
+ * @return
+ *    - ESP_OK: Request sent
+ *    - ESP_ERR_INVALID_ARG: NULL node
+ *    - ESP_ERR_INVALID_STATE: Not initialized
+ *    - ESP_FAIL: Not root
+ */
+esp_err_t mesh_flash_log_pull(const mesh_addr_t *node, uint32_t from_seq,
+                              uint16_t max_records);
+
+/**
+ * @brief Acknowledge records below upto_seq on a node (root only)
+ *
+ * The node persists the acknowledgement and may reclaim the records.
+ */
+esp_err_t mesh_flash_log_ack(const mesh_addr_t *node, uint32_t upto_seq);
+
+#endif /* __MESH_FLASH_LOG_H__ */
@@ -0,0 +1,183 @@
+/* Append-Only Flash Log Engine
+ *
+ * Circular, log-structured record store. Records get consecutive sequence
+ * numbers and are batched in RAM into blocks of up to
+ * MESH_FLASH_LOG_BLOCK_SIZE bytes, which are programmed in one write.
+ * Sectors are reused strictly round-robin, which spreads erases evenly over
+ * the partition. The engine only talks to flash through
+ * mesh_flash_log_backend_t, so it can run against an emulated flash on a
+ * host for throughput and wear measurements.
+ */
+
+#ifndef __MESH_FLASH_LOG_ENGINE_H__
+#define __MESH_FLASH_LOG_ENGINE_H__
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_FLASH_LOG_SECTOR_SIZE (4096)
+#define MESH_FLASH_LOG_BLOCK_SIZE (512)
+#define MESH_FLASH_LOG_MAX_SECTORS (64)
+#define MESH_FLASH_LOG_MAX_RECORD (255)
+#define MESH_FLASH_LOG_PREERASE_SECTORS (2)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief Flash access used by the engine
+ *
+ * Offsets are relative to the start of the log area. erase() is only called
+ * with whole, aligned sectors.
+ */
+typedef struct {
+  esp_err_t (*read)(void *ctx, uint32_t offset, void *data, uint32_t size);
+  esp_err_t (*write)(void *ctx, uint32_t offset, const void *data,
+                     uint32_t size);
+  esp_err_t (*erase)(void *ctx, uint32_t offset, uint32_t size);
+  uint32_t size; /**< Size of the log area in bytes */
+  void *ctx;     /**< Passed back to every callback */
+} mesh_flash_log_backend_t;
+
+/**
+ * @brief Append and wear counters
+ *
+ * Write amplification is bytes_programmed / bytes_appended; wear spread is
+ * max_erase_count - min_erase_count.
+ */
+typedef struct {
+  uint32_t records_appended; /**< Records accepted by append */
+  uint32_t bytes_appended;   /**< Record payload bytes accepted */
+  uint32_t bytes_programmed; /**< Bytes written to flash incl. metadata */
+  uint32_t blocks_written;   /**< Block programs */
+  uint32_t sectors_erased;   /**< Sector erases */
+  uint32_t records_lost;     /**< Unacknowledged records overwritten */
+  uint32_t min_erase_count;  /**< Lowest per-sector erase count */
+  uint32_t max_erase_count;  /**< Highest per-sector erase count */
+} mesh_flash_log_stats_t;
+
+/**
+ * @brief Per-sector bookkeeping kept in RAM
+ */
+typedef struct {
+  uint32_t first_seq;   /**< First record in the sector, UINT32_MAX = empty */
+  uint32_t erase_count; /**< Lifetime erases, stored in the sector header */
+  bool erased;          /**< Erased and not yet written */
+} mesh_flash_log_sector_t;
+
+/**
+ * @brief Log engine instance
+ */
+typedef struct {
+  mesh_flash_log_backend_t backend;
+  mesh_flash_log_sector_t sectors[MESH_FLASH_LOG_MAX_SECTORS];
+  uint16_t sector_count;
+  uint16_t head;         /**< Oldest sector holding records */
+  uint16_t tail;         /**< Sector currently written */
+  uint32_t tail_offset;  /**< Write offset inside the tail sector */
+  uint32_t next_seq;     /**< Sequence number of the next record */
+  uint32_t acked_seq;    /**< Records below this may be reclaimed */
+  uint8_t block[MESH_FLASH_LOG_BLOCK_SIZE]; /**< Block being filled */
+  uint16_t block_length; /**< Bytes used in block */
+  uint16_t block_count;  /**< Records in block */
+  mesh_flash_log_stats_t stats;
+} mesh_flash_log_engine_t;
+
+/**
+ * @brief Callback invoked for each record read from the log
+ *
+ * @return true to continue, false to stop reading
+ */
+typedef bool (*mesh_flash_log_read_cb_t)(void *ctx, uint32_t seq,
+                                         const uint8_t *data, uint16_t length);
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Mount the log, recovering its state from flash
+ *
+ * Uncommitted blocks left by a power loss are skipped.
+ *
+ * @param engine Engine instance
+ * @param backend Flash backend
+ * @param acked_seq Acknowledged sequence number persisted by the caller
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: NULL pointers
+ *    - ESP_ERR_INVALID_SIZE: Area smaller than two sectors or larger than
+ *      MESH_FLASH_LOG_MAX_SECTORS
+ *    - Other: Error returned by the backend
+ */
+esp_err_t mesh_flash_log_engine_mount(mesh_flash_log_engine_t *engine,
+                                      const mesh_flash_log_backend_t *backend,
+                                      uint32_t acked_seq);
+
+/**
+ * @brief Append one record
+ *
+ * The record is buffered in RAM and reaches flash when its block fills or on
+ * mesh_flash_log_engine_flush().
+ *
+ * @param engine Engine instance
+ * @param data Record data
+ * @param length Record length, 1 to MESH_FLASH_LOG_MAX_RECORD
+ * @param seq Set to the record's sequence number, may be NULL
+ */
+esp_err_t mesh_flash_log_engine_append(mesh_flash_log_engine_t *engine,
+                                       const void *data, uint16_t length,
+                                       uint32_t *seq);
+
+/**
+ * @brief Program the partially filled block to flash
+ */
+esp_err_t mesh_flash_log_engine_flush(mesh_flash_log_engine_t *engine);
+
+/**
+ * @brief Read records starting at from_seq, including unflushed ones
+ *
+ * @param engine Engine instance
+ * @param from_seq First sequence number wanted; older records that were
+ *                 already reclaimed are skipped
+ * @param max_records Maximum records to deliver
+ * @param cb Callback invoked per record
+ * @param ctx Passed to cb
+ *
+ * @return Number of records delivered
+ */
+int mesh_flash_log_engine_read(mesh_flash_log_engine_t *engine,
+                               uint32_t from_seq, int max_records,
+                               mesh_flash_log_read_cb_t cb, void *ctx);
+
+/**
+ * @brief Acknowledge all records below upto_seq
+ *
+ * Acknowledged sectors become reclaimable: the head moves past them and
+ * they can be pre-erased by mesh_flash_log_engine_compact().
+ */
+void mesh_flash_log_engine_ack(mesh_flash_log_engine_t *engine,
+                               uint32_t upto_seq);
+
+/**
+ * @brief Pre-erase reclaimable sectors ahead of the tail
+ *
+ * Moves erase latency off the append path. Erases at most
+ * MESH_FLASH_LOG_PREERASE_SECTORS sectors per call.
+ *
+ * @return Number of sectors erased
+ */
+int mesh_flash_log_engine_compact(mesh_flash_log_engine_t *engine);
+
+/**
+ * @brief Sequence number of the oldest record still stored
+ */
+uint32_t mesh_flash_log_engine_first_seq(const mesh_flash_log_engine_t *engine);
+
+#endif /* __MESH_FLASH_LOG_ENGINE_H__ */
@@ -0,0 +1,81 @@
+/* ESP-MESH Healing Benchmark
+ *
+ * Measures how long the nodes below a relay need to deliver to the root
+ * again after the relay fails (see mesh_heal_engine.h). A run:
+ *
+ * 1. The root looks up the relay's descendants in the topology map and
+ *    broadcasts an arm message; from then on every node sends a small
+ *    probe with mesh_send_to_root() every probe interval while it has a
+ *    parent.
+ * 2. MESH_HEAL_ARM_MS later the root tells the relay to stop its mesh
+ *    stack for off_ms, or the relay is powered off by hand when off_ms is
+ *    0.
+ * 3. The root times the probes of the orphans as they come back and
+ *    reports the slowest and median heal time.
+ *
+ * Comparing runs with mesh_set_parent_cache_enabled() on and off gives
+ * the gain of the cached-channel scan. Every node must run
+ * mesh_heal_init(); the root also needs the topology map
+ * (mesh_topology_init()). Nodes act on arm and stop messages only from
+ * the current root.
+ */
+
+#ifndef __MESH_HEAL_H__
+#define __MESH_HEAL_H__
+
+#include "esp_err.h"
+#include "mesh_heal_engine.h"
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_HEAL_DEFAULT_PROBE_MS (250)
+#define MESH_HEAL_MIN_PROBE_MS (100) /* probe intervals armed are clamped */
+#define MESH_HEAL_MAX_PROBE_MS (60000)
+#define MESH_HEAL_ARM_MS (3000) /* probes before the relay is stopped */
+#define MESH_HEAL_TASK_STACK_SIZE (3072)
+#define MESH_HEAL_TASK_PRIORITY (2)
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Register the benchmark handler and start the probe task
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_STATE: Already initialized
+ *    - ESP_ERR_NO_MEM: Out of memory
+ */
+esp_err_t mesh_heal_init(void);
+
+/**
+ * @brief Start a run against one relay (root only)
+ *
+ * @param relay Station MAC of the relay
+ * @param off_ms Time the relay stays off, 0 to power it off by hand
+ * @param duration_ms Time the nodes keep probing
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: NULL relay or zero duration
+ *    - ESP_ERR_INVALID_STATE: Not initialized or no topology map
+ *    - ESP_ERR_NOT_FOUND: Relay not in the map
+ *    - ESP_FAIL: Not the root, or the arm message could not be sent
+ */
+esp_err_t mesh_heal_bench_start(const uint8_t *relay, uint32_t off_ms,
+                                uint32_t duration_ms);
+
+/**
+ * @brief Get the outcome of the current or last run (root only)
+ *
+ * result->healed equal to result->orphans means the run is complete.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if result is NULL,
+ *         ESP_ERR_INVALID_STATE if no run was started
+ */
+esp_err_t mesh_heal_bench_get(mesh_heal_result_t *result);
+
+#endif /* __MESH_HEAL_H__ */
@@ -0,0 +1,98 @@
+/* Healing Benchmark Engine
+ *
+ * Measures how long a mesh takes to recover from the loss of one relay.
+ * During a run every node sends a probe towards the root at a fixed
+ * interval, and the root feeds their arrivals to the engine:
+ *
+ * - The outage starts with the last probe of the relay before it fell
+ *   silent for gap_ms.
+ * - An orphan, any node that was below the relay when the run started,
+ *   has healed when its first probe after a silence of gap_ms arrives.
+ *
+ * The heal time of an orphan is the time between the two. It covers both
+ * nodes that had to find another parent and nodes whose ancestor did so
+ * for them. The engine has no WiFi dependencies so simulated runs can be
+ * replayed on a host.
+ */
+
+#ifndef __MESH_HEAL_ENGINE_H__
+#define __MESH_HEAL_ENGINE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_HEAL_MAX_ORPHANS (32)
+#define MESH_HEAL_GAP_PROBES (3) /* probes missed that count as silence */
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief Probe arrivals of one node
+ */
+typedef struct {
+  uint8_t mac[6];        /**< Station MAC */
+  bool resumed;          /**< A probe arrived after a silence */
+  uint32_t last_ms;      /**< Latest arrival, run start before the first */
+  uint32_t gap_start_ms; /**< Last arrival before the silence */
+  uint32_t resume_ms;    /**< First arrival after the silence */
+} mesh_heal_node_t;
+
+/**
+ * @brief One benchmark run
+ */
+typedef struct {
+  mesh_heal_node_t relay;
+  mesh_heal_node_t orphans[MESH_HEAL_MAX_ORPHANS];
+  uint16_t orphan_count;
+  uint32_t gap_ms; /**< Silence that marks a lost node */
+} mesh_heal_bench_t;
+
+/**
+ * @brief Outcome of a run so far
+ */
+typedef struct {
+  bool outage_seen;   /**< The relay has fallen silent */
+  uint16_t orphans;   /**< Nodes below the relay at the start */
+  uint16_t healed;    /**< Orphans delivering again */
+  uint32_t max_ms;    /**< Slowest heal, every orphan healed if complete */
+  uint32_t median_ms; /**< Median heal of the healed orphans */
+} mesh_heal_result_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Start a run
+ *
+ * @param bench Run state
+ * @param relay Station MAC of the relay that will fail
+ * @param orphans Station MACs of the nodes below it
+ * @param count Number of orphans, at most MESH_HEAL_MAX_ORPHANS are kept
+ * @param probe_ms Probe interval
+ * @param now_ms Current time
+ */
+void mesh_heal_bench_init(mesh_heal_bench_t *bench, const uint8_t *relay,
+                          const uint8_t (*orphans)[6], int count,
+                          uint32_t probe_ms, uint32_t now_ms);
+
+/**
+ * @brief Record a probe arrival
+ *
+ * Probes of nodes that are not part of the run are ignored.
+ */
+void mesh_heal_bench_arrival(mesh_heal_bench_t *bench, const uint8_t *mac,
+                             uint32_t now_ms);
+
+/**
+ * @brief Compute the outcome of the run so far
+ */
+void mesh_heal_bench_result(const mesh_heal_bench_t *bench, uint32_t now_ms,
+                            mesh_heal_result_t *result);
+
+#endif /* __MESH_HEAL_ENGINE_H__ */
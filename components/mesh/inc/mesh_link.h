@@ -0,0 +1,91 @@
+/* ESP-MESH Link Quality Estimator
+ *
+ * Tracks the quality of every direct link of a node, to its parent and to
+ * each child, from the RSSI the WiFi driver reports and the outcome of
+ * every esp_mesh_send() the component makes (see mesh_link_engine.h).
+ * Sends are counted against the parent when they go upwards and against a
+ * child when it is the destination; sends to deeper nodes are not, since
+ * the stack picks their next hop.
+ *
+ * The estimates are used by:
+ *
+ * - parent selection, which scores a former parent by the ETX seen on it,
+ * - the topology reports, which carry the ETX of the link to the parent
+ *   to the root,
+ * - mesh_link_get() and mesh_link_list() for diagnostics.
+ */
+
+#ifndef __MESH_LINK_H__
+#define __MESH_LINK_H__
+
+#include "esp_err.h"
+#include "mesh_link_engine.h"
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_LINK_DEFAULT_SAMPLE_MS (2000)
+#define MESH_LINK_TASK_STACK_SIZE (2560)
+#define MESH_LINK_TASK_PRIORITY (2)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief Link estimator configuration
+ */
+typedef struct {
+  uint32_t sample_ms; /**< RSSI sampling interval, 0 = default */
+} mesh_link_config_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Start the link estimator
+ *
+ * @param config Configuration, NULL for the defaults
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_STATE: Already initialized
+ *    - ESP_ERR_NO_MEM: Out of memory
+ */
+esp_err_t mesh_link_init(const mesh_link_config_t *config);
+
+/**
+ * @brief Get the estimate of the link to a neighbour
+ *
+ * @param mac Station MAC of the neighbour
+ * @param estimate Output
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: NULL argument
+ *    - ESP_ERR_INVALID_STATE: Not initialized
+ *    - ESP_ERR_NOT_FOUND: No link to mac
+ */
+esp_err_t mesh_link_get(const uint8_t *mac, mesh_link_estimate_t *estimate);
+
+/**
+ * @brief Get the estimate of the link to the current parent
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if there is no parent link,
+ *         ESP_ERR_INVALID_STATE if not initialized
+ */
+esp_err_t mesh_link_get_parent(mesh_link_estimate_t *estimate);
+
+/**
+ * @brief List the estimates of all links, current neighbours first
+ *
+ * @param estimates Array to fill
+ * @param max Size of estimates
+ *
+ * @return Number of estimates written
+ */
+int mesh_link_list(mesh_link_estimate_t *estimates, int max);
+
+#endif /* __MESH_LINK_H__ */
@@ -0,0 +1,147 @@
+/* Link Quality Estimator Engine
+ *
+ * Keeps an estimate of every direct mesh link of a node, its parent and
+ * its children, in a fixed table keyed by station MAC:
+ *
+ * - an EWMA of the RSSI sampled from the WiFi driver,
+ * - an EWMA of the delivery ratio of sends handed to the link, from which
+ *   the expected transmission count (ETX) follows,
+ * - send, failure and retry counters, where a retry is a send made while
+ *   the previous send on the link failed.
+ *
+ * Both averages start as plain means and settle to their EWMA weight, so
+ * a new link is usable after a few samples. Links that are no longer a
+ * parent or child keep their history until the slot is needed. The
+ * engine has no WiFi dependencies so it can be run on a host.
+ */
+
+#ifndef __MESH_LINK_ENGINE_H__
+#define __MESH_LINK_ENGINE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_LINK_TABLE_SIZE (16)
+#define MESH_LINK_RSSI_WEIGHT (8)      /* EWMA over about 8 samples */
+#define MESH_LINK_DELIVERY_WEIGHT (16) /* EWMA over about 16 sends */
+#define MESH_LINK_MIN_SENDS (8)        /* before an ETX is given */
+#define MESH_LINK_DELIVERY_ONE (4096)  /* delivery ratio 1.0 */
+#define MESH_LINK_ETX_UNKNOWN (0)
+#define MESH_LINK_ETX_MAX (255) /* tenths, a link that delivers nothing */
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief What a link is to this node
+ */
+typedef enum {
+  MESH_LINK_ROLE_NONE = 0,   /**< History of a former neighbour */
+  MESH_LINK_ROLE_PARENT = 1, /**< Current parent */
+  MESH_LINK_ROLE_CHILD = 2,  /**< Directly associated child */
+} mesh_link_role_t;
+
+/**
+ * @brief One link of the table
+ */
+typedef struct {
+  uint8_t mac[6];        /**< Station MAC of the neighbour */
+  uint8_t role;          /**< mesh_link_role_t */
+  bool used;             /**< Slot holds a link */
+  int16_t rssi_x16;      /**< RSSI average, dBm * 16 */
+  uint16_t rssi_samples; /**< Saturating */
+  uint16_t delivery;     /**< Delivery average, MESH_LINK_DELIVERY_ONE = 1 */
+  bool last_failed;      /**< The previous send failed */
+  uint32_t sent;         /**< Sends handed to the link */
+  uint32_t failed;       /**< Sends the stack refused */
+  uint32_t retries;      /**< Sends made after a failed one */
+  uint32_t last_ms;      /**< Time of the last sample or send */
+} mesh_link_entry_t;
+
+/**
+ * @brief Link table
+ */
+typedef struct {
+  mesh_link_entry_t links[MESH_LINK_TABLE_SIZE];
+} mesh_link_engine_t;
+
+/**
+ * @brief Estimate of one link
+ */
+typedef struct {
+  uint8_t mac[6];             /**< Station MAC of the neighbour */
+  mesh_link_role_t role;      /**< What the link is to this node */
+  int8_t rssi;                /**< RSSI average, 0 if never sampled */
+  uint8_t etx;                /**< Tenths, MESH_LINK_ETX_UNKNOWN if few */
+  uint16_t delivery_permille; /**< Delivery ratio average */
+  uint32_t sent;              /**< Sends handed to the link */
+  uint32_t failed;            /**< Sends the stack refused */
+  uint32_t retries;           /**< Sends made after a failed one */
+  uint32_t age_ms;            /**< Time since the last sample or send */
+} mesh_link_estimate_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Initialize an empty table
+ */
+void mesh_link_engine_init(mesh_link_engine_t *engine);
+
+/**
+ * @brief Mark every link as a former neighbour
+ *
+ * Called before a round of mesh_link_engine_sample() calls that set the
+ * current roles again.
+ */
+void mesh_link_engine_clear_roles(mesh_link_engine_t *engine);
+
+/**
+ * @brief Record an RSSI sample of a neighbour, adding it if new
+ *
+ * A new link replaces the former neighbour seen longest ago.
+ *
+ * @return Link index, or -1 if every slot holds a current neighbour
+ */
+int mesh_link_engine_sample(mesh_link_engine_t *engine, const uint8_t *mac,
+                            mesh_link_role_t role, int8_t rssi,
+                            uint32_t now_ms);
+
+/**
+ * @brief Record the outcome of a send
+ *
+ * @param engine Link table
+ * @param index Link index
+ * @param ok true if the stack accepted the send
+ * @param now_ms Current time
+ */
+void mesh_link_engine_send(mesh_link_engine_t *engine, int index, bool ok,
+                           uint32_t now_ms);
+
+/**
+ * @brief Find a link
+ *
+ * @return Link index, or -1 if unknown
+ */
+int mesh_link_engine_find(const mesh_link_engine_t *engine, const uint8_t *mac);
+
+/**
+ * @brief Find the link to the current parent
+ *
+ * @return Link index, or -1 if none
+ */
+int mesh_link_engine_parent(const mesh_link_engine_t *engine);
+
+/**
+ * @brief Read the estimate of a link
+ */
+void mesh_link_engine_estimate(const mesh_link_engine_t *engine, int index,
+                               uint32_t now_ms,
+                               mesh_link_estimate_t *estimate);
+
+#endif /* __MESH_LINK_ENGINE_H__ */
@@ -0,0 +1,139 @@
+/* ESP-MESH Firmware Distribution (Mesh OTA)
+ *
+ * The root splits a firmware image into chunks and multicasts them down the
+ * tree. Every target writes chunks straight into its next OTA partition as
+ * they arrive, tracks missing chunks in a bitmap and asks only for those in
+ * the following retransmission round. Progress is persisted in NVS so a
+ * transfer resumes after a reboot.
+ */
+
+#ifndef __MESH_OTA_H__
+#define __MESH_OTA_H__
+
+#include "esp_err.h"
+#include "esp_mesh.h"
+#include "esp_partition.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_OTA_CHUNK_SIZE (1024)
+#define MESH_OTA_MAX_TARGETS (64) /* addresses per multicast packet */
+#define MESH_OTA_MAX_NACK_RANGES (32)
+#define MESH_OTA_DEFAULT_ROUNDS (8)
+#define MESH_OTA_STATUS_WINDOW_MS (3000)
+#define MESH_OTA_TASK_STACK_SIZE (4096)
+#define MESH_OTA_TASK_PRIORITY (4)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief Callback used by the root to read image data
+ *
+ * @param ctx User context from mesh_ota_config_t
+ * @param offset Byte offset in the image
+ * @param buf Destination buffer
+ * @param length Number of bytes to read
+ *
+ * @return ESP_OK on success, error code otherwise
+ */
+typedef esp_err_t (*mesh_ota_read_cb_t)(void *ctx, uint32_t offset,
+                                        uint8_t *buf, uint16_t length);
+
+/**
+ * @brief Parameters of a distribution started by the root
+ */
+typedef struct {
+  uint32_t image_id;          /**< Identifies the image, must change per build */
+  uint32_t image_size;        /**< Image size in bytes */
+  mesh_ota_read_cb_t read;    /**< Image source */
+  void *ctx;                  /**< Passed to read() */
+  const mesh_addr_t *targets; /**< Target nodes, NULL for the routing table */
+  int target_count;           /**< Number of entries in targets */
+  uint16_t chunk_interval_ms; /**< Pacing between chunks, 0 = queue-paced */
+  uint8_t max_rounds;         /**< Retransmission rounds, 0 = default */
+  bool reboot;                /**< Targets reboot into the image when done */
+} mesh_ota_config_t;
+
+/**
+ * @brief Transfer state
+ */
+typedef enum {
+  MESH_OTA_STATE_IDLE = 0,  /**< No transfer */
+  MESH_OTA_STATE_RECEIVING, /**< Node: receiving chunks */
+  MESH_OTA_STATE_VERIFIED,  /**< Node: image complete, waiting for commit */
+  MESH_OTA_STATE_SENDING,   /**< Root: distribution in progress */
+  MESH_OTA_STATE_DONE,      /**< Root: all targets verified and committed */
+  MESH_OTA_STATE_FAILED     /**< Transfer aborted */
+} mesh_ota_state_t;
+
+/**
+ * @brief Progress snapshot
+ */
+typedef struct {
+  mesh_ota_state_t state; /**< Current state */
+  uint32_t image_id;      /**< Image being transferred */
+  uint16_t chunk_count;   /**< Chunks in the image */
+  uint16_t chunks_missing; /**< Node: chunks still missing */
+  uint8_t round;          /**< Root: current retransmission round */
+  uint16_t target_count;  /**< Root: number of targets */
+  uint16_t targets_done;  /**< Root: targets reporting a verified image */
+} mesh_ota_status_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Initialize mesh OTA on this node
+ *
+ * Registers the OTA protocol handler and loads any transfer saved before the
+ * last reboot. Call after nvs_flash_init() and mesh_data_transfer_init().
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_STATE: Already initialized
+ *    - ESP_ERR_NO_MEM: Out of memory
+ */
+esp_err_t mesh_ota_init(void);
+
+/**
+ * @brief Start distributing an image from the root
+ *
+ * Runs in a background task: one pipelined pass over all chunks followed by
+ * retransmission rounds driven by the targets' missing-chunk reports, then a
+ * commit once every target has verified the image. Without a target list
+ * the chunks go to a mesh group every node joins in mesh_ota_init(), and
+ * the root tracks every node of its routing table.
+ *
+ * @param config Distribution parameters
+ *
+ * @return
+ *    - ESP_OK: Distribution started
+ *    - ESP_ERR_INVALID_ARG: Invalid configuration
+ *    - ESP_ERR_NO_MEM: No memory for the target table
+ *    - ESP_ERR_INVALID_STATE: Not initialized or a distribution is running
+ *    - ESP_FAIL: Not a root node
+ */
+esp_err_t mesh_ota_start(const mesh_ota_config_t *config);
+
+/**
+ * @brief Get the current transfer progress
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if status is NULL
+ */
+esp_err_t mesh_ota_get_status(mesh_ota_status_t *status);
+
+/**
+ * @brief mesh_ota_read_cb_t reading from a flash partition
+ *
+ * Pass the partition (for example the root's running partition) as ctx.
+ */
+esp_err_t mesh_ota_partition_read(void *ctx, uint32_t offset, uint8_t *buf,
+                                  uint16_t length);
+
+#endif /* __MESH_OTA_H__ */
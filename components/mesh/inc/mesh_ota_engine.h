@@ -0,0 +1,150 @@
+/* Mesh OTA Chunk Engine
+ *
+ * Tracks which chunks of a firmware image have been written to the target
+ * partition. The engine only talks to storage through mesh_ota_storage_t,
+ * so it can run against the OTA partition on the device or against an
+ * in-memory buffer on a host.
+ */
+
+#ifndef __MESH_OTA_ENGINE_H__
+#define __MESH_OTA_ENGINE_H__
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_OTA_SECTOR_SIZE (4096)
+#define MESH_OTA_MAX_CHUNKS (2048)
+#define MESH_OTA_BITMAP_BYTES (MESH_OTA_MAX_CHUNKS / 8)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief Storage backend used by the engine
+ *
+ * Offsets are relative to the start of the image. erase() is only called
+ * with sector-aligned ranges.
+ */
+typedef struct {
+  esp_err_t (*erase)(void *ctx, uint32_t offset, uint32_t size);
+  esp_err_t (*write)(void *ctx, uint32_t offset, const void *data,
+                     uint32_t size);
+  void *ctx; /**< Passed back to every callback */
+} mesh_ota_storage_t;
+
+/**
+ * @brief Transfer state that must survive a reboot to resume a transfer
+ */
+typedef struct {
+  uint32_t image_id;                     /**< Identifies the image */
+  uint32_t image_size;                   /**< Image size in bytes */
+  uint32_t image_crc;                    /**< CRC32 of the whole image */
+  uint16_t chunk_size;                   /**< Bytes per chunk */
+  uint16_t chunk_count;                  /**< Number of chunks */
+  uint8_t bitmap[MESH_OTA_BITMAP_BYTES]; /**< Bit set = chunk written */
+} __attribute__((packed)) mesh_ota_engine_state_t;
+
+/**
+ * @brief Chunk engine instance
+ */
+typedef struct {
+  mesh_ota_engine_state_t state; /**< Persistable transfer state */
+  mesh_ota_storage_t storage;    /**< Storage backend */
+  uint16_t received;             /**< Number of bits set in the bitmap */
+  bool active;                   /**< A transfer has been started */
+} mesh_ota_engine_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Start a new transfer, discarding any previous progress
+ *
+ * @param engine Engine instance
+ * @param storage Storage backend
+ * @param image_id Image identifier chosen by the sender
+ * @param image_size Image size in bytes
+ * @param image_crc CRC32 of the whole image
+ * @param chunk_size Bytes per chunk, a power of two that divides
+ *                   MESH_OTA_SECTOR_SIZE
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: Invalid chunk size or NULL pointers
+ *    - ESP_ERR_INVALID_SIZE: Image needs more than MESH_OTA_MAX_CHUNKS
+ */
+esp_err_t mesh_ota_engine_begin(mesh_ota_engine_t *engine,
+                                const mesh_ota_storage_t *storage,
+                                uint32_t image_id, uint32_t image_size,
+                                uint32_t image_crc, uint16_t chunk_size);
+
+/**
+ * @brief Resume a transfer from previously saved state
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: NULL pointers or inconsistent state
+ */
+esp_err_t mesh_ota_engine_resume(mesh_ota_engine_t *engine,
+                                 const mesh_ota_storage_t *storage,
+                                 const mesh_ota_engine_state_t *state);
+
+/**
+ * @brief Write one chunk to storage and mark it received
+ *
+ * Chunks may arrive in any order and more than once. The sector holding a
+ * chunk is erased the first time any chunk of that sector arrives.
+ *
+ * @param engine Engine instance
+ * @param index Chunk index
+ * @param data Chunk data
+ * @param length Chunk length; must equal chunk_size except for the last chunk
+ *
+ * @return
+ *    - ESP_OK: Chunk written or already present
+ *    - ESP_ERR_INVALID_STATE: No transfer active
+ *    - ESP_ERR_INVALID_ARG: Index or length out of range
+ *    - Other: Error returned by the storage backend
+ */
+esp_err_t mesh_ota_engine_write_chunk(mesh_ota_engine_t *engine,
+                                      uint16_t index, const uint8_t *data,
+                                      uint16_t length);
+
+/**
+ * @brief Check whether a chunk has been received
+ */
+bool mesh_ota_engine_has_chunk(const mesh_ota_engine_t *engine,
+                               uint16_t index);
+
+/**
+ * @brief Number of chunks still missing
+ */
+uint16_t mesh_ota_engine_missing_count(const mesh_ota_engine_t *engine);
+
+/**
+ * @brief Find the next run of missing chunks at or after start
+ *
+ * @param engine Engine instance
+ * @param start First chunk index to consider
+ * @param first Set to the first missing chunk of the run
+ * @param count Set to the length of the run
+ *
+ * @return true if a run was found, false if no chunk is missing past start
+ */
+bool mesh_ota_engine_next_missing(const mesh_ota_engine_t *engine,
+                                  uint16_t start, uint16_t *first,
+                                  uint16_t *count);
+
+/**
+ * @brief Byte length of a given chunk (the last one may be short)
+ */
+uint16_t mesh_ota_engine_chunk_length(const mesh_ota_engine_t *engine,
+                                      uint16_t index);
+
+#endif /* __MESH_OTA_ENGINE_H__ */
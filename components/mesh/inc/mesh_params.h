@@ -0,0 +1,161 @@
+/* ESP-MESH Runtime Stack Parameters
+ *
+ * The maximum layer, mesh softAP connections, TX flow control window
+ * (xon_qsize), mesh capacity and child association expiry are taken from
+ * NVS when the mesh stack starts, falling back to Kconfig and the
+ * ESP-MESH defaults. They can be changed at runtime on one node or pushed
+ * by the root to the whole mesh over MESH_DATA_TYPE_CONFIG, without
+ * reflashing.
+ *
+ * The association expiry takes effect at once. The other parameters are
+ * only read by the stack when it starts, so a change is either kept for
+ * the next start or applied by restarting the mesh stack, which drops the
+ * node's parent and children for one rejoin.
+ *
+ * An optional controller (see mesh_params_engine.h) adjusts the
+ * parameters within safe bounds: each node its own xon_qsize, and the root
+ * the mesh-wide ones, which it pushes to every node.
+ */
+
+#ifndef __MESH_PARAMS_H__
+#define __MESH_PARAMS_H__
+
+#include "esp_err.h"
+#include "esp_mesh.h"
+#include "mesh_params_engine.h"
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_PARAMS_NVS_NAMESPACE "mesh_params"
+#define MESH_PARAMS_NVS_KEY "params"
+#define MESH_PARAMS_RESTART_DELAY_MS (2000) /* push reaches the leaves */
+#define MESH_PARAMS_SAMPLE_MS (1000)        /* TX queue depth sampling */
+#define MESH_PARAMS_TASK_STACK_SIZE (3072)
+#define MESH_PARAMS_TASK_PRIORITY (2)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief When a change of a start-time parameter takes effect
+ */
+typedef enum {
+  MESH_PARAMS_APPLY_NEXT_START = 0, /**< Saved, used from the next start */
+  MESH_PARAMS_APPLY_RESTART = 1,    /**< Saved, mesh stack restarted now */
+} mesh_params_apply_t;
+
+/**
+ * @brief Controller settings
+ */
+typedef struct {
+  mesh_params_controller_config_t control; /**< Thresholds, see engine */
+  mesh_params_apply_t apply;               /**< How changes are applied */
+} mesh_params_controller_settings_t;
+
+/**
+ * @brief Parameter counters
+ */
+typedef struct {
+  uint32_t changes;          /**< Parameters set on this node */
+  uint32_t restarts;         /**< Mesh stack restarts for a change */
+  uint32_t pushes_sent;      /**< Root: parameter sets pushed */
+  uint32_t pushes_received;  /**< Parameter sets received from the root */
+  uint32_t pushes_rejected;  /**< Out of bounds */
+  uint32_t controller_steps; /**< Changes made by the controller */
+  uint16_t queue_peak;       /**< Deepest TX queue in the last period */
+} mesh_params_stats_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Accept parameter sets pushed by the root
+ *
+ * Every node that should follow pushed parameters calls this; the saved
+ * parameters are used by mesh_init() either way.
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_STATE: Already initialized
+ *    - ESP_ERR_NO_MEM: Out of memory
+ */
+esp_err_t mesh_params_init(void);
+
+/**
+ * @brief Get the parameters
+ *
+ * @param active Output, parameters the running stack uses, may be NULL
+ * @param saved Output, parameters the next start will use, may be NULL
+ *
+ * @return ESP_OK
+ */
+esp_err_t mesh_params_get(mesh_params_t *active, mesh_params_t *saved);
+
+/**
+ * @brief Get the Kconfig and ESP-MESH defaults
+ */
+void mesh_params_default(mesh_params_t *params);
+
+/**
+ * @brief Change the parameters of this node
+ *
+ * The parameters are saved to NVS; the association expiry is applied at
+ * once and the rest as selected by apply.
+ *
+ * @param params New parameters
+ * @param apply When the start-time parameters take effect
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: NULL or out of bounds
+ *    - Other: NVS error, nothing changed
+ */
+esp_err_t mesh_params_set(const mesh_params_t *params,
+                          mesh_params_apply_t apply);
+
+/**
+ * @brief Push parameters from the root
+ *
+ * With a NULL node the root also applies them itself. A mesh stack restart
+ * is delayed by MESH_PARAMS_RESTART_DELAY_MS so that the push reaches the
+ * deepest nodes before their parents restart.
+ *
+ * @param node Node address, NULL for all nodes
+ * @param params New parameters
+ * @param apply When the start-time parameters take effect
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: NULL params or out of bounds
+ *    - ESP_FAIL: Not root
+ *    - Other: Send error
+ */
+esp_err_t mesh_params_push(const mesh_addr_t *node, const mesh_params_t *params,
+                           mesh_params_apply_t apply);
+
+/**
+ * @brief Start the adaptive controller
+ *
+ * @param settings Settings, NULL for the defaults
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: period shorter than MESH_PARAMS_SAMPLE_MS
+ *    - ESP_ERR_INVALID_STATE: Not initialized, or already started
+ *    - ESP_ERR_NO_MEM: Out of memory
+ */
+esp_err_t
+mesh_params_controller_start(const mesh_params_controller_settings_t *settings);
+
+/**
+ * @brief Get parameter counters
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t mesh_params_get_stats(mesh_params_stats_t *stats);
+
+#endif /* __MESH_PARAMS_H__ */
@@ -0,0 +1,164 @@
+/* Mesh Stack Parameter Controller Engine
+ *
+ * Decides when a mesh stack parameter should move, from what a node sees
+ * over one control period: its TX queue depth and send failures, and on
+ * the root the layer and association figures of the topology map.
+ *
+ * - xon_qsize grows when sends fail while the queue runs near full, and
+ *   shrinks back towards the stack default when it stays mostly empty.
+ * - max_layer grows when many nodes sit on the last allowed layer, where
+ *   they cannot take children.
+ * - ap_connections grows when most relays have every slot taken.
+ * - capacity_num grows when the mesh nears it.
+ *
+ * Only xon_qsize ever shrinks: lowering the others would disconnect nodes.
+ * A change needs confirm_periods consecutive periods of pressure, moves
+ * one parameter by one step, and starts a cooldown for every parameter.
+ * The engine has no WiFi dependencies so it can be run on a host.
+ */
+
+#ifndef __MESH_PARAMS_ENGINE_H__
+#define __MESH_PARAMS_ENGINE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+
+/* Bounds for set values */
+#define MESH_PARAMS_MAX_LAYER_MIN (1)
+#define MESH_PARAMS_MAX_LAYER_MAX (25)
+#define MESH_PARAMS_AP_CONNECTIONS_MIN (1)
+#define MESH_PARAMS_AP_CONNECTIONS_MAX (10)
+#define MESH_PARAMS_XON_QSIZE_MIN (16)
+#define MESH_PARAMS_XON_QSIZE_MAX (128)
+#define MESH_PARAMS_CAPACITY_MIN (16)
+#define MESH_PARAMS_CAPACITY_MAX (1000)
+#define MESH_PARAMS_ASSOC_EXPIRE_MIN_S (10)
+#define MESH_PARAMS_ASSOC_EXPIRE_MAX_S (600)
+
+/* ESP-MESH defaults for the values Kconfig does not set */
+#define MESH_PARAMS_DEFAULT_XON_QSIZE (32)
+#define MESH_PARAMS_DEFAULT_CAPACITY (300)
+#define MESH_PARAMS_DEFAULT_ASSOC_EXPIRE_S (10)
+
+/* The controller grows max_layer no further; deep trees add latency */
+#define MESH_PARAMS_CONTROL_MAX_LAYER (10)
+
+#define MESH_PARAMS_DEFAULT_PERIOD_MS (60000)
+#define MESH_PARAMS_DEFAULT_CONFIRM_PERIODS (3)
+#define MESH_PARAMS_DEFAULT_COOLDOWN_MS (600000)
+#define MESH_PARAMS_DEFAULT_DROP_HIGH (10)     /* per mille of sends */
+#define MESH_PARAMS_DEFAULT_QUEUE_HIGH (75)    /* percent of xon_qsize */
+#define MESH_PARAMS_DEFAULT_QUEUE_LOW (25)     /* percent of xon_qsize */
+#define MESH_PARAMS_DEFAULT_DEEP_LAYER (10)    /* percent of nodes */
+#define MESH_PARAMS_DEFAULT_FULL_RELAYS (50)   /* percent of relays */
+#define MESH_PARAMS_DEFAULT_CAPACITY_HIGH (90) /* percent of capacity_num */
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief Mesh stack parameters
+ */
+typedef struct {
+  uint8_t max_layer;       /**< Deepest layer a node may join at */
+  uint8_t ap_connections;  /**< Mesh children per node */
+  uint16_t xon_qsize;      /**< Per-queue TX flow control window */
+  uint16_t capacity_num;   /**< Nodes the mesh accepts */
+  uint16_t assoc_expire_s; /**< Silent child disassociated after this */
+} mesh_params_t;
+
+/**
+ * @brief Parameters the controller may change
+ */
+typedef enum {
+  MESH_PARAMS_KNOB_NONE = -1,
+  MESH_PARAMS_KNOB_XON_QSIZE = 0, /**< Local to each node */
+  MESH_PARAMS_KNOB_MAX_LAYER,     /**< Mesh-wide, root decides */
+  MESH_PARAMS_KNOB_AP_CONNECTIONS,
+  MESH_PARAMS_KNOB_CAPACITY,
+  MESH_PARAMS_KNOB_COUNT,
+} mesh_params_knob_t;
+
+/**
+ * @brief Controller configuration
+ */
+typedef struct {
+  uint32_t period_ms;            /**< Control period */
+  uint8_t confirm_periods;       /**< Periods of pressure before a change */
+  uint32_t cooldown_ms;          /**< Time after a change before the next */
+  uint16_t drop_high_permille;   /**< Failed sends that count as drops */
+  uint8_t queue_high_percent;    /**< Queue peak that counts as full */
+  uint8_t queue_low_percent;     /**< Queue peak that counts as idle */
+  uint8_t deep_layer_percent;    /**< Nodes on the last layer */
+  uint8_t full_relays_percent;   /**< Relays with every slot taken */
+  uint8_t capacity_high_percent; /**< Nodes of capacity_num */
+} mesh_params_controller_config_t;
+
+/**
+ * @brief What a node saw over one control period
+ */
+typedef struct {
+  uint32_t sent;        /**< Packets handed to the stack */
+  uint32_t dropped;     /**< Sends the stack refused */
+  uint16_t queue_peak;  /**< Deepest TX queue seen */
+  bool have_topology;   /**< Root: the fields below are valid */
+  uint16_t nodes;       /**< Nodes in the map, root included */
+  uint16_t deepest;     /**< Nodes on layer max_layer */
+  uint16_t relays;      /**< Nodes with children, root excluded */
+  uint16_t full_relays; /**< Relays with ap_connections children */
+} mesh_params_sample_t;
+
+/**
+ * @brief Controller state
+ */
+typedef struct {
+  mesh_params_controller_config_t config;
+  int8_t pressure[MESH_PARAMS_KNOB_COUNT]; /**< + periods up, - down */
+  bool changed;                            /**< last_change_ms is valid */
+  uint32_t last_change_ms;
+} mesh_params_controller_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Fill a controller configuration with the defaults
+ */
+void mesh_params_controller_config_default(
+    mesh_params_controller_config_t *config);
+
+/**
+ * @brief Check that every parameter is within the safe bounds
+ */
+bool mesh_params_valid(const mesh_params_t *params);
+
+/**
+ * @brief Initialize a controller
+ */
+void mesh_params_controller_init(mesh_params_controller_t *controller,
+                                 const mesh_params_controller_config_t *config);
+
+/**
+ * @brief Feed one control period
+ *
+ * @param controller Controller
+ * @param sample What the node saw over the period
+ * @param current Parameters in effect
+ * @param now_ms Current time
+ * @param next Output, current with the change applied
+ *
+ * @return Parameter changed, MESH_PARAMS_KNOB_NONE if none
+ */
+mesh_params_knob_t
+mesh_params_controller_step(mesh_params_controller_t *controller,
+                            const mesh_params_sample_t *sample,
+                            const mesh_params_t *current, uint32_t now_ms,
+                            mesh_params_t *next);
+
+#endif /* __MESH_PARAMS_ENGINE_H__ */
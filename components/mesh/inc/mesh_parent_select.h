@@ -0,0 +1,219 @@
+/* Parent Selection Engine
+ *
+ * Scores mesh parent candidates from a scan by signal strength, layer,
+ * association load, layer-2 capacity and the observed history of past
+ * connections to the same parent. A switch away from the previous parent
+ * only happens when another candidate beats it by a hysteresis margin, so
+ * two similar parents do not alternate on every rejoin. A small cache of
+ * recent parents tells a rejoining node which channels to scan first. The
+ * engine has no WiFi dependencies so recorded scan tables can be replayed
+ * on a host.
+ */
+
+#ifndef __MESH_PARENT_SELECT_H__
+#define __MESH_PARENT_SELECT_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_PARENT_HISTORY_SIZE (8)
+#define MESH_PARENT_QUALITY_UNKNOWN (50)
+#define MESH_PARENT_SCORE_REJECT (INT32_MIN)
+
+#define MESH_PARENT_DEFAULT_MIN_RSSI (-80)
+#define MESH_PARENT_DEFAULT_W_RSSI (4)
+#define MESH_PARENT_DEFAULT_W_LAYER (40)
+#define MESH_PARENT_DEFAULT_W_LOAD (1)
+#define MESH_PARENT_DEFAULT_W_LAYER2 (2)
+#define MESH_PARENT_DEFAULT_W_HISTORY (1)
+#define MESH_PARENT_DEFAULT_W_ETX (3)
+#define MESH_PARENT_DEFAULT_HYSTERESIS (20)
+#define MESH_PARENT_STABLE_LINK_MS (60000)
+
+#define MESH_PARENT_CACHE_SIZE (4)
+#define MESH_PARENT_CACHE_MAX_AGE_S (3600)
+#define MESH_PARENT_CACHE_MAGIC (0x50434348) /* "PCCH" */
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief One parent candidate from a scan
+ */
+typedef struct {
+  uint8_t bssid[6];    /**< Candidate softAP BSSID */
+  int8_t rssi;         /**< Received signal strength */
+  uint8_t layer;       /**< Candidate's layer */
+  uint8_t layer_cap;   /**< Layers left below the candidate, 0 = full */
+  uint8_t assoc;       /**< Children associated */
+  uint8_t assoc_cap;   /**< Children the candidate accepts */
+  uint16_t layer2_cap; /**< Layer-2 capacity the candidate reports */
+  uint8_t etx;         /**< Link ETX in tenths, 0 if never measured */
+} mesh_parent_candidate_t;
+
+/**
+ * @brief Scoring weights
+ *
+ * score = w_rssi * (rssi - min_rssi) - w_layer * layer
+ *         - w_load * load_percent - w_layer2 * layer2_cap
+ *         + w_history * (quality - MESH_PARENT_QUALITY_UNKNOWN)
+ *         - w_etx * (etx - 10)
+ *
+ * Candidates below min_rssi, without layer capacity or with no free
+ * association slot are rejected.
+ */
+typedef struct {
+  int8_t min_rssi;     /**< Weakest acceptable signal */
+  int16_t w_rssi;      /**< Per dB above min_rssi */
+  int16_t w_layer;     /**< Per layer of depth */
+  int16_t w_load;      /**< Per percent of association slots used */
+  int16_t w_layer2;    /**< Per unit of layer2_cap */
+  int16_t w_history;   /**< Per point of link quality */
+  int16_t w_etx;       /**< Per tenth of measured ETX above 1.0 */
+  uint16_t hysteresis; /**< Score margin needed to leave the last parent */
+} mesh_parent_weights_t;
+
+/**
+ * @brief Observed link quality of one parent
+ */
+typedef struct {
+  uint8_t bssid[6];
+  uint8_t quality;   /**< 0-100, moving average of connection outcomes */
+  uint8_t failures;  /**< Bad outcomes seen, saturating */
+  uint32_t last_use; /**< Engine clock of the last update */
+} mesh_parent_history_t;
+
+/**
+ * @brief Parent selection engine instance
+ */
+typedef struct {
+  mesh_parent_weights_t weights;
+  mesh_parent_history_t history[MESH_PARENT_HISTORY_SIZE];
+  uint32_t clock;
+} mesh_parent_engine_t;
+
+/**
+ * @brief A parent this node was recently connected to
+ */
+typedef struct {
+  uint8_t bssid[6]; /**< Parent BSSID */
+  uint8_t channel;  /**< WiFi channel */
+  uint8_t layer;    /**< Parent's layer, 0 for the router */
+  int8_t rssi;      /**< Signal strength when selected */
+  uint32_t seen_s;  /**< Wall-clock seconds when last connected */
+} mesh_parent_cache_entry_t;
+
+/**
+ * @brief Recent parents, most recent first
+ *
+ * Plain data so it can live in RTC memory and survive resets and deep
+ * sleep; mesh_parent_cache_validate() discards it after a power cycle.
+ */
+typedef struct {
+  uint32_t magic;
+  uint32_t checksum;
+  uint8_t count;
+  mesh_parent_cache_entry_t entries[MESH_PARENT_CACHE_SIZE];
+} mesh_parent_cache_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Fill weights with the defaults
+ */
+void mesh_parent_weights_default(mesh_parent_weights_t *weights);
+
+/**
+ * @brief Initialize an engine with empty history
+ *
+ * @param engine Engine instance
+ * @param weights Weights, NULL for the defaults
+ */
+void mesh_parent_engine_init(mesh_parent_engine_t *engine,
+                             const mesh_parent_weights_t *weights);
+
+/**
+ * @brief Score one candidate
+ *
+ * @return Score, higher is better; MESH_PARENT_SCORE_REJECT if the
+ *         candidate must not be used
+ */
+int32_t mesh_parent_engine_score(const mesh_parent_engine_t *engine,
+                                 const mesh_parent_candidate_t *candidate);
+
+/**
+ * @brief Decide between the best new candidate and the last parent
+ *
+ * @param engine Engine instance
+ * @param best_score Score of the best other candidate
+ * @param current_score Score of the last parent,
+ *                      MESH_PARENT_SCORE_REJECT if it was not seen
+ *
+ * @return true to switch to the best candidate
+ */
+bool mesh_parent_engine_should_switch(const mesh_parent_engine_t *engine,
+                                      int32_t best_score,
+                                      int32_t current_score);
+
+/**
+ * @brief Choose a parent from a scan table
+ *
+ * @param engine Engine instance
+ * @param candidates Scan table
+ * @param count Number of candidates
+ * @param current_bssid Last parent, NULL if none
+ *
+ * @return Index of the chosen candidate, -1 if all were rejected
+ */
+int mesh_parent_engine_select(const mesh_parent_engine_t *engine,
+                              const mesh_parent_candidate_t *candidates,
+                              int count, const uint8_t *current_bssid);
+
+/**
+ * @brief Record the outcome of a connection to a parent
+ *
+ * @param engine Engine instance
+ * @param bssid Parent BSSID
+ * @param good true for a connection that stayed up, false for one that was
+ *             refused or lost early
+ */
+void mesh_parent_engine_record(mesh_parent_engine_t *engine,
+                               const uint8_t *bssid, bool good);
+
+/**
+ * @brief Reset the cache unless it holds intact data
+ *
+ * @return true if the existing contents were kept
+ */
+bool mesh_parent_cache_validate(mesh_parent_cache_t *cache);
+
+/**
+ * @brief Insert or refresh a parent at the front of the cache
+ *
+ * The oldest entry is dropped when the cache is full.
+ */
+void mesh_parent_cache_update(mesh_parent_cache_t *cache,
+                              const mesh_parent_cache_entry_t *entry);
+
+/**
+ * @brief List the channels of fresh cache entries, most recent first
+ *
+ * @param cache Parent cache
+ * @param now_s Current wall-clock seconds
+ * @param max_age_s Entries last seen longer ago are skipped
+ * @param channels Set to the distinct channels
+ * @param max_channels Capacity of channels
+ *
+ * @return Number of channels written
+ */
+int mesh_parent_cache_channels(const mesh_parent_cache_t *cache,
+                               uint32_t now_s, uint32_t max_age_s,
+                               uint8_t *channels, int max_channels);
+
+#endif /* __MESH_PARENT_SELECT_H__ */
@@ -0,0 +1,130 @@
+/* Control Item Piggybacking Engine
+ *
+ * Queues small control items (heartbeats, acknowledgements, version
+ * adverts) per peer so the data transfer layer can attach them to the
+ * next data frame it sends to that peer instead of sending each in a
+ * frame of its own:
+ *
+ * - Attached items are encoded as MESH_DATA_TYPE_BATCH records after the
+ *   payload of the frame, oldest deadline first, as many as fit.
+ * - An item still queued at its deadline is taken out to be sent alone.
+ * - A newer item of the same kind for the same peer replaces the queued
+ *   one and keeps the earlier deadline, so a steady stream of updates
+ *   cannot hold an item back. Items are of the same kind if they have the
+ *   same type and first byte, the op or magic of a message.
+ *
+ * The engine has no WiFi dependencies so it can be run on a host.
+ */
+
+#ifndef __MESH_PIGGYBACK_ENGINE_H__
+#define __MESH_PIGGYBACK_ENGINE_H__
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_PIGGYBACK_MAX_ITEMS (16)
+#define MESH_PIGGYBACK_ITEM_MAX (48) /* bytes of one item */
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief One queued control item
+ */
+typedef struct {
+  uint8_t peer[6];      /**< Station MAC, zero for the root */
+  uint8_t type;         /**< Data type the receiver delivers it as */
+  uint8_t length;       /**< Bytes of data */
+  bool used;            /**< Slot holds an item */
+  uint32_t deadline_ms; /**< Latest time to send it */
+  uint8_t data[MESH_PIGGYBACK_ITEM_MAX];
+} mesh_piggyback_item_t;
+
+/**
+ * @brief Queue of control items for all peers
+ */
+typedef struct {
+  mesh_piggyback_item_t items[MESH_PIGGYBACK_MAX_ITEMS];
+} mesh_piggyback_queue_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Initialize an empty queue
+ */
+void mesh_piggyback_init(mesh_piggyback_queue_t *queue);
+
+/**
+ * @brief Queue an item, replacing a queued one of the same peer and kind
+ *
+ * @param peer Station MAC, zero for the root
+ * @param replaced Set if a queued item was replaced, may be NULL
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_SIZE: Longer than MESH_PIGGYBACK_ITEM_MAX
+ *    - ESP_ERR_NO_MEM: The queue is full
+ */
+esp_err_t mesh_piggyback_put(mesh_piggyback_queue_t *queue,
+                             const uint8_t peer[6], uint8_t type,
+                             const void *data, uint8_t length,
+                             uint32_t deadline_ms, bool *replaced);
+
+/**
+ * @brief Bytes needed to attach every item queued for a peer
+ */
+int mesh_piggyback_pending(const mesh_piggyback_queue_t *queue,
+                           const uint8_t peer[6]);
+
+/**
+ * @brief Encode the items of a peer that fit and take them out
+ *
+ * @param buf Output, batch records
+ * @param size Room in buf
+ * @param count Number of items taken, may be NULL
+ *
+ * @return Bytes written
+ */
+int mesh_piggyback_attach(mesh_piggyback_queue_t *queue,
+                          const uint8_t peer[6], uint8_t *buf, int size,
+                          int *count);
+
+/**
+ * @brief Put back items of a frame that could not be sent
+ *
+ * Items replaced in the meantime stay replaced. The others are due at
+ * now_ms.
+ *
+ * @param buf Records written by mesh_piggyback_attach()
+ * @param length Bytes of buf
+ *
+ * @return Number of items put back
+ */
+int mesh_piggyback_restore(mesh_piggyback_queue_t *queue,
+                           const uint8_t peer[6], const uint8_t *buf,
+                           int length, uint32_t now_ms);
+
+/**
+ * @brief Take out the item with the earliest deadline if it has passed
+ *
+ * @return true if item was filled
+ */
+bool mesh_piggyback_take_due(mesh_piggyback_queue_t *queue, uint32_t now_ms,
+                             mesh_piggyback_item_t *item);
+
+/**
+ * @brief Earliest deadline of the queue
+ *
+ * @return false if the queue is empty
+ */
+bool mesh_piggyback_next_deadline(const mesh_piggyback_queue_t *queue,
+                                  uint32_t *deadline_ms);
+
+#endif /* __MESH_PIGGYBACK_ENGINE_H__ */
@@ -0,0 +1,228 @@
+/* ESP-MESH Event Reactor
+ *
+ * Single event loop for application mesh work. Received packets, send
+ * completions, timer expiries and ESP-MESH state events are posted to one
+ * queue and dispatched to typed handlers from one task, so an application
+ * needs neither a polling task per purpose nor locking between its
+ * handlers. The task sleeps until an event arrives.
+ */
+
+#ifndef __MESH_REACTOR_H__
+#define __MESH_REACTOR_H__
+
+#include "esp_err.h"
+#include "esp_mesh.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_REACTOR_DEFAULT_QUEUE_LENGTH (32)
+#define MESH_REACTOR_MAX_HANDLERS (16)
+#define MESH_REACTOR_RX_POST_TIMEOUT_MS (50)
+#define MESH_REACTOR_TASK_STACK_SIZE (4096)
+#define MESH_REACTOR_TASK_PRIORITY (5)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief Reactor event types
+ */
+typedef enum {
+  MESH_REACTOR_EVENT_RX = 0,  /**< Application packet received */
+  MESH_REACTOR_EVENT_TX_DONE, /**< mesh_reactor_send() completed */
+  MESH_REACTOR_EVENT_TIMER,   /**< Reactor timer expired */
+  MESH_REACTOR_EVENT_MESH,    /**< ESP-MESH state event */
+  MESH_REACTOR_EVENT_USER,    /**< Posted with mesh_reactor_post() */
+  MESH_REACTOR_EVENT_MAX,
+} mesh_reactor_event_type_t;
+
+/**
+ * @brief Reactor timer handle
+ */
+typedef struct mesh_reactor_timer *mesh_reactor_timer_t;
+
+/**
+ * @brief Event passed to reactor handlers
+ *
+ * Only the member matching type is valid. Pointers are valid for the
+ * duration of the handler call.
+ */
+typedef struct {
+  mesh_reactor_event_type_t type;
+  union {
+    struct {
+      mesh_addr_t from;  /**< Sender address */
+      uint8_t data_type; /**< Data type from mesh_data_type_t */
+      uint16_t length;   /**< Payload length */
+      uint8_t *payload;  /**< Payload */
+    } rx;
+    struct {
+      uint32_t id;       /**< ID given to mesh_reactor_send() */
+      esp_err_t err;     /**< Result of the send */
+      mesh_addr_t to;    /**< Destination, unused when to_root is set */
+      bool to_root;      /**< Sent upstream to the root */
+      uint8_t data_type; /**< Data type from mesh_data_type_t */
+    } tx;
+    struct {
+      mesh_reactor_timer_t timer; /**< Timer that expired */
+    } timer;
+    struct {
+      int32_t id;   /**< mesh_event_id_t */
+      int layer;    /**< Layer when the event was posted */
+      bool is_root; /**< Root state when the event was posted */
+    } mesh;
+    struct {
+      uint32_t id; /**< ID given to mesh_reactor_post() */
+      void *arg;   /**< Argument given to mesh_reactor_post() */
+    } user;
+  };
+} mesh_reactor_event_t;
+
+/**
+ * @brief Event handler, runs in the reactor task
+ *
+ * Handlers should not block: every other event waits while one runs.
+ */
+typedef void (*mesh_reactor_handler_t)(const mesh_reactor_event_t *event,
+                                       void *ctx);
+
+/**
+ * @brief Reactor configuration
+ */
+typedef struct {
+  uint16_t queue_length; /**< Events that can wait at once */
+  uint32_t stack_size;   /**< Reactor task stack in bytes */
+  uint8_t priority;      /**< Reactor task priority */
+} mesh_reactor_config_t;
+
+/**
+ * @brief Reactor counters
+ *
+ * Wakeups counts the times the task left its blocking wait; events that
+ * arrive while it runs are drained without another wakeup.
+ */
+typedef struct {
+  uint32_t events[MESH_REACTOR_EVENT_MAX]; /**< Events dispatched per type */
+  uint32_t dropped;          /**< Events lost to a full queue or no memory */
+  uint32_t wakeups;          /**< Times the task woke up */
+  uint32_t handler_max_us;   /**< Longest single dispatch */
+  uint16_t queue_length;     /**< Queue capacity */
+  uint16_t queue_high_water; /**< Most events waiting at once */
+  uint32_t stack_size;       /**< Reactor task stack in bytes */
+  uint32_t stack_free_min;   /**< Lowest free stack seen, bytes */
+} mesh_reactor_stats_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Create the event queue and start the reactor task
+ *
+ * Must be called after the default event loop was created. Once a
+ * MESH_REACTOR_EVENT_RX handler is registered, application packets go to
+ * the reactor instead of the callback set with
+ * mesh_register_receive_callback().
+ *
+ * @param config Configuration, NULL for defaults
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_STATE: Already initialized
+ *    - ESP_ERR_NO_MEM: Out of memory
+ *    - ESP_FAIL: Task creation failed
+ */
+esp_err_t mesh_reactor_init(const mesh_reactor_config_t *config);
+
+/**
+ * @brief Register a handler for an event type
+ *
+ * Several handlers may be registered for the same type; all of them run,
+ * in registration order. Timer events go to the timer's own handler only.
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: Invalid type or NULL handler
+ *    - ESP_ERR_NO_MEM: Handler table full
+ */
+esp_err_t mesh_reactor_register(mesh_reactor_event_type_t type,
+                                mesh_reactor_handler_t handler, void *ctx);
+
+/**
+ * @brief Post a MESH_REACTOR_EVENT_USER event
+ *
+ * @param id Application-defined event ID
+ * @param arg Application-defined argument
+ * @param timeout_ms Time to wait for room in the queue
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_STATE: Not initialized
+ *    - ESP_ERR_TIMEOUT: Queue full
+ */
+esp_err_t mesh_reactor_post(uint32_t id, void *arg, uint32_t timeout_ms);
+
+/**
+ * @brief Send a packet from the reactor task
+ *
+ * The payload is copied and sent with mesh_send_to_root() or
+ * mesh_send_to_child(); the result is reported as a
+ * MESH_REACTOR_EVENT_TX_DONE event carrying id.
+ *
+ * @param to Destination child, NULL for the root
+ * @param data_type Type of data being sent
+ * @param payload Pointer to payload data
+ * @param length Length of payload in bytes
+ * @param id Application-defined ID reported with the completion
+ *
+ * @return
+ *    - ESP_OK: Send queued
+ *    - ESP_ERR_INVALID_ARG: Invalid arguments
+ *    - ESP_ERR_INVALID_STATE: Not initialized
+ *    - ESP_ERR_NO_MEM: Out of memory or queue full
+ */
+esp_err_t mesh_reactor_send(const mesh_addr_t *to, uint8_t data_type,
+                            const uint8_t *payload, uint16_t length,
+                            uint32_t id);
+
+/**
+ * @brief Create a stopped timer whose expiries are dispatched to handler
+ *
+ * An expiry that is still queued when the timer fires again is not queued
+ * twice. Timers cannot be deleted.
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: NULL handler or timer
+ *    - ESP_ERR_NO_MEM: Out of memory
+ */
+esp_err_t mesh_reactor_timer_create(mesh_reactor_handler_t handler, void *ctx,
+                                    mesh_reactor_timer_t *timer);
+
+/**
+ * @brief Start or restart a timer
+ *
+ * @param timer Timer handle
+ * @param timeout_ms Time to the first expiry, and the period if periodic
+ * @param periodic true to repeat every timeout_ms
+ */
+esp_err_t mesh_reactor_timer_start(mesh_reactor_timer_t timer,
+                                   uint32_t timeout_ms, bool periodic);
+
+/**
+ * @brief Stop a timer; an expiry that is already queued is discarded
+ */
+esp_err_t mesh_reactor_timer_stop(mesh_reactor_timer_t timer);
+
+/**
+ * @brief Get reactor counters
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t mesh_reactor_get_stats(mesh_reactor_stats_t *stats);
+
+#endif /* __MESH_REACTOR_H__ */
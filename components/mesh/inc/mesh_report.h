@@ -0,0 +1,134 @@
+/* ESP-MESH Change-of-Value Reporting
+ *
+ * Decides on the node whether a sensor reading is worth sending to the
+ * root. A reading is reported when it moved by at least the channel's
+ * deadband since the last report, but not more often than the minimum
+ * interval; a channel is refreshed after the maximum interval even if it
+ * did not change, and a heartbeat with every channel is sent when the node
+ * has been silent for the heartbeat interval.
+ *
+ * Reports are sent with mesh_send_to_root() as arrays of
+ * mesh_sensor_reading_t, so they combine with aggregation and the root
+ * telemetry table. The root can change thresholds at runtime with
+ * mesh_report_push_config().
+ */
+
+#ifndef __MESH_REPORT_H__
+#define __MESH_REPORT_H__
+
+#include "esp_err.h"
+#include "esp_mesh.h"
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_REPORT_MAX_CHANNELS (8)
+#define MESH_REPORT_ALL_CHANNELS (0xFF)
+#define MESH_REPORT_DEFAULT_MIN_INTERVAL_MS (1000)
+#define MESH_REPORT_DEFAULT_MAX_INTERVAL_MS (300000)
+#define MESH_REPORT_DEFAULT_HEARTBEAT_MS (600000)
+#define MESH_REPORT_TICK_MS (500)
+#define MESH_REPORT_TASK_STACK_SIZE (3072)
+#define MESH_REPORT_TASK_PRIORITY (3)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief Reporting thresholds of one channel
+ */
+typedef struct {
+  float deadband;           /**< Minimum change to report, 0 = any change */
+  uint32_t min_interval_ms; /**< Minimum time between reports */
+  uint32_t max_interval_ms; /**< Refresh even without change, 0 = never */
+} mesh_report_channel_config_t;
+
+/**
+ * @brief Reporting counters
+ */
+typedef struct {
+  uint32_t submitted;  /**< Readings passed to mesh_report_submit() */
+  uint32_t sent;       /**< Readings sent to the root */
+  uint32_t suppressed; /**< Readings not sent */
+  uint32_t packets;    /**< Packets sent to the root */
+  uint32_t heartbeats; /**< Heartbeat packets among them */
+} mesh_report_stats_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Start the reporting engine
+ *
+ * All channels start with deadband 0 and the default intervals.
+ *
+ * @param data_type Data type of the report packets, usually
+ *                  MESH_DATA_TYPE_SENSOR
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_STATE: Already initialized
+ *    - ESP_ERR_NO_MEM: Out of memory
+ *    - ESP_FAIL: Task creation failed
+ */
+esp_err_t mesh_report_init(uint8_t data_type);
+
+/**
+ * @brief Set the thresholds of a channel
+ *
+ * @param channel Channel, or MESH_REPORT_ALL_CHANNELS
+ * @param config Thresholds
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on invalid arguments
+ */
+esp_err_t mesh_report_set_channel(uint8_t channel,
+                                  const mesh_report_channel_config_t *config);
+
+/**
+ * @brief Set the heartbeat interval, 0 to disable heartbeats
+ */
+esp_err_t mesh_report_set_heartbeat(uint32_t heartbeat_ms);
+
+/**
+ * @brief Offer a new reading; it is sent only if the thresholds say so
+ *
+ * A reading that passes the deadband inside the minimum interval is held
+ * and sent once the interval has elapsed. On the root, or before the node
+ * has started, it is held until the node can report.
+ *
+ * @return
+ *    - ESP_OK: Reading sent, held or suppressed
+ *    - ESP_ERR_INVALID_ARG: Channel out of range
+ *    - ESP_ERR_INVALID_STATE: Not initialized
+ *    - Other: Error returned by mesh_send_to_root()
+ */
+esp_err_t mesh_report_submit(uint8_t channel, float value);
+
+/**
+ * @brief Get reporting counters
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t mesh_report_get_stats(mesh_report_stats_t *stats);
+
+/**
+ * @brief Push thresholds to nodes over MESH_DATA_TYPE_CONFIG (root only)
+ *
+ * @param node Target node, NULL for every node
+ * @param channel Channel, or MESH_REPORT_ALL_CHANNELS
+ * @param config Thresholds
+ * @param heartbeat_ms New heartbeat interval, UINT32_MAX to keep it
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: NULL config, negative or NaN deadband
+ *    - ESP_FAIL: Not root or send failed
+ */
+esp_err_t mesh_report_push_config(const mesh_addr_t *node, uint8_t channel,
+                                  const mesh_report_channel_config_t *config,
+                                  uint32_t heartbeat_ms);
+
+#endif /* __MESH_REPORT_H__ */
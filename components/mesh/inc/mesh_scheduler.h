@@ -0,0 +1,115 @@
+/* ESP-MESH Job Scheduler
+ *
+ * Runs one-shot and periodic jobs from a single task, so periodic actions
+ * such as "send config X to node group Y every 30 s" do not each need a
+ * task and a stack. Jobs live in a fixed pool allocated at init and are
+ * kept in a hierarchical timer wheel, so adding, cancelling and expiring a
+ * job costs O(1) regardless of how many jobs exist. The task sleeps until
+ * the next tick that has work instead of waking every tick.
+ */
+
+#ifndef __MESH_SCHEDULER_H__
+#define __MESH_SCHEDULER_H__
+
+#include "esp_err.h"
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_SCHED_TICK_MS (10)
+#define MESH_SCHED_WHEEL_BITS (6)
+#define MESH_SCHED_WHEEL_LEVELS (4) /* 64^4 ticks, about 46 hours */
+#define MESH_SCHED_MAX_JOBS (4096)
+#define MESH_SCHED_INVALID_JOB (0)
+#define MESH_SCHED_TASK_STACK_SIZE (4096)
+#define MESH_SCHED_TASK_PRIORITY (5)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief Job callback, runs in the scheduler task
+ *
+ * May add or cancel jobs, including itself.
+ */
+typedef void (*mesh_sched_cb_t)(void *arg);
+
+/**
+ * @brief Job handle, MESH_SCHED_INVALID_JOB is never returned
+ */
+typedef uint32_t mesh_sched_job_t;
+
+/**
+ * @brief Scheduler counters
+ *
+ * Lag is the delay between the time a job was due and the time its
+ * callback started.
+ */
+typedef struct {
+  uint16_t jobs_active; /**< Jobs currently scheduled */
+  uint16_t jobs_max;    /**< Pool size */
+  uint32_t runs;        /**< Callbacks run */
+  uint32_t lag_max_ms;  /**< Highest lag seen */
+  uint32_t lag_avg_ms;  /**< Mean lag over all runs */
+} mesh_scheduler_stats_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Allocate the job pool and start the scheduler task
+ *
+ * @param max_jobs Pool size, 1 to MESH_SCHED_MAX_JOBS
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: Invalid pool size
+ *    - ESP_ERR_INVALID_STATE: Already initialized
+ *    - ESP_ERR_NO_MEM: Out of memory
+ *    - ESP_FAIL: Task creation failed
+ */
+esp_err_t mesh_scheduler_init(uint16_t max_jobs);
+
+/**
+ * @brief Schedule a job
+ *
+ * The first run happens after delay_ms plus a random share of jitter_ms;
+ * periodic jobs then keep that phase, so jobs created together with the
+ * same period are spread out instead of firing in bursts.
+ *
+ * @param delay_ms Delay before the first run
+ * @param period_ms Period, 0 for a one-shot job
+ * @param jitter_ms Random extra delay of the first run, 0 for none
+ * @param cb Callback
+ * @param arg Passed to cb
+ * @param job Set to the job handle, may be NULL
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: NULL callback
+ *    - ESP_ERR_INVALID_STATE: Not initialized
+ *    - ESP_ERR_NO_MEM: Pool exhausted
+ */
+esp_err_t mesh_scheduler_add(uint32_t delay_ms, uint32_t period_ms,
+                             uint32_t jitter_ms, mesh_sched_cb_t cb, void *arg,
+                             mesh_sched_job_t *job);
+
+/**
+ * @brief Cancel a job
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if the job already finished
+ *         or was cancelled
+ */
+esp_err_t mesh_scheduler_cancel(mesh_sched_job_t job);
+
+/**
+ * @brief Get scheduler counters
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t mesh_scheduler_get_stats(mesh_scheduler_stats_t *stats);
+
+#endif /* __MESH_SCHEDULER_H__ */
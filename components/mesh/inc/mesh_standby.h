@@ -0,0 +1,143 @@
+/* ESP-MESH Hot-Standby Root
+ *
+ * When the root fails, every one of its children loses its parent at
+ * once, scans and elects or finds a new root, and the rest of the tree
+ * follows. A designated standby node shortens this:
+ *
+ * - The standby announces itself to the root, which then sends it a
+ *   heartbeat every heartbeat_ms carrying the versions of the node
+ *   registry and of an application state blob, and the router the root is
+ *   connected to. The standby asks for a copy whenever a version moves.
+ * - When the standby has lost the root as its parent and has heard no
+ *   heartbeat for loss_timeout_ms, it connects to the router itself and
+ *   becomes root with the registry and state already in place.
+ *
+ * The standby's own subtree stays attached through the takeover, and the
+ * old root's other children find a root one scan away, so the number of
+ * nodes that re-parent is the old root's child count minus one.
+ *
+ * Only a standby that is a direct child of the root takes over; a deeper
+ * one keeps mirroring but never tries, since its parent is still there.
+ * A returning fixed root (CONFIG_MESH_SET_ROOT) that finds another root
+ * in its scan does not start a second one; a fast boot skips that scan.
+ * The root serves one standby at a time.
+ *
+ * A standby whose link to a live root is down for longer than
+ * loss_timeout_ms also takes over and leaves two roots, so the timeout
+ * trades blackout time against that risk.
+ */
+
+#ifndef __MESH_STANDBY_H__
+#define __MESH_STANDBY_H__
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_STANDBY_DEFAULT_HEARTBEAT_MS (500)
+#define MESH_STANDBY_DEFAULT_LOSS_TIMEOUT_MS (2000)
+#define MESH_STANDBY_HELLO_HEARTBEATS (8) /* standby re-announces itself */
+#define MESH_STANDBY_SERVE_HELLOS (3)     /* root drops a silent standby */
+#define MESH_STANDBY_MAX_STATE (256)      /* application state bytes */
+#define MESH_STANDBY_TICK_MS (100)
+#define MESH_STANDBY_TASK_STACK_SIZE (3072)
+#define MESH_STANDBY_TASK_PRIORITY (4)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief Called on the standby once it is root and connected to the router
+ */
+typedef void (*mesh_standby_takeover_cb_t)(void);
+
+/**
+ * @brief Standby configuration
+ */
+typedef struct {
+  bool designated;          /**< This node is the standby */
+  uint32_t heartbeat_ms;    /**< Root heartbeat interval, 0 = default */
+  uint32_t loss_timeout_ms; /**< Silence before takeover, 0 = default */
+  /** Called once this node has taken over, may be NULL */
+  mesh_standby_takeover_cb_t on_takeover;
+} mesh_standby_config_t;
+
+/**
+ * @brief Standby counters
+ */
+typedef struct {
+  uint32_t heartbeats_sent;     /**< Root: heartbeats sent */
+  uint32_t syncs_sent;          /**< Root: registry and state copies sent */
+  uint32_t heartbeats_received; /**< Standby: heartbeats received */
+  uint32_t syncs_applied;       /**< Standby: copies applied */
+  uint32_t takeovers;           /**< Standby: takeovers started */
+  uint32_t takeovers_failed;    /**< Standby: router connection failed */
+  uint32_t last_detect_ms;      /**< Last heartbeat to takeover start */
+  uint32_t last_blackout_ms;    /**< Last heartbeat to root connected */
+  bool mirrored;                /**< Standby: registry and state current */
+} mesh_standby_stats_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Enable the standby root protocol
+ *
+ * Every node that may be root must call this so it serves heartbeats;
+ * exactly one node should set designated.
+ *
+ * @param config Configuration, NULL for a non-designated node
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: loss_timeout_ms not above heartbeat_ms
+ *    - ESP_ERR_INVALID_STATE: Already initialized
+ *    - ESP_ERR_NO_MEM: Out of memory
+ */
+esp_err_t mesh_standby_init(const mesh_standby_config_t *config);
+
+/**
+ * @brief Set the application state mirrored to the standby (root only)
+ *
+ * The standby fetches the new state after the next heartbeat.
+ *
+ * @param data State
+ * @param length Length in bytes, at most MESH_STANDBY_MAX_STATE
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: data is NULL or length too large
+ *    - ESP_ERR_INVALID_STATE: Not initialized
+ */
+esp_err_t mesh_standby_set_state(const void *data, uint16_t length);
+
+/**
+ * @brief Copy the mirrored application state
+ *
+ * On the root this is the state last set; on the standby the last copy
+ * received, and after a takeover the state the new root starts from.
+ *
+ * @param data Output buffer
+ * @param length In: buffer size, out: state length
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: NULL argument
+ *    - ESP_ERR_INVALID_SIZE: Buffer too small, length set to the size
+ *    - ESP_ERR_INVALID_STATE: Not initialized
+ */
+esp_err_t mesh_standby_get_state(void *data, uint16_t *length);
+
+/**
+ * @brief Get standby counters
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t mesh_standby_get_stats(mesh_standby_stats_t *stats);
+
+#endif /* __MESH_STANDBY_H__ */
@@ -0,0 +1,89 @@
+/* Standby Takeover Engine
+ *
+ * Decides when the standby takes over as root. The standby task reports
+ * every tick whether the node is connected and to whom, and the engine
+ * answers whether the root counts as lost:
+ *
+ * - The last parent the standby had while connected was the root, so the
+ *   root's loss is what left it without a parent.
+ * - The root's heartbeat has been silent for loss_timeout_ms, and the
+ *   standby knows which router to join.
+ *
+ * A takeover is pending until the node is root and connected, or until it
+ * finds a parent again, which means the router did not take it. The engine
+ * has no WiFi dependencies so failovers can be simulated on a host.
+ */
+
+#ifndef __MESH_STANDBY_ENGINE_H__
+#define __MESH_STANDBY_ENGINE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief Takeover state of the standby
+ */
+typedef struct {
+  uint32_t loss_timeout_ms; /**< Heartbeat silence that marks a lost root */
+  bool parent_was_root;     /**< Last parent while connected was the root */
+  bool taking_over;         /**< A takeover is pending */
+  uint32_t takeover_ms;     /**< Start of the pending takeover */
+} mesh_standby_watch_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Initialize the takeover state
+ */
+void mesh_standby_watch_init(mesh_standby_watch_t *watch,
+                             uint32_t loss_timeout_ms);
+
+/**
+ * @brief The standby is connected to a parent
+ *
+ * @param watch Takeover state
+ * @param parent_is_root The parent is the root the heartbeats come from
+ *
+ * @return true if this ends a takeover that failed
+ */
+bool mesh_standby_watch_connected(mesh_standby_watch_t *watch,
+                                  bool parent_is_root);
+
+/**
+ * @brief Check whether the standby, without a parent, should take over
+ *
+ * A pending takeover is given loss_timeout_ms before it is retried.
+ *
+ * @param watch Takeover state
+ * @param router_valid The root has reported the router it is connected to
+ * @param last_heartbeat_ms Time of the last heartbeat from the root
+ * @param now_ms Current time
+ *
+ * @return true to connect to the router now
+ */
+bool mesh_standby_watch_due(const mesh_standby_watch_t *watch,
+                            bool router_valid, uint32_t last_heartbeat_ms,
+                            uint32_t now_ms);
+
+/**
+ * @brief Record that a takeover has been started
+ *
+ * @return true if it replaces a pending takeover that failed
+ */
+bool mesh_standby_watch_started(mesh_standby_watch_t *watch,
+                                uint32_t now_ms);
+
+/**
+ * @brief The node is root and connected to the router
+ *
+ * @return true if this completes a takeover
+ */
+bool mesh_standby_watch_root(mesh_standby_watch_t *watch);
+
+#endif /* __MESH_STANDBY_ENGINE_H__ */
@@ -0,0 +1,66 @@
+/* ESP-MESH State Snapshot
+ *
+ * Role, layer, parent, root address and root reachability as last reported
+ * by mesh events. The mesh event handler publishes a new snapshot on every
+ * change. Any task or esp_timer callback can read it without sleeping and
+ * without calling into the mesh library, so send paths and application
+ * loops can check the role on every packet.
+ */
+
+#ifndef __MESH_STATE_H__
+#define __MESH_STATE_H__
+
+#include "esp_err.h"
+#include "esp_mesh.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief Mesh state as of one event
+ */
+typedef struct {
+  uint32_t generation; /**< Incremented on every published change */
+  bool started;        /**< Between MESH_EVENT_STARTED and _STOPPED */
+  bool connected;      /**< Parent (router for the root) connected */
+  bool is_root;        /**< This node is the root */
+  bool tods_reachable; /**< The root reported the external network up */
+  int8_t layer;        /**< Layer of this node, -1 before the first */
+  mesh_addr_t parent;  /**< Current or last parent BSSID */
+  mesh_addr_t root;    /**< Root address, zero until announced */
+} mesh_state_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Read a consistent copy of the current state
+ *
+ * Copies the snapshot inside a short critical section; never blocks.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if state is NULL
+ */
+esp_err_t mesh_state_get(mesh_state_t *state);
+
+/**
+ * @brief Whether this node is the root, from the current snapshot
+ */
+bool mesh_state_is_root(void);
+
+/**
+ * @brief Whether the mesh is started, from the current snapshot
+ */
+bool mesh_state_is_started(void);
+
+/**
+ * @brief Generation of the current snapshot
+ *
+ * Compare with an earlier value to tell whether anything changed since.
+ */
+uint32_t mesh_state_generation(void);
+
+#endif /* __MESH_STATE_H__ */
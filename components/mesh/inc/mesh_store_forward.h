@@ -0,0 +1,85 @@
+/* ESP-MESH Store-and-Forward Buffering
+ *
+ * Keeps upstream packets that mesh_send_to_root() cannot deliver while the
+ * node has no parent, and replays them in coalesced MESH_DATA_TYPE_BATCH
+ * bursts once the parent is back, one by one to a root that announced it
+ * does not split batches, and never larger than the root receives. Packets
+ * are held in RAM first and can spill to a flash ring partition when RAM
+ * is full.
+ */
+
+#ifndef __MESH_STORE_FORWARD_H__
+#define __MESH_STORE_FORWARD_H__
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_SF_DEFAULT_RAM_BYTES (8192)
+#define MESH_SF_DEFAULT_BURST_BYTES (1400)
+#define MESH_SF_DEFAULT_BURST_INTERVAL_MS (50)
+#define MESH_SF_DEFAULT_REPLAY_JITTER_MS (3000)
+#define MESH_SF_TASK_STACK_SIZE (3072)
+#define MESH_SF_TASK_PRIORITY (4)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief Store-and-forward configuration
+ */
+typedef struct {
+  size_t ram_bytes;            /**< RAM queue capacity */
+  const char *partition_label; /**< Flash spill partition, NULL = RAM only */
+  uint16_t burst_bytes;        /**< Max payload of one replay burst */
+  uint16_t burst_interval_ms;  /**< Pause between replay bursts */
+  uint16_t replay_jitter_ms;   /**< Random delay before replay starts */
+} mesh_store_forward_config_t;
+
+/**
+ * @brief Store-and-forward counters
+ */
+typedef struct {
+  uint32_t queued;        /**< Packets accepted into the queue */
+  uint32_t replayed;      /**< Packets delivered by replay */
+  uint32_t bursts;        /**< Replay bursts sent */
+  uint32_t dropped;       /**< Packets lost to overflow */
+  uint32_t spilled;       /**< Packets moved from RAM to flash */
+  uint32_t pending;       /**< Packets currently queued */
+  size_t ram_used;        /**< Bytes used in the RAM queue */
+  size_t flash_used;      /**< Bytes used in the flash ring */
+} mesh_store_forward_stats_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Enable store-and-forward for mesh_send_to_root()
+ *
+ * Once enabled, mesh_send_to_root() queues packets instead of failing while
+ * the node is disconnected, and returns ESP_OK for queued packets.
+ *
+ * @param config Configuration, NULL for RAM-only defaults
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_STATE: Already initialized
+ *    - ESP_ERR_NOT_FOUND: Spill partition not found
+ *    - ESP_ERR_NO_MEM: Out of memory
+ *    - ESP_FAIL: Task creation failed
+ */
+esp_err_t mesh_store_forward_init(const mesh_store_forward_config_t *config);
+
+/**
+ * @brief Get store-and-forward counters
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t mesh_store_forward_get_stats(mesh_store_forward_stats_t *stats);
+
+#endif /* __MESH_STORE_FORWARD_H__ */
@@ -0,0 +1,146 @@
+/* Store-and-Forward Queue Engine
+ *
+ * Bounded FIFO of upstream packets. Records are kept back to back in a RAM
+ * ring and the oldest can spill to a flash ring reached through
+ * mesh_sf_backend_t, where records never straddle a sector. A replay takes
+ * the oldest records into one burst of MESH_DATA_TYPE_BATCH records and
+ * only removes them once the caller reports the burst as sent.
+ *
+ * The engine has no WiFi or FreeRTOS dependencies so it can be run on a
+ * host; the caller serializes access.
+ */
+
+#ifndef __MESH_STORE_FORWARD_ENGINE_H__
+#define __MESH_STORE_FORWARD_ENGINE_H__
+
+#include "esp_err.h"
+#include "mesh_store_forward.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_SF_SECTOR_SIZE (4096)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief Flash access used by the engine
+ *
+ * Offsets are relative to the start of the spill area. erase() is only
+ * called with whole, aligned sectors.
+ */
+typedef struct {
+  esp_err_t (*read)(void *ctx, uint32_t offset, void *data, uint32_t size);
+  esp_err_t (*write)(void *ctx, uint32_t offset, const void *data,
+                     uint32_t size);
+  esp_err_t (*erase)(void *ctx, uint32_t offset, uint32_t size);
+  uint32_t size; /**< Size of the spill area in bytes */
+  void *ctx;     /**< Passed back to every callback */
+} mesh_sf_backend_t;
+
+/**
+ * @brief Records taken into a burst, handed back on completion
+ */
+typedef struct {
+  size_t length;        /**< Bytes of batch records in the burst buffer */
+  uint32_t flash_taken; /**< Records taken from the flash ring */
+  uint32_t ram_taken;   /**< Records taken from the RAM ring */
+} mesh_sf_burst_t;
+
+/**
+ * @brief Queue engine instance
+ */
+typedef struct {
+  uint8_t *ram;           /**< RAM ring storage */
+  size_t ram_bytes;       /**< RAM ring capacity */
+  size_t ram_head;        /**< Offset of the oldest RAM record */
+  size_t ram_tail;        /**< Offset the next RAM record goes to */
+  uint32_t ram_records;   /**< Records in the RAM ring */
+  bool has_flash;         /**< Spill to flash is enabled */
+  mesh_sf_backend_t flash;
+  uint32_t flash_head;    /**< Offset of the oldest flash record */
+  uint32_t flash_tail;    /**< Offset the next flash record goes to */
+  uint32_t flash_records; /**< Records in the flash ring */
+  uint16_t record_max;    /**< Largest record including its header */
+  bool replaying;         /**< A burst is out; its records are pinned */
+  mesh_store_forward_stats_t stats;
+} mesh_sf_engine_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Initialize an empty queue
+ *
+ * @param engine Engine instance
+ * @param ram RAM ring storage of ram_bytes
+ * @param ram_bytes RAM ring capacity, at least record_max
+ * @param record_max Largest record including its header; every burst
+ *                   buffer must hold at least this much
+ * @param flash Spill area, NULL for RAM only
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: NULL pointers
+ *    - ESP_ERR_INVALID_SIZE: RAM smaller than a record, or a spill area
+ *      smaller than a sector or with a record larger than a sector
+ */
+esp_err_t mesh_sf_engine_init(mesh_sf_engine_t *engine, uint8_t *ram,
+                              size_t ram_bytes, uint16_t record_max,
+                              const mesh_sf_backend_t *flash);
+
+/**
+ * @brief Append a packet to the queue
+ *
+ * When RAM is full the oldest record spills to flash, or is dropped if
+ * there is no flash or the flash ring is full too.
+ *
+ * @return
+ *    - ESP_OK: Packet queued
+ *    - ESP_ERR_INVALID_SIZE: Record larger than record_max, it could
+ *      never be replayed
+ *    - ESP_ERR_NO_MEM: Queue full while a burst is out
+ */
+esp_err_t mesh_sf_engine_enqueue(mesh_sf_engine_t *engine, uint8_t data_type,
+                                 const uint8_t *payload, uint16_t length);
+
+/**
+ * @brief Take the oldest records into a burst
+ *
+ * The oldest record is always taken. More follow while the burst stays
+ * within limit; pass 0 to take one record per burst. The records stay
+ * queued until mesh_sf_engine_finish().
+ *
+ * @param engine Engine instance
+ * @param buf Output, at least the larger of limit and record_max bytes
+ * @param limit Bytes a burst of several records may use
+ * @param burst Set to the records taken
+ *
+ * @return Number of records taken, 0 if the queue is empty
+ */
+uint32_t mesh_sf_engine_take_burst(mesh_sf_engine_t *engine, uint8_t *buf,
+                                   size_t limit, mesh_sf_burst_t *burst);
+
+/**
+ * @brief Complete a burst taken with mesh_sf_engine_take_burst()
+ *
+ * @param result Result of sending the burst: ESP_OK removes its records
+ *               as replayed, ESP_ERR_INVALID_SIZE removes them as dropped
+ *               because the root can never take them, anything else keeps
+ *               them for the next attempt
+ */
+void mesh_sf_engine_finish(mesh_sf_engine_t *engine,
+                           const mesh_sf_burst_t *burst, esp_err_t result);
+
+/**
+ * @brief Number of queued records
+ */
+uint32_t mesh_sf_engine_pending(const mesh_sf_engine_t *engine);
+
+#endif /* __MESH_STORE_FORWARD_ENGINE_H__ */
@@ -0,0 +1,147 @@
+/* ESP-MESH Root Telemetry Table
+ *
+ * Fixed-memory store on the root holding the latest value of every
+ * (node_id, channel) pair together with tumbling and sliding window
+ * aggregates (min/max/mean/count). Series are laid out as struct-of-arrays
+ * and addressed directly through the node ID, so lookups are O(1).
+ *
+ * Updates arrive from the packet handlers, which run in the reactor task.
+ * Writers and readers copy one node's cells inside a short critical
+ * section, so reads are safe from any task or esp_timer callback and never
+ * sleep.
+ */
+
+#ifndef __MESH_TELEMETRY_H__
+#define __MESH_TELEMETRY_H__
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_TELEMETRY_MAX_NODES (32)
+#define MESH_TELEMETRY_MAX_CHANNELS (8)
+#define MESH_TELEMETRY_MAX_BUCKETS (6)
+#define MESH_TELEMETRY_DEFAULT_BUCKET_MS (10000)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief Telemetry table configuration
+ *
+ * The tumbling window is one bucket long; the sliding window spans the last
+ * sliding_buckets buckets including the one being filled.
+ */
+typedef struct {
+  uint32_t bucket_ms;      /**< Bucket length, 0 = default */
+  uint8_t sliding_buckets; /**< 1 to MESH_TELEMETRY_MAX_BUCKETS, 0 = max */
+} mesh_telemetry_config_t;
+
+/**
+ * @brief Window selector
+ */
+typedef enum {
+  MESH_TELEMETRY_WINDOW_TUMBLING = 0, /**< Last completed bucket */
+  MESH_TELEMETRY_WINDOW_SLIDING = 1,  /**< Last sliding_buckets buckets */
+} mesh_telemetry_window_kind_t;
+
+/**
+ * @brief Window aggregate
+ */
+typedef struct {
+  uint32_t count;
+  float min;
+  float max;
+  float mean;
+} mesh_telemetry_window_t;
+
+/**
+ * @brief Latest values of one node, as returned by
+ *        mesh_telemetry_get_node_latest()
+ */
+typedef struct {
+  uint8_t valid_mask; /**< Bit n set if channel n has a value */
+  float values[MESH_TELEMETRY_MAX_CHANNELS];
+  uint32_t age_ms[MESH_TELEMETRY_MAX_CHANNELS]; /**< Time since update */
+} mesh_telemetry_latest_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Allocate the table and start ingesting sensor packets
+ *
+ * MESH_DATA_TYPE_SENSOR packets carrying mesh_sensor_reading_t arrays and
+ * concatenated MESH_DATA_TYPE_AGGREGATE frames are recorded for nodes found
+ * in the node registry; the packets are still passed on to the receive
+ * callback.
+ *
+ * @param config Configuration, NULL for defaults
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: Invalid configuration
+ *    - ESP_ERR_INVALID_STATE: Already initialized
+ *    - ESP_ERR_NO_MEM: Out of memory
+ */
+esp_err_t mesh_telemetry_init(const mesh_telemetry_config_t *config);
+
+/**
+ * @brief Record one value
+ *
+ * Safe to call from any task; the table's own handlers call it from the
+ * reactor task.
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: Channel out of range
+ *    - ESP_ERR_INVALID_STATE: Not initialized
+ *    - ESP_ERR_NO_MEM: MESH_TELEMETRY_MAX_NODES nodes already tracked
+ */
+esp_err_t mesh_telemetry_update(uint8_t node_id, uint8_t channel, float value);
+
+/**
+ * @brief Get the latest value of one channel
+ *
+ * @param value Pointer to store the value
+ * @param age_ms Pointer to store the time since the update, may be NULL
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if no value was recorded
+ */
+esp_err_t mesh_telemetry_get_latest(uint8_t node_id, uint8_t channel,
+                                    float *value, uint32_t *age_ms);
+
+/**
+ * @brief Get the latest values of all channels of a node in one snapshot
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if the node is not tracked
+ */
+esp_err_t mesh_telemetry_get_node_latest(uint8_t node_id,
+                                         mesh_telemetry_latest_t *latest);
+
+/**
+ * @brief Get a window aggregate of one channel
+ *
+ * @return ESP_OK on success (count may be 0), ESP_ERR_NOT_FOUND if the node
+ *         is not tracked, ESP_ERR_INVALID_ARG on invalid arguments
+ */
+esp_err_t mesh_telemetry_get_window(uint8_t node_id, uint8_t channel,
+                                    mesh_telemetry_window_kind_t kind,
+                                    mesh_telemetry_window_t *window);
+
+/**
+ * @brief Get the IDs of all tracked nodes
+ *
+ * @param node_ids Array to fill
+ * @param max Size of node_ids
+ *
+ * @return Number of IDs written
+ */
+int mesh_telemetry_get_nodes(uint8_t *node_ids, int max);
+
+#endif /* __MESH_TELEMETRY_H__ */
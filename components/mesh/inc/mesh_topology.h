@@ -0,0 +1,124 @@
+/* ESP-MESH Topology Map
+ *
+ * Every node periodically reports its parent, layer, direct child count,
+ * parent link RSSI and its send rate to the root in a small delta frame.
+ * The root assembles the reports into a tree and answers structural
+ * queries: a node's subtree size, the path from the root to a node and
+ * the relays that carry the most traffic.
+ *
+ * Every node of the mesh should use the same report interval; the root
+ * forgets nodes it has not heard from in MESH_TOPOLOGY_EXPIRE_INTERVALS
+ * intervals.
+ */
+
+#ifndef __MESH_TOPOLOGY_H__
+#define __MESH_TOPOLOGY_H__
+
+#include "esp_err.h"
+#include "mesh_topology_engine.h"
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_TOPOLOGY_DEFAULT_INTERVAL_MS (10000)
+#define MESH_TOPOLOGY_DEFAULT_KEYFRAME_EVERY (12) /* reports per keyframe */
+#define MESH_TOPOLOGY_EXPIRE_INTERVALS (3)
+#define MESH_TOPOLOGY_TASK_STACK_SIZE (3072)
+#define MESH_TOPOLOGY_TASK_PRIORITY (3)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief Topology configuration
+ */
+typedef struct {
+  uint32_t interval_ms;    /**< Report interval, 0 = default */
+  uint16_t keyframe_every; /**< Full report every N reports, 0 = default */
+} mesh_topology_config_t;
+
+/**
+ * @brief Topology counters
+ */
+typedef struct {
+  uint32_t reports_sent;      /**< Frames sent by this node */
+  uint32_t keyframes_sent;    /**< Of which keyframes */
+  uint32_t bytes_sent;        /**< Frame bytes sent by this node */
+  uint32_t reports_applied;   /**< Frames applied by the root */
+  uint32_t keyframe_requests; /**< Keyframes the root asked for */
+  uint32_t expired;           /**< Nodes the root forgot */
+  uint16_t nodes;             /**< Nodes in the root's map, root included */
+} mesh_topology_stats_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Start reporting, and mapping when this node is root
+ *
+ * The root allocates the map (about 10 KB) the first time it runs as root.
+ *
+ * @param config Configuration, NULL for defaults
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_STATE: Already initialized
+ *    - ESP_ERR_NO_MEM: Out of memory
+ */
+esp_err_t mesh_topology_init(const mesh_topology_config_t *config);
+
+/**
+ * @brief Copy one node of the map (root only)
+ *
+ * @param mac Station MAC of the node
+ * @param node Output
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: NULL argument
+ *    - ESP_ERR_INVALID_STATE: No map on this node
+ *    - ESP_ERR_NOT_FOUND: Node unknown
+ */
+esp_err_t mesh_topology_get_node(const uint8_t *mac,
+                                 mesh_topology_node_t *node);
+
+/**
+ * @brief Number of nodes in a subtree, its root included (root only)
+ *
+ * @return Subtree size, 0 if the node is unknown or there is no map
+ */
+int mesh_topology_subtree_size(const uint8_t *mac);
+
+/**
+ * @brief MACs from the root down to a node (root only)
+ *
+ * @param mac Node
+ * @param path Output, path[0] is the root
+ * @param max_hops Capacity of path
+ *
+ * @return Number of entries, or -1 if the path is not known
+ */
+int mesh_topology_path(const uint8_t *mac, uint8_t (*path)[6], int max_hops);
+
+/**
+ * @brief Relays ranked by the traffic of their descendants (root only)
+ *
+ * @param relays Output, busiest first
+ * @param max_relays Capacity of relays
+ *
+ * @return Number of relays written
+ */
+int mesh_topology_busiest_relays(mesh_topology_relay_t *relays,
+                                 int max_relays);
+
+/**
+ * @brief Get topology counters
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t mesh_topology_get_stats(mesh_topology_stats_t *stats);
+
+#endif /* __MESH_TOPOLOGY_H__ */
@@ -0,0 +1,213 @@
+/* Topology Tree Engine
+ *
+ * Keeps the mesh tree as the root sees it, built from the parent each node
+ * reports. Nodes live in a fixed table with a MAC hash index and are
+ * linked to their parent and siblings, and every node caches the size and
+ * traffic of its subtree. A report therefore costs O(depth), and subtree
+ * size and path queries need no search of the table.
+ *
+ * Node reports are delta frames: only the fields that changed since the
+ * previous frame are sent, the traffic counter as a varint increment, and
+ * a keyframe with every field is sent periodically or on request. The
+ * engine has no WiFi dependencies so it runs on a host as well.
+ */
+
+#ifndef __MESH_TOPOLOGY_ENGINE_H__
+#define __MESH_TOPOLOGY_ENGINE_H__
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define MESH_TOPOLOGY_MAX_NODES (256)
+#define MESH_TOPOLOGY_HASH_BUCKETS (64)
+#define MESH_TOPOLOGY_NONE (0xFFFF)
+#define MESH_TOPOLOGY_MAX_FRAME (18)
+#define MESH_TOPOLOGY_RSSI_DEADBAND (3) /* dB change worth a field */
+#define MESH_TOPOLOGY_ETX_DEADBAND (2)  /* tenths change worth a field */
+
+/* Frame layout: op, seq, flags, then the flagged fields in this order */
+#define MESH_TOPOLOGY_OP_REPORT (0x01)
+#define MESH_TOPOLOGY_OP_KEYFRAME_REQUEST (0x02)
+
+#define MESH_TOPOLOGY_FIELD_PARENT (1 << 0)   /* 6-byte parent STA MAC */
+#define MESH_TOPOLOGY_FIELD_LAYER (1 << 1)    /* 1 byte */
+#define MESH_TOPOLOGY_FIELD_CHILDREN (1 << 2) /* 1 byte, direct children */
+#define MESH_TOPOLOGY_FIELD_RSSI (1 << 3)     /* 1 byte, link to parent */
+#define MESH_TOPOLOGY_FIELD_TRAFFIC (1 << 4)  /* varint, packets since last */
+#define MESH_TOPOLOGY_FIELD_ETX (1 << 5)      /* 1 byte, link to parent */
+#define MESH_TOPOLOGY_FLAG_KEYFRAME (1 << 7)  /* every field present */
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/**
+ * @brief What a node measures about itself
+ */
+typedef struct {
+  uint8_t parent[6];   /**< Parent station MAC */
+  uint8_t layer;       /**< Own layer */
+  uint8_t children;    /**< Directly associated children */
+  int8_t rssi;         /**< Signal from the parent */
+  uint8_t etx;         /**< ETX to the parent in tenths, 0 = unknown */
+  uint32_t tx_packets; /**< Packets sent since boot */
+} mesh_topology_sample_t;
+
+/**
+ * @brief Node-side frame encoder state
+ */
+typedef struct {
+  mesh_topology_sample_t last; /**< Values the root has been sent */
+  uint8_t seq;                 /**< Sequence number of the next frame */
+  bool primed;                 /**< A keyframe has been sent */
+} mesh_topology_encoder_t;
+
+/**
+ * @brief One node of the tree
+ */
+typedef struct {
+  uint8_t mac[6];           /**< Station MAC */
+  uint8_t parent_mac[6];    /**< Reported parent */
+  uint16_t parent;          /**< Parent index, NONE if not in the table */
+  uint16_t first_child;     /**< Child list head */
+  uint16_t next_sibling;    /**< Next child of the same parent */
+  uint16_t next_in_bucket;  /**< Hash chain */
+  uint16_t subtree_size;    /**< Nodes below and including this one */
+  uint8_t layer;            /**< Reported layer */
+  uint8_t children;         /**< Reported direct children */
+  int8_t rssi;              /**< Reported link RSSI */
+  uint8_t etx;              /**< Reported link ETX, tenths, 0 = unknown */
+  uint8_t seq;              /**< Sequence number of the last frame */
+  bool used;                /**< Slot holds a node */
+  uint32_t last_seen_ms;    /**< Time of the last frame */
+  uint32_t traffic;         /**< Own packets per report, averaged */
+  uint32_t subtree_traffic; /**< traffic summed over the subtree */
+} mesh_topology_node_t;
+
+/**
+ * @brief Tree instance (about 10 KB, allocate on the root only)
+ */
+typedef struct {
+  mesh_topology_node_t nodes[MESH_TOPOLOGY_MAX_NODES];
+  uint16_t buckets[MESH_TOPOLOGY_HASH_BUCKETS];
+  uint16_t root;  /**< Index of the root, NONE until set */
+  uint16_t count; /**< Nodes in the table, root included */
+} mesh_topology_engine_t;
+
+/**
+ * @brief A relay ranked by the traffic it carries
+ */
+typedef struct {
+  uint8_t mac[6];
+  uint8_t layer;
+  uint16_t subtree_size; /**< Nodes below and including the relay */
+  uint32_t relayed;      /**< Traffic of its descendants per report */
+} mesh_topology_relay_t;
+
+/*******************************************************
+ *                Function Declarations
+ *******************************************************/
+
+/**
+ * @brief Encode a report frame
+ *
+ * @param encoder Encoder state, zeroed before the first call
+ * @param sample Current values
+ * @param keyframe true to send every field
+ * @param frame Output, at least MESH_TOPOLOGY_MAX_FRAME bytes
+ *
+ * @return Frame length
+ */
+uint16_t mesh_topology_encode(mesh_topology_encoder_t *encoder,
+                              const mesh_topology_sample_t *sample,
+                              bool keyframe, uint8_t *frame);
+
+/**
+ * @brief Initialize an empty tree
+ */
+void mesh_topology_engine_init(mesh_topology_engine_t *engine);
+
+/**
+ * @brief Set the root node, at layer 1
+ *
+ * @return ESP_OK, or ESP_ERR_NO_MEM if the table is full
+ */
+esp_err_t mesh_topology_engine_set_root(mesh_topology_engine_t *engine,
+                                        const uint8_t *mac);
+
+/**
+ * @brief Apply a report frame from a node
+ *
+ * @param engine Tree instance
+ * @param mac Station MAC of the sender
+ * @param frame Frame payload
+ * @param length Frame length
+ * @param now_ms Current time
+ *
+ * @return
+ *    - ESP_OK: Applied
+ *    - ESP_ERR_NOT_FOUND: Unknown node and not a keyframe; not applied,
+ *      ask the node for a keyframe
+ *    - ESP_ERR_INVALID_STATE: Frames were missed; applied, but ask the
+ *      node for a keyframe
+ *    - ESP_ERR_INVALID_SIZE: Malformed frame
+ *    - ESP_ERR_NO_MEM: Table full
+ */
+esp_err_t mesh_topology_engine_apply(mesh_topology_engine_t *engine,
+                                     const uint8_t *mac, const uint8_t *frame,
+                                     uint16_t length, uint32_t now_ms);
+
+/**
+ * @brief Remove nodes silent for longer than max_age_ms
+ *
+ * Their children stay in the table, detached, until they report again or
+ * expire themselves. The root never expires.
+ *
+ * @return Number of nodes removed
+ */
+int mesh_topology_engine_expire(mesh_topology_engine_t *engine,
+                                uint32_t now_ms, uint32_t max_age_ms);
+
+/**
+ * @brief Find a node
+ *
+ * @return Node index, or -1 if unknown
+ */
+int mesh_topology_engine_find(const mesh_topology_engine_t *engine,
+                              const uint8_t *mac);
+
+/**
+ * @brief List the MACs from the root down to a node
+ *
+ * @param engine Tree instance
+ * @param mac Node
+ * @param path Output, path[0] is the root
+ * @param max_hops Capacity of path
+ *
+ * @return Number of entries, or -1 if the node is unknown, not connected to
+ *         the root or deeper than max_hops
+ */
+int mesh_topology_engine_path(const mesh_topology_engine_t *engine,
+                              const uint8_t *mac, uint8_t (*path)[6],
+                              int max_hops);
+
+/**
+ * @brief Rank relays by the traffic of their descendants
+ *
+ * The root is left out since it carries all of it.
+ *
+ * @param engine Tree instance
+ * @param relays Output, busiest first
+ * @param max_relays Capacity of relays
+ *
+ * @return Number of relays written
+ */
+int mesh_topology_engine_busiest(const mesh_topology_engine_t *engine,
+                                 mesh_topology_relay_t *relays,
+                                 int max_relays);
+
+#endif /* __MESH_TOPOLOGY_ENGINE_H__ */
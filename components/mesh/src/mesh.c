@@ -1,15 +1,29 @@
 /* ESP-MESH Initialization and Event Handling */
 
 #include "mesh.h"
+#include "esp_attr.h"
+#include "esp_crc.h"
 #include "esp_event.h"
 #include "esp_log.h"
 #include "esp_mac.h"
 #include "esp_mesh.h"
 #include "esp_mesh_internal.h"
+#include "esp_ota_ops.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
 #include "mesh_data_transfer.h"
+#include "mesh_event_log.h"
+#include "mesh_internal.h"
 #include "mesh_light.h"
+#include "mesh_parent_select.h"
+#include <stddef.h>
+#include <stdio.h>
 #include <string.h>
+#include <sys/time.h>
 
 /*******************************************************
  *                Constants
@@ -17,6 +31,65 @@
 static const char *MESH_TAG = "mesh_main";
 static const uint8_t MESH_ID[6] = {0x77, 0x77, 0x77, 0x77, 0x77, 0x77};
 
+#define FAST_BOOT_MAGIC (0x4D464254) /* "MFBT" */
+#define MESH_EVENT_STEER (-1)         /* internal: leave the current parent */
+#define MESH_EVENT_TAKEOVER (-2)      /* internal: become root via the router */
+#define MESH_EVENT_RESTART (-3)       /* internal: restart with new params */
+#define MESH_EVENT_OUTAGE (-4)        /* internal: stop the mesh for a while */
+
+/* Distinguish the handshake from other MESH_DATA_TYPE_CONFIG payloads */
+#define MESH_CAPS_CONFIG_MAGIC (0xDE)
+#define MESH_IDENTITY_CONFIG_MAGIC (0xDF)
+
+#define MESH_MAX_GROUPS (4) /* groups joined through mesh_join_group() */
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/* Root -> node answer to an identity, and broadcast when it gains features */
+typedef struct {
+  uint8_t magic; /**< MESH_CAPS_CONFIG_MAGIC */
+  mesh_node_caps_t caps;
+} __attribute__((packed)) mesh_caps_msg_t;
+
+/* Node -> root identity, sent again when the root changes */
+typedef struct {
+  uint8_t magic; /**< MESH_IDENTITY_CONFIG_MAGIC */
+  mesh_node_identity_t identity;
+} __attribute__((packed)) mesh_identity_msg_t;
+
+/* A mesh event copied out of the default event loop */
+typedef struct {
+  int32_t id;
+  int64_t posted_us;
+  union {
+    mesh_event_child_connected_t child;
+    mesh_event_routing_table_change_t routing_table;
+    mesh_event_no_parent_found_t no_parent;
+    mesh_event_connected_t connected;
+    mesh_event_disconnected_t disconnected;
+    mesh_event_layer_change_t layer_change;
+    mesh_event_root_address_t root_address;
+    mesh_event_toDS_state_t tods_state;
+    mesh_event_root_fixed_t root_fixed;
+    mesh_event_scan_done_t scan_done;
+    uint8_t steer_bssid[6];
+    mesh_parent_target_t takeover;
+    uint32_t outage_ms;
+  } data;
+} mesh_event_item_t;
+
+/* Validated configuration and last parent, reused by the next warm boot */
+typedef struct {
+  uint32_t magic;
+  uint32_t crc;
+  uint8_t app_sha256[8]; /* Firmware the record was written by */
+  mesh_cfg_t cfg;
+  bool parent_valid;
+  mesh_parent_target_t parent;
+} mesh_fast_boot_t;
+
 /*******************************************************
  *                Variable Definitions
  *******************************************************/
@@ -24,22 +97,287 @@ static mesh_addr_t mesh_parent_addr;
 static int mesh_layer = -1;
 static esp_netif_t *netif_sta = NULL;
 
-/* Node registry for application-level addressing */
+/* Parent scoring and link history */
+static mesh_parent_engine_t parent_engine;
+static mesh_addr_t parent_attempt_addr;
+static int8_t parent_attempt_rssi = 0;
+static int64_t parent_connected_us = 0;
+
+/* Recent parents survive resets and deep sleep for a fast rejoin */
+static RTC_NOINIT_ATTR mesh_parent_cache_t parent_cache;
+static bool parent_cache_enabled = true;
+static uint8_t parent_scan_channels[MESH_PARENT_CACHE_SIZE];
+static int parent_scan_channel_count = 0;
+static int parent_scan_cursor = 0;
+static bool parent_scan_targeted = false;
+
+/* Rejoin timing, split by whether a targeted scan found the parent */
+static int64_t rejoin_start_us = 0;
+static bool rejoin_via_cache = false;
+static uint32_t rejoin_samples[2][MESH_REJOIN_SAMPLES];
+static uint32_t rejoin_counts[2];
+static uint32_t rejoin_last_ms = 0;
+
+/* Orphan healing */
+static int parent_lost_retries = 0; /* failed reconnects to the parent */
+static esp_timer_handle_t outage_timer = NULL;
+
+/* Fast boot: connect straight to the last parent, scan only if it fails */
+static RTC_NOINIT_ATTR mesh_fast_boot_t fast_boot;
+static bool fast_boot_enabled = true;
+static bool fast_boot_warm = false;
+static bool fast_boot_restart = false; /* stack restarted, RAM still valid */
+static bool fast_boot_attempt = false;
+static mesh_parent_target_t parent_target;
+
+/* Load balancing: a scan that looks for a parent other than the current */
+static bool steer_scan = false;
+static bool takeover_pending = false; /* standby root joining the router */
+
+/* Events are handled by a task fed from a fixed ring, not in the loop */
+static QueueHandle_t event_ring = NULL;
+static portMUX_TYPE event_stats_mux = portMUX_INITIALIZER_UNLOCKED;
+static mesh_event_stats_t event_stats;
+static uint64_t event_latency_sum_us = 0;
+static uint64_t event_process_sum_us = 0;
+
+/* Working copy of the published state; only the event handler writes */
+static mesh_state_t state_shadow = {.layer = -1};
+
+/* Node registry for application-level addressing, guarded by registry_mux
+ * together with root_caps; both are read from any task sending data */
+static portMUX_TYPE registry_mux = portMUX_INITIALIZER_UNLOCKED;
 static mesh_registered_node_t node_registry[MESH_MAX_REGISTERED_NODES];
 static int node_registry_count = 0;
+static uint16_t node_registry_version = 0; /* bumped on every change */
+static uint8_t own_node_id = 0;
+static mesh_identity_msg_t own_identity; /* announced again on root change */
+
+/* Mesh groups of the modules; the stack takes the whole list at once */
+static portMUX_TYPE group_mux = portMUX_INITIALIZER_UNLOCKED;
+static mesh_addr_t groups[MESH_MAX_GROUPS];
+static int group_count = 0;
+
+/* Identity handshake */
+static uint32_t local_features =
+    MESH_NODE_FEATURE_BATCH | MESH_NODE_FEATURE_HEADER_EXT;
+static mesh_node_caps_t root_caps; /* protocol 0 until the root answers */
 
 /*******************************************************
  *                Function Declarations
  *******************************************************/
+static void mesh_start_parent_scan(bool restart);
 static void mesh_scan_done_handler(int num);
 static void mesh_event_handler(void *arg, esp_event_base_t event_base,
                                int32_t event_id, void *event_data);
 static void ip_event_handler(void *arg, esp_event_base_t event_base,
                              int32_t event_id, void *event_data);
+static esp_err_t mesh_apply_groups(void);
+static void mesh_identity_root_changed(const mesh_addr_t *old_root);
+static bool mesh_identity_handle_config(mesh_addr_t *from, uint8_t data_type,
+                                        uint8_t *payload, uint16_t length);
 
 /*******************************************************
  *                Function Definitions
  *******************************************************/
+static uint32_t wall_clock_s(void) {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (uint32_t)tv.tv_sec;
+}
+
+static void mesh_publish_state(void) {
+  state_shadow.is_root = esp_mesh_is_root();
+  state_shadow.layer = mesh_layer;
+  mesh_state_publish(&state_shadow);
+}
+
+static uint32_t fast_boot_crc(void) {
+  return esp_crc32_le(0, fast_boot.app_sha256,
+                      sizeof(fast_boot) -
+                          offsetof(mesh_fast_boot_t, app_sha256));
+}
+
+/**
+ * @brief Check that the fast boot record was written by this firmware
+ *
+ * @return true if the cached configuration can be used
+ */
+static bool fast_boot_validate(void) {
+  const uint8_t *sha = esp_app_get_description()->app_elf_sha256;
+
+  if (fast_boot.magic == FAST_BOOT_MAGIC && fast_boot.crc == fast_boot_crc() &&
+      memcmp(fast_boot.app_sha256, sha, sizeof(fast_boot.app_sha256)) == 0) {
+    return true;
+  }
+
+  memset(&fast_boot, 0, sizeof(fast_boot));
+  fast_boot.magic = FAST_BOOT_MAGIC;
+  memcpy(fast_boot.app_sha256, sha, sizeof(fast_boot.app_sha256));
+  fast_boot.crc = fast_boot_crc();
+  return false;
+}
+
+static void fast_boot_save_parent(const mesh_parent_target_t *target) {
+  fast_boot.parent_valid = (target != NULL);
+  if (target != NULL) {
+    fast_boot.parent = *target;
+  }
+  fast_boot.crc = fast_boot_crc();
+}
+
+/**
+ * @brief Fill the mesh configuration from Kconfig
+ */
+static void mesh_build_config(mesh_cfg_t *cfg) {
+  mesh_cfg_t defaults = MESH_INIT_CONFIG_DEFAULT();
+  *cfg = defaults;
+
+  /* Mesh ID */
+  memcpy((uint8_t *)&cfg->mesh_id, MESH_ID, 6);
+
+  /* Router configuration */
+  cfg->channel = CONFIG_MESH_CHANNEL;
+  cfg->router.ssid_len = strlen(CONFIG_MESH_ROUTER_SSID);
+  memcpy((uint8_t *)&cfg->router.ssid, CONFIG_MESH_ROUTER_SSID,
+         cfg->router.ssid_len);
+  memcpy((uint8_t *)&cfg->router.password, CONFIG_MESH_ROUTER_PASSWD,
+         strlen(CONFIG_MESH_ROUTER_PASSWD));
+
+  /* Mesh softAP configuration */
+  cfg->mesh_ap.max_connection = CONFIG_MESH_AP_CONNECTIONS;
+  cfg->mesh_ap.nonmesh_max_connection = CONFIG_MESH_NON_MESH_AP_CONNECTIONS;
+  memcpy((uint8_t *)&cfg->mesh_ap.password, CONFIG_MESH_AP_PASSWD,
+         strlen(CONFIG_MESH_AP_PASSWD));
+}
+
+/**
+ * @brief Configure the mesh stack for a start with the saved parameters
+ */
+static void mesh_configure_stack(const mesh_cfg_t *base) {
+  mesh_cfg_t cfg = *base;
+  mesh_params_t params;
+
+  mesh_params_boot(&params);
+  cfg.mesh_ap.max_connection = params.ap_connections;
+  ESP_ERROR_CHECK(esp_mesh_set_config(&cfg));
+  ESP_ERROR_CHECK(esp_mesh_set_max_layer(params.max_layer));
+  ESP_ERROR_CHECK(esp_mesh_set_xon_qsize(params.xon_qsize));
+  ESP_ERROR_CHECK(esp_mesh_set_capacity_num(params.capacity_num));
+  ESP_ERROR_CHECK(esp_mesh_set_ap_assoc_expire(params.assoc_expire_s));
+}
+
+/**
+ * @brief Connect to a parent chosen by a scan or taken from the cache
+ */
+static void mesh_connect_parent(const mesh_parent_target_t *target) {
+  wifi_config_t parent = {0};
+
+  mesh_event_log_put(MESH_EVENT_LOG_PARENT_SET, target->bssid, target->layer,
+                     target->channel);
+  parent_target = *target;
+  memcpy(parent_attempt_addr.addr, target->bssid, 6);
+  parent_attempt_rssi = target->rssi;
+
+  /* Configure parent - both channel and SSID are mandatory */
+  parent.sta.channel = target->channel;
+  memcpy(&parent.sta.ssid, target->ssid, sizeof(target->ssid));
+  parent.sta.bssid_set = 1;
+  memcpy(&parent.sta.bssid, target->bssid, 6);
+
+  if (target->type == MESH_ROOT) {
+    if (target->authmode != WIFI_AUTH_OPEN) {
+      memcpy(&parent.sta.password, CONFIG_MESH_ROUTER_PASSWD,
+             strlen(CONFIG_MESH_ROUTER_PASSWD));
+    }
+    ESP_ERROR_CHECK(
+        esp_mesh_set_parent(&parent, NULL, target->type, target->layer));
+  } else {
+    ESP_ERROR_CHECK(esp_mesh_set_ap_authmode(target->authmode));
+    if (target->authmode != WIFI_AUTH_OPEN) {
+      memcpy(&parent.sta.password, CONFIG_MESH_AP_PASSWD,
+             strlen(CONFIG_MESH_AP_PASSWD));
+    }
+    mesh_addr_t mesh_id;
+    memcpy(mesh_id.addr, target->mesh_id, 6);
+    ESP_ERROR_CHECK(
+        esp_mesh_set_parent(&parent, &mesh_id, target->type, target->layer));
+  }
+}
+
+/**
+ * @brief Scan for a parent, trying the channels of cached parents first
+ *
+ * @param restart true to start over with the cached channels, false to
+ *                continue after a scan that found no parent
+ */
+static void mesh_start_parent_scan(bool restart) {
+  wifi_scan_config_t scan_config = {0};
+
+  if (restart) {
+    parent_scan_cursor = 0;
+    parent_scan_channel_count =
+        parent_cache_enabled
+            ? mesh_parent_cache_channels(&parent_cache, wall_clock_s(),
+                                         MESH_PARENT_CACHE_MAX_AGE_S,
+                                         parent_scan_channels,
+                                         MESH_PARENT_CACHE_SIZE)
+            : 0;
+  }
+
+  esp_wifi_scan_stop();
+  /* mesh softAP is hidden */
+  scan_config.show_hidden = 1;
+  scan_config.scan_type = WIFI_SCAN_TYPE_PASSIVE;
+  parent_scan_targeted = parent_scan_cursor < parent_scan_channel_count;
+  if (parent_scan_targeted) {
+    scan_config.channel = parent_scan_channels[parent_scan_cursor++];
+    ESP_LOGD(MESH_TAG, "<SCAN>cached channel:%u", scan_config.channel);
+  }
+  esp_wifi_scan_start(&scan_config, 0);
+}
+
+static void mesh_record_rejoin(void) {
+  if (rejoin_start_us == 0) {
+    return;
+  }
+
+  int kind = rejoin_via_cache ? 1 : 0;
+  rejoin_last_ms = (esp_timer_get_time() - rejoin_start_us) / 1000;
+  rejoin_samples[kind][rejoin_counts[kind] % MESH_REJOIN_SAMPLES] =
+      rejoin_last_ms;
+  rejoin_counts[kind]++;
+  rejoin_start_us = 0;
+  mesh_event_log_put(MESH_EVENT_LOG_REJOIN, NULL, rejoin_last_ms, kind);
+}
+
+static void outage_timer_cb(void *arg) {
+  if (mesh_request_restart() != ESP_OK) {
+    ESP_LOGE(MESH_TAG, "Failed to queue the restart after an outage");
+  }
+}
+
+static uint32_t rejoin_median(int kind) {
+  uint32_t sorted[MESH_REJOIN_SAMPLES];
+  int n = rejoin_counts[kind] < MESH_REJOIN_SAMPLES ? rejoin_counts[kind]
+                                                    : MESH_REJOIN_SAMPLES;
+
+  if (n == 0) {
+    return 0;
+  }
+  memcpy(sorted, rejoin_samples[kind], n * sizeof(uint32_t));
+  for (int i = 1; i < n; i++) {
+    uint32_t v = sorted[i];
+    int j = i - 1;
+    while (j >= 0 && sorted[j] > v) {
+      sorted[j + 1] = sorted[j];
+      j--;
+    }
+    sorted[j + 1] = v;
+  }
+  return sorted[n / 2];
+}
+
 static void mesh_scan_done_handler(int num) {
   int i;
   int ie_len = 0;
@@ -50,42 +388,80 @@ static void mesh_scan_done_handler(int num) {
   bool parent_found = false;
   mesh_type_t my_type = MESH_IDLE;
   int my_layer = -1;
-  wifi_config_t parent = {0};
-  wifi_scan_config_t scan_config = {0};
+#if CONFIG_MESH_SET_ROOT
+  bool root_active = false;
+#endif
+#if CONFIG_MESH_SET_NODE
+  mesh_parent_candidate_t candidate;
+  int32_t score;
+  int32_t best_score = MESH_PARENT_SCORE_REJECT;
+  int32_t last_score = MESH_PARENT_SCORE_REJECT;
+  wifi_ap_record_t last_record;
+  mesh_assoc_t last_assoc;
+#endif
+
+  if (takeover_pending) {
+    esp_mesh_flush_scan_result();
+    return;
+  }
 
   for (i = 0; i < num; i++) {
     esp_mesh_scan_get_ap_ie_len(&ie_len);
     esp_mesh_scan_get_ap_record(&record, &assoc);
     if (ie_len == sizeof(assoc)) {
-      ESP_LOGW(MESH_TAG,
-               "<MESH>[%d]%s, layer:%d/%d, assoc:%d/%d, %d, " MACSTR
-               ", channel:%u, rssi:%d, ID<" MACSTR "><%s>",
-               i, record.ssid, assoc.layer, assoc.layer_cap, assoc.assoc,
-               assoc.assoc_cap, assoc.layer2_cap, MAC2STR(record.bssid),
-               record.primary, record.rssi, MAC2STR(assoc.mesh_id),
-               assoc.encrypted ? "IE Encrypted" : "IE Unencrypted");
+#if CONFIG_MESH_SET_NODE
+      score = MESH_PARENT_SCORE_REJECT;
+      if (assoc.mesh_type != MESH_IDLE) {
+        memcpy(candidate.bssid, record.bssid, 6);
+        candidate.rssi = record.rssi;
+        candidate.layer = assoc.layer;
+        candidate.layer_cap = assoc.layer_cap;
+        candidate.assoc = assoc.assoc;
+        candidate.assoc_cap = assoc.assoc_cap;
+        candidate.layer2_cap = assoc.layer2_cap;
+        candidate.etx = mesh_link_etx(record.bssid);
+        score = mesh_parent_engine_score(&parent_engine, &candidate);
+        if (score != MESH_PARENT_SCORE_REJECT) {
+          score -= mesh_balance_penalty(record.bssid);
+        }
+        // Same format as the scan tables in host_test/scans/
+        ESP_LOGD(MESH_TAG, "<SCAN>ap " MACSTR " %d %u %u %u %u %u %u",
+                 MAC2STR(record.bssid), candidate.rssi, candidate.layer,
+                 candidate.layer_cap, candidate.assoc, candidate.assoc_cap,
+                 candidate.layer2_cap, candidate.etx);
+      }
+#endif
+      mesh_event_log_put(MESH_EVENT_LOG_SCAN_RECORD, record.bssid,
+                         (assoc.layer << 8) | record.primary, record.rssi);
+#if CONFIG_MESH_SET_ROOT
+      if (assoc.mesh_type == MESH_ROOT) {
+        root_active = true;
+      }
+#endif
 
 #if CONFIG_MESH_SET_NODE
-      if (assoc.mesh_type != MESH_IDLE && assoc.layer_cap &&
-          assoc.assoc < assoc.assoc_cap && record.rssi > -70) {
-        if (assoc.layer < parent_assoc.layer ||
-            assoc.layer2_cap < parent_assoc.layer2_cap) {
-          parent_found = true;
-          memcpy(&parent_record, &record, sizeof(record));
-          memcpy(&parent_assoc, &assoc, sizeof(assoc));
-          if (parent_assoc.layer_cap != 1) {
-            my_type = MESH_NODE;
-          } else {
-            my_type = MESH_LEAF;
-          }
-          my_layer = parent_assoc.layer + 1;
-          break;
+      if (score == MESH_PARENT_SCORE_REJECT) {
+        continue;
+      }
+      ESP_LOGD(MESH_TAG, "<MESH>[%d] score:%" PRId32, i, score);
+      if (memcmp(record.bssid, mesh_parent_addr.addr, 6) == 0) {
+        if (steer_scan) {
+          continue;
         }
+        // Kept apart so hysteresis can favour the last parent
+        last_score = score;
+        memcpy(&last_record, &record, sizeof(record));
+        memcpy(&last_assoc, &assoc, sizeof(assoc));
+      } else if (score > best_score) {
+        parent_found = true;
+        best_score = score;
+        memcpy(&parent_record, &record, sizeof(record));
+        memcpy(&parent_assoc, &assoc, sizeof(assoc));
       }
 #endif
     } else {
-      ESP_LOGI(MESH_TAG, "[%d]%s, " MACSTR ", channel:%u, rssi:%d", i,
-               record.ssid, MAC2STR(record.bssid), record.primary, record.rssi);
+      mesh_event_log_put(MESH_EVENT_LOG_SCAN_RECORD, record.bssid,
+                         record.primary, record.rssi);
 #if CONFIG_MESH_SET_ROOT
       if (!strcmp(CONFIG_MESH_ROUTER_SSID, (char *)record.ssid)) {
         parent_found = true;
@@ -96,113 +472,157 @@ static void mesh_scan_done_handler(int num) {
 #endif
     }
   }
-  esp_mesh_flush_scan_result();
+#if CONFIG_MESH_SET_NODE
+  if (last_score != MESH_PARENT_SCORE_REJECT &&
+      !mesh_parent_engine_should_switch(&parent_engine, best_score,
+                                        last_score)) {
+    parent_found = true;
+    memcpy(&parent_record, &last_record, sizeof(record));
+    memcpy(&parent_assoc, &last_assoc, sizeof(assoc));
+  }
   if (parent_found) {
-    /* Configure parent - both channel and SSID are mandatory */
-    parent.sta.channel = parent_record.primary;
-    memcpy(&parent.sta.ssid, &parent_record.ssid, sizeof(parent_record.ssid));
-    parent.sta.bssid_set = 1;
-    memcpy(&parent.sta.bssid, parent_record.bssid, 6);
-
-    if (my_type == MESH_ROOT) {
-      if (parent_record.authmode != WIFI_AUTH_OPEN) {
-        memcpy(&parent.sta.password, CONFIG_MESH_ROUTER_PASSWD,
-               strlen(CONFIG_MESH_ROUTER_PASSWD));
-      }
-      ESP_LOGW(MESH_TAG, "<PARENT>%s, " MACSTR ", channel:%u, rssi:%d",
-               parent_record.ssid, MAC2STR(parent_record.bssid),
-               parent_record.primary, parent_record.rssi);
-      ESP_ERROR_CHECK(esp_mesh_set_parent(&parent, NULL, my_type, my_layer));
+    if (parent_assoc.layer_cap != 1) {
+      my_type = MESH_NODE;
     } else {
-      ESP_ERROR_CHECK(esp_mesh_set_ap_authmode(parent_record.authmode));
-      if (parent_record.authmode != WIFI_AUTH_OPEN) {
-        memcpy(&parent.sta.password, CONFIG_MESH_AP_PASSWD,
-               strlen(CONFIG_MESH_AP_PASSWD));
-      }
-      ESP_LOGW(MESH_TAG,
-               "<PARENT>%s, layer:%d/%d, assoc:%d/%d, %d, " MACSTR
-               ", channel:%u, rssi:%d",
-               parent_record.ssid, parent_assoc.layer, parent_assoc.layer_cap,
-               parent_assoc.assoc, parent_assoc.assoc_cap,
-               parent_assoc.layer2_cap, MAC2STR(parent_record.bssid),
-               parent_record.primary, parent_record.rssi);
-      ESP_ERROR_CHECK(esp_mesh_set_parent(
-          &parent, (mesh_addr_t *)&parent_assoc.mesh_id, my_type, my_layer));
+      my_type = MESH_LEAF;
+    }
+    my_layer = parent_assoc.layer + 1;
+  }
+#endif
+  esp_mesh_flush_scan_result();
+#if CONFIG_MESH_SET_ROOT
+  if (root_active && parent_found) {
+    // A standby root took over while this root was away; do not start a
+    // second one, keep scanning until it is gone
+    ESP_LOGW(MESH_TAG, "<SCAN>another root is active, waiting");
+    parent_found = false;
+  }
+#endif
+  if (steer_scan) {
+    // Move only if another parent qualifies; the current one was skipped
+    steer_scan = false;
+    mesh_event_log_put(MESH_EVENT_LOG_STEER, mesh_parent_addr.addr, 0,
+                       parent_found);
+    if (!parent_found && state_shadow.connected) {
+      return;
     }
+  }
+  if (parent_found) {
+    mesh_parent_target_t target = {
+        .channel = parent_record.primary,
+        .authmode = parent_record.authmode,
+        .type = my_type,
+        .layer = my_layer,
+        .rssi = parent_record.rssi,
+    };
+    memcpy(target.bssid, parent_record.bssid, 6);
+    memcpy(target.ssid, parent_record.ssid, sizeof(target.ssid));
+    memcpy(target.mesh_id, parent_assoc.mesh_id, 6);
+    rejoin_via_cache = parent_scan_targeted;
+    mesh_connect_parent(&target);
   } else {
-    esp_wifi_scan_stop();
-    scan_config.show_hidden = 1;
-    scan_config.scan_type = WIFI_SCAN_TYPE_PASSIVE;
-    esp_wifi_scan_start(&scan_config, 0);
+    mesh_start_parent_scan(false);
   }
 }
 
-static void mesh_event_handler(void *arg, esp_event_base_t event_base,
-                               int32_t event_id, void *event_data) {
+/**
+ * @brief Handle one mesh event, in the mesh event task
+ */
+static void mesh_process_event(int32_t event_id, void *event_data) {
   mesh_addr_t id = {0};
   static int last_layer = 0;
-  wifi_scan_config_t scan_config = {0};
 
   switch (event_id) {
   case MESH_EVENT_STARTED: {
     esp_mesh_get_id(&id);
-    ESP_LOGI(MESH_TAG, "<MESH_EVENT_STARTED>ID:" MACSTR "", MAC2STR(id.addr));
+    mesh_event_log_put(event_id, id.addr, 0, 0);
     mesh_layer = esp_mesh_get_layer();
+    state_shadow.started = true;
+    mesh_publish_state();
+    mesh_boot_trace_mark(MESH_BOOT_PHASE_MESH_STARTED);
+    // Group membership is part of the stack configuration of each start
+    mesh_apply_groups();
     ESP_ERROR_CHECK(esp_mesh_set_self_organized(0, 0));
-    esp_wifi_scan_stop();
-    /* mesh softAP is hidden */
-    scan_config.show_hidden = 1;
-    scan_config.scan_type = WIFI_SCAN_TYPE_PASSIVE;
-    esp_wifi_scan_start(&scan_config, 0);
+    rejoin_start_us = esp_timer_get_time();
+    rejoin_via_cache = false;
+    if ((fast_boot_warm || fast_boot_restart) && fast_boot.parent_valid) {
+      // Warm boot or restart: skip the scan and go back to the last parent
+      mesh_event_log_put(MESH_EVENT_LOG_FAST_BOOT, fast_boot.parent.bssid,
+                         fast_boot.parent.channel, 0);
+      fast_boot_attempt = true;
+      rejoin_via_cache = true;
+      mesh_connect_parent(&fast_boot.parent);
+    } else {
+      mesh_start_parent_scan(true);
+    }
+    fast_boot_restart = false;
   } break;
   case MESH_EVENT_STOPPED: {
-    ESP_LOGI(MESH_TAG, "<MESH_EVENT_STOPPED>");
+    mesh_event_log_put(event_id, NULL, 0, 0);
     mesh_layer = esp_mesh_get_layer();
+    state_shadow.started = false;
+    state_shadow.connected = false;
+    state_shadow.tods_reachable = false;
+    mesh_publish_state();
   } break;
   case MESH_EVENT_CHILD_CONNECTED: {
     mesh_event_child_connected_t *child_connected =
         (mesh_event_child_connected_t *)event_data;
-    ESP_LOGI(MESH_TAG, "<MESH_EVENT_CHILD_CONNECTED>aid:%d, " MACSTR "",
-             child_connected->aid, MAC2STR(child_connected->mac));
+    mesh_event_log_put(event_id, child_connected->mac, child_connected->aid,
+                       0);
   } break;
   case MESH_EVENT_CHILD_DISCONNECTED: {
     mesh_event_child_disconnected_t *child_disconnected =
         (mesh_event_child_disconnected_t *)event_data;
-    ESP_LOGI(MESH_TAG, "<MESH_EVENT_CHILD_DISCONNECTED>aid:%d, " MACSTR "",
-             child_disconnected->aid, MAC2STR(child_disconnected->mac));
+    mesh_event_log_put(event_id, child_disconnected->mac,
+                       child_disconnected->aid, 0);
   } break;
   case MESH_EVENT_ROUTING_TABLE_ADD: {
     mesh_event_routing_table_change_t *routing_table =
         (mesh_event_routing_table_change_t *)event_data;
-    ESP_LOGW(MESH_TAG, "<MESH_EVENT_ROUTING_TABLE_ADD>add %d, new:%d",
-             routing_table->rt_size_change, routing_table->rt_size_new);
+    mesh_event_log_put(event_id, NULL, routing_table->rt_size_new,
+                       routing_table->rt_size_change);
   } break;
   case MESH_EVENT_ROUTING_TABLE_REMOVE: {
     mesh_event_routing_table_change_t *routing_table =
         (mesh_event_routing_table_change_t *)event_data;
-    ESP_LOGW(MESH_TAG, "<MESH_EVENT_ROUTING_TABLE_REMOVE>remove %d, new:%d",
-             routing_table->rt_size_change, routing_table->rt_size_new);
+    mesh_event_log_put(event_id, NULL, routing_table->rt_size_new,
+                       routing_table->rt_size_change);
   } break;
   case MESH_EVENT_NO_PARENT_FOUND: {
     mesh_event_no_parent_found_t *no_parent =
         (mesh_event_no_parent_found_t *)event_data;
-    ESP_LOGI(MESH_TAG, "<MESH_EVENT_NO_PARENT_FOUND>scan times:%d",
-             no_parent->scan_times);
+    mesh_event_log_put(event_id, NULL, no_parent->scan_times, 0);
   } break;
   case MESH_EVENT_PARENT_CONNECTED: {
     mesh_event_connected_t *connected = (mesh_event_connected_t *)event_data;
-    esp_mesh_get_id(&id);
+    mesh_boot_trace_mark(MESH_BOOT_PHASE_PARENT_CONNECTED);
     mesh_layer = connected->self_layer;
     memcpy(&mesh_parent_addr.addr, connected->connected.bssid, 6);
-    ESP_LOGI(MESH_TAG,
-             "<MESH_EVENT_PARENT_CONNECTED>layer:%d-->%d, parent:" MACSTR
-             "%s, ID:" MACSTR "",
-             last_layer, mesh_layer, MAC2STR(mesh_parent_addr.addr),
-             esp_mesh_is_root()  ? "<ROOT>"
-             : (mesh_layer == 2) ? "<layer2>"
-                                 : "",
-             MAC2STR(id.addr));
+    mesh_event_log_put(event_id, mesh_parent_addr.addr, mesh_layer,
+                       last_layer);
     last_layer = mesh_layer;
+    state_shadow.connected = true;
+    state_shadow.parent = mesh_parent_addr;
+    mesh_publish_state();
+    parent_connected_us = esp_timer_get_time();
+    parent_lost_retries = 0;
+    mesh_record_rejoin();
+    mesh_parent_cache_entry_t cached = {
+        .channel = connected->connected.channel,
+        .layer = mesh_layer - 1,
+        .rssi = parent_attempt_rssi,
+        .seen_s = wall_clock_s(),
+    };
+    memcpy(cached.bssid, connected->connected.bssid, 6);
+    mesh_parent_cache_update(&parent_cache, &cached);
+    fast_boot_attempt = false;
+    // A standby that took over must not come back as root after a reboot
+    if (fast_boot_enabled && !takeover_pending &&
+        memcmp(parent_target.bssid, connected->connected.bssid, 6) == 0) {
+      fast_boot_save_parent(&parent_target);
+    }
+    takeover_pending = false;
     mesh_connected_indicator(mesh_layer);
     if (esp_mesh_is_root()) {
       esp_netif_dhcpc_stop(netif_sta);
@@ -212,63 +632,291 @@ static void mesh_event_handler(void *arg, esp_event_base_t event_base,
   case MESH_EVENT_PARENT_DISCONNECTED: {
     mesh_event_disconnected_t *disconnected =
         (mesh_event_disconnected_t *)event_data;
-    ESP_LOGI(MESH_TAG, "<MESH_EVENT_PARENT_DISCONNECTED>reason:%d",
-             disconnected->reason);
+    mesh_event_log_put(event_id, disconnected->bssid, disconnected->reason,
+                       0);
     mesh_disconnected_indicator();
     mesh_layer = esp_mesh_get_layer();
-    if (disconnected->reason == WIFI_REASON_ASSOC_TOOMANY) {
-      esp_wifi_scan_stop();
-      scan_config.show_hidden = 1;
-      scan_config.scan_type = WIFI_SCAN_TYPE_PASSIVE;
-      esp_wifi_scan_start(&scan_config, 0);
+    state_shadow.connected = false;
+    mesh_publish_state();
+    // The parent is gone, not just a frame lost, once its beacons stopped
+    // or the stack failed to reach it again
+    bool parent_lost = disconnected->reason == WIFI_REASON_BEACON_TIMEOUT ||
+                       disconnected->reason == WIFI_REASON_NO_AP_FOUND ||
+                       ++parent_lost_retries > MESH_PARENT_LOST_RETRIES;
+    if (parent_connected_us != 0) {
+      // A link that stayed up counts for its parent, a short one against it
+      mesh_parent_engine_record(&parent_engine, mesh_parent_addr.addr,
+                                esp_timer_get_time() - parent_connected_us >=
+                                    MESH_PARENT_STABLE_LINK_MS * 1000LL);
+      parent_connected_us = 0;
+      // The parent was in use until now, not just when it was joined, so
+      // its channel is still worth scanning first
+      if (parent_cache.count > 0 &&
+          memcmp(parent_cache.entries[0].bssid, mesh_parent_addr.addr, 6) ==
+              0) {
+        mesh_parent_cache_entry_t cached = parent_cache.entries[0];
+        cached.seen_s = wall_clock_s();
+        mesh_parent_cache_update(&parent_cache, &cached);
+      }
+      rejoin_start_us = esp_timer_get_time();
+      rejoin_via_cache = false;
+    } else {
+      mesh_parent_engine_record(&parent_engine, parent_attempt_addr.addr,
+                                false);
+    }
+    if (takeover_pending) {
+      // The router did not take the standby root; look for the new root
+      takeover_pending = false;
+      mesh_start_parent_scan(true);
+    } else if (fast_boot_attempt) {
+      // The cached parent is gone or moved; forget it and scan
+      mesh_event_log_put(MESH_EVENT_LOG_FAST_BOOT, fast_boot.parent.bssid,
+                         fast_boot.parent.channel, 1);
+      fast_boot_attempt = false;
+      fast_boot_save_parent(NULL);
+      rejoin_via_cache = false;
+      mesh_start_parent_scan(true);
+    } else if (disconnected->reason == WIFI_REASON_ASSOC_TOOMANY) {
+      mesh_start_parent_scan(true);
+    } else if (parent_lost && last_layer > 2 && !steer_scan) {
+      // Below layer 2 another parent still has a path to the root; a node
+      // that lost the root itself leaves that to the standby. The cached
+      // channel is scanned right away: trying runners-up of an older scan
+      // lost more time on full or moved ones than it saved (sim_heal.c)
+      parent_lost_retries = 0;
+      mesh_start_parent_scan(true);
     }
   } break;
   case MESH_EVENT_LAYER_CHANGE: {
     mesh_event_layer_change_t *layer_change =
         (mesh_event_layer_change_t *)event_data;
     mesh_layer = layer_change->new_layer;
-    ESP_LOGI(MESH_TAG, "<MESH_EVENT_LAYER_CHANGE>layer:%d-->%d%s", last_layer,
-             mesh_layer,
-             esp_mesh_is_root()  ? "<ROOT>"
-             : (mesh_layer == 2) ? "<layer2>"
-                                 : "");
+    mesh_event_log_put(event_id, NULL, mesh_layer, last_layer);
     last_layer = mesh_layer;
+    mesh_publish_state();
     mesh_connected_indicator(mesh_layer);
   } break;
   case MESH_EVENT_ROOT_ADDRESS: {
     mesh_event_root_address_t *root_addr =
         (mesh_event_root_address_t *)event_data;
-    ESP_LOGI(MESH_TAG, "<MESH_EVENT_ROOT_ADDRESS>root address:" MACSTR "",
-             MAC2STR(root_addr->addr));
+    mesh_event_log_put(event_id, root_addr->addr, 0, 0);
+    mesh_addr_t old_root = state_shadow.root;
+    memcpy(state_shadow.root.addr, root_addr->addr, 6);
+    mesh_publish_state();
+    mesh_boot_trace_mark(MESH_BOOT_PHASE_ROOT_ADDRESS);
+    if (memcmp(old_root.addr, root_addr->addr, 6) != 0) {
+      mesh_identity_root_changed(&old_root);
+    }
   } break;
   case MESH_EVENT_TODS_STATE: {
     mesh_event_toDS_state_t *toDs_state = (mesh_event_toDS_state_t *)event_data;
-    ESP_LOGI(MESH_TAG, "<MESH_EVENT_TODS_REACHABLE>state:%d", *toDs_state);
+    mesh_event_log_put(event_id, NULL, *toDs_state, 0);
+    state_shadow.tods_reachable = (*toDs_state == MESH_TODS_REACHABLE);
+    mesh_publish_state();
+    if (*toDs_state == MESH_TODS_REACHABLE) {
+      mesh_boot_trace_mark(MESH_BOOT_PHASE_TODS_STATE);
+    }
   } break;
   case MESH_EVENT_ROOT_FIXED: {
     mesh_event_root_fixed_t *root_fixed = (mesh_event_root_fixed_t *)event_data;
-    ESP_LOGI(MESH_TAG, "<MESH_EVENT_ROOT_FIXED>%s",
-             root_fixed->is_fixed ? "fixed" : "not fixed");
+    mesh_event_log_put(event_id, NULL, root_fixed->is_fixed, 0);
   } break;
   case MESH_EVENT_SCAN_DONE: {
     mesh_event_scan_done_t *scan_done = (mesh_event_scan_done_t *)event_data;
-    ESP_LOGI(MESH_TAG, "<MESH_EVENT_SCAN_DONE>number:%d", scan_done->number);
+    mesh_event_log_put(event_id, NULL, scan_done->number, 0);
+    mesh_boot_trace_mark(MESH_BOOT_PHASE_SCAN_DONE);
     mesh_scan_done_handler(scan_done->number);
   } break;
+  case MESH_EVENT_TAKEOVER: {
+    mesh_parent_target_t *router = (mesh_parent_target_t *)event_data;
+    if (!state_shadow.is_root && !state_shadow.connected) {
+      // Scan results still in flight are dropped until the router answers
+      esp_wifi_scan_stop();
+      steer_scan = false;
+      takeover_pending = true;
+      mesh_connect_parent(router);
+    }
+  } break;
+  case MESH_EVENT_RESTART: {
+    // The stack reads these parameters only when it starts
+    ESP_LOGI(MESH_TAG, "<Config>restarting mesh with new parameters");
+    esp_wifi_scan_stop();
+    steer_scan = false;
+    takeover_pending = false;
+    if (state_shadow.started) {
+      esp_err_t err = esp_mesh_stop();
+      if (err != ESP_OK) {
+        ESP_LOGE(MESH_TAG, "Failed to stop mesh: %s", esp_err_to_name(err));
+        break;
+      }
+    }
+    mesh_configure_stack(&fast_boot.cfg);
+    fast_boot_restart = fast_boot_enabled;
+    ESP_ERROR_CHECK(esp_mesh_start());
+  } break;
+  case MESH_EVENT_OUTAGE: {
+    // Children see the same loss as from a relay that lost power
+    uint32_t outage_ms = *(uint32_t *)event_data;
+    ESP_LOGW(MESH_TAG, "<Heal>mesh off for %" PRIu32 " ms", outage_ms);
+    esp_wifi_scan_stop();
+    steer_scan = false;
+    if (esp_mesh_stop() == ESP_OK) {
+      esp_timer_stop(outage_timer);
+      esp_timer_start_once(outage_timer, outage_ms * 1000ULL);
+    }
+  } break;
+  case MESH_EVENT_STEER: {
+    uint8_t *bssid = (uint8_t *)event_data;
+    // Stale once the node has moved or lost the parent by itself
+    if (state_shadow.connected && !steer_scan &&
+        memcmp(bssid, mesh_parent_addr.addr, 6) == 0) {
+      steer_scan = true;
+      mesh_start_parent_scan(true);
+    }
+  } break;
   default:
-    ESP_LOGD(MESH_TAG, "event id:%" PRId32 "", event_id);
+    mesh_event_log_put(event_id, NULL, 0, 0);
     break;
   }
 }
 
+/**
+ * @brief Size of the data posted with a mesh event that is processed
+ */
+static size_t mesh_event_data_size(int32_t event_id) {
+  switch (event_id) {
+  case MESH_EVENT_CHILD_CONNECTED:
+  case MESH_EVENT_CHILD_DISCONNECTED:
+    return sizeof(mesh_event_child_connected_t);
+  case MESH_EVENT_ROUTING_TABLE_ADD:
+  case MESH_EVENT_ROUTING_TABLE_REMOVE:
+    return sizeof(mesh_event_routing_table_change_t);
+  case MESH_EVENT_NO_PARENT_FOUND:
+    return sizeof(mesh_event_no_parent_found_t);
+  case MESH_EVENT_PARENT_CONNECTED:
+    return sizeof(mesh_event_connected_t);
+  case MESH_EVENT_PARENT_DISCONNECTED:
+    return sizeof(mesh_event_disconnected_t);
+  case MESH_EVENT_LAYER_CHANGE:
+    return sizeof(mesh_event_layer_change_t);
+  case MESH_EVENT_ROOT_ADDRESS:
+    return sizeof(mesh_event_root_address_t);
+  case MESH_EVENT_TODS_STATE:
+    return sizeof(mesh_event_toDS_state_t);
+  case MESH_EVENT_ROOT_FIXED:
+    return sizeof(mesh_event_root_fixed_t);
+  case MESH_EVENT_SCAN_DONE:
+    return sizeof(mesh_event_scan_done_t);
+  case MESH_EVENT_STEER:
+    return 6;
+  case MESH_EVENT_TAKEOVER:
+    return sizeof(mesh_parent_target_t);
+  case MESH_EVENT_RESTART:
+    return 0;
+  case MESH_EVENT_OUTAGE:
+    return sizeof(uint32_t);
+  default:
+    return 0;
+  }
+}
+
+/**
+ * @brief Copy a mesh event into the ring; runs in the default event loop
+ *
+ * Churn events (children and routing table) are dropped first, so the
+ * last MESH_EVENT_RING_RESERVE slots stay free for state changes.
+ */
+static void mesh_event_handler(void *arg, esp_event_base_t event_base,
+                               int32_t event_id, void *event_data) {
+  mesh_event_item_t item;
+  size_t size = mesh_event_data_size(event_id);
+  bool churn = event_id == MESH_EVENT_CHILD_CONNECTED ||
+               event_id == MESH_EVENT_CHILD_DISCONNECTED ||
+               event_id == MESH_EVENT_ROUTING_TABLE_ADD ||
+               event_id == MESH_EVENT_ROUTING_TABLE_REMOVE;
+
+  item.id = event_id;
+  item.posted_us = esp_timer_get_time();
+  if (size > 0 && event_data != NULL) {
+    memcpy(&item.data, event_data, size);
+  }
+
+  if ((churn && uxQueueSpacesAvailable(event_ring) <=
+                    MESH_EVENT_RING_RESERVE) ||
+      xQueueSend(event_ring, &item, 0) != pdTRUE) {
+    taskENTER_CRITICAL(&event_stats_mux);
+    event_stats.dropped++;
+    taskEXIT_CRITICAL(&event_stats_mux);
+    return;
+  }
+
+  // The event task updates the other counters concurrently
+  uint16_t waiting = uxQueueMessagesWaiting(event_ring);
+  taskENTER_CRITICAL(&event_stats_mux);
+  if (waiting > event_stats.ring_high_water) {
+    event_stats.ring_high_water = waiting;
+  }
+  taskEXIT_CRITICAL(&event_stats_mux);
+}
+
+static void mesh_event_task(void *arg) {
+  mesh_event_item_t item;
+
+  while (xQueueReceive(event_ring, &item, portMAX_DELAY) == pdTRUE) {
+    int64_t start_us = esp_timer_get_time();
+    mesh_process_event(item.id, &item.data);
+    int64_t end_us = esp_timer_get_time();
+
+    uint32_t latency_us = (uint32_t)(start_us - item.posted_us);
+    uint32_t process_us = (uint32_t)(end_us - start_us);
+    taskENTER_CRITICAL(&event_stats_mux);
+    event_stats.events++;
+    event_latency_sum_us += latency_us;
+    event_process_sum_us += process_us;
+    if (latency_us > event_stats.latency_max_us) {
+      event_stats.latency_max_us = latency_us;
+    }
+    if (process_us > event_stats.process_max_us) {
+      event_stats.process_max_us = process_us;
+    }
+    taskEXIT_CRITICAL(&event_stats_mux);
+  }
+  vTaskDelete(NULL);
+}
+
 static void ip_event_handler(void *arg, esp_event_base_t event_base,
                              int32_t event_id, void *event_data) {
   ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
   ESP_LOGI(MESH_TAG, "<IP_EVENT_STA_GOT_IP>IP:" IPSTR,
            IP2STR(&event->ip_info.ip));
+  mesh_boot_trace_mark(MESH_BOOT_PHASE_GOT_IP);
 }
 
 esp_err_t mesh_init(void) {
+  mesh_boot_trace_mark(MESH_BOOT_PHASE_MESH_INIT);
+  ESP_ERROR_CHECK(mesh_event_log_init());
+  event_ring = xQueueCreate(MESH_EVENT_RING_SIZE, sizeof(mesh_event_item_t));
+  if (event_ring == NULL ||
+      xTaskCreate(mesh_event_task, "mesh_event", MESH_EVENT_TASK_STACK_SIZE,
+                  NULL, MESH_EVENT_TASK_PRIORITY, NULL) != pdPASS) {
+    ESP_LOGE(MESH_TAG, "Failed to start event task");
+    return ESP_ERR_NO_MEM;
+  }
+  event_stats.ring_size = MESH_EVENT_RING_SIZE;
+  ESP_ERROR_CHECK(mesh_data_transfer_register_type_handler(
+      MESH_DATA_TYPE_CONFIG, mesh_identity_handle_config));
+  esp_timer_create_args_t outage_args = {
+      .callback = outage_timer_cb,
+      .name = "mesh_outage",
+  };
+  ESP_ERROR_CHECK(esp_timer_create(&outage_args, &outage_timer));
+  mesh_parent_engine_init(&parent_engine, NULL);
+  if (mesh_parent_cache_validate(&parent_cache)) {
+    ESP_LOGI(MESH_TAG, "<Config>%u cached parents", parent_cache.count);
+  }
+  fast_boot_warm = fast_boot_validate() && fast_boot_enabled;
+  mesh_boot_trace_set_warm(fast_boot_warm && fast_boot.parent_valid);
+
   /* Create network interfaces for mesh */
   ESP_ERROR_CHECK(esp_netif_create_default_wifi_mesh_netifs(&netif_sta, NULL));
 
@@ -277,7 +925,10 @@ esp_err_t mesh_init(void) {
   ESP_ERROR_CHECK(esp_wifi_init(&config));
   ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP,
                                              &ip_event_handler, NULL));
-  ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_FLASH));
+  /* The configuration is applied on every boot, so persisting it to flash
+   * only adds writes to the boot path */
+  ESP_ERROR_CHECK(esp_wifi_set_storage(fast_boot_enabled ? WIFI_STORAGE_RAM
+                                                         : WIFI_STORAGE_FLASH));
   ESP_ERROR_CHECK(esp_wifi_set_ps(WIFI_PS_NONE));
   ESP_ERROR_CHECK(esp_wifi_start());
 
@@ -286,27 +937,13 @@ esp_err_t mesh_init(void) {
   ESP_ERROR_CHECK(esp_event_handler_register(MESH_EVENT, ESP_EVENT_ANY_ID,
                                              &mesh_event_handler, NULL));
 
-  /* Mesh configuration */
-  mesh_cfg_t cfg = MESH_INIT_CONFIG_DEFAULT();
-
-  /* Mesh ID */
-  memcpy((uint8_t *)&cfg.mesh_id, MESH_ID, 6);
-
-  /* Router configuration */
-  cfg.channel = CONFIG_MESH_CHANNEL;
-  cfg.router.ssid_len = strlen(CONFIG_MESH_ROUTER_SSID);
-  memcpy((uint8_t *)&cfg.router.ssid, CONFIG_MESH_ROUTER_SSID,
-         cfg.router.ssid_len);
-  memcpy((uint8_t *)&cfg.router.password, CONFIG_MESH_ROUTER_PASSWD,
-         strlen(CONFIG_MESH_ROUTER_PASSWD));
-
-  /* Mesh softAP configuration */
+  /* Mesh configuration, reused as accepted on the last boot when warm */
   ESP_ERROR_CHECK(esp_mesh_set_ap_authmode(CONFIG_MESH_AP_AUTHMODE));
-  cfg.mesh_ap.max_connection = CONFIG_MESH_AP_CONNECTIONS;
-  cfg.mesh_ap.nonmesh_max_connection = CONFIG_MESH_NON_MESH_AP_CONNECTIONS;
-  memcpy((uint8_t *)&cfg.mesh_ap.password, CONFIG_MESH_AP_PASSWD,
-         strlen(CONFIG_MESH_AP_PASSWD));
-  ESP_ERROR_CHECK(esp_mesh_set_config(&cfg));
+  if (!fast_boot_warm) {
+    mesh_build_config(&fast_boot.cfg);
+    fast_boot.crc = fast_boot_crc();
+  }
+  mesh_configure_stack(&fast_boot.cfg);
 
   /* Mesh IE crypto configuration */
 #if CONFIG_MESH_IE_CRYPTO_FUNCS
@@ -327,10 +964,195 @@ esp_err_t mesh_init(void) {
   return ESP_OK;
 }
 
+esp_err_t mesh_request_takeover(const mesh_parent_target_t *router) {
+  mesh_event_item_t item;
+
+  if (event_ring == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  item.id = MESH_EVENT_TAKEOVER;
+  item.posted_us = esp_timer_get_time();
+  item.data.takeover = *router;
+  memset(item.data.takeover.ssid, 0, sizeof(item.data.takeover.ssid));
+  memcpy(item.data.takeover.ssid, CONFIG_MESH_ROUTER_SSID,
+         strlen(CONFIG_MESH_ROUTER_SSID));
+  item.data.takeover.type = MESH_ROOT;
+  item.data.takeover.layer = MESH_ROOT_LAYER;
+  if (xQueueSend(event_ring, &item, 0) != pdTRUE) {
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
+
+esp_err_t mesh_request_restart(void) {
+  mesh_event_item_t item;
+
+  if (event_ring == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  item.id = MESH_EVENT_RESTART;
+  item.posted_us = esp_timer_get_time();
+  if (xQueueSend(event_ring, &item, 0) != pdTRUE) {
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
+
+esp_err_t mesh_request_outage(uint32_t off_ms) {
+  mesh_event_item_t item;
+
+  if (event_ring == NULL || outage_timer == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  item.id = MESH_EVENT_OUTAGE;
+  item.posted_us = esp_timer_get_time();
+  item.data.outage_ms = off_ms;
+  if (xQueueSend(event_ring, &item, 0) != pdTRUE) {
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
+
+bool mesh_get_parent_target(mesh_parent_target_t *target) {
+  mesh_state_t state;
+
+  mesh_state_get(&state);
+  if (!state.connected ||
+      memcmp(state.parent.addr, parent_target.bssid, 6) != 0) {
+    return false;
+  }
+  *target = parent_target;
+  return true;
+}
+
+esp_err_t mesh_request_steer(const uint8_t *bssid) {
+  mesh_event_item_t item;
+
+  if (event_ring == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  item.id = MESH_EVENT_STEER;
+  item.posted_us = esp_timer_get_time();
+  memcpy(item.data.steer_bssid, bssid, 6);
+  if (xQueueSend(event_ring, &item, 0) != pdTRUE) {
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
+
+esp_err_t mesh_set_parent_weights(const mesh_parent_weights_t *weights) {
+  if (weights == NULL) {
+    ESP_LOGE(MESH_TAG, "Invalid weights pointer");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  parent_engine.weights = *weights;
+  return ESP_OK;
+}
+
+esp_err_t mesh_set_parent_cache_enabled(bool enable) {
+  parent_cache_enabled = enable;
+  return ESP_OK;
+}
+
+esp_err_t mesh_set_fast_boot_enabled(bool enable) {
+  fast_boot_enabled = enable;
+  return ESP_OK;
+}
+
+esp_err_t mesh_get_event_stats(mesh_event_stats_t *stats) {
+  if (stats == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (event_ring == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  taskENTER_CRITICAL(&event_stats_mux);
+  *stats = event_stats;
+  uint64_t latency_sum_us = event_latency_sum_us;
+  uint64_t process_sum_us = event_process_sum_us;
+  taskEXIT_CRITICAL(&event_stats_mux);
+  if (stats->events > 0) {
+    stats->latency_mean_us = latency_sum_us / stats->events;
+    stats->process_mean_us = process_sum_us / stats->events;
+  }
+  return ESP_OK;
+}
+
+esp_err_t mesh_get_rejoin_stats(mesh_rejoin_stats_t *stats) {
+  if (stats == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  stats->rejoins_full = rejoin_counts[0];
+  stats->rejoins_cached = rejoin_counts[1];
+  stats->median_full_ms = rejoin_median(0);
+  stats->median_cached_ms = rejoin_median(1);
+  stats->last_ms = rejoin_last_ms;
+  return ESP_OK;
+}
+
 /*******************************************************
  *                Node Registry Functions
  *******************************************************/
 
+/**
+ * @brief Add or update a registry entry
+ *
+ * @param caps Announced capabilities, NULL to keep the known ones
+ */
+static esp_err_t registry_put(uint8_t node_id, const mesh_addr_t *mac_addr,
+                              uint8_t node_type, const char *name,
+                              const mesh_node_caps_t *caps) {
+  uint32_t now = esp_log_timestamp();
+  mesh_registered_node_t *node = NULL;
+  bool added = false;
+
+  taskENTER_CRITICAL(&registry_mux);
+  // Check if node already exists
+  for (int i = 0; i < node_registry_count; i++) {
+    if (node_registry[i].node_id == node_id) {
+      node = &node_registry[i];
+      break;
+    }
+  }
+  if (node == NULL && node_registry_count < MESH_MAX_REGISTERED_NODES) {
+    // Add new node
+    node = &node_registry[node_registry_count++];
+    memset(node, 0, sizeof(*node));
+    node->node_id = node_id;
+    added = true;
+  }
+  if (node != NULL) {
+    if (caps != NULL) {
+      node->caps = *caps;
+    } else if (memcmp(&node->mac_addr, mac_addr, sizeof(mesh_addr_t)) != 0) {
+      memset(&node->caps, 0, sizeof(node->caps));
+    }
+    memcpy(&node->mac_addr, mac_addr, sizeof(mesh_addr_t));
+    node->node_type = node_type;
+    strncpy(node->name, name, sizeof(node->name) - 1);
+    node->name[sizeof(node->name) - 1] = '\0';
+    node->is_active = true;
+    node->last_seen = now;
+    node_registry_version++;
+  }
+  taskEXIT_CRITICAL(&registry_mux);
+
+  if (node == NULL) {
+    ESP_LOGE(MESH_TAG, "Node registry full");
+    return ESP_ERR_NO_MEM;
+  }
+  ESP_LOGI(MESH_TAG, "%s node ID %d: %s", added ? "Registered" : "Updated",
+           node_id, name);
+  return ESP_OK;
+}
+
 esp_err_t mesh_register_node(uint8_t node_id, const mesh_addr_t *mac_addr,
                              uint8_t node_type, const char *name) {
   if (mac_addr == NULL || name == NULL) {
@@ -338,41 +1160,204 @@ esp_err_t mesh_register_node(uint8_t node_id, const mesh_addr_t *mac_addr,
     return ESP_ERR_INVALID_ARG;
   }
 
-  // Check if node already exists
-  for (int i = 0; i < node_registry_count; i++) {
-    if (node_registry[i].node_id == node_id) {
-      // Update existing node
-      memcpy(&node_registry[i].mac_addr, mac_addr, sizeof(mesh_addr_t));
-      node_registry[i].node_type = node_type;
-      strncpy(node_registry[i].name, name, sizeof(node_registry[i].name) - 1);
-      node_registry[i].name[sizeof(node_registry[i].name) - 1] = '\0';
-      node_registry[i].is_active = true;
-      node_registry[i].last_seen = esp_log_timestamp();
-      ESP_LOGI(MESH_TAG, "Updated node ID %d: %s", node_id, name);
-      return ESP_OK;
+  return registry_put(node_id, mac_addr, node_type, name, NULL);
+}
+
+/**
+ * @brief App version "1.2.3", "v1.2.3-4-gabc" etc. as 0xMMmmpppp
+ *
+ * @return 0 if the version does not start with a number
+ */
+static uint32_t firmware_version(void) {
+  const char *version = esp_app_get_description()->version;
+  unsigned major = 0, minor = 0, patch = 0;
+
+  if (version[0] == 'v') {
+    version++;
+  }
+  if (sscanf(version, "%u.%u.%u", &major, &minor, &patch) < 1 ||
+      major > 0xFF || minor > 0xFF || patch > 0xFFFF) {
+    return 0;
+  }
+  return (uint32_t)major << 24 | (uint32_t)minor << 16 | patch;
+}
+
+static void local_caps(mesh_node_caps_t *caps) {
+  caps->protocol = MESH_PROTOCOL_VERSION;
+  caps->features = (uint16_t)__atomic_load_n(&local_features, __ATOMIC_RELAXED);
+  caps->rx_buffer = MESH_RX_BUFFER_SIZE;
+  caps->rx_queue = (uint16_t)esp_mesh_get_xon_qsize();
+  caps->firmware = firmware_version();
+}
+
+/**
+ * @brief Tell one node (NULL: every node) what the root can receive
+ */
+static void mesh_send_caps(const mesh_addr_t *to) {
+  mesh_caps_msg_t msg = {.magic = MESH_CAPS_CONFIG_MAGIC};
+  esp_err_t err;
+
+  local_caps(&msg.caps);
+  if (to != NULL) {
+    err = mesh_send_to_child(to, MESH_DATA_TYPE_CONFIG, (uint8_t *)&msg,
+                             sizeof(msg));
+  } else {
+    err = mesh_broadcast_from_root(MESH_DATA_TYPE_CONFIG, (uint8_t *)&msg,
+                                   sizeof(msg));
+  }
+  if (err != ESP_OK) {
+    ESP_LOGW(MESH_TAG, "Failed to send caps: %s", esp_err_to_name(err));
+  }
+}
+
+/**
+ * @brief MESH_DATA_TYPE_CONFIG handler for the identity handshake
+ *
+ * The root registers every identity and answers with its own caps. A node
+ * keeps its root's caps. Both messages start with their magic, so other
+ * config payloads of the same length still reach the application.
+ */
+static bool mesh_identity_handle_config(mesh_addr_t *from, uint8_t data_type,
+                                        uint8_t *payload, uint16_t length) {
+  if (!mesh_state_is_root()) {
+    if (length != sizeof(mesh_caps_msg_t) ||
+        payload[0] != MESH_CAPS_CONFIG_MAGIC) {
+      return false;
     }
+    mesh_node_caps_t caps;
+    memcpy(&caps, payload + offsetof(mesh_caps_msg_t, caps), sizeof(caps));
+    taskENTER_CRITICAL(&registry_mux);
+    root_caps = caps;
+    taskEXIT_CRITICAL(&registry_mux);
+    ESP_LOGI(MESH_TAG, "Root caps: protocol %u, features 0x%04x, rx %u",
+             caps.protocol, caps.features, caps.rx_buffer);
+    return true;
   }
 
-  // Add new node
-  if (node_registry_count >= MESH_MAX_REGISTERED_NODES) {
-    ESP_LOGE(MESH_TAG, "Node registry full");
-    return ESP_ERR_NO_MEM;
+  mesh_node_identity_t identity;
+  if (length != sizeof(mesh_identity_msg_t) ||
+      payload[0] != MESH_IDENTITY_CONFIG_MAGIC) {
+    return false;
+  }
+  memcpy(&identity, payload + offsetof(mesh_identity_msg_t, identity),
+         sizeof(identity));
+  identity.name[sizeof(identity.name) - 1] = '\0';
+  if (identity.node_id == 0) {
+    return true;
   }
 
-  node_registry[node_registry_count].node_id = node_id;
-  memcpy(&node_registry[node_registry_count].mac_addr, mac_addr,
-         sizeof(mesh_addr_t));
-  node_registry[node_registry_count].node_type = node_type;
-  strncpy(node_registry[node_registry_count].name, name,
-          sizeof(node_registry[node_registry_count].name) - 1);
-  node_registry[node_registry_count]
-      .name[sizeof(node_registry[node_registry_count].name) - 1] = '\0';
-  node_registry[node_registry_count].is_active = true;
-  node_registry[node_registry_count].last_seen = esp_log_timestamp();
-  node_registry_count++;
+  if (registry_put(identity.node_id, from, identity.node_type, identity.name,
+                   &identity.caps) == ESP_OK) {
+    mesh_send_caps(from);
+  }
+  return true;
+}
 
-  ESP_LOGI(MESH_TAG, "Registered node ID %d: %s", node_id, name);
-  return ESP_OK;
+/**
+ * @brief Forget the old root's caps and announce again to the new root
+ *
+ * Until the new root answers it is assumed to speak only the legacy
+ * features, so nothing is sent in an encoding it may not know.
+ *
+ * @param old_root Previous root address, zero on the first connection
+ */
+static void mesh_identity_root_changed(const mesh_addr_t *old_root) {
+  static const uint8_t zero[6] = {0};
+
+  taskENTER_CRITICAL(&registry_mux);
+  memset(&root_caps, 0, sizeof(root_caps));
+  root_caps.features = MESH_NODE_FEATURES_LEGACY;
+  root_caps.rx_buffer = MESH_RX_BUFFER_SIZE;
+  taskEXIT_CRITICAL(&registry_mux);
+  if (own_identity.identity.node_id == 0 || mesh_state_is_root() ||
+      memcmp(old_root->addr, zero, sizeof(zero)) == 0) {
+    return;
+  }
+  local_caps(&own_identity.identity.caps);
+  if (mesh_send_to_root(MESH_DATA_TYPE_CONFIG, (uint8_t *)&own_identity,
+                        sizeof(own_identity)) != ESP_OK) {
+    ESP_LOGW(MESH_TAG, "Failed to announce identity to the new root");
+  }
+}
+
+void mesh_peer_caps(const mesh_addr_t *addr, mesh_node_caps_t *caps) {
+  if (addr == NULL && mesh_state_is_root()) {
+    local_caps(caps);
+    return;
+  }
+
+  memset(caps, 0, sizeof(*caps));
+  taskENTER_CRITICAL(&registry_mux);
+  if (addr == NULL) {
+    *caps = root_caps;
+  } else {
+    for (int i = 0; i < node_registry_count; i++) {
+      if (memcmp(node_registry[i].mac_addr.addr, addr->addr, 6) == 0) {
+        *caps = node_registry[i].caps;
+        break;
+      }
+    }
+  }
+  taskEXIT_CRITICAL(&registry_mux);
+  if (caps->protocol == 0) {
+    caps->features = MESH_NODE_FEATURES_LEGACY;
+    caps->rx_buffer = MESH_RX_BUFFER_SIZE;
+  }
+}
+
+/**
+ * @brief Give the stack every group joined so far
+ */
+static esp_err_t mesh_apply_groups(void) {
+  mesh_addr_t list[MESH_MAX_GROUPS];
+
+  taskENTER_CRITICAL(&group_mux);
+  int count = group_count;
+  memcpy(list, groups, sizeof(list));
+  taskEXIT_CRITICAL(&group_mux);
+  if (count == 0) {
+    return ESP_OK;
+  }
+  esp_err_t err = esp_mesh_set_group_id(list, count);
+  if (err != ESP_OK) {
+    ESP_LOGW(MESH_TAG, "Failed to set %d groups: %s", count,
+             esp_err_to_name(err));
+  }
+  return err;
+}
+
+esp_err_t mesh_join_group(const mesh_addr_t *group) {
+  esp_err_t err = ESP_OK;
+
+  if (group == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  taskENTER_CRITICAL(&group_mux);
+  int i = 0;
+  while (i < group_count && memcmp(groups[i].addr, group->addr, 6) != 0) {
+    i++;
+  }
+  if (i == MESH_MAX_GROUPS) {
+    err = ESP_ERR_NO_MEM;
+  } else if (i == group_count) {
+    groups[group_count++] = *group;
+  }
+  taskEXIT_CRITICAL(&group_mux);
+  if (err != ESP_OK) {
+    ESP_LOGE(MESH_TAG, "No room for another group");
+    return err;
+  }
+  return mesh_state_is_started() ? mesh_apply_groups() : ESP_OK;
+}
+
+void mesh_caps_add_feature(uint16_t features) {
+  uint32_t before =
+      __atomic_fetch_or(&local_features, features, __ATOMIC_RELAXED);
+
+  if ((before | features) != before && mesh_state_is_root() &&
+      mesh_state_is_started()) {
+    mesh_send_caps(NULL);
+  }
 }
 
 esp_err_t mesh_announce_node_identity(uint8_t node_id, uint8_t node_type,
@@ -382,22 +1367,26 @@ esp_err_t mesh_announce_node_identity(uint8_t node_id, uint8_t node_type,
     return ESP_ERR_INVALID_ARG;
   }
 
-  if (esp_mesh_is_root()) {
+  if (mesh_state_is_root()) {
     ESP_LOGW(MESH_TAG, "Root node doesn't need to announce identity");
     return ESP_OK;
   }
 
-  mesh_node_identity_t identity;
-  identity.node_id = node_id;
-  identity.node_type = node_type;
-  strncpy(identity.name, name, sizeof(identity.name) - 1);
-  identity.name[sizeof(identity.name) - 1] = '\0';
+  own_node_id = node_id;
+
+  mesh_identity_msg_t msg = {.magic = MESH_IDENTITY_CONFIG_MAGIC};
+  msg.identity.node_id = node_id;
+  msg.identity.node_type = node_type;
+  strncpy(msg.identity.name, name, sizeof(msg.identity.name) - 1);
+  msg.identity.name[sizeof(msg.identity.name) - 1] = '\0';
+  local_caps(&msg.identity.caps);
+  own_identity = msg;
 
   ESP_LOGI(MESH_TAG, "Announcing identity: ID=%d, Type=%d, Name=%s", node_id,
            node_type, name);
 
-  return mesh_send_to_root(MESH_DATA_TYPE_CONFIG, (uint8_t *)&identity,
-                           sizeof(identity));
+  return mesh_send_to_root(MESH_DATA_TYPE_CONFIG, (uint8_t *)&msg,
+                           sizeof(msg));
 }
 
 esp_err_t mesh_send_to_node_id(uint8_t node_id, uint8_t data_type,
@@ -407,44 +1396,125 @@ esp_err_t mesh_send_to_node_id(uint8_t node_id, uint8_t data_type,
     return ESP_ERR_INVALID_ARG;
   }
 
-  if (!esp_mesh_is_root()) {
+  if (!mesh_state_is_root()) {
     ESP_LOGE(MESH_TAG, "Only root can send to node ID");
     return ESP_FAIL;
   }
 
-  // Find node in registry
+  // Find node in registry; the send itself may block, so not under the lock
+  mesh_registered_node_t node;
+  bool found = false;
+  taskENTER_CRITICAL(&registry_mux);
   for (int i = 0; i < node_registry_count; i++) {
     if (node_registry[i].node_id == node_id && node_registry[i].is_active) {
-      esp_err_t err = mesh_send_to_child(&node_registry[i].mac_addr, data_type,
-                                         payload, length);
-      if (err == ESP_OK) {
-        ESP_LOGI(MESH_TAG, "Sent to node ID %d (%s)", node_id,
-                 node_registry[i].name);
-        node_registry[i].last_seen = esp_log_timestamp();
-      }
-      return err;
+      node = node_registry[i];
+      found = true;
+      break;
     }
   }
+  taskEXIT_CRITICAL(&registry_mux);
+  if (!found) {
+    ESP_LOGW(MESH_TAG, "Node ID %d not found in registry", node_id);
+    return ESP_ERR_NOT_FOUND;
+  }
 
-  ESP_LOGW(MESH_TAG, "Node ID %d not found in registry", node_id);
-  return ESP_ERR_NOT_FOUND;
+  esp_err_t err =
+      mesh_send_to_child(&node.mac_addr, data_type, payload, length);
+  if (err == ESP_OK) {
+    ESP_LOGI(MESH_TAG, "Sent to node ID %d (%s)", node_id, node.name);
+    uint32_t now = esp_log_timestamp();
+    taskENTER_CRITICAL(&registry_mux);
+    for (int i = 0; i < node_registry_count; i++) {
+      if (node_registry[i].node_id == node_id) {
+        node_registry[i].last_seen = now;
+        break;
+      }
+    }
+    taskEXIT_CRITICAL(&registry_mux);
+  }
+  return err;
 }
 
-int mesh_get_registered_node_count(void) { return node_registry_count; }
+int mesh_get_registered_node_count(void) {
+  taskENTER_CRITICAL(&registry_mux);
+  int count = node_registry_count;
+  taskEXIT_CRITICAL(&registry_mux);
+  return count;
+}
 
 esp_err_t mesh_get_registered_node_info(int index,
                                         mesh_registered_node_t *node_info) {
-  if (index < 0 || index >= node_registry_count || node_info == NULL) {
+  esp_err_t err = ESP_ERR_INVALID_ARG;
+
+  if (node_info == NULL) {
     return ESP_ERR_INVALID_ARG;
   }
 
-  memcpy(node_info, &node_registry[index], sizeof(mesh_registered_node_t));
-  return ESP_OK;
+  taskENTER_CRITICAL(&registry_mux);
+  if (index >= 0 && index < node_registry_count) {
+    memcpy(node_info, &node_registry[index], sizeof(mesh_registered_node_t));
+    err = ESP_OK;
+  }
+  taskEXIT_CRITICAL(&registry_mux);
+  return err;
 }
 
+esp_err_t mesh_get_node_id_by_addr(const mesh_addr_t *mac_addr,
+                                   uint8_t *node_id) {
+  esp_err_t err = ESP_ERR_NOT_FOUND;
+
+  if (mac_addr == NULL || node_id == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  taskENTER_CRITICAL(&registry_mux);
+  for (int i = 0; i < node_registry_count; i++) {
+    if (memcmp(node_registry[i].mac_addr.addr, mac_addr->addr, 6) == 0) {
+      *node_id = node_registry[i].node_id;
+      err = ESP_OK;
+      break;
+    }
+  }
+  taskEXIT_CRITICAL(&registry_mux);
+  return err;
+}
+
+uint8_t mesh_get_own_node_id(void) { return own_node_id; }
+
 esp_err_t mesh_clear_node_registry(void) {
+  taskENTER_CRITICAL(&registry_mux);
   memset(node_registry, 0, sizeof(node_registry));
   node_registry_count = 0;
+  node_registry_version++;
+  taskEXIT_CRITICAL(&registry_mux);
   ESP_LOGI(MESH_TAG, "Node registry cleared");
   return ESP_OK;
 }
+
+uint16_t mesh_registry_version(void) {
+  taskENTER_CRITICAL(&registry_mux);
+  uint16_t version = node_registry_version;
+  taskEXIT_CRITICAL(&registry_mux);
+  return version;
+}
+
+int mesh_registry_export(mesh_registered_node_t *nodes, int max_nodes) {
+  taskENTER_CRITICAL(&registry_mux);
+  int count = node_registry_count < max_nodes ? node_registry_count : max_nodes;
+  memcpy(nodes, node_registry, count * sizeof(mesh_registered_node_t));
+  taskEXIT_CRITICAL(&registry_mux);
+  return count;
+}
+
+void mesh_registry_import(const mesh_registered_node_t *nodes, int count,
+                          uint16_t version) {
+  if (count > MESH_MAX_REGISTERED_NODES) {
+    count = MESH_MAX_REGISTERED_NODES;
+  }
+  taskENTER_CRITICAL(&registry_mux);
+  memset(node_registry, 0, sizeof(node_registry));
+  memcpy(node_registry, nodes, count * sizeof(mesh_registered_node_t));
+  node_registry_count = count;
+  node_registry_version = version;
+  taskEXIT_CRITICAL(&registry_mux);
+}
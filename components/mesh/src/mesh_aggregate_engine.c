@@ -0,0 +1,159 @@
+/* In-Network Aggregation Engine Implementation */
+
+#include "mesh_aggregate_engine.h"
+#include <string.h>
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static int find_channel(const mesh_aggregate_t *agg, uint8_t channel) {
+  for (int i = 0; i < agg->header.entry_count; i++) {
+    if (agg->summaries[i].channel == channel) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief Count the channels of `entries` not yet present in the accumulator
+ */
+static int new_channel_count(const mesh_aggregate_t *agg,
+                             const uint8_t *channels, int count,
+                             int stride) {
+  uint8_t seen[MESH_AGGREGATE_MAX_CHANNELS];
+  int added = 0;
+
+  for (int i = 0; i < count; i++) {
+    uint8_t channel = channels[i * stride];
+    if (find_channel(agg, channel) >= 0 ||
+        memchr(seen, channel, added) != NULL) {
+      continue;
+    }
+    if (added == MESH_AGGREGATE_MAX_CHANNELS) {
+      return MESH_AGGREGATE_MAX_CHANNELS + 1;
+    }
+    seen[added++] = channel;
+  }
+  return added;
+}
+
+static void summary_merge(mesh_aggregate_t *agg,
+                          const mesh_aggregate_summary_t *in) {
+  int i = find_channel(agg, in->channel);
+  if (i < 0) {
+    agg->summaries[agg->header.entry_count++] = *in;
+    return;
+  }
+
+  mesh_aggregate_summary_t *s = &agg->summaries[i];
+  s->count += in->count;
+  s->sum += in->sum;
+  if (in->min < s->min) {
+    s->min = in->min;
+  }
+  if (in->max > s->max) {
+    s->max = in->max;
+  }
+}
+
+void mesh_aggregate_reset(mesh_aggregate_t *agg, uint8_t data_type,
+                          mesh_aggregate_mode_t mode) {
+  agg->header.data_type = data_type;
+  agg->header.mode = mode;
+  agg->header.node_count = 0;
+  agg->header.entry_count = 0;
+}
+
+bool mesh_aggregate_add(mesh_aggregate_t *agg, const uint8_t origin[6],
+                        const mesh_sensor_reading_t *readings, int count) {
+  if (count <= 0) {
+    return true;
+  }
+
+  if (agg->header.mode == MESH_AGGREGATE_MODE_CONCAT) {
+    if (agg->header.entry_count + count > (int)MESH_AGGREGATE_MAX_RECORDS) {
+      return false;
+    }
+    for (int i = 0; i < count; i++) {
+      mesh_aggregate_record_t *r = &agg->records[agg->header.entry_count++];
+      memcpy(r->origin, origin, sizeof(r->origin));
+      r->channel = readings[i].channel;
+      r->value = readings[i].value;
+    }
+  } else {
+    if (agg->header.entry_count +
+            new_channel_count(agg, &readings[0].channel, count,
+                              sizeof(*readings)) >
+        MESH_AGGREGATE_MAX_CHANNELS) {
+      return false;
+    }
+    for (int i = 0; i < count; i++) {
+      mesh_aggregate_summary_t s = {
+          .channel = readings[i].channel,
+          .count = 1,
+          .min = readings[i].value,
+          .max = readings[i].value,
+          .sum = readings[i].value,
+      };
+      summary_merge(agg, &s);
+    }
+  }
+
+  agg->header.node_count++;
+  return true;
+}
+
+bool mesh_aggregate_merge(mesh_aggregate_t *agg, const uint8_t *frame,
+                          uint16_t length) {
+  mesh_aggregate_header_t header;
+
+  if (length < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, frame, sizeof(header));
+  if (header.data_type != agg->header.data_type ||
+      header.mode != agg->header.mode) {
+    return false;
+  }
+
+  const uint8_t *entries = frame + sizeof(header);
+  if (header.mode == MESH_AGGREGATE_MODE_CONCAT) {
+    if (length != sizeof(header) +
+                      header.entry_count * sizeof(mesh_aggregate_record_t) ||
+        agg->header.entry_count + header.entry_count >
+            (int)MESH_AGGREGATE_MAX_RECORDS) {
+      return false;
+    }
+    memcpy(&agg->records[agg->header.entry_count], entries,
+           header.entry_count * sizeof(mesh_aggregate_record_t));
+    agg->header.entry_count += header.entry_count;
+  } else {
+    if (length != sizeof(header) +
+                      header.entry_count * sizeof(mesh_aggregate_summary_t) ||
+        agg->header.entry_count +
+                new_channel_count(agg, entries, header.entry_count,
+                                  sizeof(mesh_aggregate_summary_t)) >
+            MESH_AGGREGATE_MAX_CHANNELS) {
+      return false;
+    }
+    for (int i = 0; i < header.entry_count; i++) {
+      mesh_aggregate_summary_t s;
+      memcpy(&s, entries + i * sizeof(s), sizeof(s));
+      summary_merge(agg, &s);
+    }
+  }
+
+  agg->header.node_count += header.node_count;
+  return true;
+}
+
+uint16_t mesh_aggregate_frame_length(const mesh_aggregate_t *agg) {
+  if (agg->header.node_count == 0) {
+    return 0;
+  }
+  size_t entry_size = (agg->header.mode == MESH_AGGREGATE_MODE_CONCAT)
+                          ? sizeof(mesh_aggregate_record_t)
+                          : sizeof(mesh_aggregate_summary_t);
+  return sizeof(agg->header) + agg->header.entry_count * entry_size;
+}
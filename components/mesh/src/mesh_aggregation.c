@@ -0,0 +1,219 @@
+/* ESP-MESH In-Network Aggregation Implementation */
+
+#include "mesh_aggregation.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_mesh.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "mesh_data_transfer.h"
+#include "mesh_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+static const char *TAG = "mesh_agg";
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static bool s_initialized = false;
+static mesh_aggregation_config_t s_config;
+static SemaphoreHandle_t s_lock = NULL;
+static esp_timer_handle_t s_window_timer = NULL;
+static mesh_aggregate_t *s_aggs = NULL; /* one per designated type */
+static uint8_t s_own_addr[6];
+static mesh_aggregation_stats_t s_stats;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static mesh_aggregate_t *mesh_aggregation_find(uint8_t data_type) {
+  for (int i = 0; i < s_config.type_count; i++) {
+    if (s_config.data_types[i] == data_type) {
+      return &s_aggs[i];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Send the accumulated frame to the parent and start a new one
+ *
+ * Must be called with s_lock held.
+ */
+static void mesh_aggregation_flush(mesh_aggregate_t *agg) {
+  uint16_t length = mesh_aggregate_frame_length(agg);
+  if (length == 0) {
+    return;
+  }
+
+  esp_err_t err =
+      mesh_data_send_to_parent(MESH_DATA_TYPE_AGGREGATE, (const uint8_t *)agg,
+                               length, MESH_DATA_NONBLOCK);
+  if (err == ESP_OK) {
+    s_stats.frames_out++;
+  } else if (mesh_store_forward_enqueue(MESH_DATA_TYPE_AGGREGATE,
+                                        (const uint8_t *)agg,
+                                        length) == ESP_OK) {
+    s_stats.frames_out++;
+  } else {
+    s_stats.dropped++;
+    ESP_LOGW(TAG, "Dropped aggregate of %u nodes: %s", agg->header.node_count,
+             esp_err_to_name(err));
+  }
+
+  mesh_aggregate_reset(agg, agg->header.data_type, agg->header.mode);
+}
+
+static void mesh_aggregation_window_cb(void *arg) {
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  for (int i = 0; i < s_config.type_count; i++) {
+    mesh_aggregation_flush(&s_aggs[i]);
+  }
+  xSemaphoreGive(s_lock);
+}
+
+/**
+ * @brief Merge aggregate frames from children; the root passes them on to
+ *        the application
+ */
+static bool mesh_aggregation_handle_packet(mesh_addr_t *from,
+                                           uint8_t data_type,
+                                           uint8_t *payload, uint16_t length) {
+  if (mesh_state_is_root() || length < sizeof(mesh_aggregate_header_t)) {
+    return false;
+  }
+
+  mesh_aggregate_t *agg = mesh_aggregation_find(payload[0]);
+  if (agg == NULL) {
+    ESP_LOGW(TAG, "Aggregate of unexpected type 0x%02x from " MACSTR,
+             payload[0], MAC2STR(from->addr));
+    return true;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  if (!mesh_aggregate_merge(agg, payload, length)) {
+    mesh_aggregation_flush(agg);
+    s_stats.early_flushes++;
+    if (!mesh_aggregate_merge(agg, payload, length)) {
+      s_stats.dropped++;
+      ESP_LOGW(TAG, "Malformed aggregate from " MACSTR, MAC2STR(from->addr));
+    }
+  }
+  s_stats.frames_in++;
+  xSemaphoreGive(s_lock);
+  return true;
+}
+
+esp_err_t mesh_aggregation_submit(uint8_t data_type, const uint8_t *payload,
+                                  uint16_t length) {
+  if (!s_initialized || mesh_state_is_root() ||
+      length % sizeof(mesh_sensor_reading_t) != 0) {
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+
+  mesh_aggregate_t *agg = mesh_aggregation_find(data_type);
+  if (agg == NULL) {
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+
+  // A root that cannot decode aggregate frames gets the readings as they are
+  mesh_node_caps_t root;
+  mesh_peer_caps(NULL, &root);
+  if (!(root.features & MESH_NODE_FEATURE_AGGREGATE)) {
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+
+  const mesh_sensor_reading_t *readings =
+      (const mesh_sensor_reading_t *)payload;
+  int count = length / sizeof(mesh_sensor_reading_t);
+  esp_err_t err = ESP_OK;
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  if (!mesh_aggregate_add(agg, s_own_addr, readings, count)) {
+    mesh_aggregation_flush(agg);
+    s_stats.early_flushes++;
+    if (!mesh_aggregate_add(agg, s_own_addr, readings, count)) {
+      err = ESP_ERR_NOT_SUPPORTED; // too large to aggregate, send as is
+    }
+  }
+  if (err == ESP_OK) {
+    s_stats.readings_in++;
+  }
+  xSemaphoreGive(s_lock);
+  return err;
+}
+
+/*******************************************************
+ *                Public Functions
+ *******************************************************/
+esp_err_t mesh_aggregation_init(const mesh_aggregation_config_t *config) {
+  if (config == NULL || config->type_count <= 0 ||
+      config->type_count > MESH_AGGREGATION_MAX_TYPES) {
+    ESP_LOGE(TAG, "Invalid arguments");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (s_initialized) {
+    ESP_LOGW(TAG, "Already initialized");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  memcpy(&s_config, config, sizeof(s_config));
+  if (s_config.window_ms == 0) {
+    s_config.window_ms = MESH_AGGREGATION_DEFAULT_WINDOW_MS;
+  }
+  esp_read_mac(s_own_addr, ESP_MAC_WIFI_STA);
+
+  s_lock = xSemaphoreCreateMutex();
+  s_aggs = calloc(s_config.type_count, sizeof(mesh_aggregate_t));
+  if (s_lock == NULL || s_aggs == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  for (int i = 0; i < s_config.type_count; i++) {
+    mesh_aggregate_reset(&s_aggs[i], s_config.data_types[i], s_config.mode);
+  }
+
+  esp_timer_create_args_t timer_args = {
+      .callback = mesh_aggregation_window_cb,
+      .name = "mesh_agg_window",
+  };
+  if (esp_timer_create(&timer_args, &s_window_timer) != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to create window timer");
+    return ESP_ERR_NO_MEM;
+  }
+
+  esp_err_t err = mesh_data_transfer_register_type_handler(
+      MESH_DATA_TYPE_AGGREGATE, mesh_aggregation_handle_packet);
+  if (err != ESP_OK) {
+    return err;
+  }
+  // On the root the frames go on to the application
+  mesh_caps_add_feature(MESH_NODE_FEATURE_AGGREGATE);
+
+  esp_timer_start_periodic(s_window_timer,
+                           (uint64_t)s_config.window_ms * 1000);
+  s_initialized = true;
+  ESP_LOGI(TAG, "Aggregating %d data types, window %u ms", s_config.type_count,
+           s_config.window_ms);
+  return ESP_OK;
+}
+
+esp_err_t mesh_aggregation_get_stats(mesh_aggregation_stats_t *stats) {
+  if (stats == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (s_lock != NULL) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+  }
+  *stats = s_stats;
+  if (s_lock != NULL) {
+    xSemaphoreGive(s_lock);
+  }
+  return ESP_OK;
+}
@@ -0,0 +1,332 @@
+/* ESP-MESH Relay Load Balancing Implementation */
+
+#include "mesh_balance.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_mesh.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "mesh_data_transfer.h"
+#include "mesh_internal.h"
+#include <stddef.h>
+#include <string.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+static const char *TAG = "mesh_balance";
+
+/*******************************************************
+ *                Wire Format
+ *******************************************************/
+typedef enum {
+  MESH_BALANCE_OP_BUSY = 1,  /**< root -> all: busy relays */
+  MESH_BALANCE_OP_STEER = 2, /**< root or parent -> node: leave bssid */
+} mesh_balance_op_t;
+
+typedef struct {
+  uint8_t op;
+  uint8_t count;
+  mesh_balance_busy_t busy[MESH_BALANCE_MAX_BUSY];
+} __attribute__((packed)) mesh_balance_msg_busy_t;
+
+typedef struct {
+  uint8_t op;
+  uint8_t bssid[6];
+} __attribute__((packed)) mesh_balance_msg_steer_t;
+
+/* Read-only pass over the root's topology map */
+typedef struct {
+  uint32_t now_ms;
+  int busy_count;
+  mesh_balance_busy_t busy[MESH_BALANCE_MAX_BUSY];
+  bool steer_planned;
+  mesh_balance_steer_t steer;
+} mesh_balance_plan_t;
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static bool s_initialized = false;
+static mesh_balance_config_t s_config;
+static SemaphoreHandle_t s_lock = NULL;
+static mesh_balance_stats_t s_stats;
+
+/* Root side, used by the balance task only */
+static mesh_balance_history_t s_history;
+static mesh_balance_msg_busy_t s_sent_busy;
+static int s_periods_since_busy = 0;
+
+/* Relay side */
+static bool s_handed_off = false;
+static uint32_t s_last_handoff_ms = 0;
+
+/* Node side, guarded by s_lock */
+static mesh_balance_msg_busy_t s_busy;
+static bool s_avoiding = false;
+static uint8_t s_avoid_bssid[6];
+static uint32_t s_avoid_until_ms = 0;
+static bool s_accepted = false;
+static uint32_t s_last_accept_ms = 0;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static uint32_t now_ms(void) {
+  return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static void plan_visitor(const mesh_topology_engine_t *engine, void *arg) {
+  mesh_balance_plan_t *plan = (mesh_balance_plan_t *)arg;
+
+  plan->busy_count = mesh_balance_find_busy(engine, &s_config, plan->busy,
+                                            MESH_BALANCE_MAX_BUSY);
+  plan->steer_planned = mesh_balance_plan_steer(
+      engine, &s_config, &s_history, plan->now_ms, &plan->steer);
+}
+
+static void mesh_balance_root(void) {
+  mesh_balance_plan_t plan = {.now_ms = now_ms()};
+
+  if (mesh_topology_visit(plan_visitor, &plan) != ESP_OK) {
+    return;
+  }
+
+  // Resend an unchanged list now and then for nodes that joined since
+  mesh_balance_msg_busy_t msg = {.op = MESH_BALANCE_OP_BUSY,
+                                 .count = plan.busy_count};
+  memcpy(msg.busy, plan.busy, plan.busy_count * sizeof(msg.busy[0]));
+  bool changed = memcmp(&msg, &s_sent_busy, sizeof(msg)) != 0;
+  bool refresh = plan.busy_count > 0 && ++s_periods_since_busy >=
+                                            MESH_BALANCE_BUSY_REFRESH_PERIODS;
+  if (changed || refresh) {
+    uint16_t length = offsetof(mesh_balance_msg_busy_t, busy) +
+                      plan.busy_count * sizeof(msg.busy[0]);
+    if (mesh_broadcast_from_root(MESH_DATA_TYPE_BALANCE, (uint8_t *)&msg,
+                                 length) == ESP_OK) {
+      s_sent_busy = msg;
+      s_periods_since_busy = 0;
+      xSemaphoreTake(s_lock, portMAX_DELAY);
+      s_stats.busy_updates++;
+      xSemaphoreGive(s_lock);
+    }
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  s_stats.busy_relays = plan.busy_count;
+  xSemaphoreGive(s_lock);
+
+  if (!plan.steer_planned) {
+    return;
+  }
+
+  mesh_balance_msg_steer_t steer = {.op = MESH_BALANCE_OP_STEER};
+  mesh_addr_t child;
+  memcpy(steer.bssid, plan.steer.parent, 6);
+  steer.bssid[5] += 1; // softAP BSSID is one above the station MAC
+  memcpy(child.addr, plan.steer.child, 6);
+  esp_err_t err =
+      mesh_data_send_packet(&child, MESH_DATA_FROMDS | MESH_DATA_NONBLOCK,
+                            MESH_DATA_TYPE_BALANCE, (uint8_t *)&steer,
+                            sizeof(steer), NULL, 0);
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "Failed to steer " MACSTR ": %s", MAC2STR(child.addr),
+             esp_err_to_name(err));
+    return;
+  }
+
+  ESP_LOGI(TAG, "Steering " MACSTR " off " MACSTR " (%" PRIu32 " of %" PRIu32
+           " relayed)", MAC2STR(child.addr), MAC2STR(plan.steer.parent),
+           plan.steer.moved, plan.steer.relayed);
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  s_stats.steers_sent++;
+  xSemaphoreGive(s_lock);
+}
+
+static void mesh_balance_relay(void) {
+  wifi_sta_list_t children;
+  int cap = esp_mesh_get_ap_connections();
+  uint32_t now = now_ms();
+
+  if (s_handed_off && now - s_last_handoff_ms < s_config.handoff_interval_ms) {
+    return;
+  }
+  if (esp_wifi_ap_get_sta_list(&children) != ESP_OK || children.num < 2 ||
+      cap <= 0 || children.num * 100 < cap * s_config.assoc_high_percent) {
+    return;
+  }
+
+  // The child with the weakest link is the likeliest to hear other parents
+  int weakest = 0;
+  for (int i = 1; i < children.num; i++) {
+    if (children.sta[i].rssi < children.sta[weakest].rssi) {
+      weakest = i;
+    }
+  }
+
+  mesh_balance_msg_steer_t steer = {.op = MESH_BALANCE_OP_STEER};
+  mesh_addr_t child;
+  esp_read_mac(steer.bssid, ESP_MAC_WIFI_SOFTAP);
+  memcpy(child.addr, children.sta[weakest].mac, 6);
+  if (mesh_data_send_packet(&child, MESH_DATA_P2P | MESH_DATA_NONBLOCK,
+                            MESH_DATA_TYPE_BALANCE, (uint8_t *)&steer,
+                            sizeof(steer), NULL, 0) != ESP_OK) {
+    return;
+  }
+
+  ESP_LOGI(TAG, "%d of %d slots used, handing off " MACSTR, children.num,
+           cap, MAC2STR(child.addr));
+  s_handed_off = true;
+  s_last_handoff_ms = now;
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  s_stats.handoffs_sent++;
+  xSemaphoreGive(s_lock);
+}
+
+static void mesh_balance_task(void *arg) {
+  mesh_state_t state;
+
+  while (1) {
+    vTaskDelay(pdMS_TO_TICKS(s_config.period_ms));
+    mesh_state_get(&state);
+    if (!state.started) {
+      continue;
+    }
+
+    if (state.is_root) {
+      mesh_balance_root();
+    } else if (state.connected) {
+      mesh_balance_relay();
+    }
+  }
+}
+
+static void mesh_balance_steer_received(const mesh_balance_msg_steer_t *msg) {
+  mesh_state_t state;
+  uint32_t now = now_ms();
+  bool accept;
+
+  mesh_state_get(&state);
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  s_stats.steers_received++;
+  accept = state.connected && !state.is_root &&
+           memcmp(msg->bssid, state.parent.addr, 6) == 0 &&
+           (!s_accepted || now - s_last_accept_ms >= s_config.node_cooldown_ms);
+  if (accept && mesh_request_steer(msg->bssid) == ESP_OK) {
+    s_stats.steers_accepted++;
+    s_accepted = true;
+    s_last_accept_ms = now;
+    s_avoiding = true;
+    memcpy(s_avoid_bssid, msg->bssid, 6);
+    s_avoid_until_ms = now + s_config.avoid_ms;
+  } else {
+    s_stats.steers_ignored++;
+  }
+  xSemaphoreGive(s_lock);
+}
+
+static bool mesh_balance_handle_packet(mesh_addr_t *from, uint8_t data_type,
+                                       uint8_t *payload, uint16_t length) {
+  if (length == sizeof(mesh_balance_msg_steer_t) &&
+      payload[0] == MESH_BALANCE_OP_STEER) {
+    mesh_balance_msg_steer_t msg;
+    memcpy(&msg, payload, sizeof(msg));
+    mesh_balance_steer_received(&msg);
+  } else if (length >= offsetof(mesh_balance_msg_busy_t, busy) &&
+             payload[0] == MESH_BALANCE_OP_BUSY &&
+             payload[1] <= MESH_BALANCE_MAX_BUSY &&
+             length == offsetof(mesh_balance_msg_busy_t, busy) +
+                           payload[1] * sizeof(mesh_balance_busy_t)) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    memset(&s_busy, 0, sizeof(s_busy));
+    memcpy(&s_busy, payload, length);
+    xSemaphoreGive(s_lock);
+  }
+  return true;
+}
+
+int16_t mesh_balance_penalty(const uint8_t *bssid) {
+  int16_t penalty = 0;
+
+  if (s_lock == NULL) {
+    return 0;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  for (int i = 0; i < s_busy.count; i++) {
+    if (memcmp(s_busy.busy[i].bssid, bssid, 6) == 0) {
+      penalty += s_busy.busy[i].penalty;
+    }
+  }
+  // Keeps a moved node from drifting straight back
+  if (s_avoiding && (int32_t)(s_avoid_until_ms - now_ms()) > 0 &&
+      memcmp(s_avoid_bssid, bssid, 6) == 0) {
+    penalty += 2 * s_config.busy_penalty;
+  }
+  xSemaphoreGive(s_lock);
+  return penalty;
+}
+
+/*******************************************************
+ *                Public Functions
+ *******************************************************/
+esp_err_t mesh_balance_init(const mesh_balance_config_t *config) {
+  if (s_initialized) {
+    ESP_LOGW(TAG, "Already initialized");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  if (config != NULL) {
+    s_config = *config;
+  } else {
+    mesh_balance_config_default(&s_config);
+  }
+  if (s_config.period_ms == 0) {
+    ESP_LOGE(TAG, "Invalid period");
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (s_config.traffic_ratio_percent < 100) {
+    ESP_LOGE(TAG, "Invalid traffic ratio");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  s_lock = xSemaphoreCreateMutex();
+  if (s_lock == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  esp_err_t err = mesh_data_transfer_register_type_handler(
+      MESH_DATA_TYPE_BALANCE, mesh_balance_handle_packet);
+  if (err != ESP_OK) {
+    return err;
+  }
+
+  if (xTaskCreate(mesh_balance_task, "mesh_balance",
+                  MESH_BALANCE_TASK_STACK_SIZE, NULL,
+                  MESH_BALANCE_TASK_PRIORITY, NULL) != pdPASS) {
+    ESP_LOGE(TAG, "Failed to create balance task");
+    return ESP_ERR_NO_MEM;
+  }
+
+  s_initialized = true;
+  return ESP_OK;
+}
+
+esp_err_t mesh_balance_get_stats(mesh_balance_stats_t *stats) {
+  if (stats == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (s_lock == NULL) {
+    memset(stats, 0, sizeof(*stats));
+    return ESP_OK;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  *stats = s_stats;
+  xSemaphoreGive(s_lock);
+  return ESP_OK;
+}
@@ -0,0 +1,177 @@
+/* Relay Load Balancing Engine Implementation */
+
+#include "mesh_balance_engine.h"
+#include <string.h>
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static uint32_t node_relayed(const mesh_topology_node_t *node) {
+  if (node->first_child == MESH_TOPOLOGY_NONE) {
+    return 0;
+  }
+  return node->subtree_traffic - node->traffic;
+}
+
+/**
+ * @brief Find busy relays, busiest first
+ *
+ * @return Number of relays written to idx and relayed
+ */
+static int collect_busy(const mesh_topology_engine_t *topology,
+                        const mesh_balance_config_t *config, uint16_t *idx,
+                        uint32_t *relayed, uint32_t *mean, int max_busy) {
+  uint32_t sums[MESH_BALANCE_MAX_LAYERS] = {0};
+  uint16_t counts[MESH_BALANCE_MAX_LAYERS] = {0};
+  int count = 0;
+
+  // Idle nodes count towards the mean of their layer: they are parents
+  // the children of its relays could have chosen instead
+  for (int i = 0; i < MESH_TOPOLOGY_MAX_NODES; i++) {
+    const mesh_topology_node_t *node = &topology->nodes[i];
+    if (node->used && i != topology->root &&
+        node->layer < MESH_BALANCE_MAX_LAYERS) {
+      sums[node->layer] += node_relayed(node);
+      counts[node->layer]++;
+    }
+  }
+
+  for (int i = 0; i < MESH_TOPOLOGY_MAX_NODES; i++) {
+    const mesh_topology_node_t *node = &topology->nodes[i];
+    if (!node->used || i == topology->root ||
+        node->layer >= MESH_BALANCE_MAX_LAYERS || counts[node->layer] < 2) {
+      continue;
+    }
+
+    // At or below the mean is never busy, whatever the configured ratio
+    uint32_t load = node_relayed(node);
+    uint64_t sum = sums[node->layer];
+    uint64_t scaled = (uint64_t)load * counts[node->layer];
+    if (load < config->min_relayed || scaled <= sum ||
+        scaled * 100 < sum * config->traffic_ratio_percent) {
+      continue;
+    }
+
+    int pos = count < max_busy ? count++ : max_busy;
+    while (pos > 0 && relayed[pos - 1] < load) {
+      if (pos < max_busy) {
+        idx[pos] = idx[pos - 1];
+        relayed[pos] = relayed[pos - 1];
+        mean[pos] = mean[pos - 1];
+      }
+      pos--;
+    }
+    if (pos < max_busy) {
+      idx[pos] = (uint16_t)i;
+      relayed[pos] = load;
+      mean[pos] = (uint32_t)(sum / counts[node->layer]);
+    }
+  }
+  return count;
+}
+
+static bool recently_steered(const mesh_balance_history_t *history,
+                             const mesh_balance_config_t *config,
+                             const uint8_t *mac, uint32_t now_ms) {
+  for (int i = 0; i < MESH_BALANCE_HISTORY_SIZE; i++) {
+    if (memcmp(history->mac[i], mac, 6) == 0 &&
+        now_ms - history->time_ms[i] < config->node_cooldown_ms) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void mesh_balance_config_default(mesh_balance_config_t *config) {
+  config->period_ms = MESH_BALANCE_DEFAULT_PERIOD_MS;
+  config->assoc_high_percent = MESH_BALANCE_DEFAULT_ASSOC_HIGH;
+  config->traffic_ratio_percent = MESH_BALANCE_DEFAULT_TRAFFIC_RATIO;
+  config->min_relayed = MESH_BALANCE_DEFAULT_MIN_RELAYED;
+  config->busy_penalty = MESH_BALANCE_DEFAULT_PENALTY;
+  config->steer_interval_ms = MESH_BALANCE_DEFAULT_STEER_INTERVAL_MS;
+  config->handoff_interval_ms = MESH_BALANCE_DEFAULT_HANDOFF_INTERVAL_MS;
+  config->node_cooldown_ms = MESH_BALANCE_DEFAULT_NODE_COOLDOWN_MS;
+  config->avoid_ms = MESH_BALANCE_DEFAULT_AVOID_MS;
+}
+
+int mesh_balance_find_busy(const mesh_topology_engine_t *topology,
+                           const mesh_balance_config_t *config,
+                           mesh_balance_busy_t *busy, int max_busy) {
+  uint16_t idx[MESH_BALANCE_MAX_BUSY];
+  uint32_t relayed[MESH_BALANCE_MAX_BUSY];
+  uint32_t mean[MESH_BALANCE_MAX_BUSY];
+
+  if (max_busy > MESH_BALANCE_MAX_BUSY) {
+    max_busy = MESH_BALANCE_MAX_BUSY;
+  }
+  int count = collect_busy(topology, config, idx, relayed, mean, max_busy);
+
+  for (int i = 0; i < count; i++) {
+    // Scaled by how far over the threshold the relay is, at most 4x
+    uint64_t limit = (uint64_t)mean[i] * config->traffic_ratio_percent;
+    uint64_t scale = limit > 0 ? (uint64_t)relayed[i] * 10000 / limit : 400;
+    if (scale > 400) {
+      scale = 400;
+    }
+    memcpy(busy[i].bssid, topology->nodes[idx[i]].mac, 6);
+    busy[i].bssid[5] += 1; // softAP BSSID is one above the station MAC
+    busy[i].penalty = (int16_t)(config->busy_penalty * (int32_t)scale / 100);
+  }
+  return count;
+}
+
+bool mesh_balance_plan_steer(const mesh_topology_engine_t *topology,
+                             const mesh_balance_config_t *config,
+                             mesh_balance_history_t *history, uint32_t now_ms,
+                             mesh_balance_steer_t *steer) {
+  uint16_t idx[MESH_BALANCE_MAX_BUSY];
+  uint32_t relayed[MESH_BALANCE_MAX_BUSY];
+  uint32_t mean[MESH_BALANCE_MAX_BUSY];
+
+  if (history->steered &&
+      now_ms - history->last_steer_ms < config->steer_interval_ms) {
+    return false;
+  }
+
+  int count = collect_busy(topology, config, idx, relayed, mean,
+                           MESH_BALANCE_MAX_BUSY);
+  for (int i = 0; i < count; i++) {
+    const mesh_topology_node_t *relay = &topology->nodes[idx[i]];
+    uint32_t excess = relayed[i] - mean[i];
+    uint16_t best = MESH_TOPOLOGY_NONE;
+    uint32_t best_error = UINT32_MAX;
+
+    // Moving a subtree carrying t leaves relayed - t here and about
+    // mean + t at the new parent; t = excess / 2 evens them out
+    for (uint16_t c = relay->first_child; c != MESH_TOPOLOGY_NONE;
+         c = topology->nodes[c].next_sibling) {
+      const mesh_topology_node_t *child = &topology->nodes[c];
+      uint32_t t = child->subtree_traffic;
+      if (t == 0 || t >= excess ||
+          recently_steered(history, config, child->mac, now_ms)) {
+        continue;
+      }
+      uint32_t error = 2 * t > excess ? 2 * t - excess : excess - 2 * t;
+      if (error < best_error) {
+        best_error = error;
+        best = c;
+      }
+    }
+    if (best == MESH_TOPOLOGY_NONE) {
+      continue;
+    }
+
+    memcpy(steer->child, topology->nodes[best].mac, 6);
+    memcpy(steer->parent, relay->mac, 6);
+    steer->relayed = relayed[i];
+    steer->moved = topology->nodes[best].subtree_traffic;
+
+    memcpy(history->mac[history->next], steer->child, 6);
+    history->time_ms[history->next] = now_ms;
+    history->next = (history->next + 1) % MESH_BALANCE_HISTORY_SIZE;
+    history->steered = true;
+    history->last_steer_ms = now_ms;
+    return true;
+  }
+  return false;
+}
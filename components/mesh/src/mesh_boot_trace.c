@@ -0,0 +1,239 @@
+/* ESP-MESH Boot Trace Implementation */
+
+#include "mesh_boot_trace.h"
+#include "esp_attr.h"
+#include "esp_crc.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "mesh_internal.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+static const char *TAG = "mesh_boot";
+
+/* Query layout: base | phase << 8 | threshold in units, 0 = phase time */
+#define QUERY_PHASE_SHIFT (8)
+#define QUERY_PHASE_MASK (0x0F)
+#define QUERY_THRESHOLD_MASK (0xFF)
+
+#define HISTORY_MAGIC (0x42545448) /* "BTTH" */
+
+static const char *s_phase_names[MESH_BOOT_PHASE_MAX] = {
+    "mesh_init",    "mesh_started", "scan_done",
+    "parent_conn",  "root_address", "tods_state",
+    "got_ip",       "first_send",   "first_receive",
+};
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/* Time to first packet of recent boots, index 0 cold and 1 warm */
+typedef struct {
+  uint32_t magic;
+  uint32_t crc;
+  uint32_t counts[2];
+  uint32_t samples[2][MESH_BOOT_TRACE_SAMPLES];
+} boot_history_t;
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static int64_t s_phase_us[MESH_BOOT_PHASE_MAX];
+static bool s_warm = false;
+static uint32_t s_first_packet_ms = 0;
+
+/* Survives software resets and deep sleep, not power cycles */
+static RTC_NOINIT_ATTR boot_history_t s_history;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static uint32_t history_crc(void) {
+  return esp_crc32_le(0, (const uint8_t *)s_history.counts,
+                      sizeof(s_history) - offsetof(boot_history_t, counts));
+}
+
+static void history_validate(void) {
+  if (s_history.magic != HISTORY_MAGIC || s_history.crc != history_crc()) {
+    memset(&s_history, 0, sizeof(s_history));
+    s_history.magic = HISTORY_MAGIC;
+    s_history.crc = history_crc();
+  }
+}
+
+static void history_add(uint32_t ms) {
+  int kind = s_warm ? 1 : 0;
+
+  history_validate();
+  s_history.samples[kind][s_history.counts[kind] % MESH_BOOT_TRACE_SAMPLES] =
+      ms;
+  s_history.counts[kind]++;
+  s_history.crc = history_crc();
+}
+
+static uint32_t history_median(int kind) {
+  uint32_t sorted[MESH_BOOT_TRACE_SAMPLES];
+  int n = s_history.counts[kind] < MESH_BOOT_TRACE_SAMPLES
+              ? s_history.counts[kind]
+              : MESH_BOOT_TRACE_SAMPLES;
+
+  if (n == 0) {
+    return 0;
+  }
+  memcpy(sorted, s_history.samples[kind], n * sizeof(uint32_t));
+  for (int i = 1; i < n; i++) {
+    uint32_t v = sorted[i];
+    int j = i - 1;
+    while (j >= 0 && sorted[j] > v) {
+      sorted[j + 1] = sorted[j];
+      j--;
+    }
+    sorted[j + 1] = v;
+  }
+  return sorted[n / 2];
+}
+
+void mesh_boot_trace_mark(mesh_boot_phase_t phase) {
+  if (phase >= MESH_BOOT_PHASE_MAX || s_phase_us[phase] != 0) {
+    return;
+  }
+
+  s_phase_us[phase] = esp_timer_get_time();
+  if ((phase == MESH_BOOT_PHASE_FIRST_SEND ||
+       phase == MESH_BOOT_PHASE_FIRST_RECEIVE) &&
+      s_first_packet_ms == 0) {
+    s_first_packet_ms = s_phase_us[phase] / 1000;
+    history_add(s_first_packet_ms);
+    ESP_LOGI(TAG, "First packet after %" PRIu32 " ms (%s boot)",
+             s_first_packet_ms, s_warm ? "warm" : "cold");
+  }
+}
+
+void mesh_boot_trace_set_warm(bool warm) { s_warm = warm; }
+
+esp_err_t mesh_boot_trace_answer(uint16_t query, float *value) {
+  if ((query & ~0x0FFF) != MESH_BOOT_TRACE_QUERY_BASE) {
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+
+  int phase = (query >> QUERY_PHASE_SHIFT) & QUERY_PHASE_MASK;
+  int threshold = query & QUERY_THRESHOLD_MASK;
+  if (phase >= MESH_BOOT_PHASE_MAX || s_phase_us[phase] == 0) {
+    return ESP_ERR_NOT_FOUND; // counted as present, without a value
+  }
+
+  float phase_ms = s_phase_us[phase] / 1000.0f;
+  if (threshold == 0) {
+    *value = phase_ms;
+  } else {
+    *value = (phase_ms < threshold * MESH_BOOT_TRACE_QUERY_UNIT_MS) ? 1 : 0;
+  }
+  return ESP_OK;
+}
+
+esp_err_t mesh_boot_trace_get(mesh_boot_record_t *record) {
+  if (record == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  memcpy(record->phase_us, s_phase_us, sizeof(s_phase_us));
+  record->reset_reason = esp_reset_reason();
+  record->warm = s_warm;
+  return ESP_OK;
+}
+
+esp_err_t mesh_boot_trace_get_stats(mesh_boot_stats_t *stats) {
+  if (stats == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  history_validate();
+  stats->boots_cold = s_history.counts[0];
+  stats->boots_warm = s_history.counts[1];
+  stats->median_cold_ms = history_median(0);
+  stats->median_warm_ms = history_median(1);
+  stats->last_ms = s_first_packet_ms;
+  return ESP_OK;
+}
+
+const char *mesh_boot_phase_name(mesh_boot_phase_t phase) {
+  return (phase < MESH_BOOT_PHASE_MAX) ? s_phase_names[phase] : "unknown";
+}
+
+void mesh_boot_trace_log(void) {
+  int64_t previous = 0;
+
+  ESP_LOGI(TAG, "Boot trace (%s boot, reset reason %d):",
+           s_warm ? "warm" : "cold", esp_reset_reason());
+  for (int i = 0; i < MESH_BOOT_PHASE_MAX; i++) {
+    if (s_phase_us[i] == 0) {
+      continue;
+    }
+    ESP_LOGI(TAG, "  %-14s %8lld us (+%lld us)", s_phase_names[i],
+             (long long)s_phase_us[i], (long long)(s_phase_us[i] - previous));
+    previous = s_phase_us[i];
+  }
+}
+
+esp_err_t mesh_boot_trace_collect(mesh_boot_phase_t phase, uint32_t bucket_ms,
+                                  uint8_t bucket_count, uint32_t timeout_ms,
+                                  mesh_boot_histogram_t *histogram) {
+  uint32_t units = (bucket_ms + MESH_BOOT_TRACE_QUERY_UNIT_MS - 1) /
+                   MESH_BOOT_TRACE_QUERY_UNIT_MS;
+
+  if (phase >= MESH_BOOT_PHASE_MAX || histogram == NULL || units == 0 ||
+      bucket_count == 0 || bucket_count > MESH_BOOT_TRACE_MAX_BUCKETS ||
+      units * (bucket_count - 1) > QUERY_THRESHOLD_MASK) {
+    ESP_LOGE(TAG, "Invalid arguments");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  memset(histogram, 0, sizeof(*histogram));
+  histogram->bucket_ms = units * MESH_BOOT_TRACE_QUERY_UNIT_MS;
+  histogram->bucket_count = bucket_count;
+
+  uint16_t query = MESH_BOOT_TRACE_QUERY_BASE | (phase << QUERY_PHASE_SHIFT);
+  mesh_collect_result_t result;
+  esp_err_t status = ESP_OK;
+
+  // Summary: who reached the phase, and when
+  esp_err_t err = mesh_collect(query, timeout_ms, &result);
+  if (err != ESP_OK && err != ESP_ERR_TIMEOUT) {
+    return err;
+  }
+  status = err;
+  histogram->responded = result.responded;
+  histogram->reached = result.value_count;
+  if (result.value_count > 0) {
+    histogram->min_ms = result.min;
+    histogram->max_ms = result.max;
+    histogram->mean_ms = result.sum / result.value_count;
+  }
+
+  // Nodes below each bucket boundary; buckets are the differences
+  uint16_t below_previous = 0;
+  for (int i = 0; i < bucket_count - 1; i++) {
+    err = mesh_collect(query | (units * (i + 1)), timeout_ms, &result);
+    if (err != ESP_OK && err != ESP_ERR_TIMEOUT) {
+      return err;
+    }
+    if (err != ESP_OK) {
+      status = err;
+    }
+    uint16_t below = (uint16_t)result.sum;
+    histogram->counts[i] = (below > below_previous) ? below - below_previous
+                                                    : 0;
+    below_previous = below;
+  }
+  uint16_t reached = histogram->reached;
+  histogram->counts[bucket_count - 1] =
+      (reached > below_previous) ? reached - below_previous : 0;
+
+  return status;
+}
@@ -0,0 +1,264 @@
+/* ESP-MESH Collective Poll Implementation */
+
+#include "mesh_collect.h"
+#include "mesh_collect_engine.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_mesh.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "mesh_data_transfer.h"
+#include "mesh_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+static const char *TAG = "mesh_collect";
+
+/*******************************************************
+ *                Wire Format
+ *******************************************************/
+typedef struct {
+  uint8_t op;
+  uint16_t req_id;
+  uint16_t query;
+  uint32_t timeout_ms;
+} __attribute__((packed)) mesh_collect_msg_request_t;
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static bool s_initialized = false;
+static mesh_collect_responder_t s_responder = NULL;
+static SemaphoreHandle_t s_lock = NULL;
+static SemaphoreHandle_t s_done = NULL;
+static esp_timer_handle_t s_timer = NULL;
+
+/* Collection in progress on this node; the root uses the same accumulator */
+static mesh_collect_msg_reply_t s_acc;
+static bool s_collecting = false;
+static uint16_t s_expected = 0;
+static uint16_t s_next_req_id = 0;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+/**
+ * @brief Forward the merged subtree reply; called with s_lock held
+ */
+static void reply_send(void) {
+  s_collecting = false;
+  esp_timer_stop(s_timer);
+
+  esp_err_t err =
+      mesh_data_send_to_parent(MESH_DATA_TYPE_COLLECT, (const uint8_t *)&s_acc,
+                               sizeof(s_acc), MESH_DATA_NONBLOCK);
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "Failed to forward reply %u: %s", s_acc.req_id,
+             esp_err_to_name(err));
+  }
+}
+
+static void mesh_collect_timer_cb(void *arg) {
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  if (s_collecting) {
+    ESP_LOGD(TAG, "Reply %u timed out with %u of %u nodes", s_acc.req_id,
+             s_acc.responded, s_expected);
+    reply_send();
+  }
+  xSemaphoreGive(s_lock);
+}
+
+static void mesh_collect_node_request(const mesh_collect_msg_request_t *req) {
+  float value = 0;
+
+  esp_err_t err = mesh_boot_trace_answer(req->query, &value);
+  if (err == ESP_ERR_NOT_SUPPORTED) {
+    err = (s_responder != NULL) ? s_responder(req->query, &value) : ESP_FAIL;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  if (s_acc.req_id == req->req_id && s_acc.responded > 0) {
+    xSemaphoreGive(s_lock);
+    return; // duplicate request
+  }
+  mesh_collect_reply_init(&s_acc, req->req_id);
+  mesh_collect_reply_answer(&s_acc, mesh_get_own_node_id(), err == ESP_OK,
+                            value);
+
+  // The routing table of a node covers its own subtree, itself included
+  s_expected = esp_mesh_get_routing_table_size();
+  if (s_acc.responded >= s_expected) {
+    reply_send();
+  } else {
+    mesh_state_t state;
+    mesh_state_get(&state);
+    uint32_t wait_ms = mesh_collect_wait_ms(req->timeout_ms, state.layer,
+                                            esp_mesh_get_max_layer());
+    s_collecting = true;
+    esp_timer_start_once(s_timer, (uint64_t)wait_ms * 1000);
+  }
+  xSemaphoreGive(s_lock);
+}
+
+static void mesh_collect_reply(const mesh_collect_msg_reply_t *reply) {
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  if (!s_collecting || reply->req_id != s_acc.req_id) {
+    xSemaphoreGive(s_lock);
+    if (!mesh_state_is_root()) {
+      // Late reply from a slow branch: pass it on unmerged
+      mesh_data_send_to_parent(MESH_DATA_TYPE_COLLECT, (const uint8_t *)reply,
+                               sizeof(*reply), MESH_DATA_NONBLOCK);
+    }
+    return;
+  }
+
+  mesh_collect_reply_merge(&s_acc, reply);
+  if (s_acc.responded >= s_expected) {
+    if (mesh_state_is_root()) {
+      s_collecting = false;
+      xSemaphoreGive(s_done);
+    } else {
+      reply_send();
+    }
+  }
+  xSemaphoreGive(s_lock);
+}
+
+static bool mesh_collect_handle_packet(mesh_addr_t *from, uint8_t data_type,
+                                       uint8_t *payload, uint16_t length) {
+  if (length == sizeof(mesh_collect_msg_request_t) &&
+      payload[0] == MESH_COLLECT_OP_REQUEST && !mesh_state_is_root()) {
+    mesh_collect_msg_request_t req;
+    memcpy(&req, payload, sizeof(req));
+    mesh_collect_node_request(&req);
+  } else if (length == sizeof(mesh_collect_msg_reply_t) &&
+             payload[0] == MESH_COLLECT_OP_REPLY) {
+    mesh_collect_msg_reply_t reply;
+    memcpy(&reply, payload, sizeof(reply));
+    mesh_collect_reply(&reply);
+  }
+  return true;
+}
+
+/*******************************************************
+ *                Public Functions
+ *******************************************************/
+esp_err_t mesh_collect_init(mesh_collect_responder_t responder) {
+  if (s_initialized) {
+    ESP_LOGW(TAG, "Already initialized");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  s_lock = xSemaphoreCreateMutex();
+  s_done = xSemaphoreCreateBinary();
+  if (s_lock == NULL || s_done == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  esp_timer_create_args_t timer_args = {
+      .callback = mesh_collect_timer_cb,
+      .name = "mesh_collect",
+  };
+  if (esp_timer_create(&timer_args, &s_timer) != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to create timer");
+    return ESP_ERR_NO_MEM;
+  }
+
+  esp_err_t err = mesh_data_transfer_register_type_handler(
+      MESH_DATA_TYPE_COLLECT, mesh_collect_handle_packet);
+  if (err != ESP_OK) {
+    return err;
+  }
+
+  s_responder = responder;
+  s_initialized = true;
+  return ESP_OK;
+}
+
+esp_err_t mesh_collect(uint16_t query, uint32_t timeout_ms,
+                       mesh_collect_result_t *result) {
+  if (result == NULL) {
+    ESP_LOGE(TAG, "Invalid arguments");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (!s_initialized || s_collecting) {
+    ESP_LOGE(TAG, "Not initialized or collection running");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  if (!mesh_state_is_root()) {
+    ESP_LOGE(TAG, "Only root can collect");
+    return ESP_FAIL;
+  }
+
+  if (timeout_ms == 0) {
+    timeout_ms = MESH_COLLECT_DEFAULT_TIMEOUT_MS;
+  }
+
+  // Every node but the root itself is polled
+  int size = esp_mesh_get_routing_table_size();
+  mesh_addr_t *targets = malloc(size * sizeof(mesh_addr_t));
+  if (targets == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  uint8_t own_addr[6];
+  int count = 0;
+  esp_read_mac(own_addr, ESP_MAC_WIFI_STA);
+  esp_mesh_get_routing_table(targets, size * sizeof(mesh_addr_t), &size);
+  for (int i = 0; i < size; i++) {
+    if (memcmp(targets[i].addr, own_addr, sizeof(own_addr)) != 0) {
+      targets[count++] = targets[i];
+    }
+  }
+
+  memset(result, 0, sizeof(*result));
+  result->expected = count;
+  if (count == 0) {
+    free(targets);
+    return ESP_OK;
+  }
+
+  mesh_collect_msg_request_t req = {
+      .op = MESH_COLLECT_OP_REQUEST,
+      .query = query,
+      .timeout_ms = timeout_ms,
+  };
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  req.req_id = ++s_next_req_id;
+  mesh_collect_reply_init(&s_acc, req.req_id);
+  s_expected = count;
+  s_collecting = true;
+  xSemaphoreTake(s_done, 0);
+  xSemaphoreGive(s_lock);
+
+  int64_t start = esp_timer_get_time();
+  esp_err_t err = mesh_multicast_from_root(
+      targets, count, MESH_DATA_TYPE_COLLECT, (uint8_t *)&req, sizeof(req));
+  free(targets);
+  if (err == ESP_OK) {
+    xSemaphoreTake(s_done, pdMS_TO_TICKS(timeout_ms));
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  s_collecting = false;
+  result->responded = s_acc.responded;
+  result->value_count = s_acc.value_count;
+  result->min = s_acc.min;
+  result->max = s_acc.max;
+  result->sum = s_acc.sum;
+  memcpy(result->bitmap, s_acc.bitmap, sizeof(result->bitmap));
+  xSemaphoreGive(s_lock);
+  result->elapsed_ms = (esp_timer_get_time() - start) / 1000;
+
+  if (err != ESP_OK) {
+    return ESP_FAIL;
+  }
+  ESP_LOGI(TAG, "Collect %u: %u of %u nodes in %" PRIu32 " ms", req.req_id,
+           result->responded, result->expected, result->elapsed_ms);
+  return (result->responded >= result->expected) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
@@ -0,0 +1,60 @@
+/* Collective Poll Engine Implementation */
+
+#include "mesh_collect_engine.h"
+#include <string.h>
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+void mesh_collect_reply_init(mesh_collect_msg_reply_t *reply,
+                             uint16_t req_id) {
+  memset(reply, 0, sizeof(*reply));
+  reply->op = MESH_COLLECT_OP_REPLY;
+  reply->req_id = req_id;
+}
+
+void mesh_collect_reply_answer(mesh_collect_msg_reply_t *reply,
+                               uint8_t node_id, bool has_value, float value) {
+  mesh_collect_msg_reply_t own = {.responded = 1};
+
+  if (has_value) {
+    own.value_count = 1;
+    own.min = own.max = own.sum = value;
+  }
+  if (node_id != 0) {
+    own.bitmap[node_id / 8] |= 1 << (node_id % 8);
+  }
+  mesh_collect_reply_merge(reply, &own);
+}
+
+void mesh_collect_reply_merge(mesh_collect_msg_reply_t *reply,
+                              const mesh_collect_msg_reply_t *in) {
+  if (in->value_count > 0) {
+    if (reply->value_count == 0 || in->min < reply->min) {
+      reply->min = in->min;
+    }
+    if (reply->value_count == 0 || in->max > reply->max) {
+      reply->max = in->max;
+    }
+    reply->sum += in->sum;
+    reply->value_count += in->value_count;
+  }
+  reply->responded += in->responded;
+  for (int i = 0; i < MESH_COLLECT_BITMAP_BYTES; i++) {
+    reply->bitmap[i] |= in->bitmap[i];
+  }
+}
+
+uint32_t mesh_collect_wait_ms(uint32_t timeout_ms, int layer, int max_layer) {
+  if (max_layer < 1) {
+    max_layer = 1;
+  }
+  if (layer < 1) {
+    layer = 1;
+  } else if (layer > max_layer) {
+    layer = max_layer;
+  }
+  uint64_t wait_ms =
+      (uint64_t)timeout_ms * (uint32_t)(max_layer - layer + 1) / max_layer;
+  return wait_ms > 0 ? (uint32_t)wait_ms : 1;
+}
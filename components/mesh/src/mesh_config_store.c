@@ -0,0 +1,625 @@
+/* ESP-MESH Replicated Configuration Store Implementation */
+
+#include "mesh_config_store.h"
+#include "esp_log.h"
+#include "esp_mesh.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "mesh_data_transfer.h"
+#include "mesh_internal.h"
+#include "nvs.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+static const char *TAG = "mesh_config_store";
+
+/* Distinguishes the store from other MESH_DATA_TYPE_CONFIG payloads */
+#define MESH_CONFIG_STORE_MAGIC (0xDD)
+#define MESH_CONFIG_STORE_RECORD_VERSION (0x01)
+#define MESH_CONFIG_STORE_BASE_FULL (UINT32_MAX) /* pending full document */
+
+/* Group every node joins; multicast, locally administered */
+static const mesh_addr_t s_group = {
+    .addr = {0x03, 0x4D, 0x43, 0x46, 0x47, 0x01},
+};
+
+/*******************************************************
+ *                Wire Format
+ *******************************************************/
+typedef enum {
+  MESH_CONFIG_STORE_OP_DIFF = 1,   /**< root -> nodes: diff follows */
+  MESH_CONFIG_STORE_OP_ADVERT = 2, /**< node -> root: version held */
+} mesh_config_store_op_t;
+
+#define MESH_CONFIG_STORE_ADVERT_NEED_FULL (1 << 0)
+
+typedef struct {
+  uint8_t magic;
+  uint8_t op;
+} __attribute__((packed)) mesh_config_store_msg_header_t;
+
+typedef struct {
+  uint8_t magic;
+  uint8_t op;
+  uint8_t flags;
+  uint32_t version;
+  uint32_t digest;
+} __attribute__((packed)) mesh_config_store_msg_advert_t;
+
+/* NVS record */
+typedef struct {
+  uint8_t version;
+  mesh_config_doc_t doc;
+} mesh_config_store_record_t;
+
+/* A node waiting for a catch-up diff */
+typedef struct {
+  mesh_addr_t addr;
+  uint32_t base; /**< MESH_CONFIG_STORE_BASE_FULL for the full document */
+} mesh_config_store_pending_t;
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static bool s_initialized = false;
+static mesh_config_store_config_t s_config;
+static mesh_config_store_cb_t s_callback = NULL;
+
+/* Guarded by s_lock */
+static SemaphoreHandle_t s_lock = NULL;
+static mesh_config_doc_t s_doc;     /* applied, or published on the root */
+static mesh_config_doc_t s_work;    /* scratch for apply and publish */
+static mesh_config_doc_t *s_staged; /* root: next version, NULL if none */
+static mesh_config_store_stats_t s_stats;
+
+/* Root side, guarded by s_lock */
+static mesh_config_store_pending_t s_pending[MESH_CONFIG_STORE_MAX_PENDING];
+static int s_pending_count = 0;
+static uint32_t s_ahead_version = 0; /* highest version seen above ours */
+
+/* Node side, guarded by s_lock */
+static bool s_advert_due = false;
+static bool s_need_full = false;
+static uint32_t s_next_advert_ms = 0;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static uint32_t now_ms(void) {
+  return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static void load_saved(void) {
+  mesh_config_store_record_t *record = malloc(sizeof(*record));
+  size_t size = sizeof(*record);
+  nvs_handle_t nvs;
+
+  mesh_config_doc_init(&s_doc);
+  if (record == NULL) {
+    return;
+  }
+  if (nvs_open(MESH_CONFIG_STORE_NVS_NAMESPACE, NVS_READONLY, &nvs) ==
+      ESP_OK) {
+    if (nvs_get_blob(nvs, MESH_CONFIG_STORE_NVS_KEY, record, &size) ==
+            ESP_OK &&
+        size == sizeof(*record) &&
+        record->version == MESH_CONFIG_STORE_RECORD_VERSION) {
+      s_doc = record->doc;
+    }
+    nvs_close(nvs);
+  }
+  free(record);
+}
+
+/**
+ * @brief Save s_doc; called with s_lock held
+ */
+static esp_err_t save(void) {
+  mesh_config_store_record_t *record = malloc(sizeof(*record));
+  nvs_handle_t nvs;
+
+  if (record == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  record->version = MESH_CONFIG_STORE_RECORD_VERSION;
+  record->doc = s_doc;
+
+  esp_err_t err =
+      nvs_open(MESH_CONFIG_STORE_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+  if (err == ESP_OK) {
+    err = nvs_set_blob(nvs, MESH_CONFIG_STORE_NVS_KEY, record,
+                       sizeof(*record));
+    if (err == ESP_OK) {
+      err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+  }
+  free(record);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to save version %" PRIu32 ": %s", s_doc.version,
+             esp_err_to_name(err));
+  }
+  return err;
+}
+
+/**
+ * @brief Encode the diff of s_doc from base behind a message header
+ *
+ * Called with s_lock held.
+ *
+ * @return Message length, or 0 on failure; *msg is allocated on success
+ */
+static int encode_diff(uint32_t base, uint8_t **msg) {
+  mesh_config_store_msg_header_t header = {
+      .magic = MESH_CONFIG_STORE_MAGIC,
+      .op = MESH_CONFIG_STORE_OP_DIFF,
+  };
+  uint8_t *buf = malloc(sizeof(header) + MESH_CONFIG_MAX_DIFF);
+
+  if (buf == NULL) {
+    return 0;
+  }
+  int length = mesh_config_doc_diff(&s_doc, base, buf + sizeof(header),
+                                    MESH_CONFIG_MAX_DIFF);
+  if (length < 0) {
+    free(buf);
+    return 0;
+  }
+  memcpy(buf, &header, sizeof(header));
+
+  const mesh_config_diff_header_t *diff =
+      (const mesh_config_diff_header_t *)(buf + sizeof(header));
+  s_stats.diffs_sent++;
+  s_stats.bytes_sent += sizeof(header) + length;
+  if (diff->flags & MESH_CONFIG_DIFF_FULL) {
+    s_stats.full_sent++;
+  }
+  *msg = buf;
+  return sizeof(header) + length;
+}
+
+/**
+ * @brief Send the diff from base to every node through the group
+ */
+static esp_err_t send_to_group(uint32_t base) {
+  uint8_t *msg = NULL;
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  int length = encode_diff(base, &msg);
+  xSemaphoreGive(s_lock);
+  if (length == 0) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  // The stack forwards a group packet down the tree once per relay
+  esp_err_t err = mesh_data_send_packet(&s_group, MESH_DATA_GROUP,
+                                        MESH_DATA_TYPE_CONFIG, msg, length,
+                                        NULL, 0);
+  free(msg);
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "Failed to send to the group: %s", esp_err_to_name(err));
+  }
+  return err;
+}
+
+/**
+ * @brief Answer the adverts queued since the last check
+ *
+ * Nodes that hold the same version share one multicast.
+ */
+static void mesh_config_store_root(void) {
+  mesh_config_store_pending_t pending[MESH_CONFIG_STORE_MAX_PENDING];
+  mesh_addr_t targets[MESH_CONFIG_STORE_MAX_PENDING];
+  bool answered[MESH_CONFIG_STORE_MAX_PENDING] = {false};
+  int count;
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  count = s_pending_count;
+  memcpy(pending, s_pending, count * sizeof(pending[0]));
+  s_pending_count = 0;
+  bool rebase = s_ahead_version > s_doc.version;
+  if (rebase) {
+    // Nodes kept a newer version than this root; move past it as a whole
+    mesh_config_doc_rebase(&s_doc, s_ahead_version + 1);
+    save();
+    ESP_LOGW(TAG, "Nodes ahead at %" PRIu32 ", republishing as %" PRIu32,
+             s_ahead_version, s_doc.version);
+  }
+  s_ahead_version = 0;
+  xSemaphoreGive(s_lock);
+
+  if (rebase) {
+    send_to_group(MESH_CONFIG_STORE_BASE_FULL);
+    return;
+  }
+
+  for (int i = 0; i < count; i++) {
+    if (answered[i]) {
+      continue;
+    }
+    int target_count = 0;
+    for (int j = i; j < count; j++) {
+      if (!answered[j] && pending[j].base == pending[i].base) {
+        targets[target_count++] = pending[j].addr;
+        answered[j] = true;
+      }
+    }
+
+    uint8_t *msg = NULL;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int length = encode_diff(pending[i].base, &msg);
+    xSemaphoreGive(s_lock);
+    if (length == 0) {
+      continue;
+    }
+    esp_err_t err = mesh_multicast_from_root(
+        targets, target_count, MESH_DATA_TYPE_CONFIG, msg, length);
+    free(msg);
+    if (err != ESP_OK) {
+      ESP_LOGW(TAG, "Failed to answer %d nodes: %s", target_count,
+               esp_err_to_name(err));
+    }
+  }
+}
+
+/**
+ * @param urgent Send now instead of with the next data frame to the root
+ */
+static void mesh_config_store_advertise(bool urgent) {
+  mesh_config_store_msg_advert_t msg = {
+      .magic = MESH_CONFIG_STORE_MAGIC,
+      .op = MESH_CONFIG_STORE_OP_ADVERT,
+  };
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  msg.flags = s_need_full ? MESH_CONFIG_STORE_ADVERT_NEED_FULL : 0;
+  msg.version = s_doc.version;
+  msg.digest = mesh_config_doc_digest(&s_doc);
+  xSemaphoreGive(s_lock);
+
+  // Other adverts can wait for a data frame to the root
+  esp_err_t err = ESP_FAIL;
+  if (!urgent) {
+    err = mesh_data_piggyback(NULL, MESH_DATA_TYPE_CONFIG, &msg, sizeof(msg),
+                              MESH_CONFIG_STORE_ADVERT_SPREAD_MS);
+  }
+  if (err != ESP_OK) {
+    err = mesh_data_send_packet(NULL, MESH_DATA_TODS, MESH_DATA_TYPE_CONFIG,
+                                (uint8_t *)&msg, sizeof(msg), NULL, 0);
+  }
+  if (err != ESP_OK) {
+    return;
+  }
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  s_stats.adverts_sent++;
+  s_need_full = false;
+  xSemaphoreGive(s_lock);
+}
+
+static void mesh_config_store_task(void *arg) {
+  bool was_connected = false;
+  mesh_addr_t last_root = {0};
+  mesh_state_t state;
+
+  while (1) {
+    vTaskDelay(pdMS_TO_TICKS(MESH_CONFIG_STORE_CHECK_MS));
+    mesh_state_get(&state);
+
+    if (state.is_root) {
+      mesh_config_store_root();
+      was_connected = false;
+      continue;
+    }
+
+    // A new parent or root may have missed versions; advertise soon
+    bool connected = state.connected;
+    bool urgent = false;
+    uint32_t now = now_ms();
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (connected && (!was_connected ||
+                      memcmp(&last_root, &state.root, sizeof(last_root)))) {
+      s_next_advert_ms =
+          now + esp_random() % MESH_CONFIG_STORE_ADVERT_SPREAD_MS;
+    } else if (connected && s_advert_due) {
+      s_next_advert_ms = now;
+      urgent = true;
+    }
+    s_advert_due = false;
+    bool advertise =
+        connected && (int32_t)(now - s_next_advert_ms) >= 0;
+    if (advertise) {
+      s_next_advert_ms = now + s_config.advert_interval_ms;
+    }
+    xSemaphoreGive(s_lock);
+    was_connected = connected;
+    last_root = state.root;
+
+    if (advertise) {
+      mesh_config_store_advertise(urgent);
+    }
+  }
+}
+
+static void mesh_config_store_advert_received(
+    const mesh_addr_t *from, const mesh_config_store_msg_advert_t *msg) {
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  s_stats.adverts_received++;
+  bool full = (msg->flags & MESH_CONFIG_STORE_ADVERT_NEED_FULL) ||
+              (msg->version == s_doc.version &&
+               msg->digest != mesh_config_doc_digest(&s_doc));
+  if (msg->version > s_doc.version) {
+    if (msg->version > s_ahead_version) {
+      s_ahead_version = msg->version;
+    }
+  } else if (msg->version < s_doc.version || full) {
+    int i = 0;
+    while (i < s_pending_count &&
+           memcmp(&s_pending[i].addr, from, sizeof(*from)) != 0) {
+      i++;
+    }
+    // A full queue drops the advert; the node repeats it later
+    if (i < MESH_CONFIG_STORE_MAX_PENDING) {
+      s_pending[i].addr = *from;
+      s_pending[i].base = full ? MESH_CONFIG_STORE_BASE_FULL : msg->version;
+      if (i == s_pending_count) {
+        s_pending_count++;
+      }
+    }
+  }
+  xSemaphoreGive(s_lock);
+}
+
+static void mesh_config_store_diff_received(const uint8_t *diff,
+                                            uint16_t length) {
+  mesh_config_diff_header_t header;
+  uint32_t applied = 0;
+
+  if (length < sizeof(header)) {
+    return;
+  }
+  memcpy(&header, diff, sizeof(header));
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  bool full = header.flags & MESH_CONFIG_DIFF_FULL;
+  bool current = header.version == s_doc.version &&
+                 header.digest == mesh_config_doc_digest(&s_doc);
+  // Group messages also reach nodes that caught up by another path; a
+  // root behind this node learns of it from the next advert
+  if (current || (!full && header.version <= s_doc.version)) {
+    s_advert_due |= header.version < s_doc.version;
+    xSemaphoreGive(s_lock);
+    return;
+  }
+  uint32_t held = s_doc.version;
+
+  esp_err_t err = mesh_config_doc_apply(&s_doc, diff, length, &s_work);
+  if (err == ESP_OK) {
+    s_doc = s_work;
+    s_stats.diffs_applied++;
+    save();
+    applied = s_doc.version;
+  } else {
+    s_stats.diffs_rejected++;
+    s_advert_due = true;
+    s_need_full = err != ESP_ERR_INVALID_VERSION;
+  }
+  mesh_config_store_cb_t callback = s_callback;
+  xSemaphoreGive(s_lock);
+
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "Rejected version %" PRIu32 " on %" PRIu32 ": %s",
+             header.version, held, esp_err_to_name(err));
+    return;
+  }
+  ESP_LOGI(TAG, "Applied version %" PRIu32 " (%u bytes)", applied, length);
+  if (callback != NULL) {
+    callback(applied);
+  }
+}
+
+static bool mesh_config_store_handle_config(mesh_addr_t *from,
+                                            uint8_t data_type,
+                                            uint8_t *payload,
+                                            uint16_t length) {
+  mesh_config_store_msg_header_t header;
+
+  if (length < sizeof(header) || payload[0] != MESH_CONFIG_STORE_MAGIC) {
+    return false;
+  }
+  memcpy(&header, payload, sizeof(header));
+
+  bool is_root = mesh_state_is_root();
+  if (is_root && header.op == MESH_CONFIG_STORE_OP_ADVERT &&
+      length == sizeof(mesh_config_store_msg_advert_t)) {
+    mesh_config_store_msg_advert_t msg;
+    memcpy(&msg, payload, sizeof(msg));
+    mesh_config_store_advert_received(from, &msg);
+  } else if (!is_root && header.op == MESH_CONFIG_STORE_OP_DIFF) {
+    mesh_config_store_diff_received(payload + sizeof(header),
+                                    length - sizeof(header));
+  }
+  return true;
+}
+
+/*******************************************************
+ *                Public Functions
+ *******************************************************/
+esp_err_t mesh_config_store_init(const mesh_config_store_config_t *config) {
+  if (s_initialized) {
+    ESP_LOGW(TAG, "Already initialized");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  s_config.advert_interval_ms = MESH_CONFIG_STORE_DEFAULT_ADVERT_MS;
+  if (config != NULL && config->advert_interval_ms != 0) {
+    s_config.advert_interval_ms = config->advert_interval_ms;
+  }
+
+  s_lock = xSemaphoreCreateMutex();
+  if (s_lock == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  load_saved();
+  ESP_LOGI(TAG, "Loaded version %" PRIu32, s_doc.version);
+
+  esp_err_t err = mesh_data_transfer_register_type_handler(
+      MESH_DATA_TYPE_CONFIG, mesh_config_store_handle_config);
+  if (err != ESP_OK) {
+    return err;
+  }
+  err = mesh_join_group(&s_group);
+  if (err != ESP_OK) {
+    return err;
+  }
+  mesh_caps_add_feature(MESH_NODE_FEATURE_CONFIG_STORE);
+
+  if (xTaskCreate(mesh_config_store_task, "mesh_config",
+                  MESH_CONFIG_STORE_TASK_STACK_SIZE, NULL,
+                  MESH_CONFIG_STORE_TASK_PRIORITY, NULL) != pdPASS) {
+    ESP_LOGE(TAG, "Failed to create config store task");
+    return ESP_ERR_NO_MEM;
+  }
+
+  s_initialized = true;
+  return ESP_OK;
+}
+
+/**
+ * @brief Start staging from the published document; called with s_lock held
+ */
+static esp_err_t stage(void) {
+  if (s_staged == NULL) {
+    s_staged = malloc(sizeof(*s_staged));
+    if (s_staged == NULL) {
+      return ESP_ERR_NO_MEM;
+    }
+    *s_staged = s_doc;
+  }
+  return ESP_OK;
+}
+
+esp_err_t mesh_config_store_set(const char *key, const void *value,
+                                uint8_t length) {
+  if (!s_initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (!mesh_state_is_root()) {
+    ESP_LOGE(TAG, "Not a root node");
+    return ESP_FAIL;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  esp_err_t err = stage();
+  if (err == ESP_OK) {
+    err = mesh_config_doc_set(s_staged, key, value, length, 0);
+  }
+  xSemaphoreGive(s_lock);
+  return err;
+}
+
+esp_err_t mesh_config_store_delete(const char *key) {
+  if (!s_initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (!mesh_state_is_root()) {
+    ESP_LOGE(TAG, "Not a root node");
+    return ESP_FAIL;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  esp_err_t err = stage();
+  if (err == ESP_OK) {
+    err = mesh_config_doc_delete(s_staged, key, 0);
+  }
+  xSemaphoreGive(s_lock);
+  return err;
+}
+
+esp_err_t mesh_config_store_publish(void) {
+  if (!s_initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (!mesh_state_is_root()) {
+    ESP_LOGE(TAG, "Not a root node");
+    return ESP_FAIL;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  if (s_staged == NULL) {
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+  }
+  uint32_t base = s_doc.version;
+  s_work = s_doc;
+  // Versions rebased since the changes were staged do not matter here
+  int changes = mesh_config_doc_merge(&s_work, s_staged, base + 1);
+  free(s_staged);
+  s_staged = NULL;
+  if (changes <= 0) {
+    xSemaphoreGive(s_lock);
+    return changes < 0 ? ESP_ERR_NO_MEM : ESP_OK;
+  }
+  s_work.version = base + 1;
+  s_doc = s_work;
+  s_stats.publishes++;
+  esp_err_t err = save();
+  xSemaphoreGive(s_lock);
+
+  ESP_LOGI(TAG, "Publishing version %" PRIu32 " (%d keys changed)", base + 1,
+           changes);
+  esp_err_t send_err = send_to_group(base);
+  return err != ESP_OK ? err : send_err;
+}
+
+esp_err_t mesh_config_store_get(const char *key, void *value,
+                                uint8_t *length) {
+  if (key == NULL || value == NULL || length == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (s_lock == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  esp_err_t err = ESP_ERR_NOT_FOUND;
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  const mesh_config_entry_t *entry = mesh_config_doc_find(&s_doc, key);
+  if (entry != NULL && entry->length > *length) {
+    err = ESP_ERR_INVALID_SIZE;
+  } else if (entry != NULL) {
+    memcpy(value, entry->value, entry->length);
+    err = ESP_OK;
+  }
+  if (entry != NULL) {
+    *length = entry->length;
+  }
+  xSemaphoreGive(s_lock);
+  return err;
+}
+
+esp_err_t mesh_config_store_register_callback(mesh_config_store_cb_t cb) {
+  s_callback = cb;
+  return ESP_OK;
+}
+
+esp_err_t mesh_config_store_get_stats(mesh_config_store_stats_t *stats) {
+  if (stats == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (s_lock == NULL) {
+    memset(stats, 0, sizeof(*stats));
+    return ESP_OK;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  *stats = s_stats;
+  stats->version = s_doc.version;
+  xSemaphoreGive(s_lock);
+  return ESP_OK;
+}
@@ -0,0 +1,321 @@
+/* Replicated Configuration Store Engine Implementation */
+
+#include "mesh_config_store_engine.h"
+#include <string.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+#define RECORD_DELETE (0x80) /* in the key length byte */
+#define FNV_OFFSET (2166136261u)
+#define FNV_PRIME (16777619u)
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static uint32_t fnv1a(uint32_t hash, const void *data, int length) {
+  const uint8_t *bytes = (const uint8_t *)data;
+  for (int i = 0; i < length; i++) {
+    hash = (hash ^ bytes[i]) * FNV_PRIME;
+  }
+  return hash;
+}
+
+static int entry_size(const mesh_config_entry_t *entry) {
+  int key_length = (int)strlen(entry->key);
+  return entry->deleted ? 1 + key_length : 2 + key_length + entry->length;
+}
+
+static int find_slot(const mesh_config_doc_t *doc, const char *key) {
+  for (int i = 0; i < MESH_CONFIG_MAX_KEYS; i++) {
+    if (doc->entries[i].used && strcmp(doc->entries[i].key, key) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief Size of the full document encoding
+ */
+static int full_size(const mesh_config_doc_t *doc) {
+  int size = sizeof(mesh_config_diff_header_t);
+  for (int i = 0; i < MESH_CONFIG_MAX_KEYS; i++) {
+    const mesh_config_entry_t *entry = &doc->entries[i];
+    if (entry->used && !entry->deleted) {
+      size += entry_size(entry);
+    }
+  }
+  return size;
+}
+
+void mesh_config_doc_init(mesh_config_doc_t *doc) {
+  memset(doc, 0, sizeof(*doc));
+}
+
+esp_err_t mesh_config_doc_set(mesh_config_doc_t *doc, const char *key,
+                              const void *value, uint8_t length,
+                              uint32_t version) {
+  size_t key_length = key != NULL ? strlen(key) : 0;
+
+  if (key_length == 0 || key_length >= MESH_CONFIG_KEY_SIZE ||
+      length > MESH_CONFIG_VALUE_MAX || (value == NULL && length > 0)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  int slot = find_slot(doc, key);
+  if (slot >= 0) {
+    const mesh_config_entry_t *entry = &doc->entries[slot];
+    if (!entry->deleted && entry->length == length &&
+        (length == 0 || memcmp(entry->value, value, length) == 0)) {
+      return ESP_OK;
+    }
+  }
+
+  int size = full_size(doc) + 2 + (int)key_length + length;
+  if (slot >= 0 && !doc->entries[slot].deleted) {
+    size -= entry_size(&doc->entries[slot]);
+  }
+  if (size > MESH_CONFIG_MAX_DIFF) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  if (slot < 0) {
+    int oldest = -1;
+    for (int i = 0; i < MESH_CONFIG_MAX_KEYS; i++) {
+      const mesh_config_entry_t *entry = &doc->entries[i];
+      if (!entry->used) {
+        slot = i;
+        break;
+      }
+      if (entry->deleted &&
+          (oldest < 0 || entry->version < doc->entries[oldest].version)) {
+        oldest = i;
+      }
+    }
+    if (slot < 0 && oldest < 0) {
+      return ESP_ERR_NO_MEM;
+    }
+    if (slot < 0) {
+      // Diffs from before this deletion can no longer carry it
+      slot = oldest;
+      if (doc->entries[slot].version > doc->floor) {
+        doc->floor = doc->entries[slot].version;
+      }
+    }
+  }
+
+  mesh_config_entry_t *entry = &doc->entries[slot];
+  memset(entry, 0, sizeof(*entry));
+  memcpy(entry->key, key, key_length);
+  if (length > 0) {
+    memcpy(entry->value, value, length);
+  }
+  entry->length = length;
+  entry->used = true;
+  entry->version = version;
+  return ESP_OK;
+}
+
+esp_err_t mesh_config_doc_delete(mesh_config_doc_t *doc, const char *key,
+                                 uint32_t version) {
+  int slot = key != NULL ? find_slot(doc, key) : -1;
+
+  if (slot < 0 || doc->entries[slot].deleted) {
+    return ESP_ERR_NOT_FOUND;
+  }
+
+  mesh_config_entry_t *entry = &doc->entries[slot];
+  memset(entry->value, 0, sizeof(entry->value));
+  entry->length = 0;
+  entry->deleted = true;
+  entry->version = version;
+  return ESP_OK;
+}
+
+const mesh_config_entry_t *mesh_config_doc_find(const mesh_config_doc_t *doc,
+                                                const char *key) {
+  int slot = key != NULL ? find_slot(doc, key) : -1;
+
+  if (slot < 0 || doc->entries[slot].deleted) {
+    return NULL;
+  }
+  return &doc->entries[slot];
+}
+
+uint32_t mesh_config_doc_digest(const mesh_config_doc_t *doc) {
+  uint32_t digest = 0;
+
+  // XOR of per-entry hashes is independent of the slot order
+  for (int i = 0; i < MESH_CONFIG_MAX_KEYS; i++) {
+    const mesh_config_entry_t *entry = &doc->entries[i];
+    if (entry->used && !entry->deleted) {
+      uint32_t hash = fnv1a(FNV_OFFSET, entry->key, strlen(entry->key) + 1);
+      digest ^= fnv1a(hash, entry->value, entry->length);
+    }
+  }
+  return digest;
+}
+
+int mesh_config_doc_diff(const mesh_config_doc_t *doc, uint32_t base,
+                         uint8_t *buf, int size) {
+  mesh_config_diff_header_t header = {
+      .base = base,
+      .version = doc->version,
+      .digest = mesh_config_doc_digest(doc),
+  };
+  bool full = base < doc->floor || base > doc->version;
+
+  if (!full) {
+    int incremental = sizeof(header);
+    for (int i = 0; i < MESH_CONFIG_MAX_KEYS; i++) {
+      const mesh_config_entry_t *entry = &doc->entries[i];
+      if (entry->used && entry->version > base) {
+        incremental += entry_size(entry);
+      }
+    }
+    full = incremental > full_size(doc);
+  }
+  if (full) {
+    header.flags = MESH_CONFIG_DIFF_FULL;
+    header.base = 0;
+  }
+
+  int offset = sizeof(header);
+  for (int i = 0; i < MESH_CONFIG_MAX_KEYS; i++) {
+    const mesh_config_entry_t *entry = &doc->entries[i];
+    bool include = full ? entry->used && !entry->deleted
+                        : entry->used && entry->version > base;
+    if (!include) {
+      continue;
+    }
+    int key_length = (int)strlen(entry->key);
+    if (offset + entry_size(entry) > size) {
+      return -1;
+    }
+    buf[offset++] = (uint8_t)key_length | (entry->deleted ? RECORD_DELETE : 0);
+    memcpy(&buf[offset], entry->key, key_length);
+    offset += key_length;
+    if (!entry->deleted) {
+      buf[offset++] = entry->length;
+      memcpy(&buf[offset], entry->value, entry->length);
+      offset += entry->length;
+    }
+    header.count++;
+  }
+
+  if (size < (int)sizeof(header)) {
+    return -1;
+  }
+  memcpy(buf, &header, sizeof(header));
+  return offset;
+}
+
+esp_err_t mesh_config_doc_apply(const mesh_config_doc_t *doc,
+                                const uint8_t *diff, int length,
+                                mesh_config_doc_t *out) {
+  mesh_config_diff_header_t header;
+
+  if (length < (int)sizeof(header)) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  memcpy(&header, diff, sizeof(header));
+  bool full = header.flags & MESH_CONFIG_DIFF_FULL;
+  if (!full && header.base != doc->version) {
+    return ESP_ERR_INVALID_VERSION;
+  }
+
+  if (full) {
+    mesh_config_doc_init(out);
+    out->floor = header.version;
+  } else {
+    *out = *doc;
+  }
+
+  int offset = sizeof(header);
+  for (int r = 0; r < header.count; r++) {
+    char key[MESH_CONFIG_KEY_SIZE] = {0};
+    if (offset >= length) {
+      return ESP_ERR_INVALID_SIZE;
+    }
+    bool deleted = diff[offset] & RECORD_DELETE;
+    int key_length = diff[offset++] & ~RECORD_DELETE;
+    if (key_length == 0 || key_length >= MESH_CONFIG_KEY_SIZE ||
+        offset + key_length + (deleted ? 0 : 1) > length) {
+      return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(key, &diff[offset], key_length);
+    offset += key_length;
+
+    if (deleted) {
+      // A node may never have seen a key that was set and deleted since
+      mesh_config_doc_delete(out, key, header.version);
+      continue;
+    }
+    uint8_t value_length = diff[offset++];
+    if (offset + value_length > length) {
+      return ESP_ERR_INVALID_SIZE;
+    }
+    esp_err_t err = mesh_config_doc_set(out, key, &diff[offset],
+                                        value_length, header.version);
+    if (err != ESP_OK) {
+      return err == ESP_ERR_INVALID_ARG ? ESP_ERR_INVALID_SIZE : err;
+    }
+    offset += value_length;
+  }
+  if (offset != length) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  out->version = header.version;
+  if (mesh_config_doc_digest(out) != header.digest) {
+    return ESP_ERR_INVALID_CRC;
+  }
+  return ESP_OK;
+}
+
+int mesh_config_doc_merge(mesh_config_doc_t *doc,
+                          const mesh_config_doc_t *staged, uint32_t version) {
+  int changes = 0;
+
+  // Deletions first, they free room for the sets
+  for (int i = 0; i < MESH_CONFIG_MAX_KEYS; i++) {
+    const mesh_config_entry_t *have = &doc->entries[i];
+    if (have->used && !have->deleted &&
+        mesh_config_doc_find(staged, have->key) == NULL) {
+      mesh_config_doc_delete(doc, have->key, version);
+      changes++;
+    }
+  }
+
+  for (int i = 0; i < MESH_CONFIG_MAX_KEYS; i++) {
+    const mesh_config_entry_t *want = &staged->entries[i];
+    if (!want->used || want->deleted) {
+      continue;
+    }
+    const mesh_config_entry_t *have = mesh_config_doc_find(doc, want->key);
+    if (have != NULL && have->length == want->length &&
+        memcmp(have->value, want->value, want->length) == 0) {
+      continue;
+    }
+    if (mesh_config_doc_set(doc, want->key, want->value, want->length,
+                            version) != ESP_OK) {
+      return -1;
+    }
+    changes++;
+  }
+  return changes;
+}
+
+void mesh_config_doc_rebase(mesh_config_doc_t *doc, uint32_t version) {
+  for (int i = 0; i < MESH_CONFIG_MAX_KEYS; i++) {
+    mesh_config_entry_t *entry = &doc->entries[i];
+    if (entry->deleted) {
+      memset(entry, 0, sizeof(*entry));
+    } else if (entry->used) {
+      entry->version = version;
+    }
+  }
+  doc->version = version;
+  doc->floor = version;
+}
@@ -3,17 +3,220 @@
 #include "mesh_data_transfer.h"
 #include "esp_log.h"
 #include "esp_mesh.h"
+#include "esp_timer.h"
 #include "freertos/task.h"
+#include "mesh_aggregate_engine.h"
+#include "mesh_filter.h"
+#include "mesh_internal.h"
+#include "mesh_piggyback_engine.h"
 #include <string.h>
 
 static const char *TAG = "mesh_data_transfer";
 
+/* Destination used together with MESH_OPT_SEND_GROUP */
+static const mesh_addr_t s_multicast_addr = {
+    .addr = {0x01, 0x00, 0x5e, 0x00, 0x00, 0x00}};
+
+typedef struct {
+  uint8_t data_type;
+  mesh_type_handler_t handler;
+} mesh_type_handler_entry_t;
+
 static TaskHandle_t s_receive_task_handle = NULL;
 static mesh_data_receive_cb_t s_receive_callback = NULL;
 static bool s_initialized = false;
+static mesh_type_handler_entry_t s_type_handlers[MESH_MAX_TYPE_HANDLERS];
+static int s_type_handler_count = 0;
+static uint32_t s_tx_packets = 0; /* packets handed to the mesh stack */
+static uint32_t s_tx_dropped = 0; /* sends the mesh stack refused */
+
+/* Control items waiting for a data frame, guarded by s_piggyback_mux */
+static portMUX_TYPE s_piggyback_mux = portMUX_INITIALIZER_UNLOCKED;
+static mesh_piggyback_queue_t s_piggyback;
+static mesh_piggyback_stats_t s_piggyback_stats;
+static esp_timer_handle_t s_piggyback_timer = NULL;
+static bool s_piggyback_armed = false;
 
 static void mesh_receive_task(void *arg);
 
+static uint32_t now_ms(void) {
+  return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+/**
+ * @brief Start the deadline timer unless it is already running
+ *
+ * While items are queued the timer fires at least every
+ * MESH_PIGGYBACK_TICK_MS, so an item is sent at most that late.
+ */
+static void piggyback_kick(void) {
+  uint32_t deadline = 0;
+  bool start = false;
+
+  taskENTER_CRITICAL(&s_piggyback_mux);
+  if (!s_piggyback_armed &&
+      mesh_piggyback_next_deadline(&s_piggyback, &deadline)) {
+    s_piggyback_armed = true;
+    start = true;
+  }
+  taskEXIT_CRITICAL(&s_piggyback_mux);
+
+  if (start) {
+    int32_t wait = (int32_t)(deadline - now_ms());
+    wait = wait < 0 ? 0 : wait;
+    wait = wait > MESH_PIGGYBACK_TICK_MS ? MESH_PIGGYBACK_TICK_MS : wait;
+    esp_timer_start_once(s_piggyback_timer, (uint64_t)wait * 1000);
+  }
+}
+
+/**
+ * @brief Send the items whose deadline passed without a data frame
+ */
+static void mesh_piggyback_timer_cb(void *arg) {
+  static const uint8_t root[6] = {0};
+  mesh_piggyback_item_t item;
+
+  while (1) {
+    taskENTER_CRITICAL(&s_piggyback_mux);
+    bool due = mesh_piggyback_take_due(&s_piggyback, now_ms(), &item);
+    taskEXIT_CRITICAL(&s_piggyback_mux);
+    if (!due) {
+      break;
+    }
+
+    // Items still queued for the peer are attached to this frame
+    mesh_addr_t to;
+    int flag = MESH_DATA_TODS;
+    memcpy(to.addr, item.peer, 6);
+    if (memcmp(item.peer, root, 6) != 0) {
+      flag = mesh_state_is_root() ? MESH_DATA_FROMDS : MESH_DATA_P2P;
+    }
+    esp_err_t err = mesh_data_send_packet(
+        flag == MESH_DATA_TODS ? NULL : &to, flag | MESH_DATA_NONBLOCK,
+        item.type, item.data, item.length, NULL, 0);
+
+    taskENTER_CRITICAL(&s_piggyback_mux);
+    if (err == ESP_OK) {
+      s_piggyback_stats.standalone++;
+    } else {
+      s_piggyback_stats.dropped++;
+    }
+    taskEXIT_CRITICAL(&s_piggyback_mux);
+  }
+
+  taskENTER_CRITICAL(&s_piggyback_mux);
+  s_piggyback_armed = false;
+  taskEXIT_CRITICAL(&s_piggyback_mux);
+  piggyback_kick();
+}
+
+/**
+ * @brief Room for control items in a send, and the peer they are for
+ *
+ * Only unicast sends to the root, or to a node that announced
+ * MESH_NODE_FEATURE_HEADER_EXT, carry items, and never more than the
+ * destination receives.
+ *
+ * @return Bytes, 0 if nothing is attached
+ */
+static int piggyback_room(const mesh_addr_t *to, int flag,
+                          const mesh_opt_t *opt, uint16_t length,
+                          uint8_t peer[6]) {
+  mesh_node_caps_t caps;
+
+  if (opt != NULL || (flag & MESH_DATA_GROUP)) {
+    return 0;
+  }
+  memset(peer, 0, 6);
+  if (to != NULL) {
+    memcpy(peer, to->addr, 6);
+  }
+
+  taskENTER_CRITICAL(&s_piggyback_mux);
+  int pending = mesh_piggyback_pending(&s_piggyback, peer);
+  taskEXIT_CRITICAL(&s_piggyback_mux);
+  if (pending == 0) {
+    return 0;
+  }
+
+  mesh_peer_caps(to, &caps);
+  if (!(caps.features & MESH_NODE_FEATURE_HEADER_EXT)) {
+    return 0;
+  }
+  int limit = (caps.rx_buffer < MESH_MPS ? caps.rx_buffer : MESH_MPS) -
+              (int)sizeof(mesh_data_header_t) - length;
+  if (limit <= 0) {
+    return 0;
+  }
+  return pending < limit ? pending : limit;
+}
+
+/**
+ * @brief Offer a packet to the registered internal type handlers
+ *
+ * @return true if one of the handlers consumed the packet
+ */
+static bool mesh_dispatch_type_handlers(mesh_addr_t *from, uint8_t data_type,
+                                        uint8_t *payload, uint16_t length) {
+  for (int i = 0; i < s_type_handler_count; i++) {
+    if (s_type_handlers[i].data_type == data_type &&
+        s_type_handlers[i].handler(from, data_type, payload, length)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Hand one packet to the internal handlers or the user callback
+ */
+static void mesh_deliver_packet(mesh_addr_t *from, uint8_t data_type,
+                                uint8_t *payload, uint16_t length) {
+  // Component-internal protocols are consumed before the application
+  if (mesh_dispatch_type_handlers(from, data_type, payload, length)) {
+    return;
+  }
+
+  ESP_LOGI(TAG, "Received data: type=0x%02x, length=%u", data_type, length);
+
+  // With a reactor running, application handlers run in its task instead
+  if (mesh_reactor_post_rx(from, data_type, payload, length) !=
+      ESP_ERR_NOT_SUPPORTED) {
+    return;
+  }
+
+  // Invoke user callback if registered
+  if (s_receive_callback != NULL) {
+    s_receive_callback(from, data_type, payload, length);
+  } else {
+    ESP_LOGW(TAG, "No receive callback registered, data discarded");
+  }
+}
+
+/**
+ * @brief Split a MESH_DATA_TYPE_BATCH payload into its records
+ */
+static void mesh_deliver_batch(mesh_addr_t *from, uint8_t *payload,
+                               uint16_t length) {
+  uint16_t offset = 0;
+  int count = 0;
+
+  while (offset + sizeof(mesh_batch_record_header_t) <= length) {
+    mesh_batch_record_header_t *record =
+        (mesh_batch_record_header_t *)(payload + offset);
+    offset += sizeof(mesh_batch_record_header_t);
+    if (record->length > length - offset) {
+      ESP_LOGW(TAG, "Truncated batch record after %d records", count);
+      return;
+    }
+    mesh_deliver_packet(from, record->type, payload + offset, record->length);
+    offset += record->length;
+    count++;
+  }
+
+  ESP_LOGD(TAG, "Batch of %d records delivered", count);
+}
+
 /**
  * @brief Task that continuously receives mesh data packets
  */
@@ -60,22 +263,30 @@ static void mesh_receive_task(void *arg) {
     mesh_data_packet_t *packet = (mesh_data_packet_t *)data.data;
     uint16_t payload_length = packet->header.length;
 
-    // Validate payload length
-    if (payload_length + sizeof(mesh_data_header_t) != data.size) {
+    // Validate payload length; control items may follow the payload
+    bool ext = packet->header.flags & MESH_DATA_FLAG_EXT;
+    if (ext ? payload_length + sizeof(mesh_data_header_t) > data.size
+            : payload_length + sizeof(mesh_data_header_t) != data.size) {
       ESP_LOGW(TAG, "Packet length mismatch: header=%d, actual=%d",
                payload_length + (int)(sizeof(mesh_data_header_t)), data.size);
       continue;
     }
 
-    ESP_LOGI(TAG, "Received data: type=0x%02x, length=%u, flag=0x%x",
+    ESP_LOGD(TAG, "Received data: type=0x%02x, length=%u, flag=0x%x",
              packet->header.type, payload_length, flag);
+    mesh_boot_trace_mark(MESH_BOOT_PHASE_FIRST_RECEIVE);
 
-    // Invoke user callback if registered
-    if (s_receive_callback != NULL) {
-      s_receive_callback(&from, packet->header.type, packet->payload,
-                         payload_length);
+    // The control items were queued before the payload was sent
+    if (ext) {
+      mesh_deliver_batch(&from, packet->payload + payload_length,
+                         data.size - sizeof(mesh_data_header_t) -
+                             payload_length);
+    }
+    if (packet->header.type == MESH_DATA_TYPE_BATCH) {
+      mesh_deliver_batch(&from, packet->payload, payload_length);
     } else {
-      ESP_LOGW(TAG, "No receive callback registered, data discarded");
+      mesh_deliver_packet(&from, packet->header.type, packet->payload,
+                          payload_length);
     }
   }
 
@@ -102,6 +313,16 @@ esp_err_t mesh_data_transfer_init(void) {
     return ESP_FAIL;
   }
 
+  mesh_piggyback_init(&s_piggyback);
+  esp_timer_create_args_t timer_args = {
+      .callback = mesh_piggyback_timer_cb,
+      .name = "mesh_piggyback",
+  };
+  if (esp_timer_create(&timer_args, &s_piggyback_timer) != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to create piggyback timer");
+    return ESP_ERR_NO_MEM;
+  }
+
   s_initialized = true;
   ESP_LOGI(TAG, "Mesh data transfer initialized successfully");
   return ESP_OK;
@@ -129,21 +350,16 @@ esp_err_t mesh_data_transfer_deinit(void) {
   return ESP_OK;
 }
 
-esp_err_t mesh_send_to_root(uint8_t data_type, const uint8_t *payload,
-                            uint16_t length) {
-  if (payload == NULL || length == 0) {
-    ESP_LOGE(TAG, "Invalid arguments");
-    return ESP_ERR_INVALID_ARG;
-  }
-
-  if (!esp_mesh_is_device_active()) {
-    ESP_LOGE(TAG, "Mesh not started");
-    return ESP_ERR_MESH_NOT_START;
-  }
+esp_err_t mesh_data_send_packet(const mesh_addr_t *to, int flag,
+                                uint8_t data_type, const uint8_t *payload,
+                                uint16_t length, const mesh_opt_t *opt,
+                                int opt_count) {
+  uint8_t peer[6];
+  int room = piggyback_room(to, flag, opt, length, peer);
 
   // Allocate packet buffer
   uint16_t packet_size = sizeof(mesh_data_header_t) + length;
-  mesh_data_packet_t *packet = malloc(packet_size);
+  mesh_data_packet_t *packet = malloc(packet_size + room);
   if (packet == NULL) {
     ESP_LOGE(TAG, "Failed to allocate packet buffer");
     return ESP_ERR_NO_MEM;
@@ -152,22 +368,121 @@ esp_err_t mesh_send_to_root(uint8_t data_type, const uint8_t *payload,
   // Build packet
   packet->header.type = data_type;
   packet->header.length = length;
-  packet->header.reserved = 0;
-  memcpy(packet->payload, payload, length);
+  packet->header.flags = 0;
+  if (length > 0) {
+    memcpy(packet->payload, payload, length);
+  }
+
+  // Pending control items for the peer ride along
+  uint8_t *ext = packet->payload + length;
+  int ext_length = 0, ext_count = 0;
+  if (room > 0) {
+    taskENTER_CRITICAL(&s_piggyback_mux);
+    ext_length =
+        mesh_piggyback_attach(&s_piggyback, peer, ext, room, &ext_count);
+    taskEXIT_CRITICAL(&s_piggyback_mux);
+  }
+  if (ext_length > 0) {
+    packet->header.flags |= MESH_DATA_FLAG_EXT;
+  }
 
   // Prepare mesh data structure
   mesh_data_t data;
   data.data = (uint8_t *)packet;
-  data.size = packet_size;
+  data.size = packet_size + ext_length;
   data.proto = MESH_PROTO_BIN;
   data.tos = MESH_TOS_P2P;
 
-  // Send to root (upstream)
-  esp_err_t err = esp_mesh_send(NULL, &data, MESH_DATA_TODS, NULL, 0);
+  esp_err_t err = esp_mesh_send(to, &data, flag, opt, opt_count);
+  mesh_link_record_send(to, flag, err);
+  if (err == ESP_OK) {
+    mesh_boot_trace_mark(MESH_BOOT_PHASE_FIRST_SEND);
+    __atomic_fetch_add(&s_tx_packets, 1, __ATOMIC_RELAXED);
+  } else {
+    __atomic_fetch_add(&s_tx_dropped, 1, __ATOMIC_RELAXED);
+  }
+
+  if (ext_length > 0) {
+    taskENTER_CRITICAL(&s_piggyback_mux);
+    if (err == ESP_OK) {
+      s_piggyback_stats.piggybacked += ext_count;
+    } else {
+      mesh_piggyback_restore(&s_piggyback, peer, ext, ext_length, now_ms());
+    }
+    taskEXIT_CRITICAL(&s_piggyback_mux);
+    if (err != ESP_OK) {
+      piggyback_kick();
+    }
+  }
 
   free(packet);
+  return err;
+}
+
+esp_err_t mesh_data_send_to_parent(uint8_t data_type, const uint8_t *payload,
+                                   uint16_t length, int flag) {
+  mesh_state_t state;
+
+  mesh_state_get(&state);
+  if (state.connected && state.layer > 2) {
+    // The parent's station MAC is one below its softAP BSSID
+    mesh_addr_t parent = state.parent;
+    parent.addr[5] -= 1;
+    return mesh_data_send_packet(&parent, MESH_DATA_P2P | flag, data_type,
+                                 payload, length, NULL, 0);
+  }
+  return mesh_data_send_packet(NULL, MESH_DATA_TODS | flag, data_type, payload,
+                               length, NULL, 0);
+}
+
+esp_err_t mesh_send_to_root(uint8_t data_type, const uint8_t *payload,
+                            uint16_t length) {
+  if (payload == NULL || length == 0) {
+    ESP_LOGE(TAG, "Invalid arguments");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  // Readings matching no filter subscription are not sent at all
+  uint8_t filtered[MESH_FILTER_MAX_READINGS * sizeof(mesh_sensor_reading_t)];
+  uint16_t filtered_length;
+  if (mesh_filter_apply(data_type, payload, length, filtered,
+                        &filtered_length) == ESP_OK) {
+    if (filtered_length == 0) {
+      ESP_LOGD(TAG, "Filtered out %d bytes (type=0x%02x)", length, data_type);
+      return ESP_OK;
+    }
+    payload = filtered;
+    length = filtered_length;
+  }
+
+  // Designated types are merged into the next aggregate frame instead
+  if (mesh_aggregation_submit(data_type, payload, length) == ESP_OK) {
+    ESP_LOGD(TAG, "Aggregated %d bytes (type=0x%02x)", length, data_type);
+    return ESP_OK;
+  }
+
+  // Keep ordering behind packets still waiting for replay
+  if (mesh_store_forward_is_holding() &&
+      mesh_store_forward_enqueue(data_type, payload, length) == ESP_OK) {
+    ESP_LOGI(TAG, "Queued %d bytes for root (type=0x%02x)", length, data_type);
+    return ESP_OK;
+  }
+
+  if (!mesh_state_is_started()) {
+    ESP_LOGE(TAG, "Mesh not started");
+    return ESP_ERR_MESH_NOT_START;
+  }
+
+  // Send to root (upstream)
+  esp_err_t err = mesh_data_send_packet(NULL, MESH_DATA_TODS, data_type,
+                                        payload, length, NULL, 0);
 
   if (err != ESP_OK) {
+    if (mesh_store_forward_enqueue(data_type, payload, length) == ESP_OK) {
+      ESP_LOGW(TAG, "Send to root failed (%s), queued for replay",
+               esp_err_to_name(err));
+      return ESP_OK;
+    }
     ESP_LOGE(TAG, "Failed to send to root: %s", esp_err_to_name(err));
     return err;
   }
@@ -183,41 +498,28 @@ esp_err_t mesh_send_to_child(const mesh_addr_t *dest_addr, uint8_t data_type,
     return ESP_ERR_INVALID_ARG;
   }
 
-  if (!esp_mesh_is_device_active()) {
+  if (!mesh_state_is_started()) {
     ESP_LOGE(TAG, "Mesh not started");
     return ESP_ERR_MESH_NOT_START;
   }
 
-  if (!esp_mesh_is_root()) {
+  if (!mesh_state_is_root()) {
     ESP_LOGE(TAG, "Not a root node");
     return ESP_FAIL;
   }
 
-  // Allocate packet buffer
-  uint16_t packet_size = sizeof(mesh_data_header_t) + length;
-  mesh_data_packet_t *packet = malloc(packet_size);
-  if (packet == NULL) {
-    ESP_LOGE(TAG, "Failed to allocate packet buffer");
-    return ESP_ERR_NO_MEM;
+  // A packet the node cannot receive would only cost airtime
+  mesh_node_caps_t caps;
+  mesh_peer_caps(dest_addr, &caps);
+  if (sizeof(mesh_data_header_t) + length > caps.rx_buffer) {
+    ESP_LOGE(TAG, "%d bytes exceed what the child receives (%u)", length,
+             caps.rx_buffer);
+    return ESP_ERR_INVALID_SIZE;
   }
 
-  // Build packet
-  packet->header.type = data_type;
-  packet->header.length = length;
-  packet->header.reserved = 0;
-  memcpy(packet->payload, payload, length);
-
-  // Prepare mesh data structure
-  mesh_data_t data;
-  data.data = (uint8_t *)packet;
-  data.size = packet_size;
-  data.proto = MESH_PROTO_BIN;
-  data.tos = MESH_TOS_P2P;
-
   // Send to specific child (downstream)
-  esp_err_t err = esp_mesh_send(dest_addr, &data, MESH_DATA_FROMDS, NULL, 0);
-
-  free(packet);
+  esp_err_t err = mesh_data_send_packet(dest_addr, MESH_DATA_FROMDS, data_type,
+                                        payload, length, NULL, 0);
 
   if (err != ESP_OK) {
     ESP_LOGE(TAG, "Failed to send to child: %s", esp_err_to_name(err));
@@ -235,12 +537,12 @@ esp_err_t mesh_broadcast_from_root(uint8_t data_type, const uint8_t *payload,
     return ESP_ERR_INVALID_ARG;
   }
 
-  if (!esp_mesh_is_device_active()) {
+  if (!mesh_state_is_started()) {
     ESP_LOGE(TAG, "Mesh not started");
     return ESP_ERR_MESH_NOT_START;
   }
 
-  if (!esp_mesh_is_root()) {
+  if (!mesh_state_is_root()) {
     ESP_LOGE(TAG, "Not a root node");
     return ESP_FAIL;
   }
@@ -256,7 +558,7 @@ esp_err_t mesh_broadcast_from_root(uint8_t data_type, const uint8_t *payload,
   // Build packet
   packet->header.type = data_type;
   packet->header.length = length;
-  packet->header.reserved = 0;
+  packet->header.flags = 0;
   memcpy(packet->payload, payload, length);
 
   // Prepare mesh data structure
@@ -292,9 +594,13 @@ esp_err_t mesh_broadcast_from_root(uint8_t data_type, const uint8_t *payload,
   for (int i = 0; i < route_table_size; i++) {
     esp_err_t err =
         esp_mesh_send(&route_table[i], &data, MESH_DATA_FROMDS, NULL, 0);
+    mesh_link_record_send(&route_table[i], MESH_DATA_FROMDS, err);
     if (err == ESP_OK) {
+      mesh_boot_trace_mark(MESH_BOOT_PHASE_FIRST_SEND);
+      __atomic_fetch_add(&s_tx_packets, 1, __ATOMIC_RELAXED);
       success_count++;
     } else {
+      __atomic_fetch_add(&s_tx_dropped, 1, __ATOMIC_RELAXED);
       ESP_LOGW(TAG, "Failed to send to node: %s", esp_err_to_name(err));
     }
   }
@@ -308,6 +614,115 @@ esp_err_t mesh_broadcast_from_root(uint8_t data_type, const uint8_t *payload,
   return (success_count > 0) ? ESP_OK : ESP_FAIL;
 }
 
+esp_err_t mesh_multicast_from_root(const mesh_addr_t *targets, int target_count,
+                                   uint8_t data_type, const uint8_t *payload,
+                                   uint16_t length) {
+  if (targets == NULL || target_count <= 0 || payload == NULL ||
+      length == 0) {
+    ESP_LOGE(TAG, "Invalid arguments");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (!mesh_state_is_started()) {
+    ESP_LOGE(TAG, "Mesh not started");
+    return ESP_ERR_MESH_NOT_START;
+  }
+
+  if (!mesh_state_is_root()) {
+    ESP_LOGE(TAG, "Not a root node");
+    return ESP_FAIL;
+  }
+
+  // The mesh stack replicates the packet at each relay on the way down
+  mesh_opt_t opt;
+  opt.type = MESH_OPT_SEND_GROUP;
+  opt.len = target_count * sizeof(mesh_addr_t);
+  opt.val = (uint8_t *)targets;
+
+  esp_err_t err = mesh_data_send_packet(&s_multicast_addr, MESH_DATA_P2P,
+                                        data_type, payload, length, &opt, 1);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to multicast: %s", esp_err_to_name(err));
+    return err;
+  }
+
+  ESP_LOGD(TAG, "Multicast %d bytes to %d nodes (type=0x%02x)", length,
+           target_count, data_type);
+  return ESP_OK;
+}
+
+esp_err_t mesh_data_piggyback(const mesh_addr_t *to, uint8_t data_type,
+                              const void *item, uint8_t length,
+                              uint32_t delay_ms) {
+  uint8_t peer[6] = {0};
+  bool replaced = false;
+
+  if (!s_initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (to != NULL) {
+    memcpy(peer, to->addr, 6);
+  }
+
+  taskENTER_CRITICAL(&s_piggyback_mux);
+  esp_err_t err = mesh_piggyback_put(&s_piggyback, peer, data_type, item,
+                                     length, now_ms() + delay_ms, &replaced);
+  if (err == ESP_OK) {
+    s_piggyback_stats.queued++;
+    s_piggyback_stats.replaced += replaced;
+  }
+  taskEXIT_CRITICAL(&s_piggyback_mux);
+
+  if (err == ESP_OK) {
+    piggyback_kick();
+  }
+  return err;
+}
+
+esp_err_t mesh_data_get_piggyback_stats(mesh_piggyback_stats_t *stats) {
+  if (stats == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  taskENTER_CRITICAL(&s_piggyback_mux);
+  *stats = s_piggyback_stats;
+  taskEXIT_CRITICAL(&s_piggyback_mux);
+  return ESP_OK;
+}
+
+uint32_t mesh_data_tx_packets(void) {
+  return __atomic_load_n(&s_tx_packets, __ATOMIC_RELAXED);
+}
+
+uint32_t mesh_data_tx_dropped(void) {
+  return __atomic_load_n(&s_tx_dropped, __ATOMIC_RELAXED);
+}
+
+esp_err_t mesh_data_transfer_register_type_handler(uint8_t data_type,
+                                                   mesh_type_handler_t handler) {
+  if (handler == NULL) {
+    ESP_LOGE(TAG, "Invalid handler pointer");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  for (int i = 0; i < s_type_handler_count; i++) {
+    if (s_type_handlers[i].data_type == data_type &&
+        s_type_handlers[i].handler == handler) {
+      return ESP_OK;
+    }
+  }
+
+  if (s_type_handler_count >= MESH_MAX_TYPE_HANDLERS) {
+    ESP_LOGE(TAG, "Type handler table full");
+    return ESP_ERR_NO_MEM;
+  }
+
+  s_type_handlers[s_type_handler_count].data_type = data_type;
+  s_type_handlers[s_type_handler_count].handler = handler;
+  s_type_handler_count++;
+  return ESP_OK;
+}
+
 esp_err_t mesh_register_receive_callback(mesh_data_receive_cb_t callback) {
   if (callback == NULL) {
     ESP_LOGE(TAG, "Invalid callback pointer");
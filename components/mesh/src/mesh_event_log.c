@@ -0,0 +1,149 @@
+/* ESP-MESH Binary Event Log Implementation */
+
+#include "mesh_event_log.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_mesh.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "mesh_internal.h"
+#include <string.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+static const char *TAG = "mesh_event_log";
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static mesh_event_log_record_t s_records[MESH_EVENT_LOG_SIZE];
+static uint32_t s_written = 0; /* sequence number of the next record */
+static SemaphoreHandle_t s_lock = NULL;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static const char *code_name(uint8_t code) {
+  switch (code) {
+  case MESH_EVENT_STARTED:
+    return "STARTED";
+  case MESH_EVENT_STOPPED:
+    return "STOPPED";
+  case MESH_EVENT_CHILD_CONNECTED:
+    return "CHILD_CONNECTED";
+  case MESH_EVENT_CHILD_DISCONNECTED:
+    return "CHILD_DISCONNECTED";
+  case MESH_EVENT_ROUTING_TABLE_ADD:
+    return "ROUTING_TABLE_ADD";
+  case MESH_EVENT_ROUTING_TABLE_REMOVE:
+    return "ROUTING_TABLE_REMOVE";
+  case MESH_EVENT_PARENT_CONNECTED:
+    return "PARENT_CONNECTED";
+  case MESH_EVENT_PARENT_DISCONNECTED:
+    return "PARENT_DISCONNECTED";
+  case MESH_EVENT_NO_PARENT_FOUND:
+    return "NO_PARENT_FOUND";
+  case MESH_EVENT_LAYER_CHANGE:
+    return "LAYER_CHANGE";
+  case MESH_EVENT_TODS_STATE:
+    return "TODS_STATE";
+  case MESH_EVENT_ROOT_ADDRESS:
+    return "ROOT_ADDRESS";
+  case MESH_EVENT_ROOT_FIXED:
+    return "ROOT_FIXED";
+  case MESH_EVENT_SCAN_DONE:
+    return "SCAN_DONE";
+  case MESH_EVENT_LOG_SCAN_RECORD:
+    return "SCAN_RECORD";
+  case MESH_EVENT_LOG_PARENT_SET:
+    return "PARENT_SET";
+  case MESH_EVENT_LOG_REJOIN:
+    return "REJOIN";
+  case MESH_EVENT_LOG_FAST_BOOT:
+    return "FAST_BOOT";
+  case MESH_EVENT_LOG_STEER:
+    return "STEER";
+  default:
+    return "EVENT";
+  }
+}
+
+esp_err_t mesh_event_log_init(void) {
+  if (s_lock != NULL) {
+    return ESP_OK;
+  }
+
+  s_lock = xSemaphoreCreateMutex();
+  if (s_lock == NULL) {
+    ESP_LOGE(TAG, "Failed to create lock");
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
+
+void mesh_event_log_put(uint8_t code, const uint8_t *mac, int32_t value,
+                        int16_t arg) {
+  if (s_lock == NULL) {
+    return;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  mesh_event_log_record_t *record =
+      &s_records[s_written % MESH_EVENT_LOG_SIZE];
+  record->time_ms = esp_log_timestamp();
+  record->value = value;
+  record->arg = arg;
+  record->code = code;
+  record->has_mac = (mac != NULL);
+  if (mac != NULL) {
+    memcpy(record->mac, mac, 6);
+  }
+  s_written++;
+  xSemaphoreGive(s_lock);
+}
+
+int mesh_event_log_read(uint32_t *cursor, mesh_event_log_record_t *records,
+                        int max_records) {
+  int count = 0;
+
+  if (s_lock == NULL || cursor == NULL || records == NULL) {
+    return 0;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  if (s_written - *cursor > MESH_EVENT_LOG_SIZE) {
+    *cursor = s_written - MESH_EVENT_LOG_SIZE; // skip overwritten records
+  }
+  while (*cursor != s_written && count < max_records) {
+    records[count++] = s_records[*cursor % MESH_EVENT_LOG_SIZE];
+    (*cursor)++;
+  }
+  xSemaphoreGive(s_lock);
+  return count;
+}
+
+void mesh_event_log_dump(void) {
+  mesh_event_log_record_t records[16];
+  uint32_t cursor = 0;
+  int count;
+
+  while ((count = mesh_event_log_read(&cursor, records, 16)) > 0) {
+    for (int i = 0; i < count; i++) {
+      const mesh_event_log_record_t *r = &records[i];
+      if (r->code == MESH_EVENT_LOG_SCAN_RECORD) {
+        ESP_LOGI(TAG, "%8" PRIu32 " %s " MACSTR " layer:%" PRId32
+                 " channel:%" PRId32 " rssi:%d",
+                 r->time_ms, code_name(r->code), MAC2STR(r->mac),
+                 r->value >> 8, r->value & 0xFF, r->arg);
+      } else if (r->has_mac) {
+        ESP_LOGI(TAG, "%8" PRIu32 " %s " MACSTR " %" PRId32 " %d",
+                 r->time_ms, code_name(r->code), MAC2STR(r->mac), r->value,
+                 r->arg);
+      } else {
+        ESP_LOGI(TAG, "%8" PRIu32 " %s(%u) %" PRId32 " %d", r->time_ms,
+                 code_name(r->code), r->code, r->value, r->arg);
+      }
+    }
+  }
+}
@@ -0,0 +1,252 @@
+/* ESP-MESH Filter Subscriptions Implementation */
+
+#include "mesh_filter.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "mesh_aggregate_engine.h"
+#include "mesh_data_transfer.h"
+#include "mesh_internal.h"
+#include <string.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+static const char *TAG = "mesh_filter";
+
+/*******************************************************
+ *                Wire Format
+ *******************************************************/
+typedef enum {
+  MESH_FILTER_OP_INSTALL = 1, /**< root -> nodes: add or replace */
+  MESH_FILTER_OP_REMOVE = 2,  /**< root -> nodes: remove */
+} mesh_filter_op_t;
+
+typedef struct {
+  uint8_t op;
+  uint8_t sub_id;
+  uint8_t data_type;
+  uint8_t code[];
+} __attribute__((packed)) mesh_filter_msg_t;
+
+typedef struct {
+  bool used;
+  uint8_t sub_id;
+  uint8_t data_type;
+  uint16_t length;
+  uint8_t code[MESH_FILTER_MAX_CODE];
+} mesh_filter_subscription_t;
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static bool s_initialized = false;
+static SemaphoreHandle_t s_lock = NULL;
+static mesh_filter_subscription_t s_subs[MESH_FILTER_MAX_SUBSCRIPTIONS];
+static mesh_filter_stats_t s_stats;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static mesh_filter_subscription_t *find_subscription(uint8_t sub_id) {
+  for (int i = 0; i < MESH_FILTER_MAX_SUBSCRIPTIONS; i++) {
+    if (s_subs[i].used && s_subs[i].sub_id == sub_id) {
+      return &s_subs[i];
+    }
+  }
+  return NULL;
+}
+
+static void install(const mesh_filter_msg_t *msg, uint16_t code_length) {
+  if (mesh_filter_validate(msg->code, code_length) != ESP_OK) {
+    ESP_LOGW(TAG, "Rejected invalid filter %u", msg->sub_id);
+    return;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  mesh_filter_subscription_t *sub = find_subscription(msg->sub_id);
+  for (int i = 0; sub == NULL && i < MESH_FILTER_MAX_SUBSCRIPTIONS; i++) {
+    if (!s_subs[i].used) {
+      sub = &s_subs[i];
+      s_stats.installed++;
+    }
+  }
+  if (sub != NULL) {
+    sub->used = true;
+    sub->sub_id = msg->sub_id;
+    sub->data_type = msg->data_type;
+    sub->length = code_length;
+    memcpy(sub->code, msg->code, code_length);
+  }
+  xSemaphoreGive(s_lock);
+
+  if (sub == NULL) {
+    ESP_LOGW(TAG, "No room for filter %u", msg->sub_id);
+  } else {
+    ESP_LOGI(TAG, "Installed filter %u for type 0x%02x", msg->sub_id,
+             msg->data_type);
+  }
+}
+
+static void remove_subscriptions(uint8_t sub_id) {
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  for (int i = 0; i < MESH_FILTER_MAX_SUBSCRIPTIONS; i++) {
+    if (s_subs[i].used && (sub_id == MESH_FILTER_ALL_SUBSCRIPTIONS ||
+                           s_subs[i].sub_id == sub_id)) {
+      s_subs[i].used = false;
+      s_stats.installed--;
+    }
+  }
+  xSemaphoreGive(s_lock);
+  ESP_LOGI(TAG, "Removed filter %u", sub_id);
+}
+
+static bool mesh_filter_handle_packet(mesh_addr_t *from, uint8_t data_type,
+                                      uint8_t *payload, uint16_t length) {
+  if (mesh_state_is_root() || length < sizeof(mesh_filter_msg_t)) {
+    return true;
+  }
+
+  const mesh_filter_msg_t *msg = (const mesh_filter_msg_t *)payload;
+  switch (msg->op) {
+  case MESH_FILTER_OP_INSTALL:
+    install(msg, length - sizeof(*msg));
+    break;
+  case MESH_FILTER_OP_REMOVE:
+    remove_subscriptions(msg->sub_id);
+    break;
+  default:
+    ESP_LOGD(TAG, "Unknown filter op %u", msg->op);
+    break;
+  }
+  return true;
+}
+
+esp_err_t mesh_filter_apply(uint8_t data_type, const uint8_t *payload,
+                            uint16_t length, uint8_t *out,
+                            uint16_t *out_length) {
+  if (!s_initialized || s_stats.installed == 0 ||
+      length % sizeof(mesh_sensor_reading_t) != 0 ||
+      length > MESH_FILTER_MAX_READINGS * sizeof(mesh_sensor_reading_t)) {
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+
+  esp_err_t err = ESP_ERR_NOT_SUPPORTED;
+  *out_length = 0;
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  uint32_t start = esp_cpu_get_cycle_count();
+  for (uint16_t offset = 0; offset < length;
+       offset += sizeof(mesh_sensor_reading_t)) {
+    mesh_sensor_reading_t reading;
+    memcpy(&reading, payload + offset, sizeof(reading));
+
+    bool match = false;
+    for (int i = 0; i < MESH_FILTER_MAX_SUBSCRIPTIONS && !match; i++) {
+      const mesh_filter_subscription_t *sub = &s_subs[i];
+      if (!sub->used || sub->data_type != data_type) {
+        continue;
+      }
+      err = ESP_OK; // the type has subscriptions
+      s_stats.evaluated++;
+      match = mesh_filter_eval(sub->code, sub->length, reading.channel,
+                               reading.value);
+    }
+    if (err != ESP_OK) {
+      break; // no subscription for this type
+    }
+    if (match) {
+      memcpy(out + *out_length, &reading, sizeof(reading));
+      *out_length += sizeof(reading);
+      s_stats.passed++;
+    }
+  }
+  s_stats.eval_cycles += esp_cpu_get_cycle_count() - start;
+  if (err == ESP_OK && *out_length == 0) {
+    s_stats.packets_dropped++;
+  }
+  xSemaphoreGive(s_lock);
+  return err;
+}
+
+static esp_err_t mesh_filter_send(const mesh_addr_t *node, const void *msg,
+                                  uint16_t length) {
+  if (node == NULL) {
+    return mesh_broadcast_from_root(MESH_DATA_TYPE_FILTER,
+                                    (const uint8_t *)msg, length);
+  }
+  return mesh_send_to_child(node, MESH_DATA_TYPE_FILTER, (const uint8_t *)msg,
+                            length);
+}
+
+/*******************************************************
+ *                Public Functions
+ *******************************************************/
+esp_err_t mesh_filter_init(void) {
+  if (s_initialized) {
+    ESP_LOGW(TAG, "Already initialized");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  s_lock = xSemaphoreCreateMutex();
+  if (s_lock == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  esp_err_t err = mesh_data_transfer_register_type_handler(
+      MESH_DATA_TYPE_FILTER, mesh_filter_handle_packet);
+  if (err != ESP_OK) {
+    return err;
+  }
+
+  s_initialized = true;
+  return ESP_OK;
+}
+
+esp_err_t mesh_filter_subscribe(const mesh_addr_t *node, uint8_t sub_id,
+                                uint8_t data_type, const char *expr) {
+  uint8_t buf[sizeof(mesh_filter_msg_t) + MESH_FILTER_MAX_CODE];
+  mesh_filter_msg_t *msg = (mesh_filter_msg_t *)buf;
+  uint16_t code_length;
+
+  if (expr == NULL || sub_id == MESH_FILTER_ALL_SUBSCRIPTIONS) {
+    ESP_LOGE(TAG, "Invalid arguments");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  esp_err_t err =
+      mesh_filter_compile(expr, msg->code, MESH_FILTER_MAX_CODE, &code_length);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to compile '%s': %s", expr, esp_err_to_name(err));
+    return err;
+  }
+
+  msg->op = MESH_FILTER_OP_INSTALL;
+  msg->sub_id = sub_id;
+  msg->data_type = data_type;
+  return mesh_filter_send(node, buf, sizeof(*msg) + code_length);
+}
+
+esp_err_t mesh_filter_unsubscribe(const mesh_addr_t *node, uint8_t sub_id) {
+  mesh_filter_msg_t msg = {
+      .op = MESH_FILTER_OP_REMOVE,
+      .sub_id = sub_id,
+  };
+  return mesh_filter_send(node, &msg, sizeof(msg));
+}
+
+esp_err_t mesh_filter_get_stats(mesh_filter_stats_t *stats) {
+  if (stats == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (s_lock != NULL) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+  }
+  *stats = s_stats;
+  if (s_lock != NULL) {
+    xSemaphoreGive(s_lock);
+  }
+  return ESP_OK;
+}
@@ -0,0 +1,400 @@
+/* Reading Filter Compiler and Interpreter Implementation */
+
+#include "mesh_filter_engine.h"
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************************
+ *                Bytecode
+ *******************************************************/
+typedef enum {
+  OP_END = 0,
+  OP_CONST, /* followed by a 4-byte float */
+  OP_VALUE,
+  OP_CHANNEL,
+  OP_ADD,
+  OP_SUB,
+  OP_MUL,
+  OP_DIV,
+  OP_NEG,
+  OP_ABS,
+  OP_NOT,
+  OP_LT,
+  OP_LE,
+  OP_GT,
+  OP_GE,
+  OP_EQ,
+  OP_NE,
+  OP_AND,
+  OP_OR,
+  OP_COUNT
+} mesh_filter_op_t;
+
+/* Stack effect of every opcode, indexed by mesh_filter_op_t */
+static const int8_t s_stack_effect[OP_COUNT] = {
+    [OP_END] = 0,  [OP_CONST] = 1, [OP_VALUE] = 1, [OP_CHANNEL] = 1,
+    [OP_ADD] = -1, [OP_SUB] = -1,  [OP_MUL] = -1,  [OP_DIV] = -1,
+    [OP_NEG] = 0,  [OP_ABS] = 0,   [OP_NOT] = 0,   [OP_LT] = -1,
+    [OP_LE] = -1,  [OP_GT] = -1,   [OP_GE] = -1,   [OP_EQ] = -1,
+    [OP_NE] = -1,  [OP_AND] = -1,  [OP_OR] = -1,
+};
+
+/*******************************************************
+ *                Compiler
+ *******************************************************/
+typedef struct {
+  const char *p;
+  uint8_t *code;
+  uint16_t capacity;
+  uint16_t length;
+  int depth;
+  int nesting; /* recursion depth of the parser */
+  esp_err_t err;
+} compiler_t;
+
+static void emit(compiler_t *c, uint8_t op) {
+  if (c->err != ESP_OK) {
+    return;
+  }
+  if (c->length >= c->capacity) {
+    c->err = ESP_ERR_INVALID_SIZE;
+    return;
+  }
+  c->code[c->length++] = op;
+  c->depth += s_stack_effect[op];
+  if (c->depth > MESH_FILTER_STACK_DEPTH) {
+    c->err = ESP_ERR_INVALID_SIZE;
+  }
+}
+
+static void emit_const(compiler_t *c, float value) {
+  emit(c, OP_CONST);
+  if (c->err != ESP_OK) {
+    return;
+  }
+  if (c->length + sizeof(value) > c->capacity) {
+    c->err = ESP_ERR_INVALID_SIZE;
+    return;
+  }
+  memcpy(&c->code[c->length], &value, sizeof(value));
+  c->length += sizeof(value);
+}
+
+static void skip_space(compiler_t *c) {
+  while (isspace((unsigned char)*c->p)) {
+    c->p++;
+  }
+}
+
+static bool accept(compiler_t *c, const char *token) {
+  skip_space(c);
+  size_t n = strlen(token);
+  if (strncmp(c->p, token, n) != 0) {
+    return false;
+  }
+  c->p += n;
+  return true;
+}
+
+static void expect(compiler_t *c, const char *token) {
+  if (!accept(c, token) && c->err == ESP_OK) {
+    c->err = ESP_ERR_INVALID_ARG;
+  }
+}
+
+static bool accept_word(compiler_t *c, const char *word) {
+  skip_space(c);
+  size_t n = strlen(word);
+  if (strncmp(c->p, word, n) != 0 ||
+      isalnum((unsigned char)c->p[n]) || c->p[n] == '_') {
+    return false;
+  }
+  c->p += n;
+  return true;
+}
+
+/**
+ * @brief Enter a nested sub-expression
+ *
+ * Bounds the parser's recursion, which would otherwise follow input such
+ * as "((((" or "----" down the stack.
+ *
+ * @return false (and the error set) if the expression nests too deep
+ */
+static bool enter(compiler_t *c) {
+  if (c->err != ESP_OK) {
+    return false;
+  }
+  if (c->nesting >= MESH_FILTER_MAX_NESTING) {
+    c->err = ESP_ERR_INVALID_SIZE;
+    return false;
+  }
+  c->nesting++;
+  return true;
+}
+
+static inline void leave(compiler_t *c) { c->nesting--; }
+
+static void parse_or(compiler_t *c);
+
+static void parse_primary(compiler_t *c) {
+  skip_space(c);
+  if (accept(c, "(")) {
+    if (enter(c)) {
+      parse_or(c);
+      leave(c);
+    }
+    expect(c, ")");
+  } else if (accept_word(c, "value")) {
+    emit(c, OP_VALUE);
+  } else if (accept_word(c, "channel") || accept_word(c, "ch")) {
+    emit(c, OP_CHANNEL);
+  } else if (accept_word(c, "abs")) {
+    expect(c, "(");
+    if (enter(c)) {
+      parse_or(c);
+      leave(c);
+    }
+    expect(c, ")");
+    emit(c, OP_ABS);
+  } else if (isdigit((unsigned char)*c->p) || *c->p == '.') {
+    char *end;
+    float value = strtof(c->p, &end);
+    c->p = end;
+    emit_const(c, value);
+  } else {
+    c->err = ESP_ERR_INVALID_ARG;
+  }
+}
+
+static void parse_unary(compiler_t *c) {
+  if (accept(c, "-")) {
+    if (enter(c)) {
+      parse_unary(c);
+      leave(c);
+    }
+    emit(c, OP_NEG);
+  } else {
+    parse_primary(c);
+  }
+}
+
+static void parse_mul(compiler_t *c) {
+  parse_unary(c);
+  while (c->err == ESP_OK) {
+    if (accept(c, "*")) {
+      parse_unary(c);
+      emit(c, OP_MUL);
+    } else if (accept(c, "/")) {
+      parse_unary(c);
+      emit(c, OP_DIV);
+    } else {
+      break;
+    }
+  }
+}
+
+static void parse_add(compiler_t *c) {
+  parse_mul(c);
+  while (c->err == ESP_OK) {
+    if (accept(c, "+")) {
+      parse_mul(c);
+      emit(c, OP_ADD);
+    } else if (accept(c, "-")) {
+      parse_mul(c);
+      emit(c, OP_SUB);
+    } else {
+      break;
+    }
+  }
+}
+
+static void parse_compare(compiler_t *c) {
+  static const struct {
+    const char *token;
+    uint8_t op;
+  } ops[] = {{"<=", OP_LE}, {">=", OP_GE}, {"==", OP_EQ},
+             {"!=", OP_NE}, {"<", OP_LT},  {">", OP_GT}};
+
+  parse_add(c);
+  for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+    if (accept(c, ops[i].token)) {
+      parse_add(c);
+      emit(c, ops[i].op);
+      break;
+    }
+  }
+}
+
+static void parse_not(compiler_t *c) {
+  if (accept(c, "!")) {
+    if (enter(c)) {
+      parse_not(c);
+      leave(c);
+    }
+    emit(c, OP_NOT);
+  } else {
+    parse_compare(c);
+  }
+}
+
+static void parse_and(compiler_t *c) {
+  parse_not(c);
+  while (c->err == ESP_OK && accept(c, "&&")) {
+    parse_not(c);
+    emit(c, OP_AND);
+  }
+}
+
+static void parse_or(compiler_t *c) {
+  parse_and(c);
+  while (c->err == ESP_OK && accept(c, "||")) {
+    parse_and(c);
+    emit(c, OP_OR);
+  }
+}
+
+esp_err_t mesh_filter_compile(const char *expr, uint8_t *code,
+                              uint16_t capacity, uint16_t *length) {
+  if (expr == NULL || code == NULL || length == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  compiler_t c = {
+      .p = expr,
+      .code = code,
+      .capacity =
+          (capacity < MESH_FILTER_MAX_CODE) ? capacity : MESH_FILTER_MAX_CODE,
+      .err = ESP_OK,
+  };
+  parse_or(&c);
+  skip_space(&c);
+  if (c.err == ESP_OK && *c.p != '\0') {
+    c.err = ESP_ERR_INVALID_ARG; // trailing input
+  }
+  emit(&c, OP_END);
+
+  *length = c.length;
+  return c.err;
+}
+
+/*******************************************************
+ *                Interpreter
+ *******************************************************/
+esp_err_t mesh_filter_validate(const uint8_t *code, uint16_t length) {
+  int depth = 0;
+
+  if (code == NULL || length == 0 || length > MESH_FILTER_MAX_CODE) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  for (uint16_t pc = 0; pc < length; pc++) {
+    uint8_t op = code[pc];
+    if (op >= OP_COUNT) {
+      return ESP_ERR_INVALID_ARG;
+    }
+    if (op == OP_END) {
+      return (depth == 1 && pc == length - 1) ? ESP_OK : ESP_ERR_INVALID_ARG;
+    }
+    if (op == OP_CONST) {
+      if (pc + sizeof(float) >= length) {
+        return ESP_ERR_INVALID_ARG;
+      }
+      pc += sizeof(float);
+    }
+
+    // Binary operators need two operands, unary ones one
+    int needed = (s_stack_effect[op] < 0) ? 2 : (s_stack_effect[op] == 0);
+    if (depth < needed) {
+      return ESP_ERR_INVALID_ARG;
+    }
+    depth += s_stack_effect[op];
+    if (depth > MESH_FILTER_STACK_DEPTH) {
+      return ESP_ERR_INVALID_ARG;
+    }
+  }
+  return ESP_ERR_INVALID_ARG; // no OP_END
+}
+
+bool mesh_filter_eval(const uint8_t *code, uint16_t length, uint8_t channel,
+                      float value) {
+  float stack[MESH_FILTER_STACK_DEPTH];
+  int sp = 0;
+
+  for (uint16_t pc = 0; pc < length; pc++) {
+    float a, b;
+    switch (code[pc]) {
+    case OP_END:
+      return sp > 0 && stack[sp - 1] != 0;
+    case OP_CONST:
+      memcpy(&stack[sp++], &code[pc + 1], sizeof(float));
+      pc += sizeof(float);
+      continue;
+    case OP_VALUE:
+      stack[sp++] = value;
+      continue;
+    case OP_CHANNEL:
+      stack[sp++] = channel;
+      continue;
+    case OP_NEG:
+      stack[sp - 1] = -stack[sp - 1];
+      continue;
+    case OP_ABS:
+      stack[sp - 1] = fabsf(stack[sp - 1]);
+      continue;
+    case OP_NOT:
+      stack[sp - 1] = (stack[sp - 1] == 0);
+      continue;
+    default:
+      break;
+    }
+
+    // Binary operators
+    b = stack[--sp];
+    a = stack[sp - 1];
+    switch (code[pc]) {
+    case OP_ADD:
+      a = a + b;
+      break;
+    case OP_SUB:
+      a = a - b;
+      break;
+    case OP_MUL:
+      a = a * b;
+      break;
+    case OP_DIV:
+      a = (b != 0) ? a / b : 0;
+      break;
+    case OP_LT:
+      a = a < b;
+      break;
+    case OP_LE:
+      a = a <= b;
+      break;
+    case OP_GT:
+      a = a > b;
+      break;
+    case OP_GE:
+      a = a >= b;
+      break;
+    case OP_EQ:
+      a = a == b;
+      break;
+    case OP_NE:
+      a = a != b;
+      break;
+    case OP_AND:
+      a = (a != 0) && (b != 0);
+      break;
+    case OP_OR:
+      a = (a != 0) || (b != 0);
+      break;
+    default:
+      return false;
+    }
+    stack[sp - 1] = a;
+  }
+  return false;
+}
@@ -0,0 +1,392 @@
+/* ESP-MESH Persistent Telemetry Log Implementation */
+
+#include "mesh_flash_log.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_partition.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "mesh_data_transfer.h"
+#include "mesh_internal.h"
+#include "nvs.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+static const char *TAG = "mesh_log";
+
+#define MESH_LOG_NVS_NAMESPACE "mesh_log"
+#define MESH_LOG_NVS_KEY "acked"
+#define MESH_LOG_MAX_REPLY (MESH_MPS - sizeof(mesh_data_header_t))
+
+/*******************************************************
+ *                Wire Format
+ *******************************************************/
+typedef enum {
+  MESH_LOG_OP_PULL = 1, /**< root -> node: send records from seq */
+  MESH_LOG_OP_DATA = 2, /**< node -> root: consecutive records */
+  MESH_LOG_OP_ACK = 3,  /**< root -> node: records below seq are stored */
+} mesh_log_op_t;
+
+typedef struct {
+  uint8_t op;
+  uint32_t seq;
+  uint16_t max_records;
+} __attribute__((packed)) mesh_log_msg_pull_t;
+
+typedef struct {
+  uint8_t op;
+  uint32_t seq;
+} __attribute__((packed)) mesh_log_msg_ack_t;
+
+/* Followed by `count` records of [length u8][data], numbered from start_seq */
+typedef struct {
+  uint8_t op;
+  uint32_t first_seq; /**< Oldest record the node still stores */
+  uint32_t start_seq; /**< Sequence number of the first record below */
+  uint32_t next_seq;  /**< Cursor for the next pull */
+  uint16_t count;
+  uint8_t records[];
+} __attribute__((packed)) mesh_log_msg_data_t;
+
+typedef struct {
+  mesh_log_msg_data_t *msg;
+  uint16_t length;
+  uint16_t max_records;
+} mesh_log_reply_t;
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static bool s_initialized = false;
+static SemaphoreHandle_t s_lock = NULL;
+static const esp_partition_t *s_partition = NULL;
+static mesh_flash_log_engine_t *s_engine = NULL;
+static mesh_flash_log_record_cb_t s_record_cb = NULL;
+static mesh_flash_log_pull_done_cb_t s_done_cb = NULL;
+static uint8_t s_reply_buf[MESH_LOG_MAX_REPLY];
+
+/*******************************************************
+ *                Flash Backend
+ *******************************************************/
+static esp_err_t partition_read(void *ctx, uint32_t offset, void *data,
+                                uint32_t size) {
+  return esp_partition_read((const esp_partition_t *)ctx, offset, data, size);
+}
+
+static esp_err_t partition_write(void *ctx, uint32_t offset, const void *data,
+                                 uint32_t size) {
+  return esp_partition_write((const esp_partition_t *)ctx, offset, data, size);
+}
+
+static esp_err_t partition_erase(void *ctx, uint32_t offset, uint32_t size) {
+  return esp_partition_erase_range((const esp_partition_t *)ctx, offset, size);
+}
+
+static uint32_t mesh_log_load_acked(void) {
+  nvs_handle_t nvs;
+  uint32_t acked = 0;
+  if (nvs_open(MESH_LOG_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+    nvs_get_u32(nvs, MESH_LOG_NVS_KEY, &acked);
+    nvs_close(nvs);
+  }
+  return acked;
+}
+
+static void mesh_log_save_acked(uint32_t acked) {
+  nvs_handle_t nvs;
+  if (nvs_open(MESH_LOG_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+    ESP_LOGW(TAG, "Failed to open NVS");
+    return;
+  }
+  nvs_set_u32(nvs, MESH_LOG_NVS_KEY, acked);
+  nvs_commit(nvs);
+  nvs_close(nvs);
+}
+
+/*******************************************************
+ *                Node Side
+ *******************************************************/
+static bool mesh_log_reply_record(void *ctx, uint32_t seq, const uint8_t *data,
+                                  uint16_t length) {
+  mesh_log_reply_t *reply = (mesh_log_reply_t *)ctx;
+  mesh_log_msg_data_t *msg = reply->msg;
+
+  if (msg->count == 0) {
+    msg->start_seq = seq;
+  } else if (seq != msg->start_seq + msg->count) {
+    return false; // keep the reply consecutive
+  }
+  if ((size_t)reply->length + 1 + length > MESH_LOG_MAX_REPLY) {
+    return false;
+  }
+
+  s_reply_buf[reply->length] = (uint8_t)length;
+  memcpy(&s_reply_buf[reply->length + 1], data, length);
+  reply->length += 1 + length;
+  msg->count++;
+  return msg->count < reply->max_records;
+}
+
+static void mesh_log_node_pull(const mesh_log_msg_pull_t *pull) {
+  mesh_log_msg_data_t *msg = (mesh_log_msg_data_t *)s_reply_buf;
+  mesh_log_reply_t reply = {
+      .msg = msg,
+      .length = sizeof(*msg),
+      .max_records = pull->max_records,
+  };
+  if (reply.max_records == 0 ||
+      reply.max_records > MESH_FLASH_LOG_PULL_MAX_RECORDS) {
+    reply.max_records = MESH_FLASH_LOG_PULL_MAX_RECORDS;
+  }
+
+  msg->op = MESH_LOG_OP_DATA;
+  msg->count = 0;
+  msg->start_seq = pull->seq;
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  msg->first_seq = mesh_flash_log_engine_first_seq(s_engine);
+  mesh_flash_log_engine_read(s_engine, pull->seq, reply.max_records,
+                             mesh_log_reply_record, &reply);
+  msg->next_seq = (msg->count > 0) ? msg->start_seq + msg->count
+                                   : s_engine->next_seq;
+  xSemaphoreGive(s_lock);
+
+  esp_err_t err =
+      mesh_data_send_packet(NULL, MESH_DATA_TODS | MESH_DATA_NONBLOCK,
+                            MESH_DATA_TYPE_LOG, s_reply_buf, reply.length,
+                            NULL, 0);
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "Failed to send log records: %s", esp_err_to_name(err));
+  }
+}
+
+static void mesh_log_node_ack(const mesh_log_msg_ack_t *ack) {
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  uint32_t before = s_engine->acked_seq;
+  mesh_flash_log_engine_ack(s_engine, ack->seq);
+  uint32_t after = s_engine->acked_seq;
+  xSemaphoreGive(s_lock);
+
+  if (after != before) {
+    mesh_log_save_acked(after);
+    ESP_LOGD(TAG, "Acknowledged up to %" PRIu32, after);
+  }
+}
+
+/*******************************************************
+ *                Root Side
+ *******************************************************/
+static void mesh_log_root_data(const mesh_addr_t *from,
+                               const mesh_log_msg_data_t *msg,
+                               uint16_t length) {
+  uint16_t offset = sizeof(*msg);
+  uint16_t delivered = 0;
+
+  while (delivered < msg->count && offset < length) {
+    uint8_t record_length = ((const uint8_t *)msg)[offset];
+    if (offset + 1 + record_length > length) {
+      ESP_LOGW(TAG, "Truncated log reply from " MACSTR, MAC2STR(from->addr));
+      break;
+    }
+    if (s_record_cb != NULL) {
+      s_record_cb(from, msg->start_seq + delivered,
+                  (const uint8_t *)msg + offset + 1, record_length);
+    }
+    offset += 1 + record_length;
+    delivered++;
+  }
+
+  if (s_done_cb != NULL) {
+    s_done_cb(from, msg->first_seq,
+              (delivered == msg->count) ? msg->next_seq
+                                        : msg->start_seq + delivered,
+              delivered);
+  }
+}
+
+static esp_err_t mesh_log_root_send(const mesh_addr_t *node, const void *msg,
+                                    uint16_t length) {
+  if (node == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (!s_initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (!mesh_state_is_root()) {
+    ESP_LOGE(TAG, "Only root can pull logs");
+    return ESP_FAIL;
+  }
+  return mesh_data_send_packet(node, MESH_DATA_P2P, MESH_DATA_TYPE_LOG, msg,
+                               length, NULL, 0);
+}
+
+/*******************************************************
+ *                Protocol Handler
+ *******************************************************/
+static bool mesh_log_handle_packet(mesh_addr_t *from, uint8_t data_type,
+                                   uint8_t *payload, uint16_t length) {
+  if (length < 1) {
+    return true;
+  }
+
+  switch (payload[0]) {
+  case MESH_LOG_OP_PULL:
+    if (s_engine != NULL && length >= sizeof(mesh_log_msg_pull_t)) {
+      mesh_log_node_pull((const mesh_log_msg_pull_t *)payload);
+    }
+    break;
+  case MESH_LOG_OP_DATA:
+    if (mesh_state_is_root() && length >= sizeof(mesh_log_msg_data_t)) {
+      mesh_log_root_data(from, (const mesh_log_msg_data_t *)payload, length);
+    }
+    break;
+  case MESH_LOG_OP_ACK:
+    if (s_engine != NULL && length >= sizeof(mesh_log_msg_ack_t)) {
+      mesh_log_node_ack((const mesh_log_msg_ack_t *)payload);
+    }
+    break;
+  default:
+    ESP_LOGD(TAG, "Unknown log op %u", payload[0]);
+    break;
+  }
+  return true;
+}
+
+/*******************************************************
+ *                Public Functions
+ *******************************************************/
+esp_err_t mesh_flash_log_init(const char *partition_label) {
+  if (s_initialized) {
+    ESP_LOGW(TAG, "Already initialized");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  s_lock = xSemaphoreCreateMutex();
+  if (s_lock == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  if (partition_label != NULL) {
+    s_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                           ESP_PARTITION_SUBTYPE_ANY,
+                                           partition_label);
+    if (s_partition == NULL) {
+      ESP_LOGE(TAG, "Partition '%s' not found", partition_label);
+      return ESP_ERR_NOT_FOUND;
+    }
+
+    s_engine = calloc(1, sizeof(*s_engine));
+    if (s_engine == NULL) {
+      return ESP_ERR_NO_MEM;
+    }
+
+    mesh_flash_log_backend_t backend = {
+        .read = partition_read,
+        .write = partition_write,
+        .erase = partition_erase,
+        .size = s_partition->size,
+        .ctx = (void *)s_partition,
+    };
+    esp_err_t err =
+        mesh_flash_log_engine_mount(s_engine, &backend, mesh_log_load_acked());
+    if (err != ESP_OK) {
+      ESP_LOGE(TAG, "Failed to mount log: %s", esp_err_to_name(err));
+      free(s_engine);
+      s_engine = NULL;
+      return err;
+    }
+    ESP_LOGI(TAG, "Log mounted, records %" PRIu32 "..%" PRIu32 ", acked %" PRIu32,
+             mesh_flash_log_engine_first_seq(s_engine), s_engine->next_seq,
+             s_engine->acked_seq);
+  }
+
+  esp_err_t err = mesh_data_transfer_register_type_handler(
+      MESH_DATA_TYPE_LOG, mesh_log_handle_packet);
+  if (err != ESP_OK) {
+    return err;
+  }
+
+  s_initialized = true;
+  return ESP_OK;
+}
+
+esp_err_t mesh_flash_log_append(const void *data, uint16_t length,
+                                uint32_t *seq) {
+  if (s_engine == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  esp_err_t err = mesh_flash_log_engine_append(s_engine, data, length, seq);
+  xSemaphoreGive(s_lock);
+  return err;
+}
+
+esp_err_t mesh_flash_log_flush(void) {
+  if (s_engine == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  esp_err_t err = mesh_flash_log_engine_flush(s_engine);
+  xSemaphoreGive(s_lock);
+  return err;
+}
+
+esp_err_t mesh_flash_log_compact(int *erased) {
+  if (s_engine == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  int count = mesh_flash_log_engine_compact(s_engine);
+  xSemaphoreGive(s_lock);
+
+  if (erased != NULL) {
+    *erased = count;
+  }
+  return ESP_OK;
+}
+
+esp_err_t mesh_flash_log_get_stats(mesh_flash_log_stats_t *stats) {
+  if (stats == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (s_engine == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  *stats = s_engine->stats;
+  xSemaphoreGive(s_lock);
+  return ESP_OK;
+}
+
+esp_err_t mesh_flash_log_register_callbacks(
+    mesh_flash_log_record_cb_t record_cb,
+    mesh_flash_log_pull_done_cb_t done_cb) {
+  s_record_cb = record_cb;
+  s_done_cb = done_cb;
+  return ESP_OK;
+}
+
+esp_err_t mesh_flash_log_pull(const mesh_addr_t *node, uint32_t from_seq,
+                              uint16_t max_records) {
+  mesh_log_msg_pull_t msg = {
+      .op = MESH_LOG_OP_PULL,
+      .seq = from_seq,
+      .max_records = max_records,
+  };
+  return mesh_log_root_send(node, &msg, sizeof(msg));
+}
+
+esp_err_t mesh_flash_log_ack(const mesh_addr_t *node, uint32_t upto_seq) {
+  mesh_log_msg_ack_t msg = {
+      .op = MESH_LOG_OP_ACK,
+      .seq = upto_seq,
+  };
+  return mesh_log_root_send(node, &msg, sizeof(msg));
+}
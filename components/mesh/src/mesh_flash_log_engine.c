@@ -0,0 +1,457 @@
+/* Append-Only Flash Log Engine Implementation */
+
+#include "mesh_flash_log_engine.h"
+#include <stddef.h>
+#include <string.h>
+
+/*******************************************************
+ *                On-Flash Format
+ *******************************************************/
+#define SECTOR_MAGIC (0x474F4C4D) /* "MLOG" */
+#define BLOCK_MAGIC (0xB10C)
+#define BLOCK_COMMITTED (0x00)
+#define SEQ_EMPTY (UINT32_MAX)
+
+/* Written right after a sector is erased */
+typedef struct {
+  uint32_t magic;
+  uint32_t erase_count;
+} __attribute__((packed)) sector_header_t;
+
+/* Precedes every block; `committed` is programmed last so a block torn by a
+ * power loss is recognised and skipped */
+typedef struct {
+  uint16_t magic;
+  uint16_t length; /* payload bytes following the header */
+  uint32_t first_seq;
+  uint16_t count;
+  uint8_t committed;
+  uint8_t reserved;
+} __attribute__((packed)) block_header_t;
+
+#define BLOCK_PAYLOAD (MESH_FLASH_LOG_BLOCK_SIZE - sizeof(block_header_t))
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static inline uint32_t sector_base(uint16_t sector) {
+  return (uint32_t)sector * MESH_FLASH_LOG_SECTOR_SIZE;
+}
+
+static inline uint16_t next_sector(const mesh_flash_log_engine_t *engine,
+                                   uint16_t sector) {
+  return (sector + 1) % engine->sector_count;
+}
+
+static void update_wear_stats(mesh_flash_log_engine_t *engine) {
+  engine->stats.min_erase_count = UINT32_MAX;
+  engine->stats.max_erase_count = 0;
+  for (uint16_t i = 0; i < engine->sector_count; i++) {
+    uint32_t count = engine->sectors[i].erase_count;
+    if (count < engine->stats.min_erase_count) {
+      engine->stats.min_erase_count = count;
+    }
+    if (count > engine->stats.max_erase_count) {
+      engine->stats.max_erase_count = count;
+    }
+  }
+}
+
+/**
+ * @brief Last sequence number stored in a sector that holds records
+ */
+static uint32_t sector_last_seq(const mesh_flash_log_engine_t *engine,
+                                uint16_t sector) {
+  if (sector == engine->tail) {
+    return engine->next_seq - engine->block_count - 1;
+  }
+  for (uint16_t s = next_sector(engine, sector); s != sector;
+       s = next_sector(engine, s)) {
+    if (engine->sectors[s].first_seq != SEQ_EMPTY) {
+      return engine->sectors[s].first_seq - 1;
+    }
+    if (s == engine->tail) {
+      break;
+    }
+  }
+  return engine->next_seq - engine->block_count - 1;
+}
+
+/**
+ * @brief Point head at the oldest sector that still holds records
+ */
+static void find_head(mesh_flash_log_engine_t *engine) {
+  uint16_t s = next_sector(engine, engine->tail);
+  while (s != engine->tail && engine->sectors[s].first_seq == SEQ_EMPTY) {
+    s = next_sector(engine, s);
+  }
+  engine->head = s;
+}
+
+/**
+ * @brief Erase a sector and stamp its header
+ */
+static esp_err_t prepare_sector(mesh_flash_log_engine_t *engine,
+                                uint16_t sector) {
+  mesh_flash_log_sector_t *info = &engine->sectors[sector];
+  esp_err_t err = engine->backend.erase(
+      engine->backend.ctx, sector_base(sector), MESH_FLASH_LOG_SECTOR_SIZE);
+  if (err != ESP_OK) {
+    return err;
+  }
+
+  info->erase_count++;
+  sector_header_t header = {.magic = SECTOR_MAGIC,
+                            .erase_count = info->erase_count};
+  err = engine->backend.write(engine->backend.ctx, sector_base(sector),
+                              &header, sizeof(header));
+  if (err != ESP_OK) {
+    return err;
+  }
+
+  info->first_seq = SEQ_EMPTY;
+  info->erased = true;
+  engine->stats.sectors_erased++;
+  engine->stats.bytes_programmed += sizeof(header);
+  update_wear_stats(engine);
+  return ESP_OK;
+}
+
+/**
+ * @brief Move writing to the next sector, overwriting the oldest one if the
+ *        log is full
+ */
+static esp_err_t advance_tail(mesh_flash_log_engine_t *engine) {
+  uint16_t next = next_sector(engine, engine->tail);
+  mesh_flash_log_sector_t *info = &engine->sectors[next];
+
+  if (info->first_seq != SEQ_EMPTY) {
+    uint32_t last = sector_last_seq(engine, next);
+    uint32_t first = info->first_seq > engine->acked_seq ? info->first_seq
+                                                         : engine->acked_seq;
+    if (last + 1 > first) {
+      engine->stats.records_lost += last + 1 - first;
+    }
+    info->first_seq = SEQ_EMPTY;
+  }
+
+  if (!info->erased) {
+    esp_err_t err = prepare_sector(engine, next);
+    if (err != ESP_OK) {
+      return err;
+    }
+  }
+
+  engine->tail = next;
+  engine->tail_offset = sizeof(sector_header_t);
+  find_head(engine);
+  return ESP_OK;
+}
+
+esp_err_t mesh_flash_log_engine_mount(mesh_flash_log_engine_t *engine,
+                                      const mesh_flash_log_backend_t *backend,
+                                      uint32_t acked_seq) {
+  if (engine == NULL || backend == NULL || backend->read == NULL ||
+      backend->write == NULL || backend->erase == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  uint32_t sector_count = backend->size / MESH_FLASH_LOG_SECTOR_SIZE;
+  if (sector_count < 2 || sector_count > MESH_FLASH_LOG_MAX_SECTORS) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  memset(engine, 0, sizeof(*engine));
+  engine->backend = *backend;
+  engine->sector_count = sector_count;
+  engine->acked_seq = acked_seq;
+
+  // Recover per-sector state and locate the newest sector
+  bool found = false;
+  uint32_t newest_seq = 0;
+  for (uint16_t i = 0; i < engine->sector_count; i++) {
+    mesh_flash_log_sector_t *info = &engine->sectors[i];
+    sector_header_t header;
+    block_header_t block;
+    esp_err_t err;
+
+    info->first_seq = SEQ_EMPTY;
+    err = backend->read(backend->ctx, sector_base(i), &header, sizeof(header));
+    if (err != ESP_OK) {
+      return err;
+    }
+    if (header.magic != SECTOR_MAGIC) {
+      continue; // never used or torn erase; erased again before use
+    }
+    info->erase_count = header.erase_count;
+
+    err = backend->read(backend->ctx, sector_base(i) + sizeof(header), &block,
+                        sizeof(block));
+    if (err != ESP_OK) {
+      return err;
+    }
+    if (block.magic == BLOCK_MAGIC && block.committed == BLOCK_COMMITTED) {
+      info->first_seq = block.first_seq;
+      if (!found || block.first_seq >= newest_seq) {
+        newest_seq = block.first_seq;
+        engine->tail = i;
+        found = true;
+      }
+    } else if (block.magic == 0xFFFF) {
+      info->erased = true;
+    }
+  }
+  update_wear_stats(engine);
+
+  if (!found) {
+    // Empty log: the first flush opens sector 0
+    engine->tail = engine->sector_count - 1;
+    engine->tail_offset = MESH_FLASH_LOG_SECTOR_SIZE;
+    engine->head = 0;
+    engine->next_seq = acked_seq;
+    return ESP_OK;
+  }
+
+  // Find the end of the newest sector
+  uint32_t offset = sizeof(sector_header_t);
+  engine->next_seq = newest_seq;
+  while (offset + sizeof(block_header_t) <= MESH_FLASH_LOG_SECTOR_SIZE) {
+    block_header_t block;
+    esp_err_t err = backend->read(
+        backend->ctx, sector_base(engine->tail) + offset, &block,
+        sizeof(block));
+    if (err != ESP_OK) {
+      return err;
+    }
+    if (block.magic == 0xFFFF) {
+      break;
+    }
+    if (block.magic != BLOCK_MAGIC || block.committed != BLOCK_COMMITTED) {
+      // Torn block: never program over it, continue in the next sector
+      offset = MESH_FLASH_LOG_SECTOR_SIZE;
+      break;
+    }
+    engine->next_seq = block.first_seq + block.count;
+    offset += sizeof(block) + block.length;
+  }
+  engine->tail_offset = offset;
+  engine->sectors[engine->tail].erased = false;
+  if (engine->next_seq < acked_seq) {
+    engine->next_seq = acked_seq;
+  }
+
+  find_head(engine);
+  mesh_flash_log_engine_ack(engine, acked_seq);
+  return ESP_OK;
+}
+
+esp_err_t mesh_flash_log_engine_flush(mesh_flash_log_engine_t *engine) {
+  if (engine->block_count == 0) {
+    return ESP_OK;
+  }
+
+  uint32_t total = sizeof(block_header_t) + engine->block_length;
+  if (engine->tail_offset + total > MESH_FLASH_LOG_SECTOR_SIZE) {
+    esp_err_t err = advance_tail(engine);
+    if (err != ESP_OK) {
+      return err;
+    }
+  }
+
+  uint32_t offset = sector_base(engine->tail) + engine->tail_offset;
+  block_header_t header = {
+      .magic = BLOCK_MAGIC,
+      .length = engine->block_length,
+      .first_seq = engine->next_seq - engine->block_count,
+      .count = engine->block_count,
+      .committed = 0xFF,
+      .reserved = 0xFF,
+  };
+  uint8_t committed = BLOCK_COMMITTED;
+
+  esp_err_t err =
+      engine->backend.write(engine->backend.ctx, offset, &header,
+                            sizeof(header));
+  if (err == ESP_OK) {
+    err = engine->backend.write(engine->backend.ctx, offset + sizeof(header),
+                                engine->block, engine->block_length);
+  }
+  if (err == ESP_OK) {
+    err = engine->backend.write(
+        engine->backend.ctx, offset + offsetof(block_header_t, committed),
+        &committed, sizeof(committed));
+  }
+  if (err != ESP_OK) {
+    // Skip the damaged area; the records stay buffered for the next try
+    engine->tail_offset = MESH_FLASH_LOG_SECTOR_SIZE;
+    return err;
+  }
+
+  mesh_flash_log_sector_t *info = &engine->sectors[engine->tail];
+  if (info->first_seq == SEQ_EMPTY) {
+    info->first_seq = header.first_seq;
+  }
+  info->erased = false;
+  engine->tail_offset += total;
+  engine->stats.bytes_programmed += total;
+  engine->stats.blocks_written++;
+  engine->block_length = 0;
+  engine->block_count = 0;
+  find_head(engine);
+  return ESP_OK;
+}
+
+esp_err_t mesh_flash_log_engine_append(mesh_flash_log_engine_t *engine,
+                                       const void *data, uint16_t length,
+                                       uint32_t *seq) {
+  if (engine == NULL || data == NULL || length == 0 ||
+      length > MESH_FLASH_LOG_MAX_RECORD) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if ((size_t)engine->block_length + 1 + length > BLOCK_PAYLOAD) {
+    esp_err_t err = mesh_flash_log_engine_flush(engine);
+    if (err != ESP_OK) {
+      return err;
+    }
+  }
+
+  engine->block[engine->block_length] = (uint8_t)length;
+  memcpy(&engine->block[engine->block_length + 1], data, length);
+  engine->block_length += 1 + length;
+  engine->block_count++;
+  if (seq != NULL) {
+    *seq = engine->next_seq;
+  }
+  engine->next_seq++;
+  engine->stats.records_appended++;
+  engine->stats.bytes_appended += length;
+  return ESP_OK;
+}
+
+/**
+ * @brief Deliver the records of one block payload at or after from_seq
+ *
+ * @return false if the callback asked to stop or max_records was reached
+ */
+static bool read_block(const uint8_t *payload, uint16_t length,
+                       uint32_t first_seq, uint32_t from_seq, int max_records,
+                       int *delivered, mesh_flash_log_read_cb_t cb,
+                       void *ctx) {
+  uint16_t offset = 0;
+  uint32_t seq = first_seq;
+
+  while (offset < length) {
+    uint8_t record_length = payload[offset];
+    if (offset + 1 + record_length > length) {
+      break;
+    }
+    if (seq >= from_seq) {
+      if (!cb(ctx, seq, &payload[offset + 1], record_length)) {
+        return false;
+      }
+      if (++(*delivered) >= max_records) {
+        return false;
+      }
+    }
+    offset += 1 + record_length;
+    seq++;
+  }
+  return true;
+}
+
+int mesh_flash_log_engine_read(mesh_flash_log_engine_t *engine,
+                               uint32_t from_seq, int max_records,
+                               mesh_flash_log_read_cb_t cb, void *ctx) {
+  uint8_t payload[BLOCK_PAYLOAD];
+  int delivered = 0;
+
+  if (engine == NULL || cb == NULL || max_records <= 0) {
+    return 0;
+  }
+
+  uint16_t s = engine->head;
+  while (true) {
+    const mesh_flash_log_sector_t *info = &engine->sectors[s];
+    if (info->first_seq != SEQ_EMPTY &&
+        sector_last_seq(engine, s) >= from_seq) {
+      uint32_t offset = sizeof(sector_header_t);
+      while (offset + sizeof(block_header_t) <= MESH_FLASH_LOG_SECTOR_SIZE) {
+        block_header_t block;
+        if (engine->backend.read(engine->backend.ctx, sector_base(s) + offset,
+                                 &block, sizeof(block)) != ESP_OK ||
+            block.magic != BLOCK_MAGIC ||
+            block.committed != BLOCK_COMMITTED ||
+            block.length > BLOCK_PAYLOAD) {
+          break;
+        }
+        if (block.first_seq + block.count > from_seq) {
+          if (engine->backend.read(engine->backend.ctx,
+                                   sector_base(s) + offset + sizeof(block),
+                                   payload, block.length) != ESP_OK ||
+              !read_block(payload, block.length, block.first_seq, from_seq,
+                          max_records, &delivered, cb, ctx)) {
+            return delivered;
+          }
+        }
+        offset += sizeof(block) + block.length;
+      }
+    }
+    if (s == engine->tail) {
+      break;
+    }
+    s = next_sector(engine, s);
+  }
+
+  // Records still buffered in RAM
+  read_block(engine->block, engine->block_length,
+             engine->next_seq - engine->block_count, from_seq, max_records,
+             &delivered, cb, ctx);
+  return delivered;
+}
+
+void mesh_flash_log_engine_ack(mesh_flash_log_engine_t *engine,
+                               uint32_t upto_seq) {
+  if (upto_seq > engine->next_seq) {
+    upto_seq = engine->next_seq;
+  }
+  if (upto_seq > engine->acked_seq) {
+    engine->acked_seq = upto_seq;
+  }
+
+  // Reclaim whole sectors; the tail sector is still being written
+  while (engine->head != engine->tail &&
+         engine->sectors[engine->head].first_seq != SEQ_EMPTY &&
+         sector_last_seq(engine, engine->head) < engine->acked_seq) {
+    engine->sectors[engine->head].first_seq = SEQ_EMPTY;
+    find_head(engine);
+  }
+}
+
+int mesh_flash_log_engine_compact(mesh_flash_log_engine_t *engine) {
+  int erased = 0;
+  uint16_t s = next_sector(engine, engine->tail);
+
+  for (int i = 0; i < MESH_FLASH_LOG_PREERASE_SECTORS && s != engine->tail;
+       i++, s = next_sector(engine, s)) {
+    mesh_flash_log_sector_t *info = &engine->sectors[s];
+    if (info->first_seq != SEQ_EMPTY) {
+      break; // unacknowledged data ahead
+    }
+    if (!info->erased) {
+      if (prepare_sector(engine, s) != ESP_OK) {
+        break;
+      }
+      erased++;
+    }
+  }
+  return erased;
+}
+
+uint32_t mesh_flash_log_engine_first_seq(const mesh_flash_log_engine_t *engine) {
+  const mesh_flash_log_sector_t *info = &engine->sectors[engine->head];
+  if (info->first_seq != SEQ_EMPTY) {
+    return info->first_seq;
+  }
+  return engine->next_seq - engine->block_count;
+}
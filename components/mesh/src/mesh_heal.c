@@ -0,0 +1,306 @@
+/* ESP-MESH Healing Benchmark Implementation */
+
+#include "mesh_heal.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_mesh.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "mesh_data_transfer.h"
+#include "mesh_internal.h"
+#include <string.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+static const char *TAG = "mesh_heal";
+
+/*******************************************************
+ *                Wire Format
+ *******************************************************/
+typedef enum {
+  MESH_HEAL_OP_ARM = 1,   /**< root -> all: start probing */
+  MESH_HEAL_OP_PROBE = 2, /**< node -> root: still delivering */
+  MESH_HEAL_OP_KILL = 3,  /**< root -> relay: stop the mesh for a while */
+} mesh_heal_op_t;
+
+typedef struct {
+  uint8_t op;
+  uint16_t probe_ms;
+  uint32_t duration_ms;
+} __attribute__((packed)) mesh_heal_msg_arm_t;
+
+typedef struct {
+  uint8_t op;
+  uint32_t off_ms;
+} __attribute__((packed)) mesh_heal_msg_kill_t;
+
+/* Read-only pass over the root's topology map */
+typedef struct {
+  const uint8_t *relay;
+  bool found;
+  int count;
+  uint8_t orphans[MESH_HEAL_MAX_ORPHANS][6];
+} mesh_heal_plan_t;
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static bool s_initialized = false;
+static SemaphoreHandle_t s_lock = NULL;
+
+/* Node side, guarded by s_lock */
+static uint32_t s_probe_ms = MESH_HEAL_DEFAULT_PROBE_MS;
+static uint32_t s_probe_until_ms = 0;
+static bool s_probing = false;
+
+/* Root side, guarded by s_lock */
+static bool s_bench_started = false;
+static mesh_heal_bench_t s_bench;
+static esp_timer_handle_t s_kill_timer = NULL;
+static mesh_heal_msg_kill_t s_kill;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static uint32_t now_ms(void) {
+  return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static void plan_visitor(const mesh_topology_engine_t *engine, void *arg) {
+  mesh_heal_plan_t *plan = (mesh_heal_plan_t *)arg;
+  int relay = mesh_topology_engine_find(engine, plan->relay);
+
+  if (relay < 0) {
+    return;
+  }
+  plan->found = true;
+
+  for (int i = 0; i < MESH_TOPOLOGY_MAX_NODES; i++) {
+    if (!engine->nodes[i].used || i == relay) {
+      continue;
+    }
+    // Walk up; the hop bound guards against a stale loop in the map
+    uint16_t up = engine->nodes[i].parent;
+    for (int hops = 0; up != MESH_TOPOLOGY_NONE &&
+                       hops < MESH_TOPOLOGY_MAX_NODES;
+         hops++) {
+      if (up == relay) {
+        if (plan->count < MESH_HEAL_MAX_ORPHANS) {
+          memcpy(plan->orphans[plan->count++], engine->nodes[i].mac, 6);
+        }
+        break;
+      }
+      up = engine->nodes[up].parent;
+    }
+  }
+}
+
+/**
+ * @brief Whether a control message comes from the current root
+ */
+static bool from_root(const mesh_addr_t *from) {
+  mesh_state_t state;
+
+  mesh_state_get(&state);
+  return memcmp(from->addr, state.root.addr, 6) == 0;
+}
+
+static void mesh_heal_kill_cb(void *arg) {
+  mesh_addr_t relay;
+  mesh_heal_msg_kill_t msg;
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  memcpy(relay.addr, s_bench.relay.mac, 6);
+  msg = s_kill;
+  xSemaphoreGive(s_lock);
+
+  esp_err_t err =
+      mesh_data_send_packet(&relay, MESH_DATA_FROMDS | MESH_DATA_NONBLOCK,
+                            MESH_DATA_TYPE_HEAL, (uint8_t *)&msg, sizeof(msg),
+                            NULL, 0);
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "Failed to stop " MACSTR ": %s", MAC2STR(relay.addr),
+             esp_err_to_name(err));
+    return;
+  }
+  ESP_LOGI(TAG, "Stopping " MACSTR " for %" PRIu32 " ms",
+           MAC2STR(relay.addr), msg.off_ms);
+}
+
+static void mesh_heal_task(void *arg) {
+  const uint8_t probe = MESH_HEAL_OP_PROBE;
+  mesh_state_t state;
+
+  while (1) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t delay_ms = s_probe_ms;
+    bool probing = s_probing;
+    if (probing && (int32_t)(s_probe_until_ms - now_ms()) <= 0) {
+      s_probing = probing = false;
+    }
+    xSemaphoreGive(s_lock);
+
+    vTaskDelay(pdMS_TO_TICKS(delay_ms));
+    if (!probing) {
+      continue;
+    }
+
+    // Probes are only timed on arrival, so none are queued while orphaned
+    mesh_state_get(&state);
+    if (state.connected && !state.is_root) {
+      mesh_send_to_root(MESH_DATA_TYPE_HEAL, &probe, sizeof(probe));
+    }
+  }
+}
+
+static bool mesh_heal_handle_packet(mesh_addr_t *from, uint8_t data_type,
+                                    uint8_t *payload, uint16_t length) {
+  if (length == 1 && payload[0] == MESH_HEAL_OP_PROBE) {
+    uint32_t now = now_ms();
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_bench_started) {
+      mesh_heal_bench_arrival(&s_bench, from->addr, now);
+    }
+    xSemaphoreGive(s_lock);
+  } else if (length == sizeof(mesh_heal_msg_arm_t) &&
+             payload[0] == MESH_HEAL_OP_ARM) {
+    mesh_heal_msg_arm_t msg;
+    if (!from_root(from)) {
+      ESP_LOGW(TAG, "Ignoring arm from " MACSTR, MAC2STR(from->addr));
+      return true;
+    }
+    memcpy(&msg, payload, sizeof(msg));
+    if (msg.probe_ms < MESH_HEAL_MIN_PROBE_MS) {
+      msg.probe_ms = MESH_HEAL_MIN_PROBE_MS;
+    } else if (msg.probe_ms > MESH_HEAL_MAX_PROBE_MS) {
+      msg.probe_ms = MESH_HEAL_MAX_PROBE_MS;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_probe_ms = msg.probe_ms;
+    s_probe_until_ms = now_ms() + msg.duration_ms;
+    s_probing = true;
+    xSemaphoreGive(s_lock);
+  } else if (length == sizeof(mesh_heal_msg_kill_t) &&
+             payload[0] == MESH_HEAL_OP_KILL) {
+    mesh_heal_msg_kill_t msg;
+    if (!from_root(from)) {
+      ESP_LOGW(TAG, "Ignoring stop from " MACSTR, MAC2STR(from->addr));
+      return true;
+    }
+    memcpy(&msg, payload, sizeof(msg));
+    ESP_LOGW(TAG, "Stopping the mesh for %" PRIu32 " ms", msg.off_ms);
+    mesh_request_outage(msg.off_ms);
+  }
+  return true;
+}
+
+/*******************************************************
+ *                Public Functions
+ *******************************************************/
+esp_err_t mesh_heal_init(void) {
+  if (s_initialized) {
+    ESP_LOGW(TAG, "Already initialized");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  s_lock = xSemaphoreCreateMutex();
+  if (s_lock == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  esp_timer_create_args_t timer_args = {
+      .callback = mesh_heal_kill_cb,
+      .name = "mesh_heal_kill",
+  };
+  if (esp_timer_create(&timer_args, &s_kill_timer) != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to create kill timer");
+    return ESP_ERR_NO_MEM;
+  }
+
+  esp_err_t err = mesh_data_transfer_register_type_handler(
+      MESH_DATA_TYPE_HEAL, mesh_heal_handle_packet);
+  if (err != ESP_OK) {
+    return err;
+  }
+
+  if (xTaskCreate(mesh_heal_task, "mesh_heal", MESH_HEAL_TASK_STACK_SIZE,
+                  NULL, MESH_HEAL_TASK_PRIORITY, NULL) != pdPASS) {
+    ESP_LOGE(TAG, "Failed to create heal task");
+    return ESP_ERR_NO_MEM;
+  }
+
+  s_initialized = true;
+  return ESP_OK;
+}
+
+esp_err_t mesh_heal_bench_start(const uint8_t *relay, uint32_t off_ms,
+                                uint32_t duration_ms) {
+  mesh_heal_plan_t plan = {.relay = relay};
+
+  if (relay == NULL || duration_ms == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (!s_initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (!mesh_state_is_root()) {
+    ESP_LOGE(TAG, "Only the root can run the benchmark");
+    return ESP_FAIL;
+  }
+
+  if (mesh_topology_visit(plan_visitor, &plan) != ESP_OK) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (!plan.found) {
+    return ESP_ERR_NOT_FOUND;
+  }
+
+  mesh_heal_msg_arm_t arm = {.op = MESH_HEAL_OP_ARM,
+                             .probe_ms = MESH_HEAL_DEFAULT_PROBE_MS,
+                             .duration_ms = duration_ms};
+  esp_err_t err = mesh_broadcast_from_root(MESH_DATA_TYPE_HEAL,
+                                           (uint8_t *)&arm, sizeof(arm));
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to arm: %s", esp_err_to_name(err));
+    return ESP_FAIL;
+  }
+
+  esp_timer_stop(s_kill_timer);
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  mesh_heal_bench_init(&s_bench, relay, (const uint8_t(*)[6])plan.orphans,
+                       plan.count, MESH_HEAL_DEFAULT_PROBE_MS, now_ms());
+  s_bench_started = true;
+  s_kill.op = MESH_HEAL_OP_KILL;
+  s_kill.off_ms = off_ms;
+  xSemaphoreGive(s_lock);
+  if (off_ms > 0) {
+    esp_timer_start_once(s_kill_timer, (uint64_t)MESH_HEAL_ARM_MS * 1000);
+  }
+
+  ESP_LOGI(TAG, "Benchmark armed: relay " MACSTR ", %d orphans",
+           MAC2STR(relay), plan.count);
+  return ESP_OK;
+}
+
+esp_err_t mesh_heal_bench_get(mesh_heal_result_t *result) {
+  esp_err_t err = ESP_ERR_INVALID_STATE;
+
+  if (result == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (s_lock == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  uint32_t now = now_ms();
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  if (s_bench_started) {
+    mesh_heal_bench_result(&s_bench, now, result);
+    err = ESP_OK;
+  }
+  xSemaphoreGive(s_lock);
+  return err;
+}
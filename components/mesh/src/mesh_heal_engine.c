@@ -0,0 +1,93 @@
+/* Healing Benchmark Engine Implementation */
+
+#include "mesh_heal_engine.h"
+#include <string.h>
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static void node_init(mesh_heal_node_t *node, const uint8_t *mac,
+                      uint32_t now_ms) {
+  memset(node, 0, sizeof(*node));
+  memcpy(node->mac, mac, 6);
+  node->last_ms = now_ms;
+}
+
+static void node_arrival(mesh_heal_node_t *node, uint32_t gap_ms,
+                         uint32_t now_ms) {
+  // Only the first silence counts; the relay may come back later
+  if (!node->resumed && now_ms - node->last_ms >= gap_ms) {
+    node->resumed = true;
+    node->gap_start_ms = node->last_ms;
+    node->resume_ms = now_ms;
+  }
+  node->last_ms = now_ms;
+}
+
+void mesh_heal_bench_init(mesh_heal_bench_t *bench, const uint8_t *relay,
+                          const uint8_t (*orphans)[6], int count,
+                          uint32_t probe_ms, uint32_t now_ms) {
+  memset(bench, 0, sizeof(*bench));
+  bench->gap_ms = probe_ms * MESH_HEAL_GAP_PROBES;
+  node_init(&bench->relay, relay, now_ms);
+  if (count > MESH_HEAL_MAX_ORPHANS) {
+    count = MESH_HEAL_MAX_ORPHANS;
+  }
+  for (int i = 0; i < count; i++) {
+    node_init(&bench->orphans[i], orphans[i], now_ms);
+  }
+  bench->orphan_count = (uint16_t)count;
+}
+
+void mesh_heal_bench_arrival(mesh_heal_bench_t *bench, const uint8_t *mac,
+                             uint32_t now_ms) {
+  if (memcmp(bench->relay.mac, mac, 6) == 0) {
+    node_arrival(&bench->relay, bench->gap_ms, now_ms);
+    return;
+  }
+  for (int i = 0; i < bench->orphan_count; i++) {
+    if (memcmp(bench->orphans[i].mac, mac, 6) == 0) {
+      node_arrival(&bench->orphans[i], bench->gap_ms, now_ms);
+      return;
+    }
+  }
+}
+
+void mesh_heal_bench_result(const mesh_heal_bench_t *bench, uint32_t now_ms,
+                            mesh_heal_result_t *result) {
+  const mesh_heal_node_t *relay = &bench->relay;
+  uint32_t heals[MESH_HEAL_MAX_ORPHANS];
+  uint32_t outage_ms;
+
+  memset(result, 0, sizeof(*result));
+  result->orphans = bench->orphan_count;
+  if (relay->resumed) {
+    outage_ms = relay->gap_start_ms;
+  } else if (now_ms - relay->last_ms >= bench->gap_ms) {
+    outage_ms = relay->last_ms;
+  } else {
+    return;
+  }
+  result->outage_seen = true;
+
+  for (int i = 0; i < bench->orphan_count; i++) {
+    const mesh_heal_node_t *orphan = &bench->orphans[i];
+    // A silence that ended before the outage was not caused by it
+    if (!orphan->resumed ||
+        (int32_t)(orphan->resume_ms - outage_ms) < 0) {
+      continue;
+    }
+    uint32_t heal = orphan->resume_ms - outage_ms;
+    int j = result->healed++;
+    while (j > 0 && heals[j - 1] > heal) {
+      heals[j] = heals[j - 1];
+      j--;
+    }
+    heals[j] = heal;
+  }
+
+  if (result->healed > 0) {
+    result->max_ms = heals[result->healed - 1];
+    result->median_ms = heals[result->healed / 2];
+  }
+}
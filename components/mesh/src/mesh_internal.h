@@ -0,0 +1,396 @@
+/* ESP-MESH Component Internal Interfaces
+ *
+ * Helpers shared between the component's source files. Not part of the
+ * public API; applications should only include the headers under inc/.
+ */
+
+#ifndef __MESH_INTERNAL_H__
+#define __MESH_INTERNAL_H__
+
+#include "esp_err.h"
+#include "esp_mesh.h"
+#include "mesh.h"
+#include "mesh_boot_trace.h"
+#include "mesh_link_engine.h"
+#include "mesh_params_engine.h"
+#include "mesh_state.h"
+#include "mesh_topology_engine.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MESH_MAX_TYPE_HANDLERS (16)
+
+/**
+ * @brief Everything esp_mesh_set_parent() needs to reach one parent
+ */
+typedef struct {
+  uint8_t bssid[6];
+  uint8_t ssid[32];
+  uint8_t channel;
+  uint8_t authmode; /* wifi_auth_mode_t */
+  uint8_t mesh_id[6];
+  uint8_t type; /* mesh_type_t */
+  int8_t layer;
+  int8_t rssi;
+} mesh_parent_target_t;
+
+/**
+ * @brief Handler for a component-internal data type
+ *
+ * Invoked from the receive task before the application callback.
+ *
+ * @return true if the packet was consumed, false to pass it on to the next
+ *         handler or to the application callback
+ */
+typedef bool (*mesh_type_handler_t)(mesh_addr_t *from, uint8_t data_type,
+                                    uint8_t *payload, uint16_t length);
+
+/**
+ * @brief Callback given read access to the root's topology map
+ */
+typedef void (*mesh_topology_visitor_t)(const mesh_topology_engine_t *engine,
+                                        void *arg);
+
+/**
+ * @brief Register a handler for packets of a given data type
+ *
+ * Several handlers may be registered for the same type; they are tried in
+ * registration order until one consumes the packet.
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: Invalid handler pointer
+ *    - ESP_ERR_NO_MEM: Handler table full
+ */
+esp_err_t mesh_data_transfer_register_type_handler(uint8_t data_type,
+                                                   mesh_type_handler_t handler);
+
+/**
+ * @brief Build a data packet and hand it to esp_mesh_send()
+ *
+ * Performs no role checks and no per-packet INFO logging, so it is suitable
+ * for high-rate internal traffic.
+ *
+ * @param to Destination address, NULL for the root (MESH_DATA_TODS)
+ * @param flag esp_mesh_send() flags
+ * @param data_type Type of data being sent
+ * @param payload Pointer to payload data
+ * @param length Length of payload in bytes
+ * @param opt esp_mesh_send() options, may be NULL
+ * @param opt_count Number of options
+ */
+esp_err_t mesh_data_send_packet(const mesh_addr_t *to, int flag,
+                                uint8_t data_type, const uint8_t *payload,
+                                uint16_t length, const mesh_opt_t *opt,
+                                int opt_count);
+
+/**
+ * @brief Send a packet to this node's parent
+ *
+ * Children of the root use MESH_DATA_TODS; deeper nodes address their
+ * parent P2P, whose station MAC is one below the softAP BSSID they joined.
+ *
+ * @param data_type Type of data being sent
+ * @param payload Pointer to payload data
+ * @param length Length of payload in bytes
+ * @param flag Extra esp_mesh_send() flags, e.g. MESH_DATA_NONBLOCK
+ */
+esp_err_t mesh_data_send_to_parent(uint8_t data_type, const uint8_t *payload,
+                                   uint16_t length, int flag);
+
+/**
+ * @brief Send a small control item with the next data frame to a peer
+ *
+ * The item rides on the next packet sent to the peer, if the peer
+ * announced MESH_NODE_FEATURE_HEADER_EXT, and reaches the data_type
+ * handlers there as if it had come alone. If no packet goes to the peer
+ * within delay_ms, the item is sent alone. A newer item with the same
+ * type and first byte (op or magic) for the same peer replaces the queued
+ * one, so only send state that supersedes itself, such as heartbeats and
+ * version adverts.
+ *
+ * @param to Station MAC of the peer, NULL for the root
+ * @param delay_ms Longest the item may wait for a data frame
+ *
+ * @return
+ *    - ESP_OK: Queued
+ *    - ESP_ERR_INVALID_SIZE: Longer than MESH_PIGGYBACK_ITEM_MAX
+ *    - ESP_ERR_NO_MEM: The queue is full; send the item directly
+ *    - ESP_ERR_INVALID_STATE: Data transfer not initialized
+ */
+esp_err_t mesh_data_piggyback(const mesh_addr_t *to, uint8_t data_type,
+                              const void *item, uint8_t length,
+                              uint32_t delay_ms);
+
+/**
+ * @brief Node ID this node announced with mesh_announce_node_identity()
+ *
+ * @return Node ID, 0 if none was announced
+ */
+uint8_t mesh_get_own_node_id(void);
+
+/**
+ * @brief Capabilities of a peer as announced in the identity handshake
+ *
+ * Gives MESH_NODE_FEATURES_LEGACY and MESH_RX_BUFFER_SIZE for a peer that
+ * never announced, or a new root that has not answered yet, so callers can
+ * always pick an encoding from it. Safe to call from any task.
+ *
+ * @param addr Station MAC of a registered node (root), NULL for the root
+ * @param caps Output
+ */
+void mesh_peer_caps(const mesh_addr_t *addr, mesh_node_caps_t *caps);
+
+/**
+ * @brief Add MESH_NODE_FEATURE_* bits this node can now receive
+ *
+ * Called by modules as they start. A root tells every node at once.
+ */
+void mesh_caps_add_feature(uint16_t features);
+
+/**
+ * @brief Join a mesh group for packets sent with MESH_DATA_GROUP
+ *
+ * esp_mesh_set_group_id() replaces the whole list, so modules join through
+ * here and the list is given to the stack again on every start.
+ *
+ * @param group Multicast group address
+ *
+ * @return ESP_ERR_NO_MEM once four groups are joined
+ */
+esp_err_t mesh_join_group(const mesh_addr_t *group);
+
+/**
+ * @brief Check whether upstream packets must go through the store-and-forward
+ *        queue (node disconnected, or older packets still waiting for replay)
+ *
+ * @return false if store-and-forward is not enabled
+ */
+bool mesh_store_forward_is_holding(void);
+
+/**
+ * @brief Queue an upstream packet for later replay
+ *
+ * @return
+ *    - ESP_OK: Packet queued
+ *    - ESP_ERR_INVALID_STATE: Store-and-forward not enabled
+ *    - ESP_ERR_INVALID_SIZE: Packet larger than a replay burst
+ *    - ESP_ERR_NO_MEM: Queue full
+ */
+esp_err_t mesh_store_forward_enqueue(uint8_t data_type, const uint8_t *payload,
+                                     uint16_t length);
+
+/**
+ * @brief Absorb an upstream packet into the current aggregation window
+ *
+ * @return
+ *    - ESP_OK: Packet absorbed, nothing else to send
+ *    - ESP_ERR_NOT_SUPPORTED: Type not aggregated (or aggregation disabled);
+ *      send the packet as usual
+ */
+esp_err_t mesh_aggregation_submit(uint8_t data_type, const uint8_t *payload,
+                                  uint16_t length);
+
+/**
+ * @brief Drop the readings of an upstream packet that match no filter
+ *        subscription
+ *
+ * @param data_type Packet data type
+ * @param payload Packet payload
+ * @param length Payload length
+ * @param out Filtered payload, at least length bytes
+ * @param out_length Set to the filtered length, 0 if nothing matched
+ *
+ * @return
+ *    - ESP_OK: Packet filtered into out
+ *    - ESP_ERR_NOT_SUPPORTED: No subscription for the type (or filtering
+ *      disabled); send the packet unchanged
+ */
+esp_err_t mesh_filter_apply(uint8_t data_type, const uint8_t *payload,
+                            uint16_t length, uint8_t *out,
+                            uint16_t *out_length);
+
+/**
+ * @brief Hand an application packet to the reactor
+ *
+ * @return
+ *    - ESP_OK: Packet queued for the reactor's RX handlers
+ *    - ESP_ERR_NOT_SUPPORTED: Reactor not running or no RX handler
+ *      registered; deliver the packet to the receive callback
+ *    - Other: Packet dropped
+ */
+esp_err_t mesh_reactor_post_rx(const mesh_addr_t *from, uint8_t data_type,
+                               const uint8_t *payload, uint16_t length);
+
+/**
+ * @brief Record the first time a boot phase is reached
+ */
+void mesh_boot_trace_mark(mesh_boot_phase_t phase);
+
+/**
+ * @brief Tell the boot trace whether this boot takes the fast path
+ *
+ * Called once from mesh_init(), before any packet is sent.
+ */
+void mesh_boot_trace_set_warm(bool warm);
+
+/**
+ * @brief Answer a boot trace collect query
+ *
+ * @return
+ *    - ESP_OK: value set
+ *    - ESP_ERR_NOT_FOUND: Phase not reached yet; answer without a value
+ *    - ESP_ERR_NOT_SUPPORTED: Not a boot trace query; ask the responder
+ */
+esp_err_t mesh_boot_trace_answer(uint16_t query, float *value);
+
+/**
+ * @brief Create the event log lock; records put before are dropped
+ */
+esp_err_t mesh_event_log_init(void);
+
+/**
+ * @brief Publish a new state snapshot (mesh event handler only)
+ *
+ * The generation field is filled in by the publisher.
+ */
+void mesh_state_publish(const mesh_state_t *state);
+
+/**
+ * @brief Packets this node handed to the mesh stack since boot
+ */
+uint32_t mesh_data_tx_packets(void);
+
+/**
+ * @brief Sends the mesh stack refused since boot
+ */
+uint32_t mesh_data_tx_dropped(void);
+
+/**
+ * @brief Run a visitor on the topology map with the map locked
+ *
+ * @return
+ *    - ESP_OK: Visitor ran
+ *    - ESP_ERR_INVALID_STATE: No map on this node
+ */
+esp_err_t mesh_topology_visit(mesh_topology_visitor_t visitor, void *arg);
+
+/**
+ * @brief Parent score penalty for a candidate the root reported busy
+ *
+ * @return Penalty, 0 if the candidate is not busy or balancing is disabled
+ */
+int16_t mesh_balance_penalty(const uint8_t *bssid);
+
+/**
+ * @brief Record the outcome of an esp_mesh_send() for the link estimator
+ *
+ * Does nothing unless the estimator is running or if the send was not to
+ * the parent or a direct child.
+ */
+void mesh_link_record_send(const mesh_addr_t *to, int flag, esp_err_t err);
+
+/**
+ * @brief ETX of the link to the node with softAP BSSID bssid
+ *
+ * @return Tenths, MESH_LINK_ETX_UNKNOWN if there is no estimate or the
+ *         estimator is not running
+ */
+uint8_t mesh_link_etx(const uint8_t *bssid);
+
+/**
+ * @brief Ask the mesh event task to look for a parent other than bssid
+ *
+ * The node scans while staying connected and only moves if another parent
+ * qualifies. Ignored if bssid is no longer the parent when the request is
+ * processed.
+ *
+ * @return
+ *    - ESP_OK: Request queued
+ *    - ESP_ERR_INVALID_STATE: Mesh not initialized
+ *    - ESP_ERR_NO_MEM: Event ring full
+ */
+esp_err_t mesh_request_steer(const uint8_t *bssid);
+
+/**
+ * @brief Parent this node is connected to, as it was reached
+ *
+ * On the root this is the router, which a standby root needs to take over.
+ *
+ * @return false if not connected
+ */
+bool mesh_get_parent_target(mesh_parent_target_t *target);
+
+/**
+ * @brief Ask the mesh event task to connect to the router as the new root
+ *
+ * Only acted on while the node has no parent. Scan results are ignored
+ * until the connection succeeds or fails; on failure the node scans for a
+ * parent as usual.
+ *
+ * @param router Router BSSID, channel and authmode as the old root reached
+ *               it; SSID, type and layer are filled in here
+ *
+ * @return
+ *    - ESP_OK: Request queued
+ *    - ESP_ERR_INVALID_STATE: Mesh not initialized
+ *    - ESP_ERR_NO_MEM: Event ring full
+ */
+esp_err_t mesh_request_takeover(const mesh_parent_target_t *router);
+
+/**
+ * @brief Registry version, bumped whenever an entry is added or changed
+ */
+uint16_t mesh_registry_version(void);
+
+/**
+ * @brief Copy the node registry
+ *
+ * @return Number of entries written
+ */
+int mesh_registry_export(mesh_registered_node_t *nodes, int max_nodes);
+
+/**
+ * @brief Replace the node registry with a copy taken on another node
+ *
+ * @param version Registry version on the node the copy was taken on
+ */
+void mesh_registry_import(const mesh_registered_node_t *nodes, int count,
+                          uint16_t version);
+
+/**
+ * @brief Load the saved stack parameters for a mesh start
+ *
+ * Records them as the parameters the running stack uses. Falls back to
+ * the defaults if none are saved or NVS is not initialized.
+ */
+void mesh_params_boot(mesh_params_t *params);
+
+/**
+ * @brief Ask the mesh event task to stop and start the mesh stack
+ *
+ * The stack is configured again with the saved parameters. With fast boot
+ * enabled the node reconnects straight to its last parent, as on a warm
+ * boot, and scans only if that fails.
+ *
+ * @return
+ *    - ESP_OK: Request queued
+ *    - ESP_ERR_INVALID_STATE: Mesh not initialized
+ *    - ESP_ERR_NO_MEM: Event ring full
+ */
+esp_err_t mesh_request_restart(void);
+
+/**
+ * @brief Ask the mesh event task to stop the mesh stack for a while
+ *
+ * The node drops its parent and children as if it had lost power, and
+ * starts again after off_ms.
+ *
+ * @return
+ *    - ESP_OK: Request queued
+ *    - ESP_ERR_INVALID_STATE: Mesh not initialized
+ *    - ESP_ERR_NO_MEM: Event ring full
+ */
+esp_err_t mesh_request_outage(uint32_t off_ms);
+
+#endif /* __MESH_INTERNAL_H__ */
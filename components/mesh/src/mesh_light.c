@@ -35,7 +35,6 @@ esp_err_t mesh_light_init(void) {
   if (s_light_inited == true) {
     return ESP_OK;
   }
-  s_light_inited = true;
 
   ledc_timer_config_t ledc_timer = {
       .duty_resolution = LEDC_TIMER_13_BIT,
@@ -70,11 +69,16 @@ esp_err_t mesh_light_init(void) {
   ledc_channel_config(&ledc_channel);
   ledc_fade_func_install(0);
 
+  s_light_inited = true;
   mesh_light_set(MESH_LIGHT_INIT);
   return ESP_OK;
 }
 
 esp_err_t mesh_light_set(int color) {
+  if (!s_light_inited) {
+    return ESP_ERR_INVALID_STATE; // deferred until after the mesh starts
+  }
+
   switch (color) {
   case MESH_LIGHT_RED:
     /* Red */
@@ -0,0 +1,194 @@
+/* ESP-MESH Link Quality Estimator Implementation */
+
+#include "mesh_link.h"
+#include "esp_log.h"
+#include "esp_mesh.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mesh_internal.h"
+#include <string.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+static const char *TAG = "mesh_link";
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static bool s_initialized = false;
+static mesh_link_config_t s_config;
+
+/* Guarded by s_mux; sends are recorded from every sending task */
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static mesh_link_engine_t s_engine;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static uint32_t now_ms(void) {
+  return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static void mesh_link_sample(const mesh_state_t *state) {
+  wifi_sta_list_t children;
+  wifi_ap_record_t ap_info;
+  bool have_children = esp_wifi_ap_get_sta_list(&children) == ESP_OK;
+  // The root's parent is the router, not a mesh link
+  bool have_parent = state->connected && !state->is_root &&
+                     esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK;
+  uint32_t now = now_ms();
+
+  taskENTER_CRITICAL(&s_mux);
+  mesh_link_engine_clear_roles(&s_engine);
+  if (have_parent) {
+    // The parent's station MAC is one below its softAP BSSID
+    uint8_t parent[6];
+    memcpy(parent, state->parent.addr, 6);
+    parent[5] -= 1;
+    mesh_link_engine_sample(&s_engine, parent, MESH_LINK_ROLE_PARENT,
+                            ap_info.rssi, now);
+  }
+  for (int i = 0; have_children && i < children.num; i++) {
+    mesh_link_engine_sample(&s_engine, children.sta[i].mac,
+                            MESH_LINK_ROLE_CHILD, children.sta[i].rssi, now);
+  }
+  taskEXIT_CRITICAL(&s_mux);
+}
+
+static void mesh_link_task(void *arg) {
+  mesh_state_t state;
+
+  while (1) {
+    vTaskDelay(pdMS_TO_TICKS(s_config.sample_ms));
+    mesh_state_get(&state);
+    if (state.started) {
+      mesh_link_sample(&state);
+    }
+  }
+}
+
+/*******************************************************
+ *                Internal Functions
+ *******************************************************/
+void mesh_link_record_send(const mesh_addr_t *to, int flag, esp_err_t err) {
+  if (!s_initialized) {
+    return;
+  }
+
+  bool upwards = to == NULL || (flag & MESH_DATA_TODS);
+  if (upwards && mesh_state_is_root()) {
+    return;
+  }
+
+  taskENTER_CRITICAL(&s_mux);
+  int index = upwards ? mesh_link_engine_parent(&s_engine)
+                      : mesh_link_engine_find(&s_engine, to->addr);
+  if (index >= 0) {
+    mesh_link_engine_send(&s_engine, index, err == ESP_OK, now_ms());
+  }
+  taskEXIT_CRITICAL(&s_mux);
+}
+
+uint8_t mesh_link_etx(const uint8_t *bssid) {
+  mesh_link_estimate_t estimate = {.etx = MESH_LINK_ETX_UNKNOWN};
+  uint8_t mac[6];
+
+  if (!s_initialized) {
+    return MESH_LINK_ETX_UNKNOWN;
+  }
+
+  memcpy(mac, bssid, 6);
+  mac[5] -= 1;
+  taskENTER_CRITICAL(&s_mux);
+  int index = mesh_link_engine_find(&s_engine, mac);
+  if (index >= 0) {
+    mesh_link_engine_estimate(&s_engine, index, now_ms(), &estimate);
+  }
+  taskEXIT_CRITICAL(&s_mux);
+  return estimate.etx;
+}
+
+/*******************************************************
+ *                Public Functions
+ *******************************************************/
+esp_err_t mesh_link_init(const mesh_link_config_t *config) {
+  if (s_initialized) {
+    ESP_LOGW(TAG, "Already initialized");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  s_config.sample_ms = MESH_LINK_DEFAULT_SAMPLE_MS;
+  if (config != NULL && config->sample_ms != 0) {
+    s_config.sample_ms = config->sample_ms;
+  }
+  mesh_link_engine_init(&s_engine);
+
+  if (xTaskCreate(mesh_link_task, "mesh_link", MESH_LINK_TASK_STACK_SIZE,
+                  NULL, MESH_LINK_TASK_PRIORITY, NULL) != pdPASS) {
+    ESP_LOGE(TAG, "Failed to create task");
+    return ESP_ERR_NO_MEM;
+  }
+
+  s_initialized = true;
+  return ESP_OK;
+}
+
+esp_err_t mesh_link_get(const uint8_t *mac, mesh_link_estimate_t *estimate) {
+  if (mac == NULL || estimate == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (!s_initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  taskENTER_CRITICAL(&s_mux);
+  int index = mesh_link_engine_find(&s_engine, mac);
+  if (index >= 0) {
+    mesh_link_engine_estimate(&s_engine, index, now_ms(), estimate);
+  }
+  taskEXIT_CRITICAL(&s_mux);
+  return index >= 0 ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t mesh_link_get_parent(mesh_link_estimate_t *estimate) {
+  if (estimate == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (!s_initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  taskENTER_CRITICAL(&s_mux);
+  int index = mesh_link_engine_parent(&s_engine);
+  if (index >= 0) {
+    mesh_link_engine_estimate(&s_engine, index, now_ms(), estimate);
+  }
+  taskEXIT_CRITICAL(&s_mux);
+  return index >= 0 ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+int mesh_link_list(mesh_link_estimate_t *estimates, int max) {
+  int count = 0;
+
+  if (estimates == NULL || !s_initialized) {
+    return 0;
+  }
+
+  uint32_t now = now_ms();
+  taskENTER_CRITICAL(&s_mux);
+  // Two passes put current neighbours ahead of former ones
+  for (int pass = 0; pass < 2; pass++) {
+    for (int i = 0; i < MESH_LINK_TABLE_SIZE && count < max; i++) {
+      const mesh_link_entry_t *link = &s_engine.links[i];
+      bool current = link->role != MESH_LINK_ROLE_NONE;
+      if (link->used && current == (pass == 0)) {
+        mesh_link_engine_estimate(&s_engine, i, now, &estimates[count++]);
+      }
+    }
+  }
+  taskEXIT_CRITICAL(&s_mux);
+  return count;
+}
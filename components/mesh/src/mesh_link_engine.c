@@ -0,0 +1,134 @@
+/* Link Quality Estimator Engine Implementation */
+
+#include "mesh_link_engine.h"
+#include <string.h>
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+
+/**
+ * @brief Move an average towards a sample
+ *
+ * Weighs the sample 1/count until count reaches weight, which makes the
+ * first values a plain mean instead of a slow climb from the start value.
+ */
+static int32_t average(int32_t avg, int32_t sample, uint32_t count,
+                       uint32_t weight) {
+  uint32_t n = count < weight ? count : weight;
+  return avg + (sample - avg) / (int32_t)n;
+}
+
+void mesh_link_engine_init(mesh_link_engine_t *engine) {
+  memset(engine, 0, sizeof(*engine));
+}
+
+void mesh_link_engine_clear_roles(mesh_link_engine_t *engine) {
+  for (int i = 0; i < MESH_LINK_TABLE_SIZE; i++) {
+    engine->links[i].role = MESH_LINK_ROLE_NONE;
+  }
+}
+
+int mesh_link_engine_sample(mesh_link_engine_t *engine, const uint8_t *mac,
+                            mesh_link_role_t role, int8_t rssi,
+                            uint32_t now_ms) {
+  int index = mesh_link_engine_find(engine, mac);
+
+  if (index < 0) {
+    for (int i = 0; i < MESH_LINK_TABLE_SIZE; i++) {
+      const mesh_link_entry_t *link = &engine->links[i];
+      if (!link->used) {
+        index = i;
+        break;
+      }
+      if (link->role == MESH_LINK_ROLE_NONE &&
+          (index < 0 ||
+           now_ms - link->last_ms > now_ms - engine->links[index].last_ms)) {
+        index = i;
+      }
+    }
+    if (index < 0) {
+      return -1;
+    }
+    mesh_link_entry_t *link = &engine->links[index];
+    memset(link, 0, sizeof(*link));
+    memcpy(link->mac, mac, 6);
+    link->used = true;
+    link->delivery = MESH_LINK_DELIVERY_ONE;
+  }
+
+  mesh_link_entry_t *link = &engine->links[index];
+  link->role = (uint8_t)role;
+  if (link->rssi_samples < UINT16_MAX) {
+    link->rssi_samples++;
+  }
+  link->rssi_x16 = (int16_t)average(link->rssi_x16, rssi * 16,
+                                    link->rssi_samples, MESH_LINK_RSSI_WEIGHT);
+  link->last_ms = now_ms;
+  return index;
+}
+
+void mesh_link_engine_send(mesh_link_engine_t *engine, int index, bool ok,
+                           uint32_t now_ms) {
+  mesh_link_entry_t *link = &engine->links[index];
+
+  if (link->last_failed) {
+    link->retries++;
+  }
+  link->sent++;
+  if (!ok) {
+    link->failed++;
+  }
+  link->last_failed = !ok;
+  link->delivery = (uint16_t)average(link->delivery,
+                                     ok ? MESH_LINK_DELIVERY_ONE : 0,
+                                     link->sent, MESH_LINK_DELIVERY_WEIGHT);
+  link->last_ms = now_ms;
+}
+
+int mesh_link_engine_find(const mesh_link_engine_t *engine,
+                          const uint8_t *mac) {
+  for (int i = 0; i < MESH_LINK_TABLE_SIZE; i++) {
+    if (engine->links[i].used && memcmp(engine->links[i].mac, mac, 6) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int mesh_link_engine_parent(const mesh_link_engine_t *engine) {
+  for (int i = 0; i < MESH_LINK_TABLE_SIZE; i++) {
+    if (engine->links[i].used &&
+        engine->links[i].role == MESH_LINK_ROLE_PARENT) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void mesh_link_engine_estimate(const mesh_link_engine_t *engine, int index,
+                               uint32_t now_ms,
+                               mesh_link_estimate_t *estimate) {
+  const mesh_link_entry_t *link = &engine->links[index];
+
+  memcpy(estimate->mac, link->mac, 6);
+  estimate->role = (mesh_link_role_t)link->role;
+  estimate->rssi = (int8_t)(link->rssi_x16 / 16);
+  estimate->delivery_permille =
+      (uint16_t)((uint32_t)link->delivery * 1000 / MESH_LINK_DELIVERY_ONE);
+  estimate->sent = link->sent;
+  estimate->failed = link->failed;
+  estimate->retries = link->retries;
+  estimate->age_ms = now_ms - link->last_ms;
+
+  // ETX = 1 / delivery ratio, in tenths
+  estimate->etx = MESH_LINK_ETX_UNKNOWN;
+  if (link->sent >= MESH_LINK_MIN_SENDS) {
+    uint32_t etx = link->delivery > 0
+                       ? (10u * MESH_LINK_DELIVERY_ONE + link->delivery / 2) /
+                             link->delivery
+                       : MESH_LINK_ETX_MAX;
+    estimate->etx =
+        (uint8_t)(etx < MESH_LINK_ETX_MAX ? etx : MESH_LINK_ETX_MAX);
+  }
+}
@@ -0,0 +1,760 @@
+/* ESP-MESH Firmware Distribution Implementation */
+
+#include "mesh_ota.h"
+#include "esp_crc.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_ota_ops.h"
+#include "esp_random.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "mesh_data_transfer.h"
+#include "mesh_internal.h"
+#include "mesh_ota_engine.h"
+#include "nvs.h"
+#include <string.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+static const char *TAG = "mesh_ota";
+
+#define MESH_OTA_NVS_NAMESPACE "mesh_ota"
+#define MESH_OTA_NVS_KEY "state"
+#define MESH_OTA_PERSIST_INTERVAL (32)  /* chunks between NVS checkpoints */
+#define MESH_OTA_STATUS_SPREAD_MS (1000) /* jitter on status replies */
+#define MESH_OTA_REBOOT_DELAY_MS (2000)
+#define MESH_OTA_REBOOT_LAYER_STEP_MS (500)
+#define MESH_OTA_MISSING_UNKNOWN (0xFFFF) /* node has no state for image */
+
+/* Group every node joins; multicast, locally administered */
+static const mesh_addr_t s_group = {
+    .addr = {0x03, 0x4D, 0x4F, 0x54, 0x41, 0x01},
+};
+
+/*******************************************************
+ *                Wire Format
+ *******************************************************/
+typedef enum {
+  MESH_OTA_OP_BEGIN = 1,      /**< root -> nodes: image parameters */
+  MESH_OTA_OP_CHUNK = 2,      /**< root -> nodes: one chunk of data */
+  MESH_OTA_OP_STATUS_REQ = 3, /**< root -> nodes: report missing chunks */
+  MESH_OTA_OP_STATUS = 4,     /**< node -> root: missing chunk ranges */
+  MESH_OTA_OP_COMMIT = 5,     /**< root -> nodes: switch boot partition */
+} mesh_ota_op_t;
+
+typedef struct {
+  uint8_t op;
+  uint32_t image_id;
+} __attribute__((packed)) mesh_ota_msg_hdr_t;
+
+typedef struct {
+  mesh_ota_msg_hdr_t hdr;
+  uint32_t image_size;
+  uint32_t image_crc;
+  uint16_t chunk_size;
+} __attribute__((packed)) mesh_ota_msg_begin_t;
+
+typedef struct {
+  mesh_ota_msg_hdr_t hdr;
+  uint16_t index;
+  uint8_t data[];
+} __attribute__((packed)) mesh_ota_msg_chunk_t;
+
+typedef struct {
+  uint16_t first;
+  uint16_t count;
+} __attribute__((packed)) mesh_ota_range_t;
+
+typedef struct {
+  mesh_ota_msg_hdr_t hdr;
+  uint16_t missing;
+  uint8_t range_count;
+  mesh_ota_range_t ranges[];
+} __attribute__((packed)) mesh_ota_msg_status_t;
+
+typedef struct {
+  mesh_ota_msg_hdr_t hdr;
+  uint8_t reboot;
+} __attribute__((packed)) mesh_ota_msg_commit_t;
+
+typedef struct {
+  mesh_addr_t addr;
+  bool reported;
+  bool done;
+} mesh_ota_target_t;
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static bool s_initialized = false;
+static SemaphoreHandle_t s_lock = NULL;
+static mesh_ota_state_t s_state = MESH_OTA_STATE_IDLE;
+
+/* Node side */
+static mesh_ota_engine_t s_engine;
+static const esp_partition_t *s_partition = NULL;
+static uint16_t s_unsaved_chunks = 0;
+static esp_timer_handle_t s_status_timer = NULL;
+static esp_timer_handle_t s_reboot_timer = NULL;
+static uint32_t s_status_image_id = 0;
+
+/* Root side */
+static TaskHandle_t s_root_task_handle = NULL;
+static mesh_ota_config_t s_config;
+static mesh_ota_target_t *s_targets = NULL; /* sized at start */
+static int s_target_count = 0;
+static bool s_to_group = false; /* every node: chunks go to s_group */
+static uint8_t s_requested[MESH_OTA_BITMAP_BYTES];
+static bool s_resend_all = false;
+static uint16_t s_chunk_count = 0;
+static uint8_t s_round = 0;
+
+/*******************************************************
+ *                Node Side
+ *******************************************************/
+static esp_err_t partition_erase(void *ctx, uint32_t offset, uint32_t size) {
+  return esp_partition_erase_range((const esp_partition_t *)ctx, offset, size);
+}
+
+static esp_err_t partition_write(void *ctx, uint32_t offset, const void *data,
+                                 uint32_t size) {
+  return esp_partition_write((const esp_partition_t *)ctx, offset, data, size);
+}
+
+static void mesh_ota_save_state(void) {
+  nvs_handle_t nvs;
+  if (nvs_open(MESH_OTA_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+    ESP_LOGW(TAG, "Failed to open NVS, progress not saved");
+    return;
+  }
+  nvs_set_blob(nvs, MESH_OTA_NVS_KEY, &s_engine.state, sizeof(s_engine.state));
+  nvs_commit(nvs);
+  nvs_close(nvs);
+  s_unsaved_chunks = 0;
+}
+
+static void mesh_ota_clear_state(void) {
+  nvs_handle_t nvs;
+  if (nvs_open(MESH_OTA_NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK) {
+    nvs_erase_key(nvs, MESH_OTA_NVS_KEY);
+    nvs_commit(nvs);
+    nvs_close(nvs);
+  }
+}
+
+static uint32_t mesh_ota_crc(mesh_ota_read_cb_t read, void *ctx,
+                             uint32_t size, esp_err_t *err) {
+  uint8_t buf[256];
+  uint32_t crc = 0;
+  for (uint32_t offset = 0; offset < size; offset += sizeof(buf)) {
+    uint16_t n = (size - offset < sizeof(buf)) ? size - offset : sizeof(buf);
+    *err = read(ctx, offset, buf, n);
+    if (*err != ESP_OK) {
+      return 0;
+    }
+    crc = esp_crc32_le(crc, buf, n);
+  }
+  *err = ESP_OK;
+  return crc;
+}
+
+/**
+ * @brief Check the received image; restart the transfer if it is corrupt
+ */
+static void mesh_ota_node_verify(void) {
+  esp_err_t err;
+  uint32_t crc = mesh_ota_crc(mesh_ota_partition_read, (void *)s_partition,
+                              s_engine.state.image_size, &err);
+  if (err == ESP_OK && crc == s_engine.state.image_crc) {
+    s_state = MESH_OTA_STATE_VERIFIED;
+    ESP_LOGI(TAG, "Image 0x%08" PRIx32 " verified", s_engine.state.image_id);
+    return;
+  }
+
+  ESP_LOGE(TAG, "Image 0x%08" PRIx32 " failed verification, restarting",
+           s_engine.state.image_id);
+  mesh_ota_storage_t storage = s_engine.storage;
+  mesh_ota_engine_state_t old = s_engine.state;
+  mesh_ota_engine_begin(&s_engine, &storage, old.image_id, old.image_size,
+                        old.image_crc, old.chunk_size);
+  s_state = MESH_OTA_STATE_RECEIVING;
+}
+
+static void mesh_ota_node_begin(const mesh_ota_msg_begin_t *msg) {
+  if (s_engine.active && s_engine.state.image_id == msg->hdr.image_id &&
+      s_engine.state.image_size == msg->image_size &&
+      s_engine.state.image_crc == msg->image_crc &&
+      s_engine.state.chunk_size == msg->chunk_size) {
+    return; // already receiving (or resumed) this image
+  }
+
+  const esp_partition_t *partition = esp_ota_get_next_update_partition(NULL);
+  if (partition == NULL || msg->image_size > partition->size) {
+    ESP_LOGE(TAG, "No OTA partition for %" PRIu32 " byte image",
+             msg->image_size);
+    s_state = MESH_OTA_STATE_FAILED;
+    return;
+  }
+
+  mesh_ota_storage_t storage = {
+      .erase = partition_erase,
+      .write = partition_write,
+      .ctx = (void *)partition,
+  };
+  esp_err_t err =
+      mesh_ota_engine_begin(&s_engine, &storage, msg->hdr.image_id,
+                            msg->image_size, msg->image_crc, msg->chunk_size);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to begin transfer: %s", esp_err_to_name(err));
+    s_state = MESH_OTA_STATE_FAILED;
+    return;
+  }
+
+  s_partition = partition;
+  s_state = MESH_OTA_STATE_RECEIVING;
+  mesh_ota_save_state();
+  ESP_LOGI(TAG, "Receiving image 0x%08" PRIx32 ": %" PRIu32 " bytes, %u chunks",
+           msg->hdr.image_id, msg->image_size, s_engine.state.chunk_count);
+}
+
+static void mesh_ota_node_chunk(const mesh_ota_msg_chunk_t *msg,
+                                uint16_t data_length) {
+  if (s_state != MESH_OTA_STATE_RECEIVING ||
+      s_engine.state.image_id != msg->hdr.image_id ||
+      mesh_ota_engine_has_chunk(&s_engine, msg->index)) {
+    return;
+  }
+
+  esp_err_t err =
+      mesh_ota_engine_write_chunk(&s_engine, msg->index, msg->data, data_length);
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "Chunk %u rejected: %s", msg->index, esp_err_to_name(err));
+    return;
+  }
+
+  if (mesh_ota_engine_missing_count(&s_engine) == 0) {
+    mesh_ota_node_verify();
+    mesh_ota_save_state();
+  } else if (++s_unsaved_chunks >= MESH_OTA_PERSIST_INTERVAL) {
+    mesh_ota_save_state();
+  }
+}
+
+/**
+ * @brief Send the missing-chunk report; runs from an esp_timer so that the
+ *        replies of all targets are spread out instead of arriving at once
+ */
+static void mesh_ota_status_timer_cb(void *arg) {
+  uint32_t image_id = s_status_image_id;
+  uint8_t buf[sizeof(mesh_ota_msg_status_t) +
+              MESH_OTA_MAX_NACK_RANGES * sizeof(mesh_ota_range_t)];
+  mesh_ota_msg_status_t *msg = (mesh_ota_msg_status_t *)buf;
+
+  msg->hdr.op = MESH_OTA_OP_STATUS;
+  msg->hdr.image_id = image_id;
+  msg->range_count = 0;
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  if (!s_engine.active || s_engine.state.image_id != image_id) {
+    msg->missing = MESH_OTA_MISSING_UNKNOWN;
+  } else if (s_state == MESH_OTA_STATE_VERIFIED) {
+    msg->missing = 0;
+  } else {
+    uint16_t first, count, start = 0;
+    msg->missing = mesh_ota_engine_missing_count(&s_engine);
+    while (msg->range_count < MESH_OTA_MAX_NACK_RANGES &&
+           mesh_ota_engine_next_missing(&s_engine, start, &first, &count)) {
+      msg->ranges[msg->range_count].first = first;
+      msg->ranges[msg->range_count].count = count;
+      msg->range_count++;
+      start = first + count;
+    }
+  }
+  xSemaphoreGive(s_lock);
+
+  uint16_t length = sizeof(mesh_ota_msg_status_t) +
+                    msg->range_count * sizeof(mesh_ota_range_t);
+  esp_err_t err =
+      mesh_data_send_packet(NULL, MESH_DATA_TODS | MESH_DATA_NONBLOCK,
+                            MESH_DATA_TYPE_OTA, buf, length, NULL, 0);
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "Failed to send status: %s", esp_err_to_name(err));
+  }
+}
+
+static void mesh_ota_reboot_timer_cb(void *arg) {
+  ESP_LOGI(TAG, "Rebooting into new image");
+  esp_restart();
+}
+
+static void mesh_ota_node_commit(const mesh_ota_msg_commit_t *msg) {
+  if (s_state != MESH_OTA_STATE_VERIFIED ||
+      s_engine.state.image_id != msg->hdr.image_id) {
+    return;
+  }
+
+  esp_err_t err = esp_ota_set_boot_partition(s_partition);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to set boot partition: %s", esp_err_to_name(err));
+    s_state = MESH_OTA_STATE_FAILED;
+    return;
+  }
+
+  mesh_ota_clear_state();
+  s_engine.active = false;
+  s_state = MESH_OTA_STATE_IDLE;
+  ESP_LOGI(TAG, "Image 0x%08" PRIx32 " committed", msg->hdr.image_id);
+
+  if (msg->reboot) {
+    // Deeper layers go first so relays keep forwarding until their subtree
+    // has the commit
+    int layers_below = esp_mesh_get_max_layer() - esp_mesh_get_layer();
+    if (layers_below < 0) {
+      layers_below = 0;
+    }
+    uint64_t delay_ms = MESH_OTA_REBOOT_DELAY_MS +
+                        (uint64_t)layers_below * MESH_OTA_REBOOT_LAYER_STEP_MS;
+    esp_timer_start_once(s_reboot_timer, delay_ms * 1000);
+  }
+}
+
+/*******************************************************
+ *                Root Side
+ *******************************************************/
+static inline void requested_set(uint16_t index) {
+  s_requested[index >> 3] |= (uint8_t)(1 << (index & 7));
+}
+
+static inline bool requested_get(const uint8_t *bitmap, uint16_t index) {
+  return (bitmap[index >> 3] >> (index & 7)) & 1;
+}
+
+static void mesh_ota_root_status(const mesh_addr_t *from,
+                                 const mesh_ota_msg_status_t *msg,
+                                 uint16_t length) {
+  if (length < sizeof(*msg) ||
+      length < sizeof(*msg) + msg->range_count * sizeof(mesh_ota_range_t) ||
+      s_state != MESH_OTA_STATE_SENDING ||
+      msg->hdr.image_id != s_config.image_id) {
+    return;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  for (int i = 0; i < s_target_count; i++) {
+    if (memcmp(s_targets[i].addr.addr, from->addr, 6) != 0) {
+      continue;
+    }
+    s_targets[i].reported = true;
+    s_targets[i].done = (msg->missing == 0);
+    if (msg->missing == MESH_OTA_MISSING_UNKNOWN) {
+      s_resend_all = true;
+    }
+    for (int r = 0; r < msg->range_count; r++) {
+      uint32_t end = (uint32_t)msg->ranges[r].first + msg->ranges[r].count;
+      for (uint32_t c = msg->ranges[r].first; c < end && c < s_chunk_count;
+           c++) {
+        requested_set(c);
+      }
+    }
+    break;
+  }
+  xSemaphoreGive(s_lock);
+}
+
+/**
+ * @brief Multicast to the targets, MESH_OTA_MAX_TARGETS addresses at a time
+ *
+ * @param done_only Only the targets that verified the image
+ */
+static esp_err_t mesh_ota_root_multicast(bool done_only, const void *msg,
+                                         uint16_t length) {
+  mesh_addr_t batch[MESH_OTA_MAX_TARGETS];
+  esp_err_t err = ESP_OK;
+  int count = 0;
+
+  for (int i = 0; i <= s_target_count; i++) {
+    if (i < s_target_count && (!done_only || s_targets[i].done)) {
+      batch[count++] = s_targets[i].addr;
+    }
+    if (count > 0 && (count == MESH_OTA_MAX_TARGETS || i == s_target_count)) {
+      esp_err_t ret = mesh_multicast_from_root(batch, count, MESH_DATA_TYPE_OTA,
+                                               msg, length);
+      err = (err == ESP_OK) ? ret : err;
+      count = 0;
+    }
+  }
+  return err;
+}
+
+static esp_err_t mesh_ota_root_send(const void *msg, uint16_t length) {
+  if (!s_to_group) {
+    return mesh_ota_root_multicast(false, msg, length);
+  }
+  // The stack forwards a group packet down the tree once per relay
+  return mesh_data_send_packet(&s_group, MESH_DATA_GROUP, MESH_DATA_TYPE_OTA,
+                               msg, length, NULL, 0);
+}
+
+static int mesh_ota_root_done_count(void) {
+  int done = 0;
+  for (int i = 0; i < s_target_count; i++) {
+    done += s_targets[i].done;
+  }
+  return done;
+}
+
+/**
+ * @brief Run a complete distribution: pipelined pass, retransmission rounds
+ *        and commit
+ *
+ * @param chunk Scratch buffer for one chunk message
+ */
+static mesh_ota_state_t mesh_ota_root_distribute(mesh_ota_msg_chunk_t *chunk) {
+  uint8_t pending[MESH_OTA_BITMAP_BYTES];
+  esp_err_t err;
+
+  mesh_ota_msg_begin_t begin = {
+      .hdr = {.op = MESH_OTA_OP_BEGIN, .image_id = s_config.image_id},
+      .image_size = s_config.image_size,
+      .chunk_size = MESH_OTA_CHUNK_SIZE,
+  };
+  begin.image_crc =
+      mesh_ota_crc(s_config.read, s_config.ctx, s_config.image_size, &err);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to read image: %s", esp_err_to_name(err));
+    return MESH_OTA_STATE_FAILED;
+  }
+
+  ESP_LOGI(TAG, "Distributing image 0x%08" PRIx32 " (%u chunks) to %d nodes",
+           s_config.image_id, s_chunk_count, s_target_count);
+
+  for (s_round = 0; s_round < s_config.max_rounds; s_round++) {
+    bool resend_all = (s_round == 0);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    memcpy(pending, s_requested, sizeof(pending));
+    memset(s_requested, 0, sizeof(s_requested));
+    resend_all |= s_resend_all;
+    s_resend_all = false;
+    for (int i = 0; i < s_target_count; i++) {
+      s_targets[i].reported = false;
+    }
+    xSemaphoreGive(s_lock);
+
+    // BEGIN every round so late joiners and rebooted nodes pick up the image
+    mesh_ota_root_send(&begin, sizeof(begin));
+
+    // Stream without waiting for per-node acknowledgements: each relay
+    // forwards a chunk as soon as it arrives, so all layers work at once
+    int sent = 0;
+    chunk->hdr.op = MESH_OTA_OP_CHUNK;
+    chunk->hdr.image_id = s_config.image_id;
+    for (uint16_t i = 0; i < s_chunk_count; i++) {
+      if (!resend_all && !requested_get(pending, i)) {
+        continue;
+      }
+      uint16_t length = MESH_OTA_CHUNK_SIZE;
+      if ((uint32_t)(i + 1) * MESH_OTA_CHUNK_SIZE > s_config.image_size) {
+        length = s_config.image_size - (uint32_t)i * MESH_OTA_CHUNK_SIZE;
+      }
+      chunk->index = i;
+      err = s_config.read(s_config.ctx, (uint32_t)i * MESH_OTA_CHUNK_SIZE,
+                          chunk->data, length);
+      if (err == ESP_OK) {
+        err = mesh_ota_root_send(chunk, sizeof(*chunk) + length);
+      }
+      if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Chunk %u not sent: %s", i, esp_err_to_name(err));
+      } else {
+        sent++;
+      }
+      if (s_config.chunk_interval_ms > 0) {
+        vTaskDelay(pdMS_TO_TICKS(s_config.chunk_interval_ms));
+      }
+    }
+
+    mesh_ota_msg_hdr_t status_req = {.op = MESH_OTA_OP_STATUS_REQ,
+                                     .image_id = s_config.image_id};
+    mesh_ota_root_send(&status_req, sizeof(status_req));
+    vTaskDelay(pdMS_TO_TICKS(MESH_OTA_STATUS_WINDOW_MS));
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int done = mesh_ota_root_done_count();
+    xSemaphoreGive(s_lock);
+    ESP_LOGI(TAG, "Round %u: %d chunks sent, %d/%d nodes complete", s_round,
+             sent, done, s_target_count);
+    if (done == s_target_count) {
+      break;
+    }
+  }
+
+  // Commit only the nodes that verified the image
+  int done_count = 0;
+  mesh_ota_msg_commit_t commit = {
+      .hdr = {.op = MESH_OTA_OP_COMMIT, .image_id = s_config.image_id},
+      .reboot = s_config.reboot,
+  };
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  done_count = mesh_ota_root_done_count();
+  xSemaphoreGive(s_lock);
+  if (done_count > 0) {
+    mesh_ota_root_multicast(true, &commit, sizeof(commit));
+  }
+  ESP_LOGI(TAG, "Distribution finished: %d/%d nodes committed", done_count,
+           s_target_count);
+  return (done_count == s_target_count) ? MESH_OTA_STATE_DONE
+                                        : MESH_OTA_STATE_FAILED;
+}
+
+static void mesh_ota_root_task(void *arg) {
+  mesh_ota_msg_chunk_t *chunk =
+      malloc(sizeof(mesh_ota_msg_chunk_t) + MESH_OTA_CHUNK_SIZE);
+  if (chunk == NULL) {
+    ESP_LOGE(TAG, "Failed to allocate chunk buffer");
+    s_state = MESH_OTA_STATE_FAILED;
+  } else {
+    s_state = mesh_ota_root_distribute(chunk);
+    free(chunk);
+  }
+
+  s_root_task_handle = NULL;
+  vTaskDelete(NULL);
+}
+
+/*******************************************************
+ *                Protocol Handler
+ *******************************************************/
+static bool mesh_ota_handle_packet(mesh_addr_t *from, uint8_t data_type,
+                                   uint8_t *payload, uint16_t length) {
+  if (length < sizeof(mesh_ota_msg_hdr_t)) {
+    return true;
+  }
+
+  const mesh_ota_msg_hdr_t *hdr = (const mesh_ota_msg_hdr_t *)payload;
+  if (hdr->op == MESH_OTA_OP_STATUS) {
+    mesh_ota_root_status(from, (const mesh_ota_msg_status_t *)payload, length);
+    return true;
+  }
+  if (s_state == MESH_OTA_STATE_SENDING) {
+    return true; // the distributing root ignores its own traffic
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  switch (hdr->op) {
+  case MESH_OTA_OP_BEGIN:
+    if (length >= sizeof(mesh_ota_msg_begin_t)) {
+      mesh_ota_node_begin((const mesh_ota_msg_begin_t *)payload);
+    }
+    break;
+  case MESH_OTA_OP_CHUNK:
+    if (length > sizeof(mesh_ota_msg_chunk_t)) {
+      mesh_ota_node_chunk((const mesh_ota_msg_chunk_t *)payload,
+                          length - sizeof(mesh_ota_msg_chunk_t));
+    }
+    break;
+  case MESH_OTA_OP_STATUS_REQ:
+    if (!esp_timer_is_active(s_status_timer)) {
+      s_status_image_id = hdr->image_id;
+      esp_timer_start_once(
+          s_status_timer,
+          (uint64_t)(esp_random() % MESH_OTA_STATUS_SPREAD_MS) * 1000);
+    }
+    break;
+  case MESH_OTA_OP_COMMIT:
+    if (length >= sizeof(mesh_ota_msg_commit_t)) {
+      mesh_ota_node_commit((const mesh_ota_msg_commit_t *)payload);
+    }
+    break;
+  default:
+    ESP_LOGD(TAG, "Unknown OTA op %u", hdr->op);
+    break;
+  }
+  xSemaphoreGive(s_lock);
+  return true;
+}
+
+/*******************************************************
+ *                Public Functions
+ *******************************************************/
+esp_err_t mesh_ota_partition_read(void *ctx, uint32_t offset, uint8_t *buf,
+                                  uint16_t length) {
+  return esp_partition_read((const esp_partition_t *)ctx, offset, buf, length);
+}
+
+esp_err_t mesh_ota_init(void) {
+  if (s_initialized) {
+    ESP_LOGW(TAG, "Already initialized");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  s_lock = xSemaphoreCreateMutex();
+  if (s_lock == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  esp_timer_create_args_t reboot_args = {
+      .callback = mesh_ota_reboot_timer_cb,
+      .name = "mesh_ota_reboot",
+  };
+  esp_timer_create_args_t status_args = {
+      .callback = mesh_ota_status_timer_cb,
+      .name = "mesh_ota_status",
+  };
+  if (esp_timer_create(&reboot_args, &s_reboot_timer) != ESP_OK ||
+      esp_timer_create(&status_args, &s_status_timer) != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to create timers");
+    return ESP_ERR_NO_MEM;
+  }
+
+  // Resume a transfer interrupted by a reboot
+  nvs_handle_t nvs;
+  mesh_ota_engine_state_t saved;
+  size_t saved_size = sizeof(saved);
+  if (nvs_open(MESH_OTA_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+    if (nvs_get_blob(nvs, MESH_OTA_NVS_KEY, &saved, &saved_size) == ESP_OK &&
+        saved_size == sizeof(saved)) {
+      s_partition = esp_ota_get_next_update_partition(NULL);
+      mesh_ota_storage_t storage = {
+          .erase = partition_erase,
+          .write = partition_write,
+          .ctx = (void *)s_partition,
+      };
+      if (s_partition != NULL &&
+          mesh_ota_engine_resume(&s_engine, &storage, &saved) == ESP_OK) {
+        s_state = MESH_OTA_STATE_RECEIVING;
+        if (mesh_ota_engine_missing_count(&s_engine) == 0) {
+          mesh_ota_node_verify();
+        }
+        ESP_LOGI(TAG, "Resumed image 0x%08" PRIx32 ", %u chunks missing",
+                 saved.image_id, mesh_ota_engine_missing_count(&s_engine));
+      }
+    }
+    nvs_close(nvs);
+  }
+
+  esp_err_t err = mesh_data_transfer_register_type_handler(
+      MESH_DATA_TYPE_OTA, mesh_ota_handle_packet);
+  if (err == ESP_OK) {
+    err = mesh_join_group(&s_group);
+  }
+  if (err != ESP_OK) {
+    return err;
+  }
+
+  s_initialized = true;
+  ESP_LOGI(TAG, "Mesh OTA initialized");
+  return ESP_OK;
+}
+
+esp_err_t mesh_ota_start(const mesh_ota_config_t *config) {
+  if (config == NULL || config->read == NULL || config->image_size == 0 ||
+      config->image_size > (uint32_t)MESH_OTA_MAX_CHUNKS * MESH_OTA_CHUNK_SIZE ||
+      config->target_count < 0) {
+    ESP_LOGE(TAG, "Invalid arguments");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (!s_initialized || s_root_task_handle != NULL) {
+    ESP_LOGE(TAG, "Not initialized or distribution already running");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  if (!mesh_state_is_root()) {
+    ESP_LOGE(TAG, "Only root can distribute firmware");
+    return ESP_FAIL;
+  }
+
+  memcpy(&s_config, config, sizeof(s_config));
+  if (s_config.max_rounds == 0) {
+    s_config.max_rounds = MESH_OTA_DEFAULT_ROUNDS;
+  }
+
+  // Default to every node in the routing table except the root itself;
+  // the completion table is sized from it, so no node is left out
+  mesh_addr_t *addrs = NULL;
+  int count = 0;
+  if (config->targets != NULL) {
+    count = config->target_count;
+  } else {
+    int table_size = esp_mesh_get_routing_table_size();
+    addrs = malloc(table_size * sizeof(mesh_addr_t));
+    if (addrs == NULL ||
+        esp_mesh_get_routing_table(addrs, table_size * 6, &count) != ESP_OK) {
+      ESP_LOGE(TAG, "Failed to read the routing table");
+      free(addrs);
+      return ESP_ERR_NO_MEM;
+    }
+  }
+  mesh_ota_target_t *targets =
+      count > 0 ? calloc(count, sizeof(mesh_ota_target_t)) : NULL;
+  if (count > 0 && targets == NULL) {
+    ESP_LOGE(TAG, "No memory for %d targets", count);
+    free(addrs);
+    return ESP_ERR_NO_MEM;
+  }
+  uint8_t self[6];
+  esp_read_mac(self, ESP_MAC_WIFI_STA);
+  int target_count = 0;
+  for (int i = 0; i < count; i++) {
+    const mesh_addr_t *addr = addrs != NULL ? &addrs[i] : &config->targets[i];
+    if (addrs == NULL || memcmp(addr->addr, self, 6) != 0) {
+      targets[target_count++].addr = *addr;
+    }
+  }
+  free(addrs);
+  if (target_count == 0) {
+    ESP_LOGW(TAG, "No target nodes");
+    free(targets);
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  free(s_targets);
+  s_targets = targets;
+  s_target_count = target_count;
+  s_to_group = (config->targets == NULL);
+  xSemaphoreGive(s_lock);
+  memset(s_requested, 0, sizeof(s_requested));
+  s_resend_all = false;
+  s_round = 0;
+  s_chunk_count =
+      (config->image_size + MESH_OTA_CHUNK_SIZE - 1) / MESH_OTA_CHUNK_SIZE;
+  s_state = MESH_OTA_STATE_SENDING;
+
+  BaseType_t ret = xTaskCreate(mesh_ota_root_task, "mesh_ota_tx",
+                               MESH_OTA_TASK_STACK_SIZE, NULL,
+                               MESH_OTA_TASK_PRIORITY, &s_root_task_handle);
+  if (ret != pdPASS) {
+    ESP_LOGE(TAG, "Failed to create OTA task");
+    s_state = MESH_OTA_STATE_FAILED;
+    return ESP_FAIL;
+  }
+  return ESP_OK;
+}
+
+esp_err_t mesh_ota_get_status(mesh_ota_status_t *status) {
+  if (status == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  memset(status, 0, sizeof(*status));
+  status->state = s_state;
+  if (s_state == MESH_OTA_STATE_SENDING || s_state == MESH_OTA_STATE_DONE ||
+      s_root_task_handle != NULL) {
+    status->image_id = s_config.image_id;
+    status->chunk_count = s_chunk_count;
+    status->round = s_round;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    status->target_count = s_target_count;
+    status->targets_done = mesh_ota_root_done_count();
+    xSemaphoreGive(s_lock);
+  } else if (s_engine.active) {
+    status->image_id = s_engine.state.image_id;
+    status->chunk_count = s_engine.state.chunk_count;
+    status->chunks_missing = mesh_ota_engine_missing_count(&s_engine);
+  }
+  return ESP_OK;
+}
@@ -0,0 +1,172 @@
+/* Mesh OTA Chunk Engine Implementation */
+
+#include "mesh_ota_engine.h"
+#include <string.h>
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static inline bool bitmap_get(const uint8_t *bitmap, uint16_t index) {
+  return (bitmap[index >> 3] >> (index & 7)) & 1;
+}
+
+static inline void bitmap_set(uint8_t *bitmap, uint16_t index) {
+  bitmap[index >> 3] |= (uint8_t)(1 << (index & 7));
+}
+
+static uint16_t bitmap_count(const uint8_t *bitmap, uint16_t bits) {
+  uint16_t count = 0;
+  for (uint16_t i = 0; i < bits; i++) {
+    count += bitmap_get(bitmap, i);
+  }
+  return count;
+}
+
+/**
+ * @brief Check whether any chunk of the sector holding index was received
+ */
+static bool sector_touched(const mesh_ota_engine_t *engine, uint16_t index) {
+  uint16_t per_sector = MESH_OTA_SECTOR_SIZE / engine->state.chunk_size;
+  uint16_t first = index - (index % per_sector);
+  for (uint16_t i = first;
+       i < first + per_sector && i < engine->state.chunk_count; i++) {
+    if (bitmap_get(engine->state.bitmap, i)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool chunk_size_valid(uint16_t chunk_size) {
+  return chunk_size >= 64 && chunk_size <= MESH_OTA_SECTOR_SIZE &&
+         (chunk_size & (chunk_size - 1)) == 0;
+}
+
+esp_err_t mesh_ota_engine_begin(mesh_ota_engine_t *engine,
+                                const mesh_ota_storage_t *storage,
+                                uint32_t image_id, uint32_t image_size,
+                                uint32_t image_crc, uint16_t chunk_size) {
+  if (engine == NULL || storage == NULL || storage->erase == NULL ||
+      storage->write == NULL || image_size == 0 ||
+      !chunk_size_valid(chunk_size)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  uint32_t chunk_count = (image_size + chunk_size - 1) / chunk_size;
+  if (chunk_count > MESH_OTA_MAX_CHUNKS) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  memset(engine, 0, sizeof(*engine));
+  engine->state.image_id = image_id;
+  engine->state.image_size = image_size;
+  engine->state.image_crc = image_crc;
+  engine->state.chunk_size = chunk_size;
+  engine->state.chunk_count = (uint16_t)chunk_count;
+  engine->storage = *storage;
+  engine->active = true;
+  return ESP_OK;
+}
+
+esp_err_t mesh_ota_engine_resume(mesh_ota_engine_t *engine,
+                                 const mesh_ota_storage_t *storage,
+                                 const mesh_ota_engine_state_t *state) {
+  if (engine == NULL || storage == NULL || state == NULL ||
+      storage->erase == NULL || storage->write == NULL ||
+      !chunk_size_valid(state->chunk_size) || state->chunk_count == 0 ||
+      state->chunk_count > MESH_OTA_MAX_CHUNKS ||
+      state->chunk_count !=
+          (state->image_size + state->chunk_size - 1) / state->chunk_size) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  memcpy(&engine->state, state, sizeof(engine->state));
+  engine->storage = *storage;
+  engine->received = bitmap_count(state->bitmap, state->chunk_count);
+  engine->active = true;
+  return ESP_OK;
+}
+
+esp_err_t mesh_ota_engine_write_chunk(mesh_ota_engine_t *engine,
+                                      uint16_t index, const uint8_t *data,
+                                      uint16_t length) {
+  if (engine == NULL || !engine->active) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (data == NULL || index >= engine->state.chunk_count ||
+      length != mesh_ota_engine_chunk_length(engine, index)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (bitmap_get(engine->state.bitmap, index)) {
+    return ESP_OK; // duplicate from a retransmission round
+  }
+
+  uint32_t offset = (uint32_t)index * engine->state.chunk_size;
+  esp_err_t err;
+
+  // Chunks never straddle a sector, so the first arrival erases it
+  if (!sector_touched(engine, index)) {
+    uint32_t sector = offset - (offset % MESH_OTA_SECTOR_SIZE);
+    err = engine->storage.erase(engine->storage.ctx, sector,
+                                MESH_OTA_SECTOR_SIZE);
+    if (err != ESP_OK) {
+      return err;
+    }
+  }
+
+  err = engine->storage.write(engine->storage.ctx, offset, data, length);
+  if (err != ESP_OK) {
+    return err;
+  }
+
+  bitmap_set(engine->state.bitmap, index);
+  engine->received++;
+  return ESP_OK;
+}
+
+bool mesh_ota_engine_has_chunk(const mesh_ota_engine_t *engine,
+                               uint16_t index) {
+  return engine->active && index < engine->state.chunk_count &&
+         bitmap_get(engine->state.bitmap, index);
+}
+
+uint16_t mesh_ota_engine_missing_count(const mesh_ota_engine_t *engine) {
+  if (!engine->active) {
+    return 0;
+  }
+  return engine->state.chunk_count - engine->received;
+}
+
+bool mesh_ota_engine_next_missing(const mesh_ota_engine_t *engine,
+                                  uint16_t start, uint16_t *first,
+                                  uint16_t *count) {
+  if (!engine->active) {
+    return false;
+  }
+
+  uint16_t i = start;
+  while (i < engine->state.chunk_count &&
+         bitmap_get(engine->state.bitmap, i)) {
+    i++;
+  }
+  if (i >= engine->state.chunk_count) {
+    return false;
+  }
+
+  *first = i;
+  while (i < engine->state.chunk_count &&
+         !bitmap_get(engine->state.bitmap, i)) {
+    i++;
+  }
+  *count = i - *first;
+  return true;
+}
+
+uint16_t mesh_ota_engine_chunk_length(const mesh_ota_engine_t *engine,
+                                      uint16_t index) {
+  if (index + 1 < engine->state.chunk_count) {
+    return engine->state.chunk_size;
+  }
+  return (uint16_t)(engine->state.image_size -
+                    (uint32_t)index * engine->state.chunk_size);
+}
@@ -0,0 +1,518 @@
+/* ESP-MESH Runtime Stack Parameters Implementation */
+
+#include "mesh_params.h"
+#include "esp_log.h"
+#include "esp_mesh.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mesh_data_transfer.h"
+#include "mesh_internal.h"
+#include "nvs.h"
+#include <string.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+static const char *TAG = "mesh_params";
+
+/* Distinguishes parameter pushes from other MESH_DATA_TYPE_CONFIG payloads */
+#define MESH_PARAMS_CONFIG_MAGIC (0xDC)
+#define MESH_PARAMS_CONFIG_VERSION (0x01)
+#define MESH_PARAMS_RECORD_VERSION (0x01)
+
+/* Fields a push carries */
+#define MESH_PARAMS_FIELD_MAX_LAYER (1 << 0)
+#define MESH_PARAMS_FIELD_AP_CONNECTIONS (1 << 1)
+#define MESH_PARAMS_FIELD_XON_QSIZE (1 << 2)
+#define MESH_PARAMS_FIELD_CAPACITY (1 << 3)
+#define MESH_PARAMS_FIELD_ASSOC_EXPIRE (1 << 4)
+#define MESH_PARAMS_FIELD_ALL (0x1F)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+typedef struct {
+  uint8_t magic;
+  uint8_t version;
+  uint8_t apply; /* mesh_params_apply_t */
+  uint8_t fields;
+  uint8_t max_layer;
+  uint8_t ap_connections;
+  uint16_t xon_qsize;
+  uint16_t capacity_num;
+  uint16_t assoc_expire_s;
+} __attribute__((packed)) mesh_params_config_msg_t;
+
+/* NVS record */
+typedef struct {
+  uint8_t version;
+  mesh_params_t params;
+} mesh_params_record_t;
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static bool s_initialized = false;
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static mesh_params_stats_t s_stats;
+static esp_timer_handle_t s_restart_timer = NULL;
+
+/* Guarded by s_mux */
+static bool s_loaded = false;
+static mesh_params_t s_active; /* read by the running stack */
+static mesh_params_t s_saved;  /* read by the next start */
+
+/* Controller, used by the controller task only */
+static bool s_controller_running = false;
+static mesh_params_controller_settings_t s_settings;
+static mesh_params_controller_t s_controller;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static uint32_t now_ms(void) {
+  return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static void load_saved(mesh_params_t *params) {
+  mesh_params_record_t record;
+  size_t size = sizeof(record);
+  nvs_handle_t nvs;
+
+  mesh_params_default(params);
+  if (nvs_open(MESH_PARAMS_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+    return;
+  }
+  if (nvs_get_blob(nvs, MESH_PARAMS_NVS_KEY, &record, &size) == ESP_OK &&
+      size == sizeof(record) && record.version == MESH_PARAMS_RECORD_VERSION &&
+      mesh_params_valid(&record.params)) {
+    *params = record.params;
+  }
+  nvs_close(nvs);
+}
+
+static esp_err_t save(const mesh_params_t *params) {
+  mesh_params_record_t record = {.version = MESH_PARAMS_RECORD_VERSION};
+  nvs_handle_t nvs;
+
+  record.params = *params;
+  esp_err_t err = nvs_open(MESH_PARAMS_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+  if (err != ESP_OK) {
+    return err;
+  }
+  err = nvs_set_blob(nvs, MESH_PARAMS_NVS_KEY, &record, sizeof(record));
+  if (err == ESP_OK) {
+    err = nvs_commit(nvs);
+  }
+  nvs_close(nvs);
+  return err;
+}
+
+static bool needs_restart(const mesh_params_t *a, const mesh_params_t *b) {
+  return a->max_layer != b->max_layer ||
+         a->ap_connections != b->ap_connections ||
+         a->xon_qsize != b->xon_qsize || a->capacity_num != b->capacity_num;
+}
+
+static void restart_timer_cb(void *arg) {
+  if (mesh_request_restart() != ESP_OK) {
+    ESP_LOGW(TAG, "Mesh restart not queued, parameters kept for next start");
+  }
+}
+
+/**
+ * @brief Save parameters and apply them
+ *
+ * @param delay_ms Restart delay, 0 to restart from the caller
+ */
+static esp_err_t apply(const mesh_params_t *params, mesh_params_apply_t mode,
+                       uint32_t delay_ms) {
+  mesh_params_t active;
+
+  if (!mesh_params_valid(params)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  esp_err_t err = save(params);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to save parameters: %s", esp_err_to_name(err));
+    return err;
+  }
+
+  taskENTER_CRITICAL(&s_mux);
+  s_saved = *params;
+  if (!s_loaded) {
+    s_active = *params;
+    s_loaded = true;
+  }
+  s_active.assoc_expire_s = params->assoc_expire_s;
+  active = s_active;
+  s_stats.changes++;
+  taskEXIT_CRITICAL(&s_mux);
+
+  if (mesh_state_is_started()) {
+    esp_mesh_set_ap_assoc_expire(params->assoc_expire_s);
+  }
+  ESP_LOGI(TAG, "layer %u, connections %u, xon %u, capacity %u, expire %u s",
+           params->max_layer, params->ap_connections, params->xon_qsize,
+           params->capacity_num, params->assoc_expire_s);
+
+  if (mode != MESH_PARAMS_APPLY_RESTART || !needs_restart(&active, params) ||
+      !mesh_state_is_started()) {
+    return ESP_OK;
+  }
+
+  taskENTER_CRITICAL(&s_mux);
+  s_stats.restarts++;
+  taskEXIT_CRITICAL(&s_mux);
+  if (delay_ms > 0 && s_restart_timer != NULL) {
+    esp_timer_stop(s_restart_timer);
+    return esp_timer_start_once(s_restart_timer, delay_ms * 1000ULL);
+  }
+  return mesh_request_restart();
+}
+
+static void merge(mesh_params_t *params, const mesh_params_config_msg_t *msg) {
+  if (msg->fields & MESH_PARAMS_FIELD_MAX_LAYER) {
+    params->max_layer = msg->max_layer;
+  }
+  if (msg->fields & MESH_PARAMS_FIELD_AP_CONNECTIONS) {
+    params->ap_connections = msg->ap_connections;
+  }
+  if (msg->fields & MESH_PARAMS_FIELD_XON_QSIZE) {
+    params->xon_qsize = msg->xon_qsize;
+  }
+  if (msg->fields & MESH_PARAMS_FIELD_CAPACITY) {
+    params->capacity_num = msg->capacity_num;
+  }
+  if (msg->fields & MESH_PARAMS_FIELD_ASSOC_EXPIRE) {
+    params->assoc_expire_s = msg->assoc_expire_s;
+  }
+}
+
+static esp_err_t push(const mesh_addr_t *node, const mesh_params_t *params,
+                      uint8_t fields, mesh_params_apply_t mode) {
+  mesh_params_config_msg_t msg = {
+      .magic = MESH_PARAMS_CONFIG_MAGIC,
+      .version = MESH_PARAMS_CONFIG_VERSION,
+      .apply = (uint8_t)mode,
+      .fields = fields,
+      .max_layer = params->max_layer,
+      .ap_connections = params->ap_connections,
+      .xon_qsize = params->xon_qsize,
+      .capacity_num = params->capacity_num,
+      .assoc_expire_s = params->assoc_expire_s,
+  };
+  mesh_params_t own;
+  esp_err_t err;
+
+  if (!mesh_state_is_root()) {
+    ESP_LOGE(TAG, "Not a root node");
+    return ESP_FAIL;
+  }
+
+  mesh_params_get(NULL, &own);
+  merge(&own, &msg);
+  if (!mesh_params_valid(&own)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (node != NULL) {
+    err = mesh_send_to_child(node, MESH_DATA_TYPE_CONFIG, (uint8_t *)&msg,
+                             sizeof(msg));
+  } else {
+    err = mesh_broadcast_from_root(MESH_DATA_TYPE_CONFIG, (uint8_t *)&msg,
+                                   sizeof(msg));
+    if (err == ESP_OK) {
+      err = apply(&own, mode, MESH_PARAMS_RESTART_DELAY_MS);
+    }
+  }
+  if (err == ESP_OK) {
+    taskENTER_CRITICAL(&s_mux);
+    s_stats.pushes_sent++;
+    taskEXIT_CRITICAL(&s_mux);
+  }
+  return err;
+}
+
+static bool mesh_params_handle_config(mesh_addr_t *from, uint8_t data_type,
+                                      uint8_t *payload, uint16_t length) {
+  mesh_params_config_msg_t msg;
+  mesh_params_t params;
+
+  if (mesh_state_is_root() || length != sizeof(msg) ||
+      payload[0] != MESH_PARAMS_CONFIG_MAGIC ||
+      payload[1] != MESH_PARAMS_CONFIG_VERSION) {
+    return false;
+  }
+  memcpy(&msg, payload, sizeof(msg));
+
+  mesh_params_get(NULL, &params);
+  merge(&params, &msg);
+  bool valid = mesh_params_valid(&params) &&
+               msg.apply <= MESH_PARAMS_APPLY_RESTART;
+  taskENTER_CRITICAL(&s_mux);
+  s_stats.pushes_received++;
+  if (!valid) {
+    s_stats.pushes_rejected++;
+  }
+  taskEXIT_CRITICAL(&s_mux);
+
+  if (!valid) {
+    ESP_LOGW(TAG, "Rejected parameters out of bounds");
+    return true;
+  }
+  apply(&params, (mesh_params_apply_t)msg.apply,
+        MESH_PARAMS_RESTART_DELAY_MS);
+  return true;
+}
+
+static void count_visitor(const mesh_topology_engine_t *engine, void *arg) {
+  mesh_params_sample_t *sample = (mesh_params_sample_t *)arg;
+  mesh_params_t active;
+
+  mesh_params_get(&active, NULL);
+  sample->have_topology = true;
+  sample->nodes = engine->count;
+  for (int i = 0; i < MESH_TOPOLOGY_MAX_NODES; i++) {
+    const mesh_topology_node_t *node = &engine->nodes[i];
+    if (!node->used || i == engine->root) {
+      continue;
+    }
+    if (node->layer >= active.max_layer) {
+      sample->deepest++;
+    }
+    if (node->children > 0) {
+      sample->relays++;
+      if (node->children >= active.ap_connections) {
+        sample->full_relays++;
+      }
+    }
+  }
+}
+
+static uint16_t queue_depth(void) {
+  mesh_tx_pending_t pending;
+  int depth = 0;
+
+  if (esp_mesh_get_tx_pending(&pending) != ESP_OK) {
+    return 0;
+  }
+  // xon_qsize bounds each queue separately
+  int queues[] = {pending.to_parent, pending.to_parent_p2p, pending.to_child,
+                  pending.to_child_p2p};
+  for (int i = 0; i < 4; i++) {
+    if (queues[i] > depth) {
+      depth = queues[i];
+    }
+  }
+  return (uint16_t)depth;
+}
+
+static void mesh_params_controller_task(void *arg) {
+  uint32_t ticks = s_settings.control.period_ms / MESH_PARAMS_SAMPLE_MS;
+  uint32_t last_sent = mesh_data_tx_packets();
+  uint32_t last_dropped = mesh_data_tx_dropped();
+  uint16_t peak = 0;
+  uint32_t tick = 0;
+
+  while (1) {
+    vTaskDelay(pdMS_TO_TICKS(MESH_PARAMS_SAMPLE_MS));
+    if (!mesh_state_is_started()) {
+      continue;
+    }
+    uint16_t depth = queue_depth();
+    if (depth > peak) {
+      peak = depth;
+    }
+    if (++tick < ticks) {
+      continue;
+    }
+
+    mesh_params_sample_t sample = {.queue_peak = peak};
+    uint32_t sent = mesh_data_tx_packets();
+    uint32_t dropped = mesh_data_tx_dropped();
+    sample.sent = sent - last_sent;
+    sample.dropped = dropped - last_dropped;
+    last_sent = sent;
+    last_dropped = dropped;
+    tick = 0;
+    peak = 0;
+    if (mesh_state_is_root()) {
+      mesh_topology_visit(count_visitor, &sample);
+    }
+
+    // Measured against the saved values so a change waiting for the next
+    // start is not made again
+    mesh_params_t current;
+    mesh_params_t next;
+    mesh_params_get(NULL, &current);
+    mesh_params_knob_t knob = mesh_params_controller_step(
+        &s_controller, &sample, &current, now_ms(), &next);
+
+    taskENTER_CRITICAL(&s_mux);
+    s_stats.queue_peak = sample.queue_peak;
+    if (knob != MESH_PARAMS_KNOB_NONE) {
+      s_stats.controller_steps++;
+    }
+    taskEXIT_CRITICAL(&s_mux);
+
+    esp_err_t err = ESP_OK;
+    switch (knob) {
+    case MESH_PARAMS_KNOB_XON_QSIZE:
+      err = apply(&next, s_settings.apply, 0);
+      break;
+    case MESH_PARAMS_KNOB_MAX_LAYER:
+      err = push(NULL, &next, MESH_PARAMS_FIELD_MAX_LAYER, s_settings.apply);
+      break;
+    case MESH_PARAMS_KNOB_AP_CONNECTIONS:
+      err = push(NULL, &next, MESH_PARAMS_FIELD_AP_CONNECTIONS,
+                 s_settings.apply);
+      break;
+    case MESH_PARAMS_KNOB_CAPACITY:
+      err = push(NULL, &next, MESH_PARAMS_FIELD_CAPACITY, s_settings.apply);
+      break;
+    default:
+      break;
+    }
+    if (err != ESP_OK) {
+      ESP_LOGW(TAG, "Controller change failed: %s", esp_err_to_name(err));
+    }
+  }
+}
+
+/*******************************************************
+ *                Internal Functions
+ *******************************************************/
+void mesh_params_boot(mesh_params_t *params) {
+  mesh_params_t saved;
+
+  load_saved(&saved);
+  taskENTER_CRITICAL(&s_mux);
+  s_saved = saved;
+  s_active = saved;
+  s_loaded = true;
+  taskEXIT_CRITICAL(&s_mux);
+  *params = saved;
+}
+
+/*******************************************************
+ *                Public Functions
+ *******************************************************/
+esp_err_t mesh_params_init(void) {
+  if (s_initialized) {
+    ESP_LOGW(TAG, "Already initialized");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  esp_timer_create_args_t timer_args = {
+      .callback = restart_timer_cb,
+      .name = "mesh_params",
+  };
+  if (esp_timer_create(&timer_args, &s_restart_timer) != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to create timer");
+    return ESP_ERR_NO_MEM;
+  }
+
+  esp_err_t err = mesh_data_transfer_register_type_handler(
+      MESH_DATA_TYPE_CONFIG, mesh_params_handle_config);
+  if (err != ESP_OK) {
+    return err;
+  }
+
+  s_initialized = true;
+  return ESP_OK;
+}
+
+void mesh_params_default(mesh_params_t *params) {
+  params->max_layer = CONFIG_MESH_MAX_LAYER;
+  params->ap_connections = CONFIG_MESH_AP_CONNECTIONS;
+  params->xon_qsize = MESH_PARAMS_DEFAULT_XON_QSIZE;
+  params->capacity_num = MESH_PARAMS_DEFAULT_CAPACITY;
+  params->assoc_expire_s = MESH_PARAMS_DEFAULT_ASSOC_EXPIRE_S;
+}
+
+esp_err_t mesh_params_get(mesh_params_t *active, mesh_params_t *saved) {
+  taskENTER_CRITICAL(&s_mux);
+  bool loaded = s_loaded;
+  taskEXIT_CRITICAL(&s_mux);
+  if (!loaded) {
+    // Before mesh_init(): what the first start will use
+    mesh_params_t params;
+    load_saved(&params);
+    taskENTER_CRITICAL(&s_mux);
+    if (!s_loaded) {
+      s_saved = params;
+      s_active = params;
+      s_loaded = true;
+    }
+    taskEXIT_CRITICAL(&s_mux);
+  }
+
+  taskENTER_CRITICAL(&s_mux);
+  if (active != NULL) {
+    *active = s_active;
+  }
+  if (saved != NULL) {
+    *saved = s_saved;
+  }
+  taskEXIT_CRITICAL(&s_mux);
+  return ESP_OK;
+}
+
+esp_err_t mesh_params_set(const mesh_params_t *params,
+                          mesh_params_apply_t apply_mode) {
+  if (params == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  return apply(params, apply_mode, 0);
+}
+
+esp_err_t mesh_params_push(const mesh_addr_t *node, const mesh_params_t *params,
+                           mesh_params_apply_t apply_mode) {
+  if (params == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  return push(node, params, MESH_PARAMS_FIELD_ALL, apply_mode);
+}
+
+esp_err_t mesh_params_controller_start(
+    const mesh_params_controller_settings_t *settings) {
+  if (!s_initialized || s_controller_running) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  if (settings != NULL) {
+    s_settings = *settings;
+  } else {
+    mesh_params_controller_config_default(&s_settings.control);
+    s_settings.apply = MESH_PARAMS_APPLY_NEXT_START;
+  }
+  if (s_settings.control.period_ms < MESH_PARAMS_SAMPLE_MS) {
+    ESP_LOGE(TAG, "Invalid period");
+    return ESP_ERR_INVALID_ARG;
+  }
+  mesh_params_controller_init(&s_controller, &s_settings.control);
+
+  if (xTaskCreate(mesh_params_controller_task, "mesh_params",
+                  MESH_PARAMS_TASK_STACK_SIZE, NULL, MESH_PARAMS_TASK_PRIORITY,
+                  NULL) != pdPASS) {
+    ESP_LOGE(TAG, "Failed to create controller task");
+    return ESP_ERR_NO_MEM;
+  }
+
+  s_controller_running = true;
+  return ESP_OK;
+}
+
+esp_err_t mesh_params_get_stats(mesh_params_stats_t *stats) {
+  if (stats == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  taskENTER_CRITICAL(&s_mux);
+  *stats = s_stats;
+  taskEXIT_CRITICAL(&s_mux);
+  return ESP_OK;
+}
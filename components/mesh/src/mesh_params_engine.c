@@ -0,0 +1,173 @@
+/* Mesh Stack Parameter Controller Engine Implementation */
+
+#include "mesh_params_engine.h"
+#include <string.h>
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+
+/**
+ * @brief Count one period of pressure on a knob
+ *
+ * @param direction +1 to grow, -1 to shrink, 0 for none
+ *
+ * @return true once the pressure has lasted confirm_periods
+ */
+static bool press(mesh_params_controller_t *controller,
+                  mesh_params_knob_t knob, int direction) {
+  int8_t *p = &controller->pressure[knob];
+
+  if (direction > 0) {
+    *p = *p > 0 ? *p + 1 : 1;
+  } else if (direction < 0) {
+    *p = *p < 0 ? *p - 1 : -1;
+  } else {
+    *p = 0;
+  }
+  if (*p > 100 || *p < -100) {
+    *p = *p > 0 ? 100 : -100;
+  }
+  return direction != 0 &&
+         (direction > 0 ? *p : -*p) >= controller->config.confirm_periods;
+}
+
+static uint16_t clamp(uint32_t value, uint16_t min, uint16_t max) {
+  return value < min ? min : value > max ? max : (uint16_t)value;
+}
+
+void mesh_params_controller_config_default(
+    mesh_params_controller_config_t *config) {
+  config->period_ms = MESH_PARAMS_DEFAULT_PERIOD_MS;
+  config->confirm_periods = MESH_PARAMS_DEFAULT_CONFIRM_PERIODS;
+  config->cooldown_ms = MESH_PARAMS_DEFAULT_COOLDOWN_MS;
+  config->drop_high_permille = MESH_PARAMS_DEFAULT_DROP_HIGH;
+  config->queue_high_percent = MESH_PARAMS_DEFAULT_QUEUE_HIGH;
+  config->queue_low_percent = MESH_PARAMS_DEFAULT_QUEUE_LOW;
+  config->deep_layer_percent = MESH_PARAMS_DEFAULT_DEEP_LAYER;
+  config->full_relays_percent = MESH_PARAMS_DEFAULT_FULL_RELAYS;
+  config->capacity_high_percent = MESH_PARAMS_DEFAULT_CAPACITY_HIGH;
+}
+
+bool mesh_params_valid(const mesh_params_t *params) {
+  return params->max_layer >= MESH_PARAMS_MAX_LAYER_MIN &&
+         params->max_layer <= MESH_PARAMS_MAX_LAYER_MAX &&
+         params->ap_connections >= MESH_PARAMS_AP_CONNECTIONS_MIN &&
+         params->ap_connections <= MESH_PARAMS_AP_CONNECTIONS_MAX &&
+         params->xon_qsize >= MESH_PARAMS_XON_QSIZE_MIN &&
+         params->xon_qsize <= MESH_PARAMS_XON_QSIZE_MAX &&
+         params->capacity_num >= MESH_PARAMS_CAPACITY_MIN &&
+         params->capacity_num <= MESH_PARAMS_CAPACITY_MAX &&
+         params->assoc_expire_s >= MESH_PARAMS_ASSOC_EXPIRE_MIN_S &&
+         params->assoc_expire_s <= MESH_PARAMS_ASSOC_EXPIRE_MAX_S;
+}
+
+void mesh_params_controller_init(
+    mesh_params_controller_t *controller,
+    const mesh_params_controller_config_t *config) {
+  memset(controller, 0, sizeof(*controller));
+  controller->config = *config;
+  if (controller->config.confirm_periods == 0) {
+    controller->config.confirm_periods = 1;
+  }
+}
+
+mesh_params_knob_t
+mesh_params_controller_step(mesh_params_controller_t *controller,
+                            const mesh_params_sample_t *sample,
+                            const mesh_params_t *current, uint32_t now_ms,
+                            mesh_params_t *next) {
+  const mesh_params_controller_config_t *cfg = &controller->config;
+  bool confirmed[MESH_PARAMS_KNOB_COUNT];
+  int direction;
+
+  *next = *current;
+
+  // Drops only count against the queue when it was near full as well;
+  // a missing route fails sends with an empty queue
+  bool dropping = sample->dropped > 0 &&
+                  (uint64_t)sample->dropped * 1000 >=
+                      (uint64_t)sample->sent * cfg->drop_high_permille;
+  bool queue_full = (uint32_t)sample->queue_peak * 100 >=
+                    (uint32_t)current->xon_qsize * cfg->queue_high_percent;
+  bool queue_idle = (uint32_t)sample->queue_peak * 100 <
+                    (uint32_t)current->xon_qsize * cfg->queue_low_percent;
+  direction = 0;
+  if (dropping && queue_full &&
+      current->xon_qsize < MESH_PARAMS_XON_QSIZE_MAX) {
+    direction = 1;
+  } else if (sample->dropped == 0 && queue_idle &&
+             current->xon_qsize > MESH_PARAMS_DEFAULT_XON_QSIZE) {
+    direction = -1;
+  }
+  confirmed[MESH_PARAMS_KNOB_XON_QSIZE] =
+      press(controller, MESH_PARAMS_KNOB_XON_QSIZE, direction);
+
+  direction = 0;
+  if (sample->have_topology && sample->nodes > 1 &&
+      current->max_layer < MESH_PARAMS_CONTROL_MAX_LAYER &&
+      (uint32_t)sample->deepest * 100 >=
+          (uint32_t)sample->nodes * cfg->deep_layer_percent) {
+    direction = 1;
+  }
+  confirmed[MESH_PARAMS_KNOB_MAX_LAYER] =
+      press(controller, MESH_PARAMS_KNOB_MAX_LAYER, direction);
+
+  direction = 0;
+  if (sample->have_topology && sample->relays >= 2 &&
+      current->ap_connections < MESH_PARAMS_AP_CONNECTIONS_MAX &&
+      (uint32_t)sample->full_relays * 100 >=
+          (uint32_t)sample->relays * cfg->full_relays_percent) {
+    direction = 1;
+  }
+  confirmed[MESH_PARAMS_KNOB_AP_CONNECTIONS] =
+      press(controller, MESH_PARAMS_KNOB_AP_CONNECTIONS, direction);
+
+  direction = 0;
+  if (sample->have_topology &&
+      current->capacity_num < MESH_PARAMS_CAPACITY_MAX &&
+      (uint32_t)sample->nodes * 100 >=
+          (uint32_t)current->capacity_num * cfg->capacity_high_percent) {
+    direction = 1;
+  }
+  confirmed[MESH_PARAMS_KNOB_CAPACITY] =
+      press(controller, MESH_PARAMS_KNOB_CAPACITY, direction);
+
+  if (controller->changed &&
+      now_ms - controller->last_change_ms < cfg->cooldown_ms) {
+    return MESH_PARAMS_KNOB_NONE;
+  }
+
+  // Structural knobs first: a deeper or wider tree also drains queues
+  mesh_params_knob_t knob = MESH_PARAMS_KNOB_NONE;
+  if (confirmed[MESH_PARAMS_KNOB_MAX_LAYER]) {
+    next->max_layer = current->max_layer + 1;
+    knob = MESH_PARAMS_KNOB_MAX_LAYER;
+  } else if (confirmed[MESH_PARAMS_KNOB_AP_CONNECTIONS]) {
+    next->ap_connections = current->ap_connections + 1;
+    knob = MESH_PARAMS_KNOB_AP_CONNECTIONS;
+  } else if (confirmed[MESH_PARAMS_KNOB_CAPACITY]) {
+    next->capacity_num =
+        clamp((uint32_t)current->capacity_num * 5 / 4,
+              MESH_PARAMS_CAPACITY_MIN, MESH_PARAMS_CAPACITY_MAX);
+    knob = MESH_PARAMS_KNOB_CAPACITY;
+  } else if (confirmed[MESH_PARAMS_KNOB_XON_QSIZE]) {
+    if (controller->pressure[MESH_PARAMS_KNOB_XON_QSIZE] > 0) {
+      next->xon_qsize =
+          clamp((uint32_t)current->xon_qsize * 3 / 2,
+                MESH_PARAMS_XON_QSIZE_MIN, MESH_PARAMS_XON_QSIZE_MAX);
+    } else {
+      next->xon_qsize =
+          clamp((uint32_t)current->xon_qsize * 3 / 4,
+                MESH_PARAMS_DEFAULT_XON_QSIZE, MESH_PARAMS_XON_QSIZE_MAX);
+    }
+    knob = MESH_PARAMS_KNOB_XON_QSIZE;
+  }
+
+  if (knob != MESH_PARAMS_KNOB_NONE) {
+    controller->pressure[knob] = 0;
+    controller->changed = true;
+    controller->last_change_ms = now_ms;
+  }
+  return knob;
+}
@@ -0,0 +1,190 @@
+/* Parent Selection Engine Implementation */
+
+#include "mesh_parent_select.h"
+#include <string.h>
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static const mesh_parent_history_t *
+find_history(const mesh_parent_engine_t *engine, const uint8_t *bssid) {
+  for (int i = 0; i < MESH_PARENT_HISTORY_SIZE; i++) {
+    const mesh_parent_history_t *entry = &engine->history[i];
+    if (entry->last_use != 0 && memcmp(entry->bssid, bssid, 6) == 0) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+static uint32_t cache_checksum(const mesh_parent_cache_t *cache) {
+  const uint8_t *bytes = (const uint8_t *)cache->entries;
+  uint32_t sum = cache->count;
+
+  for (size_t i = 0; i < sizeof(cache->entries); i++) {
+    sum = sum * 31 + bytes[i];
+  }
+  return sum;
+}
+
+void mesh_parent_weights_default(mesh_parent_weights_t *weights) {
+  weights->min_rssi = MESH_PARENT_DEFAULT_MIN_RSSI;
+  weights->w_rssi = MESH_PARENT_DEFAULT_W_RSSI;
+  weights->w_layer = MESH_PARENT_DEFAULT_W_LAYER;
+  weights->w_load = MESH_PARENT_DEFAULT_W_LOAD;
+  weights->w_layer2 = MESH_PARENT_DEFAULT_W_LAYER2;
+  weights->w_history = MESH_PARENT_DEFAULT_W_HISTORY;
+  weights->w_etx = MESH_PARENT_DEFAULT_W_ETX;
+  weights->hysteresis = MESH_PARENT_DEFAULT_HYSTERESIS;
+}
+
+void mesh_parent_engine_init(mesh_parent_engine_t *engine,
+                             const mesh_parent_weights_t *weights) {
+  memset(engine, 0, sizeof(*engine));
+  if (weights != NULL) {
+    engine->weights = *weights;
+  } else {
+    mesh_parent_weights_default(&engine->weights);
+  }
+}
+
+int32_t mesh_parent_engine_score(const mesh_parent_engine_t *engine,
+                                 const mesh_parent_candidate_t *candidate) {
+  const mesh_parent_weights_t *w = &engine->weights;
+
+  if (candidate->rssi < w->min_rssi || candidate->layer_cap == 0 ||
+      candidate->assoc >= candidate->assoc_cap) {
+    return MESH_PARENT_SCORE_REJECT;
+  }
+
+  int32_t load = (int32_t)candidate->assoc * 100 / candidate->assoc_cap;
+  const mesh_parent_history_t *history = find_history(engine, candidate->bssid);
+  int32_t quality =
+      (history != NULL) ? history->quality : MESH_PARENT_QUALITY_UNKNOWN;
+  // Only links this node has sent over have an ETX; others are not judged
+  int32_t etx_excess = candidate->etx > 10 ? candidate->etx - 10 : 0;
+
+  return (int32_t)w->w_rssi * (candidate->rssi - w->min_rssi) -
+         (int32_t)w->w_layer * candidate->layer - (int32_t)w->w_load * load -
+         (int32_t)w->w_layer2 * candidate->layer2_cap +
+         (int32_t)w->w_history * (quality - MESH_PARENT_QUALITY_UNKNOWN) -
+         (int32_t)w->w_etx * etx_excess;
+}
+
+bool mesh_parent_engine_should_switch(const mesh_parent_engine_t *engine,
+                                      int32_t best_score,
+                                      int32_t current_score) {
+  if (best_score == MESH_PARENT_SCORE_REJECT) {
+    return false;
+  }
+  if (current_score == MESH_PARENT_SCORE_REJECT) {
+    return true;
+  }
+  return (int64_t)best_score >=
+         (int64_t)current_score + engine->weights.hysteresis;
+}
+
+int mesh_parent_engine_select(const mesh_parent_engine_t *engine,
+                              const mesh_parent_candidate_t *candidates,
+                              int count, const uint8_t *current_bssid) {
+  int best = -1;
+  int current = -1;
+  int32_t best_score = MESH_PARENT_SCORE_REJECT;
+  int32_t current_score = MESH_PARENT_SCORE_REJECT;
+
+  for (int i = 0; i < count; i++) {
+    int32_t score = mesh_parent_engine_score(engine, &candidates[i]);
+    if (current_bssid != NULL &&
+        memcmp(candidates[i].bssid, current_bssid, 6) == 0) {
+      current = i;
+      current_score = score;
+    } else if (score > best_score) {
+      best = i;
+      best_score = score;
+    }
+  }
+
+  if (mesh_parent_engine_should_switch(engine, best_score, current_score)) {
+    return best;
+  }
+  return (current_score != MESH_PARENT_SCORE_REJECT) ? current : -1;
+}
+
+void mesh_parent_engine_record(mesh_parent_engine_t *engine,
+                               const uint8_t *bssid, bool good) {
+  mesh_parent_history_t *entry =
+      (mesh_parent_history_t *)find_history(engine, bssid);
+
+  if (entry == NULL) {
+    // Replace an unused or the least recently updated entry
+    entry = &engine->history[0];
+    for (int i = 1; i < MESH_PARENT_HISTORY_SIZE; i++) {
+      if (engine->history[i].last_use < entry->last_use) {
+        entry = &engine->history[i];
+      }
+    }
+    memcpy(entry->bssid, bssid, 6);
+    entry->quality = MESH_PARENT_QUALITY_UNKNOWN;
+    entry->failures = 0;
+  }
+
+  // Moving average with weight 1/4 towards 100 (good) or 0 (bad)
+  int target = good ? 100 : 0;
+  entry->quality += (target - entry->quality) / 4;
+  if (!good && entry->failures < UINT8_MAX) {
+    entry->failures++;
+  }
+  entry->last_use = ++engine->clock;
+}
+
+bool mesh_parent_cache_validate(mesh_parent_cache_t *cache) {
+  if (cache->magic == MESH_PARENT_CACHE_MAGIC &&
+      cache->count <= MESH_PARENT_CACHE_SIZE &&
+      cache->checksum == cache_checksum(cache)) {
+    return true;
+  }
+
+  memset(cache, 0, sizeof(*cache));
+  cache->magic = MESH_PARENT_CACHE_MAGIC;
+  cache->checksum = cache_checksum(cache);
+  return false;
+}
+
+void mesh_parent_cache_update(mesh_parent_cache_t *cache,
+                              const mesh_parent_cache_entry_t *entry) {
+  int found = cache->count;
+
+  for (int i = 0; i < cache->count; i++) {
+    if (memcmp(cache->entries[i].bssid, entry->bssid, 6) == 0) {
+      found = i;
+      break;
+    }
+  }
+  if (found == cache->count && cache->count < MESH_PARENT_CACHE_SIZE) {
+    cache->count++;
+  }
+  if (found == MESH_PARENT_CACHE_SIZE) {
+    found = MESH_PARENT_CACHE_SIZE - 1; // drop the oldest
+  }
+
+  memmove(&cache->entries[1], &cache->entries[0],
+          found * sizeof(mesh_parent_cache_entry_t));
+  cache->entries[0] = *entry;
+  cache->checksum = cache_checksum(cache);
+}
+
+int mesh_parent_cache_channels(const mesh_parent_cache_t *cache,
+                               uint32_t now_s, uint32_t max_age_s,
+                               uint8_t *channels, int max_channels) {
+  int count = 0;
+
+  for (int i = 0; i < cache->count && count < max_channels; i++) {
+    const mesh_parent_cache_entry_t *entry = &cache->entries[i];
+    if (now_s - entry->seen_s > max_age_s ||
+        memchr(channels, entry->channel, count) != NULL) {
+      continue;
+    }
+    channels[count++] = entry->channel;
+  }
+  return count;
+}
@@ -0,0 +1,206 @@
+/* Control Item Piggybacking Engine Implementation */
+
+#include "mesh_piggyback_engine.h"
+#include <string.h>
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/* Same layout as mesh_batch_record_header_t */
+typedef struct {
+  uint8_t type;
+  uint16_t length;
+} __attribute__((packed)) record_header_t;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static bool before(uint32_t a, uint32_t b) { return (int32_t)(a - b) < 0; }
+
+/**
+ * @brief Find the queued item of the same kind: peer, type and first byte,
+ *        which is the op or magic of every internal message
+ */
+static int find_item(const mesh_piggyback_queue_t *queue,
+                     const uint8_t peer[6], uint8_t type, const uint8_t *data,
+                     uint8_t length) {
+  for (int i = 0; i < MESH_PIGGYBACK_MAX_ITEMS; i++) {
+    const mesh_piggyback_item_t *item = &queue->items[i];
+    if (item->used && item->type == type && memcmp(item->peer, peer, 6) == 0 &&
+        (item->length > 0) == (length > 0) &&
+        (length == 0 || item->data[0] == data[0])) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static int free_slot(const mesh_piggyback_queue_t *queue) {
+  for (int i = 0; i < MESH_PIGGYBACK_MAX_ITEMS; i++) {
+    if (!queue->items[i].used) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void fill(mesh_piggyback_item_t *item, const uint8_t peer[6],
+                 uint8_t type, const void *data, uint8_t length,
+                 uint32_t deadline_ms) {
+  memcpy(item->peer, peer, 6);
+  item->type = type;
+  item->length = length;
+  if (length > 0) {
+    memcpy(item->data, data, length);
+  }
+  item->deadline_ms = deadline_ms;
+  item->used = true;
+}
+
+void mesh_piggyback_init(mesh_piggyback_queue_t *queue) {
+  memset(queue, 0, sizeof(*queue));
+}
+
+esp_err_t mesh_piggyback_put(mesh_piggyback_queue_t *queue,
+                             const uint8_t peer[6], uint8_t type,
+                             const void *data, uint8_t length,
+                             uint32_t deadline_ms, bool *replaced) {
+  if (length > MESH_PIGGYBACK_ITEM_MAX) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  int slot = find_item(queue, peer, type, data, length);
+  if (replaced != NULL) {
+    *replaced = (slot >= 0);
+  }
+  if (slot >= 0) {
+    if (before(queue->items[slot].deadline_ms, deadline_ms)) {
+      deadline_ms = queue->items[slot].deadline_ms;
+    }
+  } else {
+    slot = free_slot(queue);
+    if (slot < 0) {
+      return ESP_ERR_NO_MEM;
+    }
+  }
+  fill(&queue->items[slot], peer, type, data, length, deadline_ms);
+  return ESP_OK;
+}
+
+int mesh_piggyback_pending(const mesh_piggyback_queue_t *queue,
+                           const uint8_t peer[6]) {
+  int bytes = 0;
+
+  for (int i = 0; i < MESH_PIGGYBACK_MAX_ITEMS; i++) {
+    const mesh_piggyback_item_t *item = &queue->items[i];
+    if (item->used && memcmp(item->peer, peer, 6) == 0) {
+      bytes += sizeof(record_header_t) + item->length;
+    }
+  }
+  return bytes;
+}
+
+int mesh_piggyback_attach(mesh_piggyback_queue_t *queue,
+                          const uint8_t peer[6], uint8_t *buf, int size,
+                          int *count) {
+  int order[MESH_PIGGYBACK_MAX_ITEMS];
+  int found = 0;
+  int offset = 0;
+  int taken = 0;
+
+  // Items of the peer, earliest deadline first
+  for (int i = 0; i < MESH_PIGGYBACK_MAX_ITEMS; i++) {
+    const mesh_piggyback_item_t *item = &queue->items[i];
+    if (!item->used || memcmp(item->peer, peer, 6) != 0) {
+      continue;
+    }
+    int j = found++;
+    while (j > 0 &&
+           before(item->deadline_ms, queue->items[order[j - 1]].deadline_ms)) {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = i;
+  }
+
+  for (int k = 0; k < found; k++) {
+    mesh_piggyback_item_t *item = &queue->items[order[k]];
+    record_header_t header = {.type = item->type, .length = item->length};
+    if (offset + (int)sizeof(header) + item->length > size) {
+      continue;
+    }
+    memcpy(&buf[offset], &header, sizeof(header));
+    offset += sizeof(header);
+    memcpy(&buf[offset], item->data, item->length);
+    offset += item->length;
+    item->used = false;
+    taken++;
+  }
+
+  if (count != NULL) {
+    *count = taken;
+  }
+  return offset;
+}
+
+int mesh_piggyback_restore(mesh_piggyback_queue_t *queue,
+                           const uint8_t peer[6], const uint8_t *buf,
+                           int length, uint32_t now_ms) {
+  int offset = 0;
+  int restored = 0;
+
+  while (offset + (int)sizeof(record_header_t) <= length) {
+    record_header_t header;
+    memcpy(&header, &buf[offset], sizeof(header));
+    offset += sizeof(header);
+    if (header.length > MESH_PIGGYBACK_ITEM_MAX ||
+        offset + header.length > length) {
+      break;
+    }
+    int slot = find_item(queue, peer, header.type, &buf[offset],
+                         (uint8_t)header.length);
+    if (slot < 0 && (slot = free_slot(queue)) >= 0) {
+      fill(&queue->items[slot], peer, header.type, &buf[offset],
+           (uint8_t)header.length, now_ms);
+      restored++;
+    }
+    offset += header.length;
+  }
+  return restored;
+}
+
+bool mesh_piggyback_take_due(mesh_piggyback_queue_t *queue, uint32_t now_ms,
+                             mesh_piggyback_item_t *item) {
+  int earliest = -1;
+
+  for (int i = 0; i < MESH_PIGGYBACK_MAX_ITEMS; i++) {
+    const mesh_piggyback_item_t *candidate = &queue->items[i];
+    if (candidate->used &&
+        (earliest < 0 || before(candidate->deadline_ms,
+                                queue->items[earliest].deadline_ms))) {
+      earliest = i;
+    }
+  }
+  if (earliest < 0 || before(now_ms, queue->items[earliest].deadline_ms)) {
+    return false;
+  }
+
+  *item = queue->items[earliest];
+  queue->items[earliest].used = false;
+  return true;
+}
+
+bool mesh_piggyback_next_deadline(const mesh_piggyback_queue_t *queue,
+                                  uint32_t *deadline_ms) {
+  bool found = false;
+
+  for (int i = 0; i < MESH_PIGGYBACK_MAX_ITEMS; i++) {
+    const mesh_piggyback_item_t *item = &queue->items[i];
+    if (item->used && (!found || before(item->deadline_ms, *deadline_ms))) {
+      *deadline_ms = item->deadline_ms;
+      found = true;
+    }
+  }
+  return found;
+}
@@ -0,0 +1,423 @@
+/* ESP-MESH Event Reactor Implementation */
+
+#include "mesh_reactor.h"
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "mesh_data_transfer.h"
+#include "mesh_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+static const char *TAG = "mesh_reactor";
+
+/* Queued by mesh_reactor_send(), turned into MESH_REACTOR_EVENT_TX_DONE */
+#define MESH_REACTOR_EVENT_TX_REQUEST (MESH_REACTOR_EVENT_MAX)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+struct mesh_reactor_timer {
+  esp_timer_handle_t esp_timer;
+  mesh_reactor_handler_t handler;
+  void *ctx;
+  volatile uint32_t generation; /* bumped by start/stop to void old expiries */
+  volatile bool pending;        /* an expiry of this generation is queued */
+};
+
+typedef struct {
+  mesh_reactor_event_t event;
+  uint8_t *buffer;     /* RX or TX payload owned by the item */
+  uint16_t length;     /* TX payload length */
+  uint32_t generation; /* timer generation at expiry */
+} mesh_reactor_item_t;
+
+typedef struct {
+  mesh_reactor_event_type_t type;
+  mesh_reactor_handler_t handler;
+  void *ctx;
+} mesh_reactor_handler_entry_t;
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static bool s_initialized = false;
+static QueueHandle_t s_queue = NULL;
+static SemaphoreHandle_t s_lock = NULL;
+static TaskHandle_t s_task_handle = NULL;
+static mesh_reactor_handler_entry_t s_handlers[MESH_REACTOR_MAX_HANDLERS];
+static int s_handler_count = 0;
+static int s_rx_handler_count = 0;
+static mesh_reactor_stats_t s_stats;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static void count_dropped(void) {
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  s_stats.dropped++;
+  xSemaphoreGive(s_lock);
+}
+
+static void free_item(mesh_reactor_item_t *item) {
+  free(item->buffer);
+  item->buffer = NULL;
+}
+
+static void dispatch_handlers(const mesh_reactor_event_t *event) {
+  for (int i = 0; i < s_handler_count; i++) {
+    if (s_handlers[i].type == event->type) {
+      s_handlers[i].handler(event, s_handlers[i].ctx);
+    }
+  }
+}
+
+/**
+ * @brief Turn one queue item into handler calls
+ *
+ * @return false if the item was discarded without dispatching
+ */
+static bool dispatch_item(mesh_reactor_item_t *item) {
+  mesh_reactor_event_t *event = &item->event;
+
+  switch ((int)event->type) {
+  case MESH_REACTOR_EVENT_TIMER: {
+    struct mesh_reactor_timer *timer = event->timer.timer;
+    if (item->generation != timer->generation) {
+      return false; // stopped or restarted after this expiry was queued
+    }
+    timer->pending = false;
+    timer->handler(event, timer->ctx);
+    return true;
+  }
+  case MESH_REACTOR_EVENT_TX_REQUEST: {
+    if (event->tx.to_root) {
+      event->tx.err =
+          mesh_send_to_root(event->tx.data_type, item->buffer, item->length);
+    } else {
+      event->tx.err = mesh_send_to_child(&event->tx.to, event->tx.data_type,
+                                         item->buffer, item->length);
+    }
+    event->type = MESH_REACTOR_EVENT_TX_DONE;
+    dispatch_handlers(event);
+    return true;
+  }
+  default:
+    dispatch_handlers(event);
+    return true;
+  }
+}
+
+static void mesh_reactor_task(void *arg) {
+  mesh_reactor_item_t item;
+
+  ESP_LOGI(TAG, "Reactor task started");
+
+  while (1) {
+    if (xQueueReceive(s_queue, &item, portMAX_DELAY) != pdTRUE) {
+      continue;
+    }
+
+    uint16_t waiting = uxQueueMessagesWaiting(s_queue) + 1;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_stats.wakeups++;
+    if (waiting > s_stats.queue_high_water) {
+      s_stats.queue_high_water = waiting;
+    }
+    xSemaphoreGive(s_lock);
+
+    // Drain everything that queued up before sleeping again
+    do {
+      int64_t start_us = esp_timer_get_time();
+      bool dispatched = dispatch_item(&item);
+      uint32_t elapsed_us = (uint32_t)(esp_timer_get_time() - start_us);
+      free_item(&item);
+
+      if (dispatched) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_stats.events[item.event.type]++;
+        if (elapsed_us > s_stats.handler_max_us) {
+          s_stats.handler_max_us = elapsed_us;
+        }
+        xSemaphoreGive(s_lock);
+      }
+    } while (xQueueReceive(s_queue, &item, 0) == pdTRUE);
+  }
+  vTaskDelete(NULL);
+}
+
+static void mesh_reactor_mesh_event_handler(void *arg,
+                                            esp_event_base_t event_base,
+                                            int32_t event_id,
+                                            void *event_data) {
+  mesh_reactor_item_t item = {0};
+  item.event.type = MESH_REACTOR_EVENT_MESH;
+  item.event.mesh.id = event_id;
+  item.event.mesh.layer = esp_mesh_get_layer();
+  item.event.mesh.is_root = esp_mesh_is_root();
+
+  if (xQueueSend(s_queue, &item, 0) != pdTRUE) {
+    ESP_LOGW(TAG, "Queue full, mesh event %" PRId32 " dropped", event_id);
+    count_dropped();
+  }
+}
+
+static void mesh_reactor_timer_cb(void *arg) {
+  struct mesh_reactor_timer *timer = arg;
+
+  // A slow reactor sees one expiry, not a backlog of them
+  if (timer->pending) {
+    return;
+  }
+
+  mesh_reactor_item_t item = {0};
+  item.event.type = MESH_REACTOR_EVENT_TIMER;
+  item.event.timer.timer = timer;
+  item.generation = timer->generation;
+  timer->pending = true;
+
+  if (xQueueSend(s_queue, &item, 0) != pdTRUE) {
+    timer->pending = false;
+    count_dropped();
+  }
+}
+
+esp_err_t mesh_reactor_post_rx(const mesh_addr_t *from, uint8_t data_type,
+                               const uint8_t *payload, uint16_t length) {
+  if (!s_initialized || s_rx_handler_count == 0) {
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+
+  mesh_reactor_item_t item = {0};
+  item.buffer = malloc(length > 0 ? length : 1);
+  if (item.buffer == NULL) {
+    count_dropped();
+    return ESP_ERR_NO_MEM;
+  }
+  memcpy(item.buffer, payload, length);
+
+  item.event.type = MESH_REACTOR_EVENT_RX;
+  item.event.rx.from = *from;
+  item.event.rx.data_type = data_type;
+  item.event.rx.length = length;
+  item.event.rx.payload = item.buffer;
+
+  // Block the receive task briefly rather than drop on a burst
+  if (xQueueSend(s_queue, &item,
+                 pdMS_TO_TICKS(MESH_REACTOR_RX_POST_TIMEOUT_MS)) != pdTRUE) {
+    ESP_LOGW(TAG, "Queue full, %u byte packet dropped", length);
+    free_item(&item);
+    count_dropped();
+    return ESP_ERR_TIMEOUT;
+  }
+  return ESP_OK;
+}
+
+/*******************************************************
+ *                Public Functions
+ *******************************************************/
+esp_err_t mesh_reactor_init(const mesh_reactor_config_t *config) {
+  if (s_initialized) {
+    ESP_LOGW(TAG, "Already initialized");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  mesh_reactor_config_t cfg = {
+      .queue_length = MESH_REACTOR_DEFAULT_QUEUE_LENGTH,
+      .stack_size = MESH_REACTOR_TASK_STACK_SIZE,
+      .priority = MESH_REACTOR_TASK_PRIORITY,
+  };
+  if (config != NULL) {
+    cfg = *config;
+  }
+
+  s_lock = xSemaphoreCreateMutex();
+  s_queue = xQueueCreate(cfg.queue_length, sizeof(mesh_reactor_item_t));
+  if (s_lock == NULL || s_queue == NULL) {
+    ESP_LOGE(TAG, "Failed to allocate %u event queue", cfg.queue_length);
+    return ESP_ERR_NO_MEM;
+  }
+  s_stats.queue_length = cfg.queue_length;
+  s_stats.stack_size = cfg.stack_size;
+
+  BaseType_t ret = xTaskCreate(mesh_reactor_task, "mesh_reactor",
+                               cfg.stack_size, NULL, cfg.priority,
+                               &s_task_handle);
+  if (ret != pdPASS) {
+    ESP_LOGE(TAG, "Failed to create reactor task");
+    return ESP_FAIL;
+  }
+
+  ESP_ERROR_CHECK(esp_event_handler_register(
+      MESH_EVENT, ESP_EVENT_ANY_ID, &mesh_reactor_mesh_event_handler, NULL));
+
+  s_initialized = true;
+  ESP_LOGI(TAG, "Reactor started, queue of %u events (%u bytes)",
+           cfg.queue_length,
+           (unsigned)(cfg.queue_length * sizeof(mesh_reactor_item_t)));
+  return ESP_OK;
+}
+
+esp_err_t mesh_reactor_register(mesh_reactor_event_type_t type,
+                                mesh_reactor_handler_t handler, void *ctx) {
+  if (type >= MESH_REACTOR_EVENT_MAX || type == MESH_REACTOR_EVENT_TIMER ||
+      handler == NULL) {
+    ESP_LOGE(TAG, "Invalid arguments");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (s_handler_count >= MESH_REACTOR_MAX_HANDLERS) {
+    ESP_LOGE(TAG, "Handler table full");
+    return ESP_ERR_NO_MEM;
+  }
+
+  s_handlers[s_handler_count].type = type;
+  s_handlers[s_handler_count].handler = handler;
+  s_handlers[s_handler_count].ctx = ctx;
+  s_handler_count++;
+  if (type == MESH_REACTOR_EVENT_RX) {
+    s_rx_handler_count++;
+  }
+  return ESP_OK;
+}
+
+esp_err_t mesh_reactor_post(uint32_t id, void *arg, uint32_t timeout_ms) {
+  if (!s_initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  mesh_reactor_item_t item = {0};
+  item.event.type = MESH_REACTOR_EVENT_USER;
+  item.event.user.id = id;
+  item.event.user.arg = arg;
+
+  if (xQueueSend(s_queue, &item, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+    count_dropped();
+    return ESP_ERR_TIMEOUT;
+  }
+  return ESP_OK;
+}
+
+esp_err_t mesh_reactor_send(const mesh_addr_t *to, uint8_t data_type,
+                            const uint8_t *payload, uint16_t length,
+                            uint32_t id) {
+  if (payload == NULL || length == 0) {
+    ESP_LOGE(TAG, "Invalid arguments");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (!s_initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  mesh_reactor_item_t item = {0};
+  item.buffer = malloc(length);
+  if (item.buffer == NULL) {
+    ESP_LOGE(TAG, "Failed to allocate %u byte payload", length);
+    return ESP_ERR_NO_MEM;
+  }
+  memcpy(item.buffer, payload, length);
+  item.length = length;
+
+  item.event.type = MESH_REACTOR_EVENT_TX_REQUEST;
+  item.event.tx.id = id;
+  item.event.tx.data_type = data_type;
+  item.event.tx.to_root = (to == NULL);
+  if (to != NULL) {
+    item.event.tx.to = *to;
+  }
+
+  if (xQueueSend(s_queue, &item, 0) != pdTRUE) {
+    ESP_LOGW(TAG, "Queue full, send %" PRIu32 " dropped", id);
+    free_item(&item);
+    count_dropped();
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
+
+esp_err_t mesh_reactor_timer_create(mesh_reactor_handler_t handler, void *ctx,
+                                    mesh_reactor_timer_t *timer) {
+  if (handler == NULL || timer == NULL) {
+    ESP_LOGE(TAG, "Invalid arguments");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  struct mesh_reactor_timer *t = calloc(1, sizeof(struct mesh_reactor_timer));
+  if (t == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  t->handler = handler;
+  t->ctx = ctx;
+
+  esp_timer_create_args_t args = {
+      .callback = mesh_reactor_timer_cb,
+      .arg = t,
+      .name = "mesh_reactor",
+  };
+  esp_err_t err = esp_timer_create(&args, &t->esp_timer);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to create timer: %s", esp_err_to_name(err));
+    free(t);
+    return err;
+  }
+
+  *timer = t;
+  return ESP_OK;
+}
+
+esp_err_t mesh_reactor_timer_start(mesh_reactor_timer_t timer,
+                                   uint32_t timeout_ms, bool periodic) {
+  if (timer == NULL || timeout_ms == 0) {
+    ESP_LOGE(TAG, "Invalid arguments");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (!s_initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  esp_timer_stop(timer->esp_timer);
+  timer->generation++;
+  timer->pending = false;
+
+  uint64_t timeout_us = (uint64_t)timeout_ms * 1000;
+  return periodic ? esp_timer_start_periodic(timer->esp_timer, timeout_us)
+                  : esp_timer_start_once(timer->esp_timer, timeout_us);
+}
+
+esp_err_t mesh_reactor_timer_stop(mesh_reactor_timer_t timer) {
+  if (timer == NULL) {
+    ESP_LOGE(TAG, "Invalid arguments");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  esp_timer_stop(timer->esp_timer);
+  timer->generation++;
+  timer->pending = false;
+  return ESP_OK;
+}
+
+esp_err_t mesh_reactor_get_stats(mesh_reactor_stats_t *stats) {
+  if (stats == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (!s_initialized) {
+    memset(stats, 0, sizeof(*stats));
+    return ESP_OK;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  *stats = s_stats;
+  xSemaphoreGive(s_lock);
+  stats->stack_free_min = uxTaskGetStackHighWaterMark(s_task_handle);
+  return ESP_OK;
+}
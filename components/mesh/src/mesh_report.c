@@ -0,0 +1,359 @@
+/* ESP-MESH Change-of-Value Reporting Implementation */
+
+#include "mesh_report.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "mesh_aggregate_engine.h"
+#include "mesh_data_transfer.h"
+#include "mesh_internal.h"
+#include <math.h>
+#include <string.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+static const char *TAG = "mesh_report";
+
+/* Distinguishes threshold pushes from other MESH_DATA_TYPE_CONFIG payloads */
+#define MESH_REPORT_CONFIG_MAGIC (0xDB)
+#define MESH_REPORT_CONFIG_VERSION (0x01)
+#define MESH_REPORT_KEEP_HEARTBEAT (UINT32_MAX)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+typedef struct {
+  uint8_t magic;
+  uint8_t version;
+  uint8_t channel;
+  float deadband;
+  uint32_t min_interval_ms;
+  uint32_t max_interval_ms;
+  uint32_t heartbeat_ms;
+} __attribute__((packed)) mesh_report_config_msg_t;
+
+typedef struct {
+  mesh_report_channel_config_t config;
+  float value;        /* latest submitted reading */
+  float sent_value;   /* reading of the last report */
+  uint32_t sent_ms;   /* time of the last report */
+  bool has_value;
+  bool has_sent;
+  bool pending;       /* passed the deadband inside the minimum interval */
+} mesh_report_channel_t;
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static bool s_initialized = false;
+static uint8_t s_data_type = MESH_DATA_TYPE_SENSOR;
+static SemaphoreHandle_t s_lock = NULL;
+static TaskHandle_t s_task_handle = NULL;
+static mesh_report_channel_t s_channels[MESH_REPORT_MAX_CHANNELS];
+static uint32_t s_heartbeat_ms = MESH_REPORT_DEFAULT_HEARTBEAT_MS;
+static uint32_t s_last_packet_ms = 0;
+static mesh_report_stats_t s_stats;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static inline uint32_t now_ms(void) {
+  return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+/* Also false for NaN, which would otherwise suppress every reading */
+static inline bool valid_deadband(float deadband) { return deadband >= 0; }
+
+/* Readings only leave a node that has joined and is not the root */
+static inline bool can_report(void) {
+  return mesh_state_is_started() && !mesh_state_is_root();
+}
+
+static bool exceeds_deadband(const mesh_report_channel_t *ch) {
+  if (!ch->has_sent) {
+    return true;
+  }
+  float delta = fabsf(ch->value - ch->sent_value);
+  return (ch->config.deadband > 0) ? delta >= ch->config.deadband
+                                   : delta > 0;
+}
+
+/**
+ * @brief Mark a channel reported and append its reading to the packet
+ *
+ * Must be called with s_lock held.
+ */
+static void take_reading(int channel, uint32_t now,
+                         mesh_sensor_reading_t *readings, int *count) {
+  mesh_report_channel_t *ch = &s_channels[channel];
+  readings[*count].channel = channel;
+  readings[*count].value = ch->value;
+  (*count)++;
+  ch->sent_value = ch->value;
+  ch->sent_ms = now;
+  ch->has_sent = true;
+  ch->pending = false;
+  s_last_packet_ms = now;
+}
+
+static esp_err_t send_readings(const mesh_sensor_reading_t *readings,
+                               int count) {
+  esp_err_t err =
+      mesh_send_to_root(s_data_type, (const uint8_t *)readings,
+                        count * sizeof(mesh_sensor_reading_t));
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  if (err == ESP_OK) {
+    s_stats.sent += count;
+    s_stats.packets++;
+  }
+  xSemaphoreGive(s_lock);
+  return err;
+}
+
+/**
+ * @brief Send held readings, maximum-interval refreshes and heartbeats
+ */
+static void mesh_report_task(void *arg) {
+  mesh_sensor_reading_t readings[MESH_REPORT_MAX_CHANNELS];
+
+  while (1) {
+    vTaskDelay(pdMS_TO_TICKS(MESH_REPORT_TICK_MS));
+
+    int count = 0;
+    bool heartbeat = false;
+    uint32_t now = now_ms();
+
+    // Readings stay pending until they can actually be sent
+    if (!can_report()) {
+      continue;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    heartbeat = s_heartbeat_ms != 0 && now - s_last_packet_ms >= s_heartbeat_ms;
+    for (int i = 0; i < MESH_REPORT_MAX_CHANNELS; i++) {
+      mesh_report_channel_t *ch = &s_channels[i];
+      if (!ch->has_value) {
+        continue;
+      }
+      uint32_t elapsed = now - ch->sent_ms;
+      if (heartbeat ||
+          (ch->pending && elapsed >= ch->config.min_interval_ms) ||
+          (ch->config.max_interval_ms != 0 &&
+           elapsed >= ch->config.max_interval_ms)) {
+        take_reading(i, now, readings, &count);
+      }
+    }
+    if (heartbeat && count > 0) {
+      s_stats.heartbeats++;
+    }
+    xSemaphoreGive(s_lock);
+
+    if (count > 0) {
+      esp_err_t err = send_readings(readings, count);
+      if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to send %d readings: %s", count,
+                 esp_err_to_name(err));
+      }
+    }
+  }
+  vTaskDelete(NULL);
+}
+
+static void apply_config(uint8_t channel,
+                         const mesh_report_channel_config_t *config) {
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  for (int i = 0; i < MESH_REPORT_MAX_CHANNELS; i++) {
+    if (channel == MESH_REPORT_ALL_CHANNELS || channel == i) {
+      s_channels[i].config = *config;
+    }
+  }
+  xSemaphoreGive(s_lock);
+}
+
+/**
+ * @brief Apply thresholds pushed by the root; other configuration payloads
+ *        are left to the next handler
+ */
+static bool mesh_report_handle_config(mesh_addr_t *from, uint8_t data_type,
+                                      uint8_t *payload, uint16_t length) {
+  if (mesh_state_is_root() || length != sizeof(mesh_report_config_msg_t) ||
+      payload[0] != MESH_REPORT_CONFIG_MAGIC ||
+      payload[1] != MESH_REPORT_CONFIG_VERSION) {
+    return false;
+  }
+
+  mesh_report_config_msg_t msg;
+  memcpy(&msg, payload, sizeof(msg));
+  if (msg.channel != MESH_REPORT_ALL_CHANNELS &&
+      msg.channel >= MESH_REPORT_MAX_CHANNELS) {
+    return true;
+  }
+  if (!valid_deadband(msg.deadband)) {
+    ESP_LOGW(TAG, "Ignoring thresholds with invalid deadband");
+    return true;
+  }
+
+  mesh_report_channel_config_t config = {
+      .deadband = msg.deadband,
+      .min_interval_ms = msg.min_interval_ms,
+      .max_interval_ms = msg.max_interval_ms,
+  };
+  apply_config(msg.channel, &config);
+  if (msg.heartbeat_ms != MESH_REPORT_KEEP_HEARTBEAT) {
+    mesh_report_set_heartbeat(msg.heartbeat_ms);
+  }
+
+  ESP_LOGI(TAG, "Thresholds updated: channel %u, deadband %.3f", msg.channel,
+           msg.deadband);
+  return true;
+}
+
+/*******************************************************
+ *                Public Functions
+ *******************************************************/
+esp_err_t mesh_report_init(uint8_t data_type) {
+  if (s_initialized) {
+    ESP_LOGW(TAG, "Already initialized");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  s_lock = xSemaphoreCreateMutex();
+  if (s_lock == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  s_data_type = data_type;
+  for (int i = 0; i < MESH_REPORT_MAX_CHANNELS; i++) {
+    s_channels[i].config.deadband = 0;
+    s_channels[i].config.min_interval_ms = MESH_REPORT_DEFAULT_MIN_INTERVAL_MS;
+    s_channels[i].config.max_interval_ms = MESH_REPORT_DEFAULT_MAX_INTERVAL_MS;
+  }
+  s_last_packet_ms = now_ms();
+
+  esp_err_t err = mesh_data_transfer_register_type_handler(
+      MESH_DATA_TYPE_CONFIG, mesh_report_handle_config);
+  if (err != ESP_OK) {
+    return err;
+  }
+
+  BaseType_t ret =
+      xTaskCreate(mesh_report_task, "mesh_report", MESH_REPORT_TASK_STACK_SIZE,
+                  NULL, MESH_REPORT_TASK_PRIORITY, &s_task_handle);
+  if (ret != pdPASS) {
+    ESP_LOGE(TAG, "Failed to create report task");
+    return ESP_FAIL;
+  }
+
+  s_initialized = true;
+  ESP_LOGI(TAG, "Change-of-value reporting started");
+  return ESP_OK;
+}
+
+esp_err_t mesh_report_set_channel(uint8_t channel,
+                                  const mesh_report_channel_config_t *config) {
+  if (config == NULL || !valid_deadband(config->deadband) ||
+      (channel != MESH_REPORT_ALL_CHANNELS &&
+       channel >= MESH_REPORT_MAX_CHANNELS)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (!s_initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  apply_config(channel, config);
+  return ESP_OK;
+}
+
+esp_err_t mesh_report_set_heartbeat(uint32_t heartbeat_ms) {
+  if (!s_initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  s_heartbeat_ms = heartbeat_ms;
+  xSemaphoreGive(s_lock);
+  return ESP_OK;
+}
+
+esp_err_t mesh_report_submit(uint8_t channel, float value) {
+  if (channel >= MESH_REPORT_MAX_CHANNELS) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (!s_initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  mesh_sensor_reading_t reading;
+  int count = 0;
+  uint32_t now = now_ms();
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  mesh_report_channel_t *ch = &s_channels[channel];
+  s_stats.submitted++;
+  if (ch->pending) {
+    s_stats.suppressed++; // the held reading is superseded
+  }
+  ch->value = value;
+  ch->has_value = true;
+  ch->pending = false;
+
+  if (exceeds_deadband(ch)) {
+    if (!can_report()) {
+      ch->pending = true; // sent by the report task once joined
+    } else if (!ch->has_sent ||
+               now - ch->sent_ms >= ch->config.min_interval_ms) {
+      take_reading(channel, now, &reading, &count);
+    } else {
+      ch->pending = true;
+    }
+  } else {
+    s_stats.suppressed++;
+  }
+  xSemaphoreGive(s_lock);
+
+  return (count > 0) ? send_readings(&reading, count) : ESP_OK;
+}
+
+esp_err_t mesh_report_get_stats(mesh_report_stats_t *stats) {
+  if (stats == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (s_lock != NULL) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+  }
+  *stats = s_stats;
+  if (s_lock != NULL) {
+    xSemaphoreGive(s_lock);
+  }
+  return ESP_OK;
+}
+
+esp_err_t mesh_report_push_config(const mesh_addr_t *node, uint8_t channel,
+                                  const mesh_report_channel_config_t *config,
+                                  uint32_t heartbeat_ms) {
+  if (config == NULL || !valid_deadband(config->deadband)) {
+    ESP_LOGE(TAG, "Invalid arguments");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  mesh_report_config_msg_t msg = {
+      .magic = MESH_REPORT_CONFIG_MAGIC,
+      .version = MESH_REPORT_CONFIG_VERSION,
+      .channel = channel,
+      .deadband = config->deadband,
+      .min_interval_ms = config->min_interval_ms,
+      .max_interval_ms = config->max_interval_ms,
+      .heartbeat_ms = heartbeat_ms,
+  };
+
+  if (node == NULL) {
+    return mesh_broadcast_from_root(MESH_DATA_TYPE_CONFIG, (uint8_t *)&msg,
+                                    sizeof(msg));
+  }
+  return mesh_send_to_child(node, MESH_DATA_TYPE_CONFIG, (uint8_t *)&msg,
+                            sizeof(msg));
+}
@@ -0,0 +1,364 @@
+/* ESP-MESH Job Scheduler Implementation */
+
+#include "mesh_scheduler.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+static const char *TAG = "mesh_sched";
+
+#define WHEEL_SLOTS (1 << MESH_SCHED_WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_SPAN ((uint32_t)1 << (MESH_SCHED_WHEEL_BITS * MESH_SCHED_WHEEL_LEVELS))
+#define NIL (0xFFFF)
+#define NO_EVENT (UINT32_MAX)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+typedef struct {
+  mesh_sched_cb_t cb;
+  void *arg;
+  uint32_t expires;      /* tick the job is due */
+  uint32_t period_ticks; /* 0 for one-shot */
+  uint16_t next;         /* list links: wheel slot or free list */
+  uint16_t prev;
+  uint16_t slot;         /* level * WHEEL_SLOTS + index, NIL when free */
+  uint16_t generation;   /* bumped on free to invalidate handles */
+} mesh_sched_entry_t;
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static bool s_initialized = false;
+static SemaphoreHandle_t s_lock = NULL;
+static TaskHandle_t s_task_handle = NULL;
+static mesh_sched_entry_t *s_jobs = NULL;
+static uint16_t s_heads[MESH_SCHED_WHEEL_LEVELS * WHEEL_SLOTS];
+static uint16_t s_free = NIL;
+static uint32_t s_now = 0; /* ticks processed since start */
+static int64_t s_start_us = 0;
+static mesh_scheduler_stats_t s_stats;
+static uint64_t s_lag_sum_ms = 0;
+
+/*******************************************************
+ *                Timer Wheel
+ *******************************************************/
+static inline uint32_t ms_to_ticks(uint32_t ms) {
+  return (ms + MESH_SCHED_TICK_MS - 1) / MESH_SCHED_TICK_MS;
+}
+
+static void wheel_link(uint16_t index) {
+  mesh_sched_entry_t *job = &s_jobs[index];
+  uint32_t delta = job->expires - s_now;
+  int level = 0;
+
+  while (level < MESH_SCHED_WHEEL_LEVELS - 1 &&
+         delta >= ((uint32_t)1 << (MESH_SCHED_WHEEL_BITS * (level + 1)))) {
+    level++;
+  }
+
+  uint16_t slot = level * WHEEL_SLOTS +
+                  ((job->expires >> (MESH_SCHED_WHEEL_BITS * level)) &
+                   WHEEL_MASK);
+  job->slot = slot;
+  job->prev = NIL;
+  job->next = s_heads[slot];
+  if (job->next != NIL) {
+    s_jobs[job->next].prev = index;
+  }
+  s_heads[slot] = index;
+}
+
+static void wheel_unlink(uint16_t index) {
+  mesh_sched_entry_t *job = &s_jobs[index];
+
+  if (job->prev != NIL) {
+    s_jobs[job->prev].next = job->next;
+  } else {
+    s_heads[job->slot] = job->next;
+  }
+  if (job->next != NIL) {
+    s_jobs[job->next].prev = job->prev;
+  }
+}
+
+static void job_free(uint16_t index) {
+  mesh_sched_entry_t *job = &s_jobs[index];
+  job->slot = NIL;
+  job->generation++;
+  job->next = s_free;
+  s_free = index;
+  s_stats.jobs_active--;
+}
+
+/**
+ * @brief Move the jobs of the current slot of a level down the wheel,
+ *        higher levels first
+ */
+static void wheel_cascade(int level) {
+  uint16_t slot = (s_now >> (MESH_SCHED_WHEEL_BITS * level)) & WHEEL_MASK;
+  if (slot == 0 && level + 1 < MESH_SCHED_WHEEL_LEVELS) {
+    wheel_cascade(level + 1);
+  }
+
+  uint16_t index = s_heads[level * WHEEL_SLOTS + slot];
+  s_heads[level * WHEEL_SLOTS + slot] = NIL;
+  while (index != NIL) {
+    uint16_t next = s_jobs[index].next;
+    wheel_link(index);
+    index = next;
+  }
+}
+
+/**
+ * @brief Next tick at which the wheel has work: a level-0 slot with jobs,
+ *        or the cascade of a higher-level slot with jobs
+ *
+ * Must be called with s_lock held.
+ *
+ * @return Absolute tick, NO_EVENT if no job is scheduled
+ */
+static uint32_t next_event_tick(void) {
+  uint32_t next = NO_EVENT;
+
+  if (s_stats.jobs_active == 0) {
+    return NO_EVENT;
+  }
+  for (int level = 0; level < MESH_SCHED_WHEEL_LEVELS; level++) {
+    int shift = MESH_SCHED_WHEEL_BITS * level;
+    for (uint32_t i = 1; i <= WHEEL_SLOTS; i++) {
+      uint32_t tick = ((s_now >> shift) + i) << shift;
+      if (s_heads[level * WHEEL_SLOTS + ((tick >> shift) & WHEEL_MASK)] !=
+          NIL) {
+        if (next == NO_EVENT || (int32_t)(tick - next) < 0) {
+          next = tick;
+        }
+        break;
+      }
+    }
+  }
+  return next;
+}
+
+/**
+ * @brief Advance one tick and run the jobs that became due
+ */
+static void scheduler_tick(void) {
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  s_now++;
+  if ((s_now & WHEEL_MASK) == 0) {
+    wheel_cascade(1);
+  }
+
+  uint16_t slot = s_now & WHEEL_MASK;
+  while (s_heads[slot] != NIL) {
+    uint16_t index = s_heads[slot];
+    mesh_sched_entry_t *job = &s_jobs[index];
+    mesh_sched_cb_t cb = job->cb;
+    void *arg = job->arg;
+    int64_t due_us = s_start_us +
+                     (int64_t)job->expires * MESH_SCHED_TICK_MS * 1000;
+
+    wheel_unlink(index);
+    if (job->period_ticks > 0) {
+      job->expires += job->period_ticks;
+      wheel_link(index);
+    } else {
+      job_free(index);
+    }
+
+    // Run without the lock so callbacks can add and cancel jobs
+    xSemaphoreGive(s_lock);
+    int64_t start_us = esp_timer_get_time();
+    cb(arg);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+
+    uint32_t lag_ms = (start_us > due_us) ? (start_us - due_us) / 1000 : 0;
+    if (lag_ms > s_stats.lag_max_ms) {
+      s_stats.lag_max_ms = lag_ms;
+    }
+    s_lag_sum_ms += lag_ms;
+    s_stats.runs++;
+  }
+  xSemaphoreGive(s_lock);
+}
+
+/**
+ * @brief Process every tick up to target, skipping ticks without work
+ *
+ * @return Time until the next tick with work, portMAX_DELAY if none
+ */
+static TickType_t scheduler_advance(uint32_t target) {
+  while (1) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t next = next_event_tick();
+    if (next == NO_EVENT || (int32_t)(next - target) > 0) {
+      if ((int32_t)(target - s_now) > 0) {
+        s_now = target;
+      }
+      xSemaphoreGive(s_lock);
+      if (next == NO_EVENT) {
+        return portMAX_DELAY;
+      }
+      int64_t due_us = s_start_us + (int64_t)next * MESH_SCHED_TICK_MS * 1000;
+      int64_t wait_ms = (due_us - esp_timer_get_time() + 999) / 1000;
+      return (wait_ms > 0) ? pdMS_TO_TICKS(wait_ms) + 1 : 1;
+    }
+    s_now = next - 1;
+    xSemaphoreGive(s_lock);
+    scheduler_tick();
+  }
+}
+
+static void mesh_scheduler_task(void *arg) {
+  TickType_t wait = portMAX_DELAY;
+
+  while (1) {
+    // Sleep until the next job is due or mesh_scheduler_add() wakes us
+    ulTaskNotifyTake(pdTRUE, wait);
+
+    // Catch up on every tick that elapsed, e.g. behind a slow callback
+    uint32_t target = (esp_timer_get_time() - s_start_us) /
+                      (MESH_SCHED_TICK_MS * 1000);
+    wait = scheduler_advance(target);
+  }
+  vTaskDelete(NULL);
+}
+
+/*******************************************************
+ *                Public Functions
+ *******************************************************/
+esp_err_t mesh_scheduler_init(uint16_t max_jobs) {
+  if (max_jobs == 0 || max_jobs > MESH_SCHED_MAX_JOBS) {
+    ESP_LOGE(TAG, "Invalid arguments");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (s_initialized) {
+    ESP_LOGW(TAG, "Already initialized");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  s_lock = xSemaphoreCreateMutex();
+  s_jobs = calloc(max_jobs, sizeof(mesh_sched_entry_t));
+  if (s_lock == NULL || s_jobs == NULL) {
+    ESP_LOGE(TAG, "Failed to allocate %u jobs", max_jobs);
+    return ESP_ERR_NO_MEM;
+  }
+
+  for (int i = 0; i < MESH_SCHED_WHEEL_LEVELS * WHEEL_SLOTS; i++) {
+    s_heads[i] = NIL;
+  }
+  for (int i = max_jobs - 1; i >= 0; i--) {
+    s_jobs[i].slot = NIL;
+    s_jobs[i].next = s_free;
+    s_free = i;
+  }
+  s_stats.jobs_max = max_jobs;
+  s_start_us = esp_timer_get_time();
+
+  BaseType_t ret =
+      xTaskCreate(mesh_scheduler_task, "mesh_sched", MESH_SCHED_TASK_STACK_SIZE,
+                  NULL, MESH_SCHED_TASK_PRIORITY, &s_task_handle);
+  if (ret != pdPASS) {
+    ESP_LOGE(TAG, "Failed to create scheduler task");
+    return ESP_FAIL;
+  }
+
+  s_initialized = true;
+  ESP_LOGI(TAG, "Scheduler started with %u job slots", max_jobs);
+  return ESP_OK;
+}
+
+esp_err_t mesh_scheduler_add(uint32_t delay_ms, uint32_t period_ms,
+                             uint32_t jitter_ms, mesh_sched_cb_t cb, void *arg,
+                             mesh_sched_job_t *job) {
+  if (cb == NULL) {
+    ESP_LOGE(TAG, "Invalid arguments");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (!s_initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  uint32_t jitter = (jitter_ms > 0) ? esp_random() % (jitter_ms + 1) : 0;
+  uint32_t first = ms_to_ticks(delay_ms + jitter);
+  uint32_t period = ms_to_ticks(period_ms);
+  if (first >= WHEEL_SPAN) {
+    first = WHEEL_SPAN - 1;
+  }
+  if (period >= WHEEL_SPAN) {
+    period = WHEEL_SPAN - 1;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  uint16_t index = s_free;
+  if (index == NIL) {
+    xSemaphoreGive(s_lock);
+    ESP_LOGW(TAG, "Job pool exhausted");
+    return ESP_ERR_NO_MEM;
+  }
+  s_free = s_jobs[index].next;
+
+  mesh_sched_entry_t *entry = &s_jobs[index];
+  entry->cb = cb;
+  entry->arg = arg;
+  entry->period_ticks = period;
+  entry->expires = s_now + (first > 0 ? first : 1);
+  wheel_link(index);
+  s_stats.jobs_active++;
+  if (job != NULL) {
+    *job = ((uint32_t)entry->generation << 16) | (index + 1);
+  }
+  xSemaphoreGive(s_lock);
+
+  // The task may be asleep until a later job
+  xTaskNotifyGive(s_task_handle);
+  return ESP_OK;
+}
+
+esp_err_t mesh_scheduler_cancel(mesh_sched_job_t job) {
+  uint16_t index = (job & 0xFFFF) - 1;
+
+  if (!s_initialized || job == MESH_SCHED_INVALID_JOB ||
+      index >= s_stats.jobs_max) {
+    return ESP_ERR_NOT_FOUND;
+  }
+
+  esp_err_t err = ESP_ERR_NOT_FOUND;
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  mesh_sched_entry_t *entry = &s_jobs[index];
+  if (entry->slot != NIL && entry->generation == (job >> 16)) {
+    wheel_unlink(index);
+    job_free(index);
+    err = ESP_OK;
+  }
+  xSemaphoreGive(s_lock);
+  return err;
+}
+
+esp_err_t mesh_scheduler_get_stats(mesh_scheduler_stats_t *stats) {
+  if (stats == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (s_lock != NULL) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+  }
+  *stats = s_stats;
+  stats->lag_avg_ms = (s_stats.runs > 0) ? s_lag_sum_ms / s_stats.runs : 0;
+  if (s_lock != NULL) {
+    xSemaphoreGive(s_lock);
+  }
+  return ESP_OK;
+}
@@ -0,0 +1,577 @@
+/* ESP-MESH Hot-Standby Root Implementation */
+
+#include "mesh_standby.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_mesh.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "mesh_data_transfer.h"
+#include "mesh_internal.h"
+#include "mesh_standby_engine.h"
+#include <stddef.h>
+#include <string.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+static const char *TAG = "mesh_standby";
+
+/*******************************************************
+ *                Wire Format
+ *******************************************************/
+typedef enum {
+  MESH_STANDBY_OP_HELLO = 1,     /**< standby -> root: announce, versions */
+  MESH_STANDBY_OP_HEARTBEAT = 2, /**< root -> standby */
+  MESH_STANDBY_OP_REGISTRY = 3,  /**< root -> standby: registry copy */
+  MESH_STANDBY_OP_STATE = 4,     /**< root -> standby: state copy */
+} mesh_standby_op_t;
+
+typedef struct {
+  uint8_t op;
+  uint16_t registry_version;
+  uint16_t state_version;
+} __attribute__((packed)) mesh_standby_msg_hello_t;
+
+typedef struct {
+  uint8_t op;
+  uint16_t seq;
+  uint16_t registry_version;
+  uint16_t state_version;
+  uint8_t router_bssid[6]; /* zero while the root has no router */
+  uint8_t router_channel;
+  uint8_t router_authmode;
+} __attribute__((packed)) mesh_standby_msg_heartbeat_t;
+
+/* Registry entry without last_seen, which is local to each node's clock */
+typedef struct {
+  uint8_t node_id;
+  uint8_t mac[6];
+  uint8_t node_type;
+  char name[16];
+  uint8_t is_active;
+  mesh_node_caps_t caps;
+} __attribute__((packed)) mesh_standby_node_t;
+
+typedef struct {
+  uint8_t op;
+  uint16_t version;
+  uint8_t count;
+  mesh_standby_node_t nodes[MESH_MAX_REGISTERED_NODES];
+} __attribute__((packed)) mesh_standby_msg_registry_t;
+
+typedef struct {
+  uint8_t op;
+  uint16_t version;
+  uint16_t length;
+  uint8_t data[MESH_STANDBY_MAX_STATE];
+} __attribute__((packed)) mesh_standby_msg_state_t;
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static bool s_initialized = false;
+static mesh_standby_config_t s_config;
+static SemaphoreHandle_t s_lock = NULL;
+static mesh_standby_stats_t s_stats;
+
+/* Application state, guarded by s_lock */
+static uint8_t s_state[MESH_STANDBY_MAX_STATE];
+static uint16_t s_state_length = 0;
+static uint16_t s_state_version = 0;
+
+/* Root side, guarded by s_lock */
+static bool s_serving = false;
+static mesh_addr_t s_standby;
+static uint32_t s_standby_seen_ms = 0;
+static uint16_t s_heartbeat_seq = 0;
+static uint32_t s_last_heartbeat_sent_ms = 0;
+
+/* Standby side, guarded by s_lock */
+static bool s_have_root = false;
+static uint8_t s_root_mac[6];
+static uint32_t s_last_heartbeat_ms = 0;
+static bool s_router_valid = false;
+static mesh_parent_target_t s_router;
+static uint32_t s_last_hello_ms = 0;
+static uint16_t s_last_seq = 0;
+static bool s_force_registry = false; /* root changed or restarted */
+static bool s_force_state = false;
+
+/* Standby side, used by the standby task only */
+static mesh_standby_watch_t s_watch;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static uint32_t now_ms(void) {
+  return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static void send_to_standby(const mesh_addr_t *to, const void *msg,
+                            uint16_t length) {
+  esp_err_t err =
+      mesh_data_send_packet(to, MESH_DATA_FROMDS | MESH_DATA_NONBLOCK,
+                            MESH_DATA_TYPE_STANDBY, msg, length, NULL, 0);
+  if (err != ESP_OK) {
+    ESP_LOGD(TAG, "Send to " MACSTR " failed: %s", MAC2STR(to->addr),
+             esp_err_to_name(err));
+  }
+}
+
+/**
+ * @param piggyback Let the hello wait for a data frame to the root
+ */
+static void send_hello(uint32_t now, bool piggyback) {
+  mesh_standby_msg_hello_t hello = {.op = MESH_STANDBY_OP_HELLO};
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  // A version the root cannot have forces a copy
+  hello.registry_version = mesh_registry_version();
+  if (s_force_registry) {
+    hello.registry_version ^= 0xFFFF;
+  }
+  hello.state_version = s_state_version;
+  if (s_force_state) {
+    hello.state_version ^= 0xFFFF;
+  }
+  s_last_hello_ms = now;
+  xSemaphoreGive(s_lock);
+
+  if (piggyback &&
+      mesh_data_piggyback(NULL, MESH_DATA_TYPE_STANDBY, &hello, sizeof(hello),
+                          s_config.heartbeat_ms) == ESP_OK) {
+    return;
+  }
+  mesh_data_send_packet(NULL, MESH_DATA_TODS | MESH_DATA_NONBLOCK,
+                        MESH_DATA_TYPE_STANDBY, (uint8_t *)&hello,
+                        sizeof(hello), NULL, 0);
+}
+
+/**
+ * @brief Root: send the standby whatever its versions show it is missing
+ */
+static void sync_standby(const mesh_addr_t *to,
+                         const mesh_standby_msg_hello_t *hello) {
+  if (hello->registry_version != mesh_registry_version()) {
+    static mesh_registered_node_t nodes[MESH_MAX_REGISTERED_NODES];
+    static mesh_standby_msg_registry_t msg;
+    uint16_t version = mesh_registry_version();
+    int count = mesh_registry_export(nodes, MESH_MAX_REGISTERED_NODES);
+
+    msg.op = MESH_STANDBY_OP_REGISTRY;
+    msg.version = version;
+    msg.count = (uint8_t)count;
+    for (int i = 0; i < count; i++) {
+      msg.nodes[i].node_id = nodes[i].node_id;
+      memcpy(msg.nodes[i].mac, nodes[i].mac_addr.addr, 6);
+      msg.nodes[i].node_type = nodes[i].node_type;
+      memcpy(msg.nodes[i].name, nodes[i].name, sizeof(msg.nodes[i].name));
+      msg.nodes[i].is_active = nodes[i].is_active;
+      msg.nodes[i].caps = nodes[i].caps;
+    }
+    send_to_standby(to, &msg,
+                    offsetof(mesh_standby_msg_registry_t, nodes) +
+                        count * sizeof(mesh_standby_node_t));
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_stats.syncs_sent++;
+    xSemaphoreGive(s_lock);
+  }
+
+  static mesh_standby_msg_state_t state;
+  bool send_state = false;
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  if (hello->state_version != s_state_version) {
+    state.op = MESH_STANDBY_OP_STATE;
+    state.version = s_state_version;
+    state.length = s_state_length;
+    memcpy(state.data, s_state, s_state_length);
+    s_stats.syncs_sent++;
+    send_state = true;
+  }
+  xSemaphoreGive(s_lock);
+  if (send_state) {
+    send_to_standby(to, &state,
+                    offsetof(mesh_standby_msg_state_t, data) + state.length);
+  }
+}
+
+static void mesh_standby_serve(uint32_t now) {
+  mesh_standby_msg_heartbeat_t msg = {.op = MESH_STANDBY_OP_HEARTBEAT};
+  mesh_parent_target_t router;
+  mesh_addr_t to;
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  if (s_serving && now - s_standby_seen_ms >=
+                       MESH_STANDBY_SERVE_HELLOS *
+                           MESH_STANDBY_HELLO_HEARTBEATS *
+                           s_config.heartbeat_ms) {
+    ESP_LOGW(TAG, "Standby " MACSTR " went silent", MAC2STR(s_standby.addr));
+    s_serving = false;
+  }
+  if (!s_serving || now - s_last_heartbeat_sent_ms < s_config.heartbeat_ms) {
+    xSemaphoreGive(s_lock);
+    return;
+  }
+  to = s_standby;
+  msg.seq = ++s_heartbeat_seq;
+  msg.registry_version = mesh_registry_version();
+  msg.state_version = s_state_version;
+  s_last_heartbeat_sent_ms = now;
+  s_stats.heartbeats_sent++;
+  xSemaphoreGive(s_lock);
+
+  if (mesh_get_parent_target(&router)) {
+    memcpy(msg.router_bssid, router.bssid, 6);
+    msg.router_channel = router.channel;
+    msg.router_authmode = router.authmode;
+  }
+  send_to_standby(&to, &msg, sizeof(msg));
+}
+
+static void mesh_standby_watch(const mesh_state_t *state, uint32_t now) {
+  mesh_parent_target_t router;
+  bool have_root;
+  bool router_valid;
+  uint32_t last_heartbeat;
+  uint32_t last_hello;
+  uint8_t root_mac[6];
+  uint8_t root_bssid[6];
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  have_root = s_have_root;
+  router_valid = s_router_valid;
+  router = s_router;
+  last_heartbeat = s_last_heartbeat_ms;
+  last_hello = s_last_hello_ms;
+  memcpy(root_mac, s_root_mac, 6);
+  xSemaphoreGive(s_lock);
+  memcpy(root_bssid, root_mac, 6);
+  root_bssid[5] += 1; // softAP BSSID is one above the station MAC
+
+  if (state->connected) {
+    if (mesh_standby_watch_connected(
+            &s_watch,
+            have_root && memcmp(state->parent.addr, root_bssid, 6) == 0)) {
+      xSemaphoreTake(s_lock, portMAX_DELAY);
+      s_stats.takeovers_failed++;
+      xSemaphoreGive(s_lock);
+    }
+
+    // Announce quickly until heartbeats flow, then now and then
+    bool hearing = have_root &&
+                   now - last_heartbeat < 2 * s_config.heartbeat_ms;
+    uint32_t interval = (hearing ? MESH_STANDBY_HELLO_HEARTBEATS : 2) *
+                        s_config.heartbeat_ms;
+    if (now - last_hello >= interval) {
+      send_hello(now, hearing);
+    }
+    return;
+  }
+
+  if (!mesh_standby_watch_due(&s_watch, router_valid, last_heartbeat, now)) {
+    return;
+  }
+
+  esp_err_t err = mesh_request_takeover(&router);
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "Takeover request failed: %s", esp_err_to_name(err));
+    return;
+  }
+  ESP_LOGW(TAG, "Root " MACSTR " lost, taking over via " MACSTR,
+           MAC2STR(root_mac), MAC2STR(router.bssid));
+  bool failed = mesh_standby_watch_started(&s_watch, now);
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  if (failed) {
+    s_stats.takeovers_failed++;
+  }
+  s_stats.takeovers++;
+  s_stats.last_detect_ms = now - last_heartbeat;
+  xSemaphoreGive(s_lock);
+}
+
+static void mesh_standby_task(void *arg) {
+  mesh_state_t state;
+
+  while (1) {
+    vTaskDelay(pdMS_TO_TICKS(MESH_STANDBY_TICK_MS));
+    mesh_state_get(&state);
+    if (!state.started) {
+      continue;
+    }
+
+    uint32_t now = now_ms();
+    if (state.is_root) {
+      if (state.connected && mesh_standby_watch_root(&s_watch)) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        uint32_t blackout = now - s_last_heartbeat_ms;
+        s_stats.last_blackout_ms = blackout;
+        s_have_root = false;
+        xSemaphoreGive(s_lock);
+        ESP_LOGI(TAG, "Took over as root, %" PRIu32 " ms without a root",
+                 blackout);
+        if (s_config.on_takeover != NULL) {
+          s_config.on_takeover();
+        }
+      }
+      mesh_standby_serve(now);
+    } else if (s_config.designated) {
+      mesh_standby_watch(&state, now);
+    }
+  }
+}
+
+static void handle_hello(mesh_addr_t *from,
+                         const mesh_standby_msg_hello_t *hello) {
+  uint32_t now = now_ms();
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  bool silent = now - s_standby_seen_ms >= MESH_STANDBY_SERVE_HELLOS *
+                                               MESH_STANDBY_HELLO_HEARTBEATS *
+                                               s_config.heartbeat_ms;
+  bool same = s_serving && memcmp(from->addr, s_standby.addr, 6) == 0;
+  if (!same && s_serving && !silent) {
+    xSemaphoreGive(s_lock);
+    ESP_LOGW(TAG, "Ignoring second standby " MACSTR, MAC2STR(from->addr));
+    return;
+  }
+  if (!same) {
+    ESP_LOGI(TAG, "Serving standby " MACSTR, MAC2STR(from->addr));
+    s_last_heartbeat_sent_ms = now - s_config.heartbeat_ms;
+  }
+  s_serving = true;
+  s_standby = *from;
+  s_standby_seen_ms = now;
+  xSemaphoreGive(s_lock);
+
+  sync_standby(from, hello);
+}
+
+static void handle_heartbeat(mesh_addr_t *from,
+                             const mesh_standby_msg_heartbeat_t *msg) {
+  static const uint8_t zero[6] = {0};
+  bool behind;
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  // Versions restart with the root, so equal ones prove nothing then
+  if (!s_have_root || memcmp(s_root_mac, from->addr, 6) != 0 ||
+      (int16_t)(msg->seq - s_last_seq) <= 0) {
+    s_have_root = true;
+    memcpy(s_root_mac, from->addr, 6);
+    s_router_valid = false;
+    s_force_registry = true;
+    s_force_state = true;
+  }
+  s_last_seq = msg->seq;
+  s_last_heartbeat_ms = now_ms();
+  if (memcmp(msg->router_bssid, zero, 6) != 0) {
+    memset(&s_router, 0, sizeof(s_router));
+    memcpy(s_router.bssid, msg->router_bssid, 6);
+    s_router.channel = msg->router_channel;
+    s_router.authmode = msg->router_authmode;
+    s_router_valid = true;
+  }
+  behind = s_force_registry || s_force_state ||
+           msg->registry_version != mesh_registry_version() ||
+           msg->state_version != s_state_version;
+  s_stats.heartbeats_received++;
+  s_stats.mirrored = !behind;
+  xSemaphoreGive(s_lock);
+
+  if (behind) {
+    send_hello(now_ms(), false);
+  }
+}
+
+static void handle_registry(const uint8_t *payload, uint16_t length) {
+  static mesh_registered_node_t nodes[MESH_MAX_REGISTERED_NODES];
+  static mesh_standby_msg_registry_t msg;
+  uint32_t now = esp_log_timestamp();
+
+  memcpy(&msg, payload, length);
+  memset(nodes, 0, sizeof(nodes));
+  for (int i = 0; i < msg.count; i++) {
+    nodes[i].node_id = msg.nodes[i].node_id;
+    memcpy(nodes[i].mac_addr.addr, msg.nodes[i].mac, 6);
+    nodes[i].node_type = msg.nodes[i].node_type;
+    memcpy(nodes[i].name, msg.nodes[i].name, sizeof(nodes[i].name));
+    nodes[i].name[sizeof(nodes[i].name) - 1] = '\0';
+    nodes[i].is_active = msg.nodes[i].is_active;
+    nodes[i].caps = msg.nodes[i].caps;
+    nodes[i].last_seen = now;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  mesh_registry_import(nodes, msg.count, msg.version);
+  s_force_registry = false;
+  s_stats.syncs_applied++;
+  xSemaphoreGive(s_lock);
+}
+
+static void handle_state(const uint8_t *payload) {
+  mesh_standby_msg_state_t *msg = (mesh_standby_msg_state_t *)payload;
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  memcpy(s_state, msg->data, msg->length);
+  s_state_length = msg->length;
+  s_state_version = msg->version;
+  s_force_state = false;
+  s_stats.syncs_applied++;
+  xSemaphoreGive(s_lock);
+}
+
+static bool mesh_standby_handle_packet(mesh_addr_t *from, uint8_t data_type,
+                                       uint8_t *payload, uint16_t length) {
+  bool is_root = mesh_state_is_root();
+
+  if (length == 0) {
+    return true;
+  }
+
+  switch (payload[0]) {
+  case MESH_STANDBY_OP_HELLO:
+    if (is_root && length == sizeof(mesh_standby_msg_hello_t)) {
+      mesh_standby_msg_hello_t hello;
+      memcpy(&hello, payload, sizeof(hello));
+      handle_hello(from, &hello);
+    }
+    break;
+  case MESH_STANDBY_OP_HEARTBEAT:
+    if (!is_root && s_config.designated &&
+        length == sizeof(mesh_standby_msg_heartbeat_t)) {
+      mesh_standby_msg_heartbeat_t msg;
+      memcpy(&msg, payload, sizeof(msg));
+      handle_heartbeat(from, &msg);
+    }
+    break;
+  case MESH_STANDBY_OP_REGISTRY:
+    if (!is_root && s_config.designated &&
+        length >= offsetof(mesh_standby_msg_registry_t, nodes) &&
+        payload[3] <= MESH_MAX_REGISTERED_NODES &&
+        length == offsetof(mesh_standby_msg_registry_t, nodes) +
+                      payload[3] * sizeof(mesh_standby_node_t)) {
+      handle_registry(payload, length);
+    }
+    break;
+  case MESH_STANDBY_OP_STATE:
+    if (!is_root && s_config.designated &&
+        length >= offsetof(mesh_standby_msg_state_t, data)) {
+      uint16_t state_length;
+      memcpy(&state_length, payload + 3, sizeof(state_length));
+      if (state_length <= MESH_STANDBY_MAX_STATE &&
+          length == offsetof(mesh_standby_msg_state_t, data) + state_length) {
+        handle_state(payload);
+      }
+    }
+    break;
+  default:
+    break;
+  }
+  return true;
+}
+
+/*******************************************************
+ *                Public Functions
+ *******************************************************/
+esp_err_t mesh_standby_init(const mesh_standby_config_t *config) {
+  if (s_initialized) {
+    ESP_LOGW(TAG, "Already initialized");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  memset(&s_config, 0, sizeof(s_config));
+  if (config != NULL) {
+    s_config = *config;
+  }
+  if (s_config.heartbeat_ms == 0) {
+    s_config.heartbeat_ms = MESH_STANDBY_DEFAULT_HEARTBEAT_MS;
+  }
+  if (s_config.loss_timeout_ms == 0) {
+    s_config.loss_timeout_ms = MESH_STANDBY_DEFAULT_LOSS_TIMEOUT_MS;
+  }
+  if (s_config.loss_timeout_ms <= s_config.heartbeat_ms) {
+    ESP_LOGE(TAG, "Loss timeout must exceed the heartbeat interval");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  mesh_standby_watch_init(&s_watch, s_config.loss_timeout_ms);
+  s_lock = xSemaphoreCreateMutex();
+  if (s_lock == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  esp_err_t err = mesh_data_transfer_register_type_handler(
+      MESH_DATA_TYPE_STANDBY, mesh_standby_handle_packet);
+  if (err != ESP_OK) {
+    return err;
+  }
+
+  if (xTaskCreate(mesh_standby_task, "mesh_standby",
+                  MESH_STANDBY_TASK_STACK_SIZE, NULL,
+                  MESH_STANDBY_TASK_PRIORITY, NULL) != pdPASS) {
+    ESP_LOGE(TAG, "Failed to create standby task");
+    return ESP_ERR_NO_MEM;
+  }
+
+  s_initialized = true;
+  if (s_config.designated) {
+    ESP_LOGI(TAG, "Standby root, takeover after %" PRIu32 " ms of silence",
+             s_config.loss_timeout_ms);
+  }
+  return ESP_OK;
+}
+
+esp_err_t mesh_standby_set_state(const void *data, uint16_t length) {
+  if (data == NULL || length > MESH_STANDBY_MAX_STATE) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (s_lock == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  memcpy(s_state, data, length);
+  s_state_length = length;
+  s_state_version++;
+  xSemaphoreGive(s_lock);
+  return ESP_OK;
+}
+
+esp_err_t mesh_standby_get_state(void *data, uint16_t *length) {
+  esp_err_t err = ESP_OK;
+
+  if (data == NULL || length == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (s_lock == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  if (*length < s_state_length) {
+    err = ESP_ERR_INVALID_SIZE;
+  } else {
+    memcpy(data, s_state, s_state_length);
+  }
+  *length = s_state_length;
+  xSemaphoreGive(s_lock);
+  return err;
+}
+
+esp_err_t mesh_standby_get_stats(mesh_standby_stats_t *stats) {
+  if (stats == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (s_lock == NULL) {
+    memset(stats, 0, sizeof(*stats));
+    return ESP_OK;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  *stats = s_stats;
+  xSemaphoreGive(s_lock);
+  return ESP_OK;
+}
@@ -0,0 +1,50 @@
+/* Standby Takeover Engine Implementation */
+
+#include "mesh_standby_engine.h"
+#include <string.h>
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+void mesh_standby_watch_init(mesh_standby_watch_t *watch,
+                             uint32_t loss_timeout_ms) {
+  memset(watch, 0, sizeof(*watch));
+  watch->loss_timeout_ms = loss_timeout_ms;
+}
+
+bool mesh_standby_watch_connected(mesh_standby_watch_t *watch,
+                                  bool parent_is_root) {
+  // The router did not take us and another root was found instead
+  bool failed = watch->taking_over;
+
+  watch->taking_over = false;
+  watch->parent_was_root = parent_is_root;
+  return failed;
+}
+
+bool mesh_standby_watch_due(const mesh_standby_watch_t *watch,
+                            bool router_valid, uint32_t last_heartbeat_ms,
+                            uint32_t now_ms) {
+  if (!watch->parent_was_root || !router_valid ||
+      now_ms - last_heartbeat_ms < watch->loss_timeout_ms) {
+    return false;
+  }
+  return !watch->taking_over ||
+         now_ms - watch->takeover_ms >= watch->loss_timeout_ms;
+}
+
+bool mesh_standby_watch_started(mesh_standby_watch_t *watch,
+                                uint32_t now_ms) {
+  bool failed = watch->taking_over;
+
+  watch->taking_over = true;
+  watch->takeover_ms = now_ms;
+  return failed;
+}
+
+bool mesh_standby_watch_root(mesh_standby_watch_t *watch) {
+  bool completed = watch->taking_over;
+
+  watch->taking_over = false;
+  return completed;
+}
@@ -0,0 +1,55 @@
+/* ESP-MESH State Snapshot Implementation */
+
+#include "mesh_state.h"
+#include "freertos/FreeRTOS.h"
+#include "mesh_internal.h"
+#include <string.h>
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+
+/* Single writer (the mesh event handler), any number of readers. The copy
+ * in and out is a few dozen bytes, so readers spin for at most that long
+ * and never sleep, which keeps them usable from esp_timer callbacks */
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_generation = 0;
+static mesh_state_t s_state = {.layer = -1};
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+void mesh_state_publish(const mesh_state_t *state) {
+  taskENTER_CRITICAL(&s_mux);
+  memcpy(&s_state, state, sizeof(s_state));
+  s_state.generation = s_generation + 1;
+  __atomic_store_n(&s_generation, s_state.generation, __ATOMIC_RELEASE);
+  taskEXIT_CRITICAL(&s_mux);
+}
+
+esp_err_t mesh_state_get(mesh_state_t *state) {
+  if (state == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  taskENTER_CRITICAL(&s_mux);
+  memcpy(state, &s_state, sizeof(*state));
+  taskEXIT_CRITICAL(&s_mux);
+  return ESP_OK;
+}
+
+bool mesh_state_is_root(void) {
+  mesh_state_t state;
+  mesh_state_get(&state);
+  return state.is_root;
+}
+
+bool mesh_state_is_started(void) {
+  mesh_state_t state;
+  mesh_state_get(&state);
+  return state.started;
+}
+
+uint32_t mesh_state_generation(void) {
+  return __atomic_load_n(&s_generation, __ATOMIC_ACQUIRE);
+}
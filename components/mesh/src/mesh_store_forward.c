@@ -0,0 +1,296 @@
+/* ESP-MESH Store-and-Forward Buffering Implementation */
+
+#include "mesh_store_forward.h"
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_mesh.h"
+#include "esp_partition.h"
+#include "esp_random.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "mesh_data_transfer.h"
+#include "mesh_internal.h"
+#include "mesh_store_forward_engine.h"
+#include <string.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+static const char *TAG = "mesh_sf";
+
+#define MESH_SF_MAX_BURST_BYTES (MESH_MPS - sizeof(mesh_data_header_t))
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static bool s_initialized = false;
+static mesh_store_forward_config_t s_config;
+static SemaphoreHandle_t s_lock = NULL;
+static TaskHandle_t s_task_handle = NULL;
+static volatile bool s_connected = false;
+static volatile bool s_reconnected = false;
+static mesh_sf_engine_t s_engine;
+static const esp_partition_t *s_partition = NULL;
+
+/*******************************************************
+ *                Flash Backend
+ *******************************************************/
+static esp_err_t partition_read(void *ctx, uint32_t offset, void *data,
+                                uint32_t size) {
+  return esp_partition_read((const esp_partition_t *)ctx, offset, data, size);
+}
+
+static esp_err_t partition_write(void *ctx, uint32_t offset, const void *data,
+                                 uint32_t size) {
+  return esp_partition_write((const esp_partition_t *)ctx, offset, data, size);
+}
+
+static esp_err_t partition_erase(void *ctx, uint32_t offset, uint32_t size) {
+  return esp_partition_erase_range((const esp_partition_t *)ctx, offset, size);
+}
+
+/*******************************************************
+ *                Queue
+ *******************************************************/
+bool mesh_store_forward_is_holding(void) {
+  return s_initialized &&
+         (!s_connected || mesh_sf_engine_pending(&s_engine) > 0);
+}
+
+esp_err_t mesh_store_forward_enqueue(uint8_t data_type, const uint8_t *payload,
+                                     uint16_t length) {
+  if (!s_initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  esp_err_t err = mesh_sf_engine_enqueue(&s_engine, data_type, payload, length);
+  xSemaphoreGive(s_lock);
+
+  if (err == ESP_OK && s_connected) {
+    xTaskNotifyGive(s_task_handle);
+  }
+  return err;
+}
+
+/**
+ * @brief Bytes a burst of several records may use
+ *
+ * Zero, one record per burst, unless the root announced that it splits
+ * batches. Never more than the root receives.
+ */
+static size_t burst_limit(const mesh_node_caps_t *root) {
+  if (!(root->features & MESH_NODE_FEATURE_BATCH) ||
+      root->rx_buffer <= sizeof(mesh_data_header_t)) {
+    return 0;
+  }
+  size_t limit = root->rx_buffer - sizeof(mesh_data_header_t);
+  return (limit < s_config.burst_bytes) ? limit : s_config.burst_bytes;
+}
+
+/**
+ * @brief Coalesce the oldest queued records into one burst and send it
+ *
+ * A burst of one record is sent as a plain packet. One the root cannot
+ * receive is dropped rather than retried forever.
+ *
+ * @return ESP_OK if a burst was sent or nothing was pending
+ */
+static esp_err_t mesh_sf_replay_burst(uint8_t *burst) {
+  mesh_node_caps_t root;
+  mesh_sf_burst_t taken;
+
+  mesh_peer_caps(NULL, &root);
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  uint32_t count =
+      mesh_sf_engine_take_burst(&s_engine, burst, burst_limit(&root), &taken);
+  xSemaphoreGive(s_lock);
+
+  if (count == 0) {
+    return ESP_OK;
+  }
+
+  esp_err_t err;
+  if (count == 1) {
+    const mesh_batch_record_header_t *hdr =
+        (const mesh_batch_record_header_t *)burst;
+    if (sizeof(mesh_data_header_t) + hdr->length > root.rx_buffer) {
+      err = ESP_ERR_INVALID_SIZE;
+    } else {
+      err = mesh_data_send_packet(NULL, MESH_DATA_TODS, hdr->type,
+                                  burst + sizeof(*hdr), hdr->length, NULL, 0);
+    }
+  } else {
+    err = mesh_data_send_packet(NULL, MESH_DATA_TODS, MESH_DATA_TYPE_BATCH,
+                                burst, taken.length, NULL, 0);
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  mesh_sf_engine_finish(&s_engine, &taken, err);
+  xSemaphoreGive(s_lock);
+
+  if (err == ESP_ERR_INVALID_SIZE) {
+    ESP_LOGW(TAG, "Dropped %u byte packet the root cannot receive",
+             (unsigned)(taken.length - sizeof(mesh_batch_record_header_t)));
+    return ESP_OK;
+  }
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "Replay burst failed: %s", esp_err_to_name(err));
+  } else {
+    ESP_LOGD(TAG, "Replayed %" PRIu32 " packets in %u bytes", count,
+             (unsigned)taken.length);
+  }
+  return err;
+}
+
+static void mesh_sf_task(void *arg) {
+  uint8_t *burst = malloc(s_config.burst_bytes);
+  if (burst == NULL) {
+    ESP_LOGE(TAG, "Failed to allocate burst buffer");
+    vTaskDelete(NULL);
+    return;
+  }
+
+  while (1) {
+    if (!s_connected || mesh_sf_engine_pending(&s_engine) == 0) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      continue;
+    }
+
+    // Spread the replay of a whole floor reconnecting at once
+    if (s_reconnected) {
+      s_reconnected = false;
+      if (s_config.replay_jitter_ms > 0) {
+        vTaskDelay(pdMS_TO_TICKS(esp_random() % s_config.replay_jitter_ms));
+      }
+      ESP_LOGI(TAG, "Replaying %" PRIu32 " queued packets",
+               mesh_sf_engine_pending(&s_engine));
+      continue;
+    }
+
+    if (mesh_sf_replay_burst(burst) != ESP_OK) {
+      // Back off harder when the parent link is struggling
+      vTaskDelay(pdMS_TO_TICKS(s_config.burst_interval_ms * 10));
+      continue;
+    }
+    vTaskDelay(pdMS_TO_TICKS(s_config.burst_interval_ms));
+  }
+
+  free(burst);
+  vTaskDelete(NULL);
+}
+
+static void mesh_sf_event_handler(void *arg, esp_event_base_t event_base,
+                                  int32_t event_id, void *event_data) {
+  switch (event_id) {
+  case MESH_EVENT_PARENT_CONNECTED:
+    s_connected = true;
+    s_reconnected = true;
+    xTaskNotifyGive(s_task_handle);
+    break;
+  case MESH_EVENT_PARENT_DISCONNECTED:
+    s_connected = false;
+    break;
+  default:
+    break;
+  }
+}
+
+/*******************************************************
+ *                Public Functions
+ *******************************************************/
+esp_err_t mesh_store_forward_init(const mesh_store_forward_config_t *config) {
+  if (s_initialized) {
+    ESP_LOGW(TAG, "Already initialized");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  mesh_store_forward_config_t defaults = {
+      .ram_bytes = MESH_SF_DEFAULT_RAM_BYTES,
+      .partition_label = NULL,
+      .burst_bytes = MESH_SF_DEFAULT_BURST_BYTES,
+      .burst_interval_ms = MESH_SF_DEFAULT_BURST_INTERVAL_MS,
+      .replay_jitter_ms = MESH_SF_DEFAULT_REPLAY_JITTER_MS,
+  };
+  s_config = (config != NULL) ? *config : defaults;
+  if (s_config.burst_bytes == 0 ||
+      s_config.burst_bytes > MESH_SF_MAX_BURST_BYTES) {
+    s_config.burst_bytes = MESH_SF_MAX_BURST_BYTES;
+  }
+  if (s_config.ram_bytes < s_config.burst_bytes) {
+    s_config.ram_bytes = s_config.burst_bytes;
+  }
+
+  if (s_config.partition_label != NULL) {
+    s_partition =
+        esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                 ESP_PARTITION_SUBTYPE_ANY,
+                                 s_config.partition_label);
+    if (s_partition == NULL) {
+      ESP_LOGE(TAG, "Partition '%s' not found", s_config.partition_label);
+      return ESP_ERR_NOT_FOUND;
+    }
+  }
+
+  uint8_t *ram = malloc(s_config.ram_bytes);
+  s_lock = xSemaphoreCreateMutex();
+  if (ram == NULL || s_lock == NULL) {
+    ESP_LOGE(TAG, "Failed to allocate queue");
+    return ESP_ERR_NO_MEM;
+  }
+
+  mesh_sf_backend_t backend = {
+      .read = partition_read,
+      .write = partition_write,
+      .erase = partition_erase,
+      .size = s_partition ? s_partition->size : 0,
+      .ctx = (void *)s_partition,
+  };
+  esp_err_t err = mesh_sf_engine_init(&s_engine, ram, s_config.ram_bytes,
+                                      s_config.burst_bytes,
+                                      s_partition ? &backend : NULL);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to set up queue: %s", esp_err_to_name(err));
+    free(ram);
+    return err;
+  }
+
+  mesh_state_t state;
+  mesh_state_get(&state);
+  s_connected = state.started && state.connected;
+  ESP_ERROR_CHECK(esp_event_handler_register(
+      MESH_EVENT, MESH_EVENT_PARENT_CONNECTED, &mesh_sf_event_handler, NULL));
+  ESP_ERROR_CHECK(esp_event_handler_register(
+      MESH_EVENT, MESH_EVENT_PARENT_DISCONNECTED, &mesh_sf_event_handler,
+      NULL));
+
+  BaseType_t ret =
+      xTaskCreate(mesh_sf_task, "mesh_sf_task", MESH_SF_TASK_STACK_SIZE, NULL,
+                  MESH_SF_TASK_PRIORITY, &s_task_handle);
+  if (ret != pdPASS) {
+    ESP_LOGE(TAG, "Failed to create replay task");
+    return ESP_FAIL;
+  }
+
+  s_initialized = true;
+  ESP_LOGI(TAG, "Store-and-forward enabled: %u bytes RAM%s%s",
+           (unsigned)s_config.ram_bytes, s_partition ? ", spill to " : "",
+           s_partition ? s_partition->label : "");
+  return ESP_OK;
+}
+
+esp_err_t mesh_store_forward_get_stats(mesh_store_forward_stats_t *stats) {
+  if (stats == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (s_lock != NULL) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+  }
+  memcpy(stats, &s_engine.stats, sizeof(*stats));
+  if (s_lock != NULL) {
+    xSemaphoreGive(s_lock);
+  }
+  return ESP_OK;
+}
@@ -0,0 +1,334 @@
+/* Store-and-Forward Queue Engine Implementation */
+
+#include "mesh_store_forward_engine.h"
+#include <string.h>
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+#define PAD_LENGTH (0xFFFF) /* erased flash / end-of-sector marker */
+#define SPILL_CHUNK (64)
+
+/* Same layout as mesh_batch_record_header_t */
+typedef struct {
+  uint8_t type;
+  uint16_t length;
+} __attribute__((packed)) record_header_t;
+
+/*******************************************************
+ *                RAM Ring
+ *******************************************************/
+static void ram_copy_in(mesh_sf_engine_t *engine, size_t pos, const void *src,
+                        size_t n) {
+  size_t first = engine->ram_bytes - pos;
+  if (first > n) {
+    first = n;
+  }
+  memcpy(engine->ram + pos, src, first);
+  memcpy(engine->ram, (const uint8_t *)src + first, n - first);
+}
+
+static void ram_copy_out(const mesh_sf_engine_t *engine, size_t pos,
+                         void *dst, size_t n) {
+  size_t first = engine->ram_bytes - pos;
+  if (first > n) {
+    first = n;
+  }
+  memcpy(dst, engine->ram + pos, first);
+  memcpy((uint8_t *)dst + first, engine->ram, n - first);
+}
+
+static size_t ram_advance(const mesh_sf_engine_t *engine, size_t pos,
+                          size_t n) {
+  return (pos + n) % engine->ram_bytes;
+}
+
+static size_t ram_free(const mesh_sf_engine_t *engine) {
+  return engine->ram_bytes - engine->stats.ram_used;
+}
+
+static void ram_push(mesh_sf_engine_t *engine, const record_header_t *hdr,
+                     const uint8_t *payload) {
+  ram_copy_in(engine, engine->ram_tail, hdr, sizeof(*hdr));
+  engine->ram_tail = ram_advance(engine, engine->ram_tail, sizeof(*hdr));
+  ram_copy_in(engine, engine->ram_tail, payload, hdr->length);
+  engine->ram_tail = ram_advance(engine, engine->ram_tail, hdr->length);
+  engine->stats.ram_used += sizeof(*hdr) + hdr->length;
+  engine->ram_records++;
+}
+
+static void ram_pop(mesh_sf_engine_t *engine) {
+  record_header_t hdr;
+  ram_copy_out(engine, engine->ram_head, &hdr, sizeof(hdr));
+  engine->ram_head =
+      ram_advance(engine, engine->ram_head, sizeof(hdr) + hdr.length);
+  engine->stats.ram_used -= sizeof(hdr) + hdr.length;
+  engine->ram_records--;
+}
+
+/*******************************************************
+ *                Flash Ring
+ *******************************************************/
+static uint32_t flash_wrap(const mesh_sf_engine_t *engine, uint32_t pos) {
+  return (pos >= engine->flash.size) ? 0 : pos;
+}
+
+static uint32_t flash_next_sector(const mesh_sf_engine_t *engine,
+                                  uint32_t pos) {
+  uint32_t next = (pos / MESH_SF_SECTOR_SIZE + 1) * MESH_SF_SECTOR_SIZE;
+  return (next >= engine->flash.size) ? 0 : next;
+}
+
+/**
+ * @brief Read the record header at *pos, skipping sector padding
+ */
+static void flash_peek(const mesh_sf_engine_t *engine, uint32_t *pos,
+                       record_header_t *hdr) {
+  while (true) {
+    uint32_t room = MESH_SF_SECTOR_SIZE - (*pos % MESH_SF_SECTOR_SIZE);
+    if (room >= sizeof(*hdr)) {
+      engine->flash.read(engine->flash.ctx, *pos, hdr, sizeof(*hdr));
+      if (hdr->length != PAD_LENGTH) {
+        return;
+      }
+    }
+    *pos = flash_next_sector(engine, *pos);
+  }
+}
+
+static void flash_pop(mesh_sf_engine_t *engine) {
+  record_header_t hdr;
+  flash_peek(engine, &engine->flash_head, &hdr);
+  engine->flash_head =
+      flash_wrap(engine, engine->flash_head + sizeof(hdr) + hdr.length);
+  engine->stats.flash_used -= sizeof(hdr) + hdr.length;
+  if (--engine->flash_records == 0) {
+    engine->flash_head = engine->flash_tail;
+  } else {
+    // Keep the head on a real record so it never points into padding of a
+    // sector the tail may reuse
+    flash_peek(engine, &engine->flash_head, &hdr);
+  }
+}
+
+/**
+ * @brief Drop every record in the oldest flash sector to make room
+ */
+static void flash_drop_oldest_sector(mesh_sf_engine_t *engine) {
+  uint32_t sector = engine->flash_head / MESH_SF_SECTOR_SIZE;
+  while (engine->flash_records > 0) {
+    uint32_t pos = engine->flash_head;
+    record_header_t hdr;
+    flash_peek(engine, &pos, &hdr);
+    if (pos / MESH_SF_SECTOR_SIZE != sector) {
+      break;
+    }
+    flash_pop(engine);
+    engine->stats.dropped++;
+    engine->stats.pending--;
+  }
+}
+
+/**
+ * @brief Reserve room for a record at the end of the flash ring
+ *
+ * @return ESP_OK with flash_tail at the reserved room, ESP_ERR_NO_MEM if
+ *         the ring is full and the oldest data is pinned by a burst
+ */
+static esp_err_t flash_reserve(mesh_sf_engine_t *engine, uint32_t need) {
+  uint32_t room =
+      MESH_SF_SECTOR_SIZE - (engine->flash_tail % MESH_SF_SECTOR_SIZE);
+
+  if (room < need) {
+    if (room >= sizeof(record_header_t)) {
+      record_header_t pad = {.type = 0xFF, .length = PAD_LENGTH};
+      engine->flash.write(engine->flash.ctx, engine->flash_tail, &pad,
+                          sizeof(pad));
+    }
+    engine->flash_tail = flash_next_sector(engine, engine->flash_tail);
+  }
+
+  if (engine->flash_tail % MESH_SF_SECTOR_SIZE == 0) {
+    // Entering a sector: make sure it holds no unread data, then erase it
+    if (engine->flash_records > 0 &&
+        engine->flash_head / MESH_SF_SECTOR_SIZE ==
+            engine->flash_tail / MESH_SF_SECTOR_SIZE) {
+      if (engine->replaying) {
+        return ESP_ERR_NO_MEM;
+      }
+      flash_drop_oldest_sector(engine);
+    }
+    esp_err_t err = engine->flash.erase(engine->flash.ctx, engine->flash_tail,
+                                        MESH_SF_SECTOR_SIZE);
+    if (err != ESP_OK) {
+      return err;
+    }
+  }
+
+  if (engine->flash_records == 0) {
+    engine->flash_head = engine->flash_tail;
+  }
+  return ESP_OK;
+}
+
+/**
+ * @brief Move the oldest RAM record to the end of the flash ring
+ */
+static esp_err_t spill_oldest(mesh_sf_engine_t *engine) {
+  uint8_t chunk[SPILL_CHUNK];
+  record_header_t hdr;
+
+  ram_copy_out(engine, engine->ram_head, &hdr, sizeof(hdr));
+  uint32_t need = sizeof(hdr) + hdr.length;
+  esp_err_t err = flash_reserve(engine, need);
+  if (err != ESP_OK) {
+    return err;
+  }
+
+  // Header and payload are contiguous in the ring, copy them in pieces
+  for (uint32_t done = 0; done < need; done += sizeof(chunk)) {
+    uint32_t n = need - done < sizeof(chunk) ? need - done : sizeof(chunk);
+    ram_copy_out(engine, ram_advance(engine, engine->ram_head, done), chunk,
+                 n);
+    engine->flash.write(engine->flash.ctx, engine->flash_tail + done, chunk,
+                        n);
+  }
+  engine->flash_tail = flash_wrap(engine, engine->flash_tail + need);
+  engine->stats.flash_used += need;
+  engine->flash_records++;
+
+  ram_pop(engine);
+  engine->stats.spilled++;
+  return ESP_OK;
+}
+
+/*******************************************************
+ *                Queue
+ *******************************************************/
+esp_err_t mesh_sf_engine_init(mesh_sf_engine_t *engine, uint8_t *ram,
+                              size_t ram_bytes, uint16_t record_max,
+                              const mesh_sf_backend_t *flash) {
+  if (engine == NULL || ram == NULL ||
+      record_max <= sizeof(record_header_t)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (ram_bytes < record_max) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  memset(engine, 0, sizeof(*engine));
+  engine->ram = ram;
+  engine->ram_bytes = ram_bytes;
+  engine->record_max = record_max;
+  if (flash != NULL) {
+    if (flash->read == NULL || flash->write == NULL || flash->erase == NULL) {
+      return ESP_ERR_INVALID_ARG;
+    }
+    if (flash->size < MESH_SF_SECTOR_SIZE ||
+        record_max > MESH_SF_SECTOR_SIZE) {
+      return ESP_ERR_INVALID_SIZE;
+    }
+    engine->flash = *flash;
+    engine->flash.size -= engine->flash.size % MESH_SF_SECTOR_SIZE;
+    engine->has_flash = true;
+  }
+  return ESP_OK;
+}
+
+esp_err_t mesh_sf_engine_enqueue(mesh_sf_engine_t *engine, uint8_t data_type,
+                                 const uint8_t *payload, uint16_t length) {
+  record_header_t hdr = {.type = data_type, .length = length};
+  size_t need = sizeof(hdr) + length;
+
+  // A record that does not fit a burst would block the queue for good
+  if (need > engine->record_max) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  while (ram_free(engine) < need) {
+    if (engine->replaying) {
+      // The burst holds cursors into the queue; lose the newest instead
+      engine->stats.dropped++;
+      return ESP_ERR_NO_MEM;
+    }
+    if (engine->has_flash && spill_oldest(engine) == ESP_OK) {
+      continue;
+    }
+    ram_pop(engine);
+    engine->stats.dropped++;
+    engine->stats.pending--;
+  }
+  ram_push(engine, &hdr, payload);
+  engine->stats.queued++;
+  engine->stats.pending++;
+  return ESP_OK;
+}
+
+uint32_t mesh_sf_engine_take_burst(mesh_sf_engine_t *engine, uint8_t *buf,
+                                   size_t limit, mesh_sf_burst_t *burst) {
+  uint32_t flash_pos = engine->flash_head;
+  size_t ram_pos = engine->ram_head;
+
+  memset(burst, 0, sizeof(*burst));
+
+  // Oldest data lives in flash, newer data in RAM
+  while (burst->flash_taken < engine->flash_records) {
+    record_header_t hdr;
+    uint32_t pos = flash_pos;
+    flash_peek(engine, &pos, &hdr);
+    size_t next = burst->length + sizeof(hdr) + hdr.length;
+    if (burst->length > 0 && next > limit) {
+      break;
+    }
+    engine->flash.read(engine->flash.ctx, pos, buf + burst->length,
+                       sizeof(hdr) + hdr.length);
+    burst->length = next;
+    flash_pos = flash_wrap(engine, pos + sizeof(hdr) + hdr.length);
+    burst->flash_taken++;
+  }
+  while (burst->flash_taken == engine->flash_records &&
+         burst->ram_taken < engine->ram_records) {
+    record_header_t hdr;
+    ram_copy_out(engine, ram_pos, &hdr, sizeof(hdr));
+    size_t next = burst->length + sizeof(hdr) + hdr.length;
+    if (burst->length > 0 && next > limit) {
+      break;
+    }
+    ram_copy_out(engine, ram_pos, buf + burst->length,
+                 sizeof(hdr) + hdr.length);
+    burst->length = next;
+    ram_pos = ram_advance(engine, ram_pos, sizeof(hdr) + hdr.length);
+    burst->ram_taken++;
+  }
+
+  engine->replaying = (burst->length > 0);
+  return burst->flash_taken + burst->ram_taken;
+}
+
+void mesh_sf_engine_finish(mesh_sf_engine_t *engine,
+                           const mesh_sf_burst_t *burst, esp_err_t result) {
+  uint32_t taken = burst->flash_taken + burst->ram_taken;
+
+  engine->replaying = false;
+  if (result != ESP_OK && result != ESP_ERR_INVALID_SIZE) {
+    return;
+  }
+
+  for (uint32_t i = 0; i < burst->flash_taken; i++) {
+    flash_pop(engine);
+  }
+  for (uint32_t i = 0; i < burst->ram_taken; i++) {
+    ram_pop(engine);
+  }
+  engine->stats.pending -= taken;
+  if (result == ESP_OK) {
+    engine->stats.replayed += taken;
+    engine->stats.bursts++;
+  } else {
+    engine->stats.dropped += taken;
+  }
+}
+
+uint32_t mesh_sf_engine_pending(const mesh_sf_engine_t *engine) {
+  return engine->stats.pending;
+}
@@ -0,0 +1,337 @@
+/* ESP-MESH Root Telemetry Table Implementation */
+
+#include "mesh_telemetry.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "mesh.h"
+#include "mesh_aggregate_engine.h"
+#include "mesh_data_transfer.h"
+#include "mesh_internal.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+static const char *TAG = "mesh_telemetry";
+
+#define MESH_TELEMETRY_SERIES                                                 \
+  (MESH_TELEMETRY_MAX_NODES * MESH_TELEMETRY_MAX_CHANNELS)
+#define MESH_TELEMETRY_CELLS (MESH_TELEMETRY_SERIES * MESH_TELEMETRY_MAX_BUCKETS)
+#define MESH_TELEMETRY_SLOT_NONE (0xFF)
+
+/*******************************************************
+ *                Type Definitions
+ *******************************************************/
+
+/* Struct-of-arrays: series index = slot * MAX_CHANNELS + channel, bucket
+ * cell = series * MAX_BUCKETS + (epoch % MAX_BUCKETS), so the channels of a
+ * node and the buckets of a series are contiguous */
+typedef struct {
+  uint8_t node_id[MESH_TELEMETRY_MAX_NODES];
+  uint8_t valid[MESH_TELEMETRY_MAX_NODES]; /* channel bitmask */
+  float latest[MESH_TELEMETRY_SERIES];
+  uint32_t latest_ms[MESH_TELEMETRY_SERIES];
+  uint32_t epoch[MESH_TELEMETRY_CELLS];
+  uint32_t count[MESH_TELEMETRY_CELLS];
+  float min[MESH_TELEMETRY_CELLS];
+  float max[MESH_TELEMETRY_CELLS];
+  float sum[MESH_TELEMETRY_CELLS];
+} mesh_telemetry_table_t;
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static mesh_telemetry_config_t s_config;
+static mesh_telemetry_table_t *s_table = NULL;
+static uint8_t s_slot_of[256]; /* node_id -> slot */
+static int s_node_count = 0;
+
+/* Guards the table cells; held only for a copy of one node's series, so
+ * readers in timer callbacks and send paths never sleep */
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static inline uint32_t now_ms(void) {
+  return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static int lookup_slot(uint8_t node_id) {
+  if (s_table == NULL) {
+    return -1;
+  }
+  uint8_t slot = __atomic_load_n(&s_slot_of[node_id], __ATOMIC_ACQUIRE);
+  return (slot == MESH_TELEMETRY_SLOT_NONE) ? -1 : slot;
+}
+
+/**
+ * @brief Fold the buckets of a series that fall in [first, last] epochs
+ */
+static void sum_buckets(int series, uint32_t first, uint32_t last,
+                        mesh_telemetry_window_t *window) {
+  float sum = 0;
+
+  window->count = 0;
+  window->min = INFINITY;
+  window->max = -INFINITY;
+  for (int b = 0; b < MESH_TELEMETRY_MAX_BUCKETS; b++) {
+    int cell = series * MESH_TELEMETRY_MAX_BUCKETS + b;
+    uint32_t epoch = s_table->epoch[cell];
+    if (s_table->count[cell] == 0 || epoch < first || epoch > last) {
+      continue;
+    }
+    window->count += s_table->count[cell];
+    sum += s_table->sum[cell];
+    window->min = fminf(window->min, s_table->min[cell]);
+    window->max = fmaxf(window->max, s_table->max[cell]);
+  }
+  window->mean = (window->count > 0) ? sum / window->count : 0;
+}
+
+static void ingest_readings(uint8_t node_id, const uint8_t *payload,
+                            uint16_t length) {
+  for (uint16_t offset = 0; offset + sizeof(mesh_sensor_reading_t) <= length;
+       offset += sizeof(mesh_sensor_reading_t)) {
+    mesh_sensor_reading_t reading;
+    memcpy(&reading, payload + offset, sizeof(reading));
+    mesh_telemetry_update(node_id, reading.channel, reading.value);
+  }
+}
+
+/**
+ * @brief Record sensor packets and concatenated aggregates; the packets are
+ *        passed on to the application
+ */
+static bool mesh_telemetry_handle_packet(mesh_addr_t *from, uint8_t data_type,
+                                         uint8_t *payload, uint16_t length) {
+  uint8_t node_id;
+
+  if (data_type == MESH_DATA_TYPE_SENSOR) {
+    if (length % sizeof(mesh_sensor_reading_t) == 0 &&
+        mesh_get_node_id_by_addr(from, &node_id) == ESP_OK) {
+      ingest_readings(node_id, payload, length);
+    }
+    return false;
+  }
+
+  mesh_aggregate_header_t header;
+  if (length < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, payload, sizeof(header));
+  if (header.mode != MESH_AGGREGATE_MODE_CONCAT ||
+      length != sizeof(header) +
+                    header.entry_count * sizeof(mesh_aggregate_record_t)) {
+    return false;
+  }
+
+  for (int i = 0; i < header.entry_count; i++) {
+    mesh_aggregate_record_t record;
+    mesh_addr_t origin;
+    memcpy(&record, payload + sizeof(header) + i * sizeof(record),
+           sizeof(record));
+    memcpy(origin.addr, record.origin, sizeof(origin.addr));
+    if (mesh_get_node_id_by_addr(&origin, &node_id) == ESP_OK) {
+      mesh_telemetry_update(node_id, record.channel, record.value);
+    }
+  }
+  return false;
+}
+
+/*******************************************************
+ *                Public Functions
+ *******************************************************/
+esp_err_t mesh_telemetry_init(const mesh_telemetry_config_t *config) {
+  if (s_table != NULL) {
+    ESP_LOGW(TAG, "Already initialized");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  s_config.bucket_ms = MESH_TELEMETRY_DEFAULT_BUCKET_MS;
+  s_config.sliding_buckets = MESH_TELEMETRY_MAX_BUCKETS;
+  if (config != NULL) {
+    if (config->sliding_buckets > MESH_TELEMETRY_MAX_BUCKETS) {
+      ESP_LOGE(TAG, "Invalid arguments");
+      return ESP_ERR_INVALID_ARG;
+    }
+    if (config->bucket_ms != 0) {
+      s_config.bucket_ms = config->bucket_ms;
+    }
+    if (config->sliding_buckets != 0) {
+      s_config.sliding_buckets = config->sliding_buckets;
+    }
+  }
+
+  mesh_telemetry_table_t *table = calloc(1, sizeof(*table));
+  if (table == NULL) {
+    ESP_LOGE(TAG, "Failed to allocate %u byte table",
+             (unsigned)sizeof(*table));
+    return ESP_ERR_NO_MEM;
+  }
+  memset(s_slot_of, MESH_TELEMETRY_SLOT_NONE, sizeof(s_slot_of));
+  s_table = table;
+
+  esp_err_t err = mesh_data_transfer_register_type_handler(
+      MESH_DATA_TYPE_SENSOR, mesh_telemetry_handle_packet);
+  if (err == ESP_OK) {
+    err = mesh_data_transfer_register_type_handler(
+        MESH_DATA_TYPE_AGGREGATE, mesh_telemetry_handle_packet);
+  }
+  if (err != ESP_OK) {
+    return err;
+  }
+  mesh_caps_add_feature(MESH_NODE_FEATURE_AGGREGATE);
+
+  ESP_LOGI(TAG, "Telemetry table ready (%u bytes)", (unsigned)sizeof(*table));
+  return ESP_OK;
+}
+
+esp_err_t mesh_telemetry_update(uint8_t node_id, uint8_t channel,
+                                float value) {
+  if (s_table == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (channel >= MESH_TELEMETRY_MAX_CHANNELS) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  uint32_t now = now_ms();
+  uint32_t epoch = now / s_config.bucket_ms;
+
+  taskENTER_CRITICAL(&s_mux);
+  int slot = lookup_slot(node_id);
+  if (slot < 0 && s_node_count < MESH_TELEMETRY_MAX_NODES) {
+    slot = s_node_count;
+    s_table->node_id[slot] = node_id;
+    __atomic_store_n(&s_slot_of[node_id], (uint8_t)slot, __ATOMIC_RELEASE);
+    __atomic_store_n(&s_node_count, s_node_count + 1, __ATOMIC_RELEASE);
+  }
+  if (slot < 0) {
+    taskEXIT_CRITICAL(&s_mux);
+    ESP_LOGW(TAG, "Table full, node %u not tracked", node_id);
+    return ESP_ERR_NO_MEM;
+  }
+
+  int series = slot * MESH_TELEMETRY_MAX_CHANNELS + channel;
+  int cell =
+      series * MESH_TELEMETRY_MAX_BUCKETS + epoch % MESH_TELEMETRY_MAX_BUCKETS;
+  s_table->latest[series] = value;
+  s_table->latest_ms[series] = now;
+  s_table->valid[slot] |= 1 << channel;
+  if (s_table->epoch[cell] != epoch || s_table->count[cell] == 0) {
+    s_table->epoch[cell] = epoch;
+    s_table->count[cell] = 0;
+    s_table->min[cell] = value;
+    s_table->max[cell] = value;
+    s_table->sum[cell] = 0;
+  }
+  s_table->count[cell]++;
+  s_table->sum[cell] += value;
+  s_table->min[cell] = fminf(s_table->min[cell], value);
+  s_table->max[cell] = fmaxf(s_table->max[cell], value);
+  taskEXIT_CRITICAL(&s_mux);
+  return ESP_OK;
+}
+
+esp_err_t mesh_telemetry_get_latest(uint8_t node_id, uint8_t channel,
+                                    float *value, uint32_t *age_ms) {
+  if (value == NULL || channel >= MESH_TELEMETRY_MAX_CHANNELS) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  int slot = lookup_slot(node_id);
+  if (slot < 0) {
+    return ESP_ERR_NOT_FOUND;
+  }
+
+  int series = slot * MESH_TELEMETRY_MAX_CHANNELS + channel;
+  taskENTER_CRITICAL(&s_mux);
+  bool valid = s_table->valid[slot] & (1 << channel);
+  *value = s_table->latest[series];
+  uint32_t updated = s_table->latest_ms[series];
+  taskEXIT_CRITICAL(&s_mux);
+
+  if (!valid) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  if (age_ms != NULL) {
+    *age_ms = now_ms() - updated;
+  }
+  return ESP_OK;
+}
+
+esp_err_t mesh_telemetry_get_node_latest(uint8_t node_id,
+                                         mesh_telemetry_latest_t *latest) {
+  if (latest == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  int slot = lookup_slot(node_id);
+  if (slot < 0) {
+    return ESP_ERR_NOT_FOUND;
+  }
+
+  int first = slot * MESH_TELEMETRY_MAX_CHANNELS;
+  taskENTER_CRITICAL(&s_mux);
+  latest->valid_mask = s_table->valid[slot];
+  memcpy(latest->values, &s_table->latest[first], sizeof(latest->values));
+  memcpy(latest->age_ms, &s_table->latest_ms[first], sizeof(latest->age_ms));
+  taskEXIT_CRITICAL(&s_mux);
+
+  uint32_t now = now_ms();
+  for (int i = 0; i < MESH_TELEMETRY_MAX_CHANNELS; i++) {
+    latest->age_ms[i] = now - latest->age_ms[i];
+  }
+  return ESP_OK;
+}
+
+esp_err_t mesh_telemetry_get_window(uint8_t node_id, uint8_t channel,
+                                    mesh_telemetry_window_kind_t kind,
+                                    mesh_telemetry_window_t *window) {
+  if (window == NULL || channel >= MESH_TELEMETRY_MAX_CHANNELS) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  int slot = lookup_slot(node_id);
+  if (slot < 0) {
+    return ESP_ERR_NOT_FOUND;
+  }
+
+  uint32_t epoch = now_ms() / s_config.bucket_ms;
+  uint32_t first, last;
+  if (kind == MESH_TELEMETRY_WINDOW_TUMBLING) {
+    first = last = epoch - 1;
+  } else {
+    first = (epoch + 1 >= s_config.sliding_buckets)
+                ? epoch + 1 - s_config.sliding_buckets
+                : 0;
+    last = epoch;
+  }
+
+  int series = slot * MESH_TELEMETRY_MAX_CHANNELS + channel;
+  taskENTER_CRITICAL(&s_mux);
+  sum_buckets(series, first, last, window);
+  taskEXIT_CRITICAL(&s_mux);
+
+  if (window->count == 0) {
+    window->min = window->max = 0;
+  }
+  return ESP_OK;
+}
+
+int mesh_telemetry_get_nodes(uint8_t *node_ids, int max) {
+  if (s_table == NULL || node_ids == NULL) {
+    return 0;
+  }
+
+  int count = __atomic_load_n(&s_node_count, __ATOMIC_ACQUIRE);
+  if (count > max) {
+    count = max;
+  }
+  memcpy(node_ids, s_table->node_id, count);
+  return count;
+}
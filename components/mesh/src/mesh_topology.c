@@ -0,0 +1,318 @@
+/* ESP-MESH Topology Map Implementation */
+
+#include "mesh_topology.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_mesh.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "mesh_data_transfer.h"
+#include "mesh_internal.h"
+#include "mesh_link.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************************
+ *                Constants
+ *******************************************************/
+static const char *TAG = "mesh_topology";
+
+/*******************************************************
+ *                Variable Definitions
+ *******************************************************/
+static bool s_initialized = false;
+static mesh_topology_config_t s_config;
+static SemaphoreHandle_t s_lock = NULL;
+static mesh_topology_stats_t s_stats;
+
+/* Node side */
+static mesh_topology_encoder_t s_encoder;
+static bool s_keyframe_requested = false;
+
+/* Root side, allocated the first time this node is root */
+static mesh_topology_engine_t *s_engine = NULL;
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+static uint32_t now_ms(void) {
+  return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+/**
+ * @brief Allocate the map with this node as its root; called with s_lock held
+ */
+static bool engine_ensure(void) {
+  if (s_engine != NULL) {
+    return true;
+  }
+
+  s_engine = calloc(1, sizeof(*s_engine));
+  if (s_engine == NULL) {
+    ESP_LOGE(TAG, "Failed to allocate topology map");
+    return false;
+  }
+
+  uint8_t own_addr[6];
+  esp_read_mac(own_addr, ESP_MAC_WIFI_STA);
+  mesh_topology_engine_init(s_engine);
+  mesh_topology_engine_set_root(s_engine, own_addr);
+  return true;
+}
+
+static void mesh_topology_report(const mesh_state_t *state, bool keyframe) {
+  mesh_topology_sample_t sample = {0};
+  wifi_sta_list_t children;
+  wifi_ap_record_t ap_info;
+  mesh_link_estimate_t link;
+  uint8_t frame[MESH_TOPOLOGY_MAX_FRAME];
+
+  // The parent's station MAC is one below its softAP BSSID
+  memcpy(sample.parent, state->parent.addr, 6);
+  sample.parent[5] -= 1;
+  sample.layer = (uint8_t)state->layer;
+  if (esp_wifi_ap_get_sta_list(&children) == ESP_OK) {
+    sample.children = (uint8_t)children.num;
+  }
+  if (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
+    sample.rssi = ap_info.rssi;
+  }
+  if (mesh_link_get_parent(&link) == ESP_OK) {
+    sample.etx = link.etx;
+  }
+  // The reports themselves are not the node's traffic
+  sample.tx_packets = mesh_data_tx_packets() - s_stats.reports_sent;
+
+  uint16_t length = mesh_topology_encode(&s_encoder, &sample, keyframe, frame);
+  esp_err_t err =
+      mesh_data_send_packet(NULL, MESH_DATA_TODS | MESH_DATA_NONBLOCK,
+                            MESH_DATA_TYPE_TOPOLOGY, frame, length, NULL, 0);
+  if (err != ESP_OK) {
+    // The root sees a sequence gap and asks for a keyframe
+    ESP_LOGD(TAG, "Report failed: %s", esp_err_to_name(err));
+    return;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  s_stats.reports_sent++;
+  s_stats.bytes_sent += length;
+  if (frame[2] & MESH_TOPOLOGY_FLAG_KEYFRAME) {
+    s_stats.keyframes_sent++;
+  }
+  xSemaphoreGive(s_lock);
+}
+
+static void mesh_topology_task(void *arg) {
+  uint16_t since_keyframe = 0;
+  mesh_state_t state;
+
+  while (1) {
+    vTaskDelay(pdMS_TO_TICKS(s_config.interval_ms));
+    mesh_state_get(&state);
+    if (!state.started) {
+      continue;
+    }
+
+    if (state.is_root) {
+      xSemaphoreTake(s_lock, portMAX_DELAY);
+      if (engine_ensure()) {
+        s_stats.expired += mesh_topology_engine_expire(
+            s_engine, now_ms(),
+            s_config.interval_ms * MESH_TOPOLOGY_EXPIRE_INTERVALS);
+        s_stats.nodes = s_engine->count;
+      }
+      xSemaphoreGive(s_lock);
+    } else if (state.connected) {
+      bool keyframe =
+          __atomic_exchange_n(&s_keyframe_requested, false, __ATOMIC_RELAXED);
+      if (++since_keyframe >= s_config.keyframe_every) {
+        keyframe = true;
+      }
+      if (keyframe) {
+        since_keyframe = 0;
+      }
+      mesh_topology_report(&state, keyframe);
+    }
+  }
+}
+
+static bool mesh_topology_handle_packet(mesh_addr_t *from, uint8_t data_type,
+                                        uint8_t *payload, uint16_t length) {
+  if (length == 1 && payload[0] == MESH_TOPOLOGY_OP_KEYFRAME_REQUEST) {
+    __atomic_store_n(&s_keyframe_requested, true, __ATOMIC_RELAXED);
+    return true;
+  }
+
+  if (!mesh_state_is_root()) {
+    return true;
+  }
+
+  esp_err_t err = ESP_ERR_NO_MEM;
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  if (engine_ensure()) {
+    err = mesh_topology_engine_apply(s_engine, from->addr, payload, length,
+                                     now_ms());
+    s_stats.nodes = s_engine->count;
+  }
+  if (err == ESP_OK || err == ESP_ERR_INVALID_STATE) {
+    s_stats.reports_applied++;
+  }
+  if (err == ESP_ERR_NOT_FOUND || err == ESP_ERR_INVALID_STATE) {
+    s_stats.keyframe_requests++;
+  }
+  xSemaphoreGive(s_lock);
+
+  if (err == ESP_ERR_NOT_FOUND || err == ESP_ERR_INVALID_STATE) {
+    uint8_t request = MESH_TOPOLOGY_OP_KEYFRAME_REQUEST;
+    mesh_data_send_packet(from, MESH_DATA_FROMDS | MESH_DATA_NONBLOCK,
+                          MESH_DATA_TYPE_TOPOLOGY, &request, 1, NULL, 0);
+  } else if (err != ESP_OK) {
+    ESP_LOGW(TAG, "Report from " MACSTR " rejected: %s",
+             MAC2STR(from->addr), esp_err_to_name(err));
+  }
+  return true;
+}
+
+/*******************************************************
+ *                Public Functions
+ *******************************************************/
+esp_err_t mesh_topology_init(const mesh_topology_config_t *config) {
+  if (s_initialized) {
+    ESP_LOGW(TAG, "Already initialized");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  memset(&s_config, 0, sizeof(s_config));
+  if (config != NULL) {
+    s_config = *config;
+  }
+  if (s_config.interval_ms == 0) {
+    s_config.interval_ms = MESH_TOPOLOGY_DEFAULT_INTERVAL_MS;
+  }
+  if (s_config.keyframe_every == 0) {
+    s_config.keyframe_every = MESH_TOPOLOGY_DEFAULT_KEYFRAME_EVERY;
+  }
+
+  s_lock = xSemaphoreCreateMutex();
+  if (s_lock == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  esp_err_t err = mesh_data_transfer_register_type_handler(
+      MESH_DATA_TYPE_TOPOLOGY, mesh_topology_handle_packet);
+  if (err != ESP_OK) {
+    return err;
+  }
+
+  if (xTaskCreate(mesh_topology_task, "mesh_topology",
+                  MESH_TOPOLOGY_TASK_STACK_SIZE, NULL,
+                  MESH_TOPOLOGY_TASK_PRIORITY, NULL) != pdPASS) {
+    ESP_LOGE(TAG, "Failed to create topology task");
+    return ESP_ERR_NO_MEM;
+  }
+
+  s_initialized = true;
+  ESP_LOGI(TAG, "Topology reports every %" PRIu32 " ms",
+           s_config.interval_ms);
+  return ESP_OK;
+}
+
+esp_err_t mesh_topology_get_node(const uint8_t *mac,
+                                 mesh_topology_node_t *node) {
+  esp_err_t err = ESP_ERR_INVALID_STATE;
+
+  if (mac == NULL || node == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (s_lock == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  if (s_engine != NULL) {
+    int idx = mesh_topology_engine_find(s_engine, mac);
+    if (idx >= 0) {
+      *node = s_engine->nodes[idx];
+      err = ESP_OK;
+    } else {
+      err = ESP_ERR_NOT_FOUND;
+    }
+  }
+  xSemaphoreGive(s_lock);
+  return err;
+}
+
+int mesh_topology_subtree_size(const uint8_t *mac) {
+  mesh_topology_node_t node;
+
+  if (mesh_topology_get_node(mac, &node) != ESP_OK) {
+    return 0;
+  }
+  return node.subtree_size;
+}
+
+int mesh_topology_path(const uint8_t *mac, uint8_t (*path)[6], int max_hops) {
+  int hops = -1;
+
+  if (s_lock == NULL || mac == NULL || path == NULL) {
+    return -1;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  if (s_engine != NULL) {
+    hops = mesh_topology_engine_path(s_engine, mac, path, max_hops);
+  }
+  xSemaphoreGive(s_lock);
+  return hops;
+}
+
+int mesh_topology_busiest_relays(mesh_topology_relay_t *relays,
+                                 int max_relays) {
+  int count = 0;
+
+  if (s_lock == NULL || relays == NULL) {
+    return 0;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  if (s_engine != NULL) {
+    count = mesh_topology_engine_busiest(s_engine, relays, max_relays);
+  }
+  xSemaphoreGive(s_lock);
+  return count;
+}
+
+esp_err_t mesh_topology_visit(mesh_topology_visitor_t visitor, void *arg) {
+  esp_err_t err = ESP_ERR_INVALID_STATE;
+
+  if (s_lock == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  if (s_engine != NULL) {
+    visitor(s_engine, arg);
+    err = ESP_OK;
+  }
+  xSemaphoreGive(s_lock);
+  return err;
+}
+
+esp_err_t mesh_topology_get_stats(mesh_topology_stats_t *stats) {
+  if (stats == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (s_lock == NULL) {
+    memset(stats, 0, sizeof(*stats));
+    return ESP_OK;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  *stats = s_stats;
+  xSemaphoreGive(s_lock);
+  return ESP_OK;
+}
@@ -0,0 +1,453 @@
+/* Topology Tree Engine Implementation */
+
+#include "mesh_topology_engine.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define NONE MESH_TOPOLOGY_NONE
+
+/*******************************************************
+ *                Frame Encoding
+ *******************************************************/
+static uint16_t put_varint(uint8_t *out, uint32_t value) {
+  uint16_t len = 0;
+
+  while (value >= 0x80) {
+    out[len++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  out[len++] = (uint8_t)value;
+  return len;
+}
+
+static bool get_varint(const uint8_t *in, uint16_t length, uint16_t *pos,
+                       uint32_t *value) {
+  uint32_t result = 0;
+
+  for (int shift = 0; shift < 35 && *pos < length; shift += 7) {
+    uint8_t byte = in[(*pos)++];
+    result |= (uint32_t)(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+uint16_t mesh_topology_encode(mesh_topology_encoder_t *encoder,
+                              const mesh_topology_sample_t *sample,
+                              bool keyframe, uint8_t *frame) {
+  mesh_topology_sample_t *last = &encoder->last;
+  uint8_t flags = 0;
+  uint16_t pos = 3;
+
+  keyframe = keyframe || !encoder->primed;
+  if (keyframe) {
+    flags = MESH_TOPOLOGY_FLAG_KEYFRAME | MESH_TOPOLOGY_FIELD_PARENT |
+            MESH_TOPOLOGY_FIELD_LAYER | MESH_TOPOLOGY_FIELD_CHILDREN |
+            MESH_TOPOLOGY_FIELD_RSSI | MESH_TOPOLOGY_FIELD_TRAFFIC |
+            MESH_TOPOLOGY_FIELD_ETX;
+  } else {
+    if (memcmp(sample->parent, last->parent, 6) != 0) {
+      flags |= MESH_TOPOLOGY_FIELD_PARENT;
+    }
+    if (sample->layer != last->layer) {
+      flags |= MESH_TOPOLOGY_FIELD_LAYER;
+    }
+    if (sample->children != last->children) {
+      flags |= MESH_TOPOLOGY_FIELD_CHILDREN;
+    }
+    if (abs(sample->rssi - last->rssi) >= MESH_TOPOLOGY_RSSI_DEADBAND) {
+      flags |= MESH_TOPOLOGY_FIELD_RSSI;
+    }
+    if (sample->tx_packets != last->tx_packets) {
+      flags |= MESH_TOPOLOGY_FIELD_TRAFFIC;
+    }
+    if (abs(sample->etx - last->etx) >= MESH_TOPOLOGY_ETX_DEADBAND) {
+      flags |= MESH_TOPOLOGY_FIELD_ETX;
+    }
+  }
+
+  if (flags & MESH_TOPOLOGY_FIELD_PARENT) {
+    memcpy(&frame[pos], sample->parent, 6);
+    memcpy(last->parent, sample->parent, 6);
+    pos += 6;
+  }
+  if (flags & MESH_TOPOLOGY_FIELD_LAYER) {
+    frame[pos++] = sample->layer;
+    last->layer = sample->layer;
+  }
+  if (flags & MESH_TOPOLOGY_FIELD_CHILDREN) {
+    frame[pos++] = sample->children;
+    last->children = sample->children;
+  }
+  if (flags & MESH_TOPOLOGY_FIELD_RSSI) {
+    frame[pos++] = (uint8_t)sample->rssi;
+    last->rssi = sample->rssi; // small drifts add up until they are sent
+  }
+  if (flags & MESH_TOPOLOGY_FIELD_TRAFFIC) {
+    pos += put_varint(&frame[pos], sample->tx_packets - last->tx_packets);
+    last->tx_packets = sample->tx_packets;
+  }
+  if (flags & MESH_TOPOLOGY_FIELD_ETX) {
+    frame[pos++] = sample->etx;
+    last->etx = sample->etx;
+  }
+
+  frame[0] = MESH_TOPOLOGY_OP_REPORT;
+  frame[1] = encoder->seq++;
+  frame[2] = flags;
+  encoder->primed = true;
+  return pos;
+}
+
+/*******************************************************
+ *                Tree Maintenance
+ *******************************************************/
+static uint16_t mac_hash(const uint8_t *mac) {
+  return (uint16_t)((mac[3] * 31u + mac[4] * 7u + mac[5]) %
+                    MESH_TOPOLOGY_HASH_BUCKETS);
+}
+
+/* Add size and traffic to idx and every ancestor */
+static void add_to_ancestors(mesh_topology_engine_t *engine, uint16_t idx,
+                             int32_t size, int32_t traffic) {
+  for (int hops = 0; idx != NONE && hops < MESH_TOPOLOGY_MAX_NODES; hops++) {
+    mesh_topology_node_t *node = &engine->nodes[idx];
+    node->subtree_size = (uint16_t)(node->subtree_size + size);
+    node->subtree_traffic += (uint32_t)traffic;
+    idx = node->parent;
+  }
+}
+
+static void detach(mesh_topology_engine_t *engine, uint16_t idx) {
+  mesh_topology_node_t *node = &engine->nodes[idx];
+  uint16_t *link;
+
+  if (node->parent == NONE) {
+    return;
+  }
+
+  link = &engine->nodes[node->parent].first_child;
+  while (*link != NONE && *link != idx) {
+    link = &engine->nodes[*link].next_sibling;
+  }
+  if (*link == idx) {
+    *link = node->next_sibling;
+  }
+  add_to_ancestors(engine, node->parent, -(int32_t)node->subtree_size,
+                   -(int32_t)node->subtree_traffic);
+  node->parent = NONE;
+  node->next_sibling = NONE;
+}
+
+static void attach(mesh_topology_engine_t *engine, uint16_t idx,
+                   uint16_t parent) {
+  mesh_topology_node_t *node = &engine->nodes[idx];
+
+  /* A stale report can name a descendant as parent; keep the tree a tree */
+  for (uint16_t up = parent; up != NONE; up = engine->nodes[up].parent) {
+    if (up == idx) {
+      return;
+    }
+  }
+
+  node->parent = parent;
+  node->next_sibling = engine->nodes[parent].first_child;
+  engine->nodes[parent].first_child = idx;
+  add_to_ancestors(engine, parent, node->subtree_size,
+                   (int32_t)node->subtree_traffic);
+}
+
+static void set_parent(mesh_topology_engine_t *engine, uint16_t idx,
+                       const uint8_t *parent_mac) {
+  mesh_topology_node_t *node = &engine->nodes[idx];
+
+  if (node->parent != NONE &&
+      memcmp(engine->nodes[node->parent].mac, parent_mac, 6) == 0) {
+    return;
+  }
+
+  memcpy(node->parent_mac, parent_mac, 6);
+  detach(engine, idx);
+  int parent = mesh_topology_engine_find(engine, parent_mac);
+  if (parent >= 0 && idx != engine->root) {
+    attach(engine, idx, (uint16_t)parent);
+  }
+}
+
+static int insert(mesh_topology_engine_t *engine, const uint8_t *mac) {
+  int idx = -1;
+
+  for (int i = 0; i < MESH_TOPOLOGY_MAX_NODES; i++) {
+    if (!engine->nodes[i].used) {
+      idx = i;
+      break;
+    }
+  }
+  if (idx < 0) {
+    return -1;
+  }
+
+  mesh_topology_node_t *node = &engine->nodes[idx];
+  uint16_t bucket = mac_hash(mac);
+  memset(node, 0, sizeof(*node));
+  memcpy(node->mac, mac, 6);
+  node->used = true;
+  node->parent = NONE;
+  node->first_child = NONE;
+  node->next_sibling = NONE;
+  node->subtree_size = 1;
+  node->next_in_bucket = engine->buckets[bucket];
+  engine->buckets[bucket] = (uint16_t)idx;
+  engine->count++;
+
+  /* Children that reported this node as parent before it was known */
+  for (int i = 0; i < MESH_TOPOLOGY_MAX_NODES; i++) {
+    mesh_topology_node_t *orphan = &engine->nodes[i];
+    if (orphan->used && i != idx && i != engine->root &&
+        orphan->parent == NONE && memcmp(orphan->parent_mac, mac, 6) == 0) {
+      attach(engine, (uint16_t)i, (uint16_t)idx);
+    }
+  }
+  return idx;
+}
+
+static void remove_node(mesh_topology_engine_t *engine, uint16_t idx) {
+  mesh_topology_node_t *node = &engine->nodes[idx];
+  uint16_t *link = &engine->buckets[mac_hash(node->mac)];
+
+  detach(engine, idx);
+  while (node->first_child != NONE) {
+    mesh_topology_node_t *child = &engine->nodes[node->first_child];
+    node->first_child = child->next_sibling;
+    child->parent = NONE; // keeps parent_mac, reattached if idx returns
+    child->next_sibling = NONE;
+  }
+
+  while (*link != NONE && *link != idx) {
+    link = &engine->nodes[*link].next_in_bucket;
+  }
+  if (*link == idx) {
+    *link = node->next_in_bucket;
+  }
+  node->used = false;
+  engine->count--;
+}
+
+/*******************************************************
+ *                Function Definitions
+ *******************************************************/
+void mesh_topology_engine_init(mesh_topology_engine_t *engine) {
+  memset(engine, 0, sizeof(*engine));
+  for (int i = 0; i < MESH_TOPOLOGY_HASH_BUCKETS; i++) {
+    engine->buckets[i] = NONE;
+  }
+  engine->root = NONE;
+}
+
+esp_err_t mesh_topology_engine_set_root(mesh_topology_engine_t *engine,
+                                        const uint8_t *mac) {
+  int idx = mesh_topology_engine_find(engine, mac);
+
+  if (idx < 0) {
+    idx = insert(engine, mac);
+    if (idx < 0) {
+      return ESP_ERR_NO_MEM;
+    }
+  }
+
+  detach(engine, (uint16_t)idx);
+  engine->root = (uint16_t)idx;
+  engine->nodes[idx].layer = 1;
+  memset(engine->nodes[idx].parent_mac, 0, 6);
+  return ESP_OK;
+}
+
+int mesh_topology_engine_find(const mesh_topology_engine_t *engine,
+                              const uint8_t *mac) {
+  uint16_t idx = engine->buckets[mac_hash(mac)];
+
+  while (idx != NONE) {
+    if (memcmp(engine->nodes[idx].mac, mac, 6) == 0) {
+      return idx;
+    }
+    idx = engine->nodes[idx].next_in_bucket;
+  }
+  return -1;
+}
+
+esp_err_t mesh_topology_engine_apply(mesh_topology_engine_t *engine,
+                                     const uint8_t *mac, const uint8_t *frame,
+                                     uint16_t length, uint32_t now_ms) {
+  uint8_t parent[6] = {0};
+  uint8_t layer = 0, children = 0;
+  int8_t rssi = 0;
+  uint8_t etx = 0;
+  uint32_t tx_delta = 0;
+  uint16_t pos = 3;
+
+  if (length < 3 || frame[0] != MESH_TOPOLOGY_OP_REPORT) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  uint8_t seq = frame[1];
+  uint8_t flags = frame[2];
+  bool keyframe = (flags & MESH_TOPOLOGY_FLAG_KEYFRAME) != 0;
+
+  /* Parse everything first so a malformed frame changes nothing */
+  if (flags & MESH_TOPOLOGY_FIELD_PARENT) {
+    if (length < pos + 6) {
+      return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(parent, &frame[pos], 6);
+    pos += 6;
+  }
+  if (flags & MESH_TOPOLOGY_FIELD_LAYER) {
+    if (pos >= length) {
+      return ESP_ERR_INVALID_SIZE;
+    }
+    layer = frame[pos++];
+  }
+  if (flags & MESH_TOPOLOGY_FIELD_CHILDREN) {
+    if (pos >= length) {
+      return ESP_ERR_INVALID_SIZE;
+    }
+    children = frame[pos++];
+  }
+  if (flags & MESH_TOPOLOGY_FIELD_RSSI) {
+    if (pos >= length) {
+      return ESP_ERR_INVALID_SIZE;
+    }
+    rssi = (int8_t)frame[pos++];
+  }
+  if ((flags & MESH_TOPOLOGY_FIELD_TRAFFIC) &&
+      !get_varint(frame, length, &pos, &tx_delta)) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  if (flags & MESH_TOPOLOGY_FIELD_ETX) {
+    if (pos >= length) {
+      return ESP_ERR_INVALID_SIZE;
+    }
+    etx = frame[pos++];
+  }
+  if (pos != length) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  int idx = mesh_topology_engine_find(engine, mac);
+  bool gap = false;
+  if (idx < 0) {
+    if (!keyframe) {
+      return ESP_ERR_NOT_FOUND;
+    }
+    idx = insert(engine, mac);
+    if (idx < 0) {
+      return ESP_ERR_NO_MEM;
+    }
+  } else if (!keyframe) {
+    gap = (seq != (uint8_t)(engine->nodes[idx].seq + 1));
+  }
+
+  mesh_topology_node_t *node = &engine->nodes[idx];
+  node->seq = seq;
+  node->last_seen_ms = now_ms;
+  if (flags & MESH_TOPOLOGY_FIELD_PARENT) {
+    set_parent(engine, (uint16_t)idx, parent);
+  }
+  if (flags & MESH_TOPOLOGY_FIELD_LAYER) {
+    node->layer = layer;
+  }
+  if (flags & MESH_TOPOLOGY_FIELD_CHILDREN) {
+    node->children = children;
+  }
+  if (flags & MESH_TOPOLOGY_FIELD_RSSI) {
+    node->rssi = rssi;
+  }
+  if (flags & MESH_TOPOLOGY_FIELD_ETX) {
+    node->etx = etx;
+  }
+
+  /* Heartbeats without a traffic field count as zero packets */
+  int32_t diff = ((int32_t)tx_delta - (int32_t)node->traffic) / 4;
+  node->traffic += (uint32_t)diff;
+  add_to_ancestors(engine, (uint16_t)idx, 0, diff);
+
+  return gap ? ESP_ERR_INVALID_STATE : ESP_OK;
+}
+
+int mesh_topology_engine_expire(mesh_topology_engine_t *engine,
+                                uint32_t now_ms, uint32_t max_age_ms) {
+  int removed = 0;
+
+  for (int i = 0; i < MESH_TOPOLOGY_MAX_NODES; i++) {
+    mesh_topology_node_t *node = &engine->nodes[i];
+    if (node->used && i != engine->root &&
+        now_ms - node->last_seen_ms > max_age_ms) {
+      remove_node(engine, (uint16_t)i);
+      removed++;
+    }
+  }
+  return removed;
+}
+
+int mesh_topology_engine_path(const mesh_topology_engine_t *engine,
+                              const uint8_t *mac, uint8_t (*path)[6],
+                              int max_hops) {
+  int idx = mesh_topology_engine_find(engine, mac);
+  int depth = 0;
+
+  if (idx < 0) {
+    return -1;
+  }
+
+  for (uint16_t up = (uint16_t)idx;; up = engine->nodes[up].parent) {
+    if (up == NONE || depth >= max_hops) {
+      return -1;
+    }
+    depth++;
+    if (up == engine->root) {
+      break;
+    }
+  }
+
+  uint16_t up = (uint16_t)idx;
+  for (int i = depth - 1; i >= 0; i--) {
+    memcpy(path[i], engine->nodes[up].mac, 6);
+    up = engine->nodes[up].parent;
+  }
+  return depth;
+}
+
+int mesh_topology_engine_busiest(const mesh_topology_engine_t *engine,
+                                 mesh_topology_relay_t *relays,
+                                 int max_relays) {
+  int count = 0;
+
+  for (int i = 0; i < MESH_TOPOLOGY_MAX_NODES; i++) {
+    const mesh_topology_node_t *node = &engine->nodes[i];
+    if (!node->used || i == engine->root || node->first_child == NONE) {
+      continue;
+    }
+
+    mesh_topology_relay_t relay;
+    memcpy(relay.mac, node->mac, 6);
+    relay.layer = node->layer;
+    relay.subtree_size = node->subtree_size;
+    relay.relayed = node->subtree_traffic - node->traffic;
+
+    /* Insertion into the sorted output, dropping the quietest */
+    int pos = count < max_relays ? count++ : max_relays;
+    while (pos > 0 && relays[pos - 1].relayed < relay.relayed) {
+      if (pos < max_relays) {
+        relays[pos] = relays[pos - 1];
+      }
+      pos--;
+    }
+    if (pos < max_relays) {
+      relays[pos] = relay;
+    }
+  }
+  return count;
+}
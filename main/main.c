@@ -4,26 +4,34 @@
 #include "mesh.h"
 #include "mesh_data_transfer.h"
 #include "mesh_light.h"
+#include "mesh_reactor.h"
 #include "nvs_flash.h"
 
 static const char *TAG = "main";
 
+static mesh_reactor_timer_t s_root_timer;
+
+/*
+ Test job for the contineous brocasting the message
+*/
+static void root_send_job(const mesh_reactor_event_t *event, void *ctx) {
+  mesh_addr_t child_addr = {.addr = {0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF}};
+  uint8_t cmd[] = {0x01, 0x02};
+  mesh_send_to_child(&child_addr, MESH_DATA_TYPE_CONTROL, cmd, sizeof(cmd));
+
+  // Or broadcast to all children
+  mesh_broadcast_from_root(MESH_DATA_TYPE_STATUS, cmd, sizeof(cmd));
+}
+
 /*
- Test task for the contineous brocasting the message
+ Run the job only while this node is the root
 */
-static void mesh_receive_task(void *arg) {
-  while (true) {
-    if (esp_mesh_is_root()) {
-      mesh_addr_t child_addr = {.addr = {0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF}};
-      uint8_t cmd[] = {0x01, 0x02};
-      mesh_send_to_child(&child_addr, MESH_DATA_TYPE_CONTROL, cmd, sizeof(cmd));
-
-      // Or broadcast to all children
-      mesh_broadcast_from_root(MESH_DATA_TYPE_STATUS, cmd, sizeof(cmd));
-    }
-    vTaskDelay(pdMS_TO_TICKS(1000));
+static void mesh_state_handler(const mesh_reactor_event_t *event, void *ctx) {
+  if (event->mesh.id == MESH_EVENT_PARENT_CONNECTED && event->mesh.is_root) {
+    mesh_reactor_timer_start(s_root_timer, 1000, true);
+  } else if (event->mesh.id == MESH_EVENT_PARENT_DISCONNECTED) {
+    mesh_reactor_timer_stop(s_root_timer);
   }
-  vTaskDelete(NULL); // safe incase of the return from the task
 }
 
 void my_data_handler(mesh_addr_t *from, uint8_t data_type, uint8_t *payload,
@@ -46,9 +54,6 @@ void my_data_handler(mesh_addr_t *from, uint8_t data_type, uint8_t *payload,
 void app_main(void) {
   ESP_LOGI(TAG, "Starting ESP32 Secure Mesh IoT...");
 
-  /* Initialize mesh light indicator */
-  ESP_ERROR_CHECK(mesh_light_init());
-
   /* Initialize NVS */
   ESP_ERROR_CHECK(nvs_flash_init());
 
@@ -58,6 +63,13 @@ void app_main(void) {
   /* Create default event loop */
   ESP_ERROR_CHECK(esp_event_loop_create_default());
 
+  /* Start the reactor before the mesh so no state event is missed */
+  ESP_ERROR_CHECK(mesh_reactor_init(NULL));
+  ESP_ERROR_CHECK(
+      mesh_reactor_timer_create(root_send_job, NULL, &s_root_timer));
+  ESP_ERROR_CHECK(
+      mesh_reactor_register(MESH_REACTOR_EVENT_MESH, mesh_state_handler, NULL));
+
   /* Initialize and start mesh network */
   ESP_ERROR_CHECK(mesh_init());
 
@@ -67,12 +79,16 @@ void app_main(void) {
   // Register receive callback
   ESP_ERROR_CHECK(mesh_register_receive_callback(my_data_handler));
 
+  /* The light indicator is not needed for the first packet, so its LEDC
+   * and fade setup runs while the mesh is already connecting */
+  ESP_ERROR_CHECK(mesh_light_init());
+
   // Send data from child to root
   // uint8_t sensor_data[] = {0x12, 0x34, 0x56, 0x78};
   // mesh_send_to_root(MESH_DATA_TYPE_SENSOR, sensor_data, sizeof(sensor_data));
 
   // Send data from root to specific child (if root)
-  // if (esp_mesh_is_root()) {
+  // if (mesh_state_is_root()) {
   //   mesh_addr_t child_addr = {.addr = {0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF}};
   //   uint8_t cmd[] = {0x01, 0x02};
   //   mesh_send_to_child(&child_addr, MESH_DATA_TYPE_CONTROL, cmd,
@@ -82,8 +98,5 @@ void app_main(void) {
   //   mesh_broadcast_from_root(MESH_DATA_TYPE_STATUS, cmd, sizeof(cmd));
   // }
 
-  // Create mesh receive task
-  xTaskCreate(mesh_receive_task, "mesh_rx_task", 4096, NULL, 5, NULL);
-
   ESP_LOGI(TAG, "Initialization complete");
 }
\ No newline at end of file
@@ -7,9 +7,15 @@
 #include "esp_log.h"
 #include "esp_mac.h"
 #include "esp_mesh.h"
+#include "esp_system.h"
+#include "esp_timer.h"
 #include "mesh.h"
+#include "mesh_aggregate_engine.h"
+#include "mesh_config_store.h"
 #include "mesh_data_transfer.h"
 #include "mesh_light.h"
+#include "mesh_reactor.h"
+#include "mesh_telemetry.h"
 #include "nvs_flash.h"
 
 static const char *TAG = "main";
@@ -41,7 +47,7 @@ void my_data_handler(mesh_addr_t *from, uint8_t data_type, uint8_t *payload,
     // Handle control commands
     break;
   case MESH_DATA_TYPE_CONFIG:
-    // This is handled automatically by mesh_register_node
+    // Identities are registered by the mesh component and never get here
     ESP_LOGI(TAG, "Config data received");
     break;
   default:
@@ -51,80 +57,144 @@ void my_data_handler(mesh_addr_t *from, uint8_t data_type, uint8_t *payload,
 }
 
 /*******************************************************
- *                Root Node Task
+ *                Timers
  *******************************************************/
-static void root_send_task(void *arg) {
-  ESP_LOGI(TAG, "Root send task started");
-
-  // Wait for mesh network to stabilize
-  vTaskDelay(pdMS_TO_TICKS(10000));
-
-  while (1) {
-    if (esp_mesh_is_root()) {
-      int node_count = mesh_get_registered_node_count();
-      ESP_LOGI(TAG, "=== Registered Nodes: %d ===", node_count);
-
-      // Print all registered nodes
-      for (int i = 0; i < node_count; i++) {
-        mesh_registered_node_t node_info;
-        if (mesh_get_registered_node_info(i, &node_info) == ESP_OK) {
-          ESP_LOGI(TAG, "  Node %d: ID=%d, Name=%s, Type=%d, Active=%d", i,
-                   node_info.node_id, node_info.name, node_info.node_type,
-                   node_info.is_active);
-        }
-      }
+static mesh_reactor_timer_t s_root_timer;
+static mesh_reactor_timer_t s_child_timer;
+static mesh_reactor_timer_t s_stats_timer;
+
+#define STATS_PERIOD_MS (60000)
+
+/*******************************************************
+ *                Root Node Job
+ *******************************************************/
+static void root_send_job(const mesh_reactor_event_t *event, void *ctx) {
+  if (!mesh_state_is_root()) {
+    return;
+  }
 
-      // Example 1: Send to a specific node by ID
-      uint8_t cmd[] = {0x01, 0x02, 0x03};
-      esp_err_t err =
-          mesh_send_to_node_id(2, MESH_DATA_TYPE_CONTROL, cmd, sizeof(cmd));
-      if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Successfully sent to node ID 2");
-      } else if (err == ESP_ERR_NOT_FOUND) {
-        ESP_LOGW(TAG, "Node ID 2 not found in registry");
+  // Start recording sensor readings once this node is the root
+  static bool telemetry_started = false;
+  if (!telemetry_started) {
+    telemetry_started = (mesh_telemetry_init(NULL) == ESP_OK);
+  }
+
+  int node_count = mesh_get_registered_node_count();
+  ESP_LOGI(TAG, "=== Registered Nodes: %d ===", node_count);
+
+  // Print all registered nodes
+  for (int i = 0; i < node_count; i++) {
+    mesh_registered_node_t node_info;
+    if (mesh_get_registered_node_info(i, &node_info) == ESP_OK) {
+      ESP_LOGI(TAG, "  Node %d: ID=%d, Name=%s, Type=%d, Active=%d", i,
+               node_info.node_id, node_info.name, node_info.node_type,
+               node_info.is_active);
+      if (node_info.caps.protocol > 0) {
+        ESP_LOGI(TAG, "    Protocol %u, features 0x%04x, firmware 0x%08" PRIx32,
+                 node_info.caps.protocol, node_info.caps.features,
+                 node_info.caps.firmware);
       }
 
-      // Example 2: Send different data to different node types
-      for (int i = 0; i < node_count; i++) {
-        mesh_registered_node_t node_info;
-        if (mesh_get_registered_node_info(i, &node_info) == ESP_OK) {
-          if (node_info.node_type == MESH_NODE_TYPE_SENSOR) {
-            // Send sensor configuration
-            uint8_t sensor_config[] = {0x10, 0x20};
-            mesh_send_to_node_id(node_info.node_id, MESH_DATA_TYPE_CONFIG,
-                                 sensor_config, sizeof(sensor_config));
-          } else if (node_info.node_type == MESH_NODE_TYPE_ACTUATOR) {
-            // Send actuator command
-            uint8_t actuator_cmd[] = {0x30, 0x40};
-            mesh_send_to_node_id(node_info.node_id, MESH_DATA_TYPE_CONTROL,
-                                 actuator_cmd, sizeof(actuator_cmd));
-          }
-        }
+      mesh_telemetry_latest_t latest;
+      if (mesh_telemetry_get_node_latest(node_info.node_id, &latest) ==
+              ESP_OK &&
+          (latest.valid_mask & 0x01)) {
+        ESP_LOGI(TAG, "    Channel 0: %.2f (%" PRIu32 " ms ago)",
+                 latest.values[0], latest.age_ms[0]);
       }
+    }
+  }
 
-      // Example 3: Broadcast to all children
-      uint8_t broadcast_msg[] = {0xFF, 0xFF};
-      mesh_broadcast_from_root(MESH_DATA_TYPE_STATUS, broadcast_msg,
-                               sizeof(broadcast_msg));
-      ESP_LOGI(TAG, "Broadcast sent to all children");
+  // Example 1: Send to a specific node by ID
+  uint8_t cmd[] = {0x01, 0x02, 0x03};
+  esp_err_t err =
+      mesh_send_to_node_id(2, MESH_DATA_TYPE_CONTROL, cmd, sizeof(cmd));
+  if (err == ESP_OK) {
+    ESP_LOGI(TAG, "Successfully sent to node ID 2");
+  } else if (err == ESP_ERR_NOT_FOUND) {
+    ESP_LOGW(TAG, "Node ID 2 not found in registry");
+  }
+
+  // Example 2: Share the sensor configuration through the config store;
+  // publishing an unchanged value sends nothing
+  uint8_t sensor_config[] = {0x10, 0x20};
+  mesh_config_store_set("sensor_cfg", sensor_config, sizeof(sensor_config));
+  mesh_config_store_publish();
+
+  // Example 3: Send commands to actuator nodes
+  for (int i = 0; i < node_count; i++) {
+    mesh_registered_node_t node_info;
+    if (mesh_get_registered_node_info(i, &node_info) == ESP_OK) {
+      if (node_info.node_type == MESH_NODE_TYPE_ACTUATOR) {
+        // Send actuator command
+        uint8_t actuator_cmd[] = {0x30, 0x40};
+        mesh_send_to_node_id(node_info.node_id, MESH_DATA_TYPE_CONTROL,
+                             actuator_cmd, sizeof(actuator_cmd));
+      }
     }
+  }
 
-    vTaskDelay(pdMS_TO_TICKS(10000)); // Send every 10 seconds
+  // Example 4: Broadcast to all children
+  uint8_t broadcast_msg[] = {0xFF, 0xFF};
+  mesh_broadcast_from_root(MESH_DATA_TYPE_STATUS, broadcast_msg,
+                           sizeof(broadcast_msg));
+  ESP_LOGI(TAG, "Broadcast sent to all children");
+}
+
+/*******************************************************
+ *                Child Node Job
+ *******************************************************/
+static void child_send_job(const mesh_reactor_event_t *event, void *ctx) {
+  if (mesh_state_is_root()) {
+    return;
+  }
+
+  // Send sensor data to root
+  mesh_sensor_reading_t sensor_data[] = {{.channel = 0, .value = 21.5f}};
+  esp_err_t err =
+      mesh_send_to_root(MESH_DATA_TYPE_SENSOR, (uint8_t *)sensor_data,
+                        sizeof(sensor_data));
+  if (err == ESP_OK) {
+    ESP_LOGI(TAG, "Sensor data sent to root");
   }
-  vTaskDelete(NULL);
 }
 
 /*******************************************************
- *                Child Node Task
+ *                Reactor Statistics Job
  *******************************************************/
-static void child_send_task(void *arg) {
-  ESP_LOGI(TAG, "Child send task started");
+static void stats_job(const mesh_reactor_event_t *event, void *ctx) {
+  static uint32_t last_wakeups = 0;
+  static int64_t last_us = 0;
+  mesh_reactor_stats_t stats;
+
+  // Wakeups per second of the only application task, and the RAM it costs
+  mesh_reactor_get_stats(&stats);
+  int64_t now_us = esp_timer_get_time();
+  float rate = (stats.wakeups - last_wakeups) / ((now_us - last_us) / 1e6f);
+  ESP_LOGI(TAG,
+           "Reactor: %.2f wakeups/s, stack %u of %u B used, queue high "
+           "water %u of %u, heap free %u B (min %u B)",
+           rate, (unsigned)(stats.stack_size - stats.stack_free_min),
+           (unsigned)stats.stack_size, stats.queue_high_water,
+           stats.queue_length, (unsigned)esp_get_free_heap_size(),
+           (unsigned)esp_get_minimum_free_heap_size());
+  last_wakeups = stats.wakeups;
+  last_us = now_us;
+}
 
-  // Wait for mesh connection
-  vTaskDelay(pdMS_TO_TICKS(5000));
+/*******************************************************
+ *                Mesh State Handler
+ *******************************************************/
+static void mesh_state_handler(const mesh_reactor_event_t *event, void *ctx) {
+  switch (event->mesh.id) {
+  case MESH_EVENT_PARENT_CONNECTED:
+    if (event->mesh.is_root) {
+      mesh_reactor_timer_stop(s_child_timer);
+      mesh_reactor_timer_start(s_root_timer, 10000, true);
+      break;
+    }
 
-  // Announce identity to root
-  if (!esp_mesh_is_root()) {
+    // Announce identity to root
     ESP_LOGI(TAG, "Announcing identity to root...");
     esp_err_t err =
         mesh_announce_node_identity(MY_NODE_ID, MY_NODE_TYPE, MY_NODE_NAME);
@@ -133,22 +203,16 @@ static void child_send_task(void *arg) {
     } else {
       ESP_LOGE(TAG, "Failed to announce identity: %s", esp_err_to_name(err));
     }
+    mesh_reactor_timer_stop(s_root_timer);
+    mesh_reactor_timer_start(s_child_timer, 15000, true); // Every 15 seconds
+    break;
+  case MESH_EVENT_PARENT_DISCONNECTED:
+    mesh_reactor_timer_stop(s_root_timer);
+    mesh_reactor_timer_stop(s_child_timer);
+    break;
+  default:
+    break;
   }
-
-  while (1) {
-    if (!esp_mesh_is_root()) {
-      // Send sensor data to root
-      uint8_t sensor_data[] = {0x12, 0x34, 0x56, 0x78};
-      esp_err_t err = mesh_send_to_root(MESH_DATA_TYPE_SENSOR, sensor_data,
-                                        sizeof(sensor_data));
-      if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Sensor data sent to root");
-      }
-    }
-
-    vTaskDelay(pdMS_TO_TICKS(15000)); // Send every 15 seconds
-  }
-  vTaskDelete(NULL);
 }
 
 /*******************************************************
@@ -159,9 +223,6 @@ void app_main(void) {
   ESP_LOGI(TAG, "Node Configuration: ID=%d, Type=%d, Name=%s", MY_NODE_ID,
            MY_NODE_TYPE, MY_NODE_NAME);
 
-  /* Initialize mesh light indicator */
-  ESP_ERROR_CHECK(mesh_light_init());
-
   /* Initialize NVS */
   ESP_ERROR_CHECK(nvs_flash_init());
 
@@ -171,6 +232,21 @@ void app_main(void) {
   /* Create default event loop */
   ESP_ERROR_CHECK(esp_event_loop_create_default());
 
+  /* Run the root and child jobs from the reactor task */
+  // Note: We don't know if we're root yet, so the jobs are started from
+  // mesh state events once the role is known, so set them up before
+  // the mesh starts
+  ESP_ERROR_CHECK(mesh_reactor_init(NULL));
+  ESP_ERROR_CHECK(
+      mesh_reactor_timer_create(root_send_job, NULL, &s_root_timer));
+  ESP_ERROR_CHECK(
+      mesh_reactor_timer_create(child_send_job, NULL, &s_child_timer));
+  ESP_ERROR_CHECK(
+      mesh_reactor_register(MESH_REACTOR_EVENT_MESH, mesh_state_handler, NULL));
+  ESP_ERROR_CHECK(mesh_reactor_timer_create(stats_job, NULL, &s_stats_timer));
+  ESP_ERROR_CHECK(
+      mesh_reactor_timer_start(s_stats_timer, STATS_PERIOD_MS, true));
+
   /* Initialize and start mesh network */
   ESP_ERROR_CHECK(mesh_init());
 
@@ -180,11 +256,12 @@ void app_main(void) {
   /* Register receive callback */
   ESP_ERROR_CHECK(mesh_register_receive_callback(my_data_handler));
 
-  /* Create tasks based on node role */
-  // Note: We don't know if we're root yet, so create both tasks
-  // They will check esp_mesh_is_root() before executing
-  xTaskCreate(root_send_task, "root_tx", 4096, NULL, 5, NULL);
-  xTaskCreate(child_send_task, "child_tx", 4096, NULL, 5, NULL);
+  /* Replicate the mesh-wide configuration from the root */
+  ESP_ERROR_CHECK(mesh_config_store_init(NULL));
+
+  /* The light indicator is not needed for the first packet, so its LEDC
+   * and fade setup runs while the mesh is already connecting */
+  ESP_ERROR_CHECK(mesh_light_init());
 
   ESP_LOGI(TAG, "Initialization complete");
 }